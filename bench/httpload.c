@@ -0,0 +1,429 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+/*
+ * Load client for output_http. It opens a number of multipart streams and
+ * snapshot pollers and reports the frames each of them received, the gaps
+ * between the frames and the CPU time it took. With the PID of the server
+ * it also reports the CPU time and memory of the server.
+ *
+ * usage: httpload [-H host] [-p port] [-s streams] [-n pollers]
+ *                 [-t seconds] [-P server pid]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BUFFER_SIZE (64 * 1024)
+
+enum client_type { STREAM, SNAPSHOT };
+
+typedef struct _client client;
+struct _client {
+    int id;
+    enum client_type type;
+    pthread_t thread;
+
+    /* receive buffer */
+    int fd;
+    char buffer[BUFFER_SIZE];
+    int pos, len;
+
+    long frames;
+    long long bytes;
+    int errors;
+    double last;
+    double *gaps;
+    int ngaps, allocated;
+    double cpu;
+};
+
+static struct sockaddr_in server;
+static volatile int stop = 0;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_server(client *c)
+{
+    struct timeval tv = { 1, 0 };
+
+    if((c->fd = socket(PF_INET, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+    /* wake up once a second to notice the end of the run */
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if(connect(c->fd, (struct sockaddr *)&server, sizeof(server)) != 0) {
+        close(c->fd);
+        return -1;
+    }
+
+    c->pos = c->len = 0;
+    return 0;
+}
+
+/* refill the receive buffer, returns 0 on EOF or error and at the end of the run */
+static int fill(client *c)
+{
+    int n;
+
+    while(!stop) {
+        n = recv(c->fd, c->buffer, BUFFER_SIZE, 0);
+        if(n < 0 && (errno == EAGAIN || errno == EINTR))
+            continue;
+        if(n <= 0)
+            return 0;
+        c->pos = 0;
+        c->len = n;
+        return n;
+    }
+
+    return 0;
+}
+
+/* read a line without the line end, returns -1 if the connection ended */
+static int read_line(client *c, char *line, int size)
+{
+    int n = 0;
+    char ch;
+
+    while(1) {
+        if(c->pos == c->len && fill(c) == 0)
+            return -1;
+        ch = c->buffer[c->pos++];
+        if(ch == '\n')
+            break;
+        if(ch != '\r' && n < size - 1)
+            line[n++] = ch;
+    }
+
+    line[n] = '\0';
+    return n;
+}
+
+/* skip a number of bytes, returns -1 if the connection ended */
+static int skip(client *c, long count)
+{
+    int n;
+
+    while(count > 0) {
+        if(c->pos == c->len && fill(c) == 0)
+            return -1;
+        n = (count < c->len - c->pos) ? count : c->len - c->pos;
+        c->pos += n;
+        count -= n;
+    }
+
+    return 0;
+}
+
+static void frame_received(client *c, long size)
+{
+    double t = now(), *g;
+
+    if(c->frames > 0) {
+        if(c->ngaps == c->allocated) {
+            c->allocated = c->allocated ? 2 * c->allocated : 1024;
+            if((g = realloc(c->gaps, c->allocated * sizeof(double))) == NULL) {
+                c->allocated = c->ngaps;
+                return;
+            }
+            c->gaps = g;
+        }
+        c->gaps[c->ngaps++] = t - c->last;
+    }
+
+    c->last = t;
+    c->frames++;
+    c->bytes += size;
+}
+
+static int send_request(client *c, const char *action)
+{
+    char request[128];
+    int len = snprintf(request, sizeof(request), "GET /?action=%s HTTP/1.0\r\n\r\n", action);
+
+    return (send(c->fd, request, len, MSG_NOSIGNAL) == len) ? 0 : -1;
+}
+
+/* one multipart stream, the length of each part is in its header */
+static void run_stream(client *c)
+{
+    char line[256];
+    long length;
+
+    if(connect_server(c) < 0 || send_request(c, "stream") < 0) {
+        c->errors++;
+        return;
+    }
+
+    /* response header */
+    while(read_line(c, line, sizeof(line)) > 0);
+
+    while(!stop) {
+        /* blank lines and the boundary come before the headers of a part */
+        length = -1;
+        while(read_line(c, line, sizeof(line)) >= 0) {
+            if(strncasecmp(line, "Content-Length:", 15) == 0)
+                length = atol(line + 15);
+            else if(line[0] == '\0' && length >= 0)
+                break;
+        }
+
+        if(length < 0 || skip(c, length) < 0)
+            break;
+
+        frame_received(c, length);
+    }
+
+    close(c->fd);
+}
+
+/* fetch snapshots one after another */
+static void run_snapshots(client *c)
+{
+    char line[256];
+    long length;
+    int ok;
+
+    while(!stop) {
+        if(connect_server(c) < 0 || send_request(c, "snapshot") < 0) {
+            c->errors++;
+            usleep(10000);
+            continue;
+        }
+
+        ok = (read_line(c, line, sizeof(line)) > 0 && strstr(line, " 200 ") != NULL);
+        while(read_line(c, line, sizeof(line)) > 0);
+
+        /* the snapshot ends with the connection */
+        for(length = c->len - c->pos; fill(c) > 0; length += c->len);
+
+        if(ok && !stop)
+            frame_received(c, length);
+        else if(!ok)
+            c->errors++;
+
+        close(c->fd);
+    }
+}
+
+static void *client_thread(void *arg)
+{
+    client *c = arg;
+    struct timespec cpu;
+
+    if(c->type == STREAM)
+        run_stream(c);
+    else
+        run_snapshots(c);
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    c->cpu = cpu.tv_sec + cpu.tv_nsec / 1e9;
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(client *c, int p)
+{
+    int i;
+
+    if(c->ngaps == 0)
+        return 0.0;
+
+    i = (int)((long long)c->ngaps * p / 100);
+    return c->gaps[(i < c->ngaps) ? i : c->ngaps - 1];
+}
+
+/* CPU time of a process in seconds, -1 if it can not be read */
+static double process_cpu(int pid)
+{
+    char name[64], buffer[1024], *p;
+    unsigned long utime, stime;
+    FILE *f;
+    int n;
+
+    snprintf(name, sizeof(name), "/proc/%d/stat", pid);
+    if((f = fopen(name, "r")) == NULL)
+        return -1.0;
+    n = fread(buffer, 1, sizeof(buffer) - 1, f);
+    fclose(f);
+    buffer[(n > 0) ? n : 0] = '\0';
+
+    /* the command may contain blanks, the fields follow the last parenthesis */
+    if((p = strrchr(buffer, ')')) == NULL ||
+       sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return -1.0;
+
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+/* a value in kB of /proc/PID/status, -1 if it can not be read */
+static long process_status(int pid, const char *key)
+{
+    char name[64], line[256];
+    long value = -1;
+    int len = strlen(key);
+    FILE *f;
+
+    snprintf(name, sizeof(name), "/proc/%d/status", pid);
+    if((f = fopen(name, "r")) == NULL)
+        return -1;
+    while(fgets(line, sizeof(line), f) != NULL) {
+        if(strncmp(line, key, len) == 0 && line[len] == ':') {
+            value = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(f);
+
+    return value;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-H host] [-p port] [-s streams] [-n pollers] [-t seconds] [-P server pid]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *host = "127.0.0.1";
+    int port = 8080, streams = 1, pollers = 0, seconds = 10, pid = 0;
+    int i, opt, count;
+    double start, elapsed, cpu_start = -1.0, cpu_end, total = 0.0;
+    client *clients, *c;
+
+    while((opt = getopt(argc, argv, "H:p:s:n:t:P:h")) != -1) {
+        switch(opt) {
+        case 'H': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 's': streams = atoi(optarg); break;
+        case 'n': pollers = atoi(optarg); break;
+        case 't': seconds = atoi(optarg); break;
+        case 'P': pid = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    count = streams + pollers;
+    if(count < 1 || seconds < 1 || streams < 0 || pollers < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if(inet_aton(host, &server.sin_addr) == 0) {
+        fprintf(stderr, "%s is not an IPv4 address\n", host);
+        return EXIT_FAILURE;
+    }
+
+    if((clients = calloc(count, sizeof(client))) == NULL) {
+        fprintf(stderr, "not enough memory\n");
+        return EXIT_FAILURE;
+    }
+
+    /* the input plugin may take a while to prepare its frames */
+    for(i = 0; i < 100; i++) {
+        int fd = socket(PF_INET, SOCK_STREAM, 0);
+        opt = connect(fd, (struct sockaddr *)&server, sizeof(server));
+        close(fd);
+        if(opt == 0)
+            break;
+        usleep(100000);
+    }
+    if(opt != 0) {
+        fprintf(stderr, "could not connect to %s:%d\n", host, port);
+        return EXIT_FAILURE;
+    }
+
+    if(pid > 0)
+        cpu_start = process_cpu(pid);
+    start = now();
+
+    for(i = 0; i < count; i++) {
+        c = &clients[i];
+        c->id = i;
+        c->type = (i < streams) ? STREAM : SNAPSHOT;
+        if(pthread_create(&c->thread, NULL, client_thread, c) != 0) {
+            fprintf(stderr, "could not start client %d\n", i);
+            count = i;
+            break;
+        }
+    }
+
+    sleep(seconds);
+    stop = 1;
+    elapsed = now() - start;
+    cpu_end = (pid > 0) ? process_cpu(pid) : -1.0;
+
+    for(i = 0; i < count; i++)
+        pthread_join(clients[i].thread, NULL);
+
+    printf("client type      frames      fps     MB/s   p50 ms   p99 ms   cpu ms/s  errors\n");
+    for(i = 0; i < count; i++) {
+        c = &clients[i];
+        qsort(c->gaps, c->ngaps, sizeof(double), compare_double);
+        printf("%6d %-8s %8ld %8.1f %8.2f %8.2f %8.2f %10.2f %7d\n",
+               c->id, (c->type == STREAM) ? "stream" : "snapshot", c->frames,
+               c->frames / elapsed, c->bytes / elapsed / 1e6,
+               percentile(c, 50) * 1e3, percentile(c, 99) * 1e3,
+               c->cpu * 1e3 / elapsed, c->errors);
+        total += c->frames;
+        free(c->gaps);
+    }
+
+    printf("\n%d streams, %d snapshot pollers, %.1f s: %.1f frames/s delivered\n",
+           streams, pollers, elapsed, total / elapsed);
+
+    if(pid > 0 && cpu_start >= 0.0 && cpu_end >= 0.0) {
+        printf("server: %.1f%% CPU, %.2f ms/s per client, RSS %ld kB, peak RSS %ld kB\n",
+               (cpu_end - cpu_start) * 100.0 / elapsed,
+               (cpu_end - cpu_start) * 1e3 / elapsed / count,
+               process_status(pid, "VmRSS"), process_status(pid, "VmHWM"));
+    }
+
+    free(clients);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,670 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+/*
+ * Measures the functions that run once per frame: the JPEG helpers of
+ * input_uvc, the encoder and decoder of input_gspcav1 (the encoder also on
+ * the YUYV frames of input_uvc) and the sharpness
+ * scanner of output_autofocus. They get the pictures of input_testpicture
+ * and synthetic frames of several resolutions.
+ *
+ * usage: microbench [-v] [-b filter] [-n iterations] [-t ms] [-d folder] [picture.jpg ...]
+ *
+ * With -n every case runs exactly that often, which keeps the counters of
+ * "perf stat" comparable between runs, -b selects the cases whose name
+ * contains the filter.
+ *
+ * With -v nothing is measured, instead the vector DCT and quantization of
+ * the gspcav1 encoder are compared with the scalar ones, the outputs have to
+ * be identical for every picture, format and quality. The same holds for the
+ * vector IDCT of the decoder, whose reduced decodes have to succeed as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "../plugins/input_uvc/v4l2uvc.h"
+#include "../plugins/input_uvc/jpeg_utils.h"
+#include "../plugins/input_gspcav1/jdatatype.h"
+#include "../plugins/input_gspcav1/encoder.h"
+#include "../plugins/input_gspcav1/utils.h"
+#include "../plugins/output_autofocus/processJPEG_onlyCenter.h"
+
+#define QUALITY 80
+/* input_gspcav1 scales the standard tables by this factor / 1024 */
+#define GSPCA_QUALITY 1024
+
+#define LENGTH_OF(x) (sizeof(x)/sizeof(x[0]))
+
+/* a picture to feed to the functions */
+typedef struct _sample sample;
+struct _sample {
+    char name[64];
+    unsigned char *data;
+    int size;
+    int width, height;
+};
+
+/* one measurement, the function returns a negative value on failure */
+typedef struct _bench_case bench_case;
+struct _bench_case {
+    const char *name;
+    sample *in;
+    int (*run)(bench_case *c);
+    unsigned char *out;
+    struct vdIn *vd;
+    JPEG_ENCODER_STRUCTURE *encoder;
+    jpeg_decoder *decoder;
+    int scale;
+    sharpness_ctx *sharpness;
+};
+
+static const char *filter = NULL;
+static long iterations = 0;
+static double min_time = 0.2;
+
+static const int resolutions[][2] = {
+    {320, 240}, {640, 480}, {1280, 720}, {1920, 1080}
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int load(sample *s, const char *file)
+{
+    FILE *f;
+    long size;
+    const char *base = strrchr(file, '/');
+
+    if((f = fopen(file, "rb")) == NULL)
+        return -1;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if(size <= 0 || (s->data = malloc(size)) == NULL || fread(s->data, 1, size, f) != (size_t)size) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    s->size = size;
+    snprintf(s->name, sizeof(s->name), "%.48s", base ? base + 1 : file);
+    return 0;
+}
+
+/* a camera sends MJPEG without Huffman tables, remove them from a picture */
+static int strip_dht(sample *dst, const sample *src)
+{
+    const unsigned char *p = src->data + 2, *end = src->data + src->size;
+    unsigned char *d;
+    int len;
+
+    if((dst->data = d = malloc(src->size)) == NULL)
+        return -1;
+
+    *d++ = 0xff;
+    *d++ = 0xd8;
+    while(p + 4 <= end && p[0] == 0xff && p[1] != 0xda) {
+        len = 2 + (p[2] << 8 | p[3]);
+        if(p[1] != 0xc4) {
+            memcpy(d, p, len);
+            d += len;
+        }
+        p += len;
+    }
+    memcpy(d, p, end - p);
+    d += end - p;
+
+    dst->size = d - dst->data;
+    snprintf(dst->name, sizeof(dst->name), "%.48s no DHT", src->name);
+    return 0;
+}
+
+/* YUYV or planar YUV 4:2:0 with a gradient and some structure */
+static void synthetic(sample *s, int width, int height, int planar)
+{
+    int x, y;
+    unsigned char *p, *u, *v;
+
+    s->width = width;
+    s->height = height;
+    s->size = planar ? width * height * 3 / 2 : width * height * 2;
+    s->data = p = malloc(s->size);
+    if(p == NULL)
+        return;
+
+    snprintf(s->name, sizeof(s->name), "%dx%d %s", width, height, planar ? "YUV420P" : "YUYV");
+
+    for(y = 0; y < height; y++) {
+        for(x = 0; x < width; x++) {
+            unsigned char luma = (x * 255 / width + ((x / 16 + y / 16) & 1) * 64) & 0xff;
+            if(planar) {
+                p[y * width + x] = luma;
+            } else {
+                p[2 * (y * width + x)] = luma;
+                p[2 * (y * width + x) + 1] = (x & 1) ? y * 255 / height : 255 - y * 255 / height;
+            }
+        }
+    }
+
+    if(planar) {
+        u = p + width * height;
+        v = u + width * height / 4;
+        for(y = 0; y < height / 2; y++) {
+            for(x = 0; x < width / 2; x++) {
+                u[y * width / 2 + x] = y * 510 / height;
+                v[y * width / 2 + x] = x * 510 / width;
+            }
+        }
+    }
+}
+
+/* the same frame with interleaved chroma, as NV12 cameras deliver it */
+static void to_nv12(sample *dst, const sample *src)
+{
+    int i, chroma = src->width * src->height / 4;
+    unsigned char *u = src->data + src->width * src->height, *v = u + chroma, *uv;
+
+    *dst = *src;
+    dst->data = malloc(src->size);
+    if(dst->data == NULL)
+        return;
+
+    snprintf(dst->name, sizeof(dst->name), "%dx%d NV12", src->width, src->height);
+    memcpy(dst->data, src->data, src->width * src->height);
+    uv = dst->data + src->width * src->height;
+    for(i = 0; i < chroma; i++) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+static int run_is_huffman(bench_case *c)
+{
+    return is_huffman(c->in->data);
+}
+
+static int run_memcpy_picture(bench_case *c)
+{
+    return memcpy_picture(c->out, c->in->data, c->in->size);
+}
+
+static int run_put_v4l2_exif(bench_case *c)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return put_v4l2_exif(c->out, &tv);
+}
+
+static int run_compress_yuyv_to_jpeg(bench_case *c)
+{
+    return compress_yuyv_to_jpeg(c->vd, c->vd->framebuffer, c->out, c->in->width * c->in->height * 2, QUALITY);
+}
+
+/* the planes go to libjpeg as raw data */
+static int run_compress_yuv420_to_jpeg(bench_case *c)
+{
+    return compress_yuv420_to_jpeg(c->vd, c->in->data, c->out, c->in->width * c->in->height * 3 / 2, QUALITY, 0);
+}
+
+/* the encoder reads the planes of the frame as they are */
+static int run_encode_image(bench_case *c)
+{
+    return encode_image_ctx(c->encoder, c->in->data, c->out, 1920 * 1080 * 4, GSPCA_QUALITY, YUVto420, c->in->width, c->in->height);
+}
+
+/* YUYV is packed 4:2:2, which the encoder reads without converting it */
+static int run_encode_yuyv(bench_case *c)
+{
+    return encode_image_ctx(c->encoder, c->in->data, c->out, 1920 * 1080 * 4, encoder_quality_factor(QUALITY), FOUR_TWO_TWO, c->in->width, c->in->height);
+}
+
+/* the same frame subsampled to 4:2:0 while the MCUs are read, as input_uvc does it */
+static int run_encode_yuyv420(bench_case *c)
+{
+    return encode_image_ctx(c->encoder, c->in->data, c->out, 1920 * 1080 * 4, encoder_quality_factor(QUALITY), YUYVto420, c->in->width, c->in->height);
+}
+
+static int run_jpeg_decode(bench_case *c)
+{
+    int width = 0, height = 0, err;
+
+    /* the decoder (re)allocates the picture in the case it has to */
+    err = jpeg_decode_ctx(c->decoder, &c->out, c->in->data, &width, &height, c->scale);
+    return err ? -err : width * height;
+}
+
+static int run_sharpness(bench_case *c)
+{
+    return (getFrameSharpnessValue(c->sharpness, c->in->data, c->in->size) < 0) ? -1 : 0;
+}
+
+static void measure(bench_case *c)
+{
+    long i, n;
+    double start, elapsed;
+    int rc;
+
+    if(filter != NULL && strstr(c->name, filter) == NULL)
+        return;
+
+    /* the first call warms up the caches and shows whether the input is supported */
+    if((rc = c->run(c)) < 0) {
+        printf("%-24s %-28s %s (%d)\n", c->name, c->in->name, "not supported", rc);
+        return;
+    }
+
+    n = (iterations > 0) ? iterations : 1;
+    while(1) {
+        start = now();
+        for(i = 0; i < n; i++)
+            c->run(c);
+        elapsed = now() - start;
+
+        if(iterations > 0 || elapsed >= min_time)
+            break;
+        n = (elapsed > min_time / 100) ? (long)(n * min_time * 1.1 / elapsed) + 1 : n * 10;
+    }
+
+    printf("%-24s %-28s %12.0f ns/frame %10.1f MB/s\n", c->name, c->in->name,
+           elapsed * 1e9 / n, (double)c->in->size * n / elapsed / 1e6);
+    fflush(stdout);
+}
+
+/* encode a copy of the picture, the RGB and planar formats are converted in place */
+static UINT32 encode_copy(JPEG_ENCODER_STRUCTURE *encoder, const sample *in, unsigned char *work,
+                          unsigned char *out, UINT32 size, UINT32 quality, UINT32 format)
+{
+    memcpy(work, in->data, in->size);
+    return encode_image_ctx(encoder, work, out, size, quality, format, in->width, in->height);
+}
+
+/* compare the vector and the scalar encoder, returns the number of differences */
+static int verify_encoder(sample *pictures, int count)
+{
+    static const struct {
+        const char *name;
+        UINT32 format;
+    } rgb_formats[] = {
+        { "RGB 4:4:4", RGBto444 }, { "RGB 4:2:2", RGBto422 },
+        { "RGB 4:2:0", RGBto420 }, { "RGB 4:0:0", RGBto400 }
+    };
+    static const int qualities[] = { 1, 10, 50, 80, 95, 100 };
+    JPEG_ENCODER_STRUCTURE vector, scalar;
+    sample frames[3 * LENGTH_OF(resolutions)], nv12;
+    UINT32 formats[3 * LENGTH_OF(resolutions)];
+    UINT32 size = 1920 * 1080 * 4, a, b;
+    unsigned char *work = malloc(size), *out_vector = malloc(size), *out_scalar = malloc(size);
+    unsigned char *rgb = NULL;
+    int i, f, q, width, height, n = 0, failed = 0, checked = 0;
+
+    encoder_init(&vector);
+    encoder_init(&scalar);
+    encoder_use_scalar(&scalar);
+
+    /* the test pictures decoded to RGB and the synthetic frames */
+    for(i = 0; i < count; i++) {
+        width = height = 0;
+        if(jpeg_decode(&rgb, pictures[i].data, &width, &height) != 0) {
+            printf("%-28s could not be decoded\n", pictures[i].name);
+            continue;
+        }
+        for(f = 0; f < LENGTH_OF(rgb_formats); f++) {
+            sample s = { "", rgb, width * height * 3, width, height };
+            snprintf(s.name, sizeof(s.name), "%.40s %s", pictures[i].name, rgb_formats[f].name);
+            for(q = 0; q < LENGTH_OF(qualities); q++) {
+                a = encode_copy(&vector, &s, work, out_vector, size, encoder_quality_factor(qualities[q]), rgb_formats[f].format);
+                b = encode_copy(&scalar, &s, work, out_scalar, size, encoder_quality_factor(qualities[q]), rgb_formats[f].format);
+                checked++;
+                if(a == 0 || a != b || memcmp(out_vector, out_scalar, a) != 0) {
+                    printf("%-40s quality %3d differs (%u/%u bytes)\n", s.name, qualities[q], a, b);
+                    failed++;
+                }
+            }
+        }
+    }
+    free(rgb);
+
+    for(i = 0; i < LENGTH_OF(resolutions); i++) {
+        synthetic(&frames[n], resolutions[i][0], resolutions[i][1], 0);
+        formats[n++] = FOUR_TWO_TWO;
+        synthetic(&frames[n], resolutions[i][0], resolutions[i][1], 0);
+        formats[n++] = YUYVto420;
+        synthetic(&frames[n], resolutions[i][0], resolutions[i][1], 1);
+        formats[n++] = YUVto420;
+    }
+    for(i = 0; i < n; i++) {
+        for(q = 0; q < LENGTH_OF(qualities); q++) {
+            a = encode_copy(&vector, &frames[i], work, out_vector, size, encoder_quality_factor(qualities[q]), formats[i]);
+            b = encode_copy(&scalar, &frames[i], work, out_scalar, size, encoder_quality_factor(qualities[q]), formats[i]);
+            checked++;
+            if(a == 0 || a != b || memcmp(out_vector, out_scalar, a) != 0) {
+                printf("%-40s quality %3d differs (%u/%u bytes)\n", frames[i].name, qualities[q], a, b);
+                failed++;
+            }
+            if(formats[i] != YUVto420)
+                continue;
+
+            /* interleaved chroma has to give the same picture as the planes */
+            to_nv12(&nv12, &frames[i]);
+            b = encode_copy(&vector, &nv12, work, out_scalar, size, encoder_quality_factor(qualities[q]), NV12to420);
+            checked++;
+            if(a != b || memcmp(out_vector, out_scalar, a) != 0) {
+                printf("%-40s quality %3d differs (%u/%u bytes)\n", nv12.name, qualities[q], a, b);
+                failed++;
+            }
+            free(nv12.data);
+        }
+        free(frames[i].data);
+    }
+
+    printf("%d of %d encodings identical\n", checked - failed, checked);
+    free(work);
+    free(out_vector);
+    free(out_scalar);
+    return failed;
+}
+
+/* decode a picture with the vector and the scalar IDCT and at every scale,
+   returns 1 on a difference or a failure */
+static int verify_decode(jpeg_decoder *vector, jpeg_decoder *scalar, const sample *in)
+{
+    unsigned char *a = NULL, *b = NULL;
+    int wa = 0, ha = 0, wb = 0, hb = 0, ws, hs, scale, err, failed = 0;
+
+    err = jpeg_decode_ctx(vector, &a, in->data, &wa, &ha, 1);
+    if(err != 0 || jpeg_decode_ctx(scalar, &b, in->data, &wb, &hb, 1) != 0) {
+        printf("%-40s could not be decoded (%d)\n", in->name, err);
+        failed = 1;
+    } else if(wa != wb || ha != hb || memcmp(a, b, wa * ha * 3) != 0) {
+        printf("%-40s differs\n", in->name);
+        failed = 1;
+    }
+    for(scale = 2; scale <= 8 && !failed; scale *= 2) {
+        ws = hs = 0;
+        err = jpeg_decode_ctx(vector, &b, in->data, &ws, &hs, scale);
+        if(err != 0 || ws != wa / scale || hs != ha / scale) {
+            printf("%-40s could not be decoded at 1/%d (%d)\n", in->name, scale, err);
+            failed = 1;
+        }
+    }
+    free(a);
+    free(b);
+    return failed;
+}
+
+/* compare the vector and the scalar decoder, returns the number of differences */
+static int verify_decoder(sample *pictures, int count)
+{
+    static const UINT32 formats[] = { YUVto420, FOUR_TWO_TWO };
+    static const int qualities[] = { 10, 80, 100 };
+    jpeg_decoder *vector = jpeg_decoder_new(), *scalar = jpeg_decoder_new();
+    unsigned char *out = malloc(1920 * 1080 * 4);
+    sample frame, encoded;
+    int i, f, q, failed = 0, checked = 0;
+
+    jpeg_decoder_use_scalar(scalar);
+    for(i = 0; i < count; i++) {
+        failed += verify_decode(vector, scalar, &pictures[i]);
+        checked++;
+    }
+
+    /* the encoder makes 4:2:0 and 4:2:2 pictures */
+    for(i = 0; i < LENGTH_OF(resolutions); i++) {
+        for(f = 0; f < LENGTH_OF(formats); f++) {
+            synthetic(&frame, resolutions[i][0], resolutions[i][1], formats[f] == YUVto420);
+            for(q = 0; q < LENGTH_OF(qualities); q++) {
+                encoded.data = out;
+                encoded.size = encode_image(frame.data, out, encoder_quality_factor(qualities[q]), formats[f], frame.width, frame.height);
+                snprintf(encoded.name, sizeof(encoded.name), "%.32s quality %d", frame.name, qualities[q]);
+                failed += verify_decode(vector, scalar, &encoded);
+                checked++;
+            }
+            free(frame.data);
+        }
+    }
+
+    printf("%d of %d decodings identical\n", checked - failed, checked);
+    jpeg_decoder_free(vector);
+    jpeg_decoder_free(scalar);
+    free(out);
+    return failed;
+}
+
+static int jpeg_filter(const struct dirent *entry)
+{
+    const char *ext = strrchr(entry->d_name, '.');
+    return ext != NULL && (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-v] [-b filter] [-n iterations] [-t ms] [-d folder] [picture.jpg ...]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *folder = "plugins/input_testpicture/pictures";
+    struct dirent **names;
+    sample *pictures, *stripped, yuyv[LENGTH_OF(resolutions)], yuv420[LENGTH_OF(resolutions)], encoded[LENGTH_OF(resolutions)];
+    int i, s, n, count = 0, opt, verify = 0;
+    unsigned char *out;
+    char path[1024];
+    sharpness_ctx sharpness;
+    JPEG_ENCODER_STRUCTURE encoder, scalar;
+    jpeg_decoder *decoder, *scalar_decoder;
+    static const struct {
+        const char *name;
+        int scale, scalar;
+    } decodes[] = {
+        { "jpeg_decode", 1, 0 }, { "jpeg_decode scalar", 1, 1 },
+        { "jpeg_decode 1/2", 2, 0 }, { "jpeg_decode 1/4", 4, 0 }, { "jpeg_decode 1/8", 8, 0 }
+    };
+    struct vdIn vd;
+    bench_case c;
+
+    while((opt = getopt(argc, argv, "b:n:t:d:vh")) != -1) {
+        switch(opt) {
+        case 'v': verify = 1; break;
+        case 'b': filter = optarg; break;
+        case 'n': iterations = atol(optarg); break;
+        case 't': min_time = atoi(optarg) / 1000.0; break;
+        case 'd': folder = optarg; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* pictures from the command line or from the folder */
+    n = argc - optind;
+    if(n == 0 && (n = scandir(folder, &names, jpeg_filter, alphasort)) < 0) {
+        perror(folder);
+        return EXIT_FAILURE;
+    }
+    pictures = calloc(n, sizeof(sample));
+    stripped = calloc(n, sizeof(sample));
+    for(i = 0; i < n; i++) {
+        if(optind < argc) {
+            snprintf(path, sizeof(path), "%s", argv[optind + i]);
+        } else {
+            snprintf(path, sizeof(path), "%s/%s", folder, names[i]->d_name);
+            free(names[i]);
+        }
+        if(load(&pictures[count], path) < 0) {
+            fprintf(stderr, "could not read %s\n", path);
+            continue;
+        }
+        strip_dht(&stripped[count], &pictures[count]);
+        count++;
+    }
+    if(optind == argc)
+        free(names);
+
+    if(verify)
+        return verify_encoder(pictures, count) + verify_decoder(pictures, count) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    /* large enough for every output of the functions */
+    out = malloc(1920 * 1080 * 4);
+    sharpness_init(&sharpness);
+    encoder_init(&encoder);
+    encoder_init(&scalar);
+    encoder_use_scalar(&scalar);
+    decoder = jpeg_decoder_new();
+    scalar_decoder = jpeg_decoder_new();
+    jpeg_decoder_use_scalar(scalar_decoder);
+    memset(&vd, 0, sizeof(vd));
+
+    memset(&c, 0, sizeof(c));
+    c.out = out;
+    c.vd = &vd;
+    c.encoder = &encoder;
+    c.sharpness = &sharpness;
+
+    for(i = 0; i < count; i++) {
+        c.name = "is_huffman";
+        c.run = run_is_huffman;
+        c.in = &pictures[i];
+        measure(&c);
+    }
+
+    for(i = 0; i < count; i++) {
+        c.name = "memcpy_picture";
+        c.run = run_memcpy_picture;
+        c.in = &pictures[i];
+        measure(&c);
+        c.in = &stripped[i];
+        measure(&c);
+    }
+
+    c.name = "put_v4l2_exif";
+    c.run = run_put_v4l2_exif;
+    c.in = &pictures[0];
+    measure(&c);
+
+    for(i = 0; i < LENGTH_OF(resolutions); i++) {
+        synthetic(&yuyv[i], resolutions[i][0], resolutions[i][1], 0);
+        synthetic(&yuv420[i], resolutions[i][0], resolutions[i][1], 1);
+
+        vd.width = yuyv[i].width;
+        vd.height = yuyv[i].height;
+        vd.framebuffer = yuyv[i].data;
+        c.name = "compress_yuyv_to_jpeg";
+        c.run = run_compress_yuyv_to_jpeg;
+        c.in = &yuyv[i];
+        measure(&c);
+
+        c.name = "encode_image yuyv";
+        c.run = run_encode_yuyv;
+        measure(&c);
+
+        c.name = "encode_image yuyv420";
+        c.run = run_encode_yuyv420;
+        measure(&c);
+    }
+
+    for(i = 0; i < LENGTH_OF(resolutions); i++) {
+        vd.width = yuv420[i].width;
+        vd.height = yuv420[i].height;
+        c.name = "compress_yuv420_to_jpeg";
+        c.run = run_compress_yuv420_to_jpeg;
+        c.in = &yuv420[i];
+        measure(&c);
+
+        c.name = "encode_image";
+        c.run = run_encode_image;
+        measure(&c);
+
+        /* the same without the vector DCT and quantization */
+        c.name = "encode_image scalar";
+        c.encoder = &scalar;
+        measure(&c);
+        c.encoder = &encoder;
+
+        /* keep the output of the encoder for the decoder */
+        encoded[i].size = encode_image(yuv420[i].data, out, GSPCA_QUALITY, YUVto420, yuv420[i].width, yuv420[i].height);
+        encoded[i].data = malloc(encoded[i].size);
+        memcpy(encoded[i].data, out, encoded[i].size);
+        snprintf(encoded[i].name, sizeof(encoded[i].name), "%dx%d encode_image", yuv420[i].width, yuv420[i].height);
+    }
+
+    /* the decoder allocates the picture itself, at full size with the
+       vector and the scalar IDCT and reduced in the DCT domain */
+    c.out = NULL;
+    c.run = run_jpeg_decode;
+    for(s = 0; s < LENGTH_OF(decodes); s++) {
+        c.name = decodes[s].name;
+        c.decoder = decodes[s].scalar ? scalar_decoder : decoder;
+        c.scale = decodes[s].scale;
+        for(i = 0; i < count; i++) {
+            c.in = &pictures[i];
+            measure(&c);
+        }
+        for(i = 0; i < LENGTH_OF(resolutions); i++) {
+            c.in = &encoded[i];
+            measure(&c);
+        }
+    }
+    free(c.out);
+    c.out = out;
+
+    c.name = "getFrameSharpnessValue";
+    c.run = run_sharpness;
+    for(i = 0; i < count; i++) {
+        c.in = &pictures[i];
+        measure(&c);
+    }
+    for(i = 0; i < LENGTH_OF(resolutions); i++) {
+        c.in = &encoded[i];
+        measure(&c);
+    }
+
+    sharpness_free(&sharpness);
+    jpeg_decoder_free(decoder);
+    jpeg_decoder_free(scalar_decoder);
+    for(i = 0; i < count; i++) {
+        free(pictures[i].data);
+        free(stripped[i].data);
+    }
+    for(i = 0; i < LENGTH_OF(resolutions); i++) {
+        free(yuyv[i].data);
+        free(yuv420[i].data);
+        free(encoded[i].data);
+    }
+    free(pictures);
+    free(stripped);
+    free(out);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+
+#/******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+#******************************************************************************/
+
+## Starts MJPG-streamer with output_http on localhost and measures what
+## a number of clients receive. Run it from the top directory after
+## building, "make bench" does both. The settings can be overridden
+## from the environment, for example:
+## STREAMS=50 INPUT="input_file.so -f /tmp/pics -p -F 30 -l" make bench
+
+INPUT=${INPUT:-"input_testpicture.so -r 1280x720 -f 60 -s 100:300"}
+PORT=${PORT:-8090}
+STREAMS=${STREAMS:-10}
+POLLERS=${POLLERS:-2}
+DURATION=${DURATION:-10}
+
+export LD_LIBRARY_PATH="$(pwd)"
+
+./mjpg_streamer -i "$INPUT" -o "output_http.so -p $PORT" > /dev/null 2>&1 &
+PID=$!
+trap 'kill $PID 2> /dev/null' EXIT INT TERM
+
+sleep 1
+kill -0 $PID 2> /dev/null || { echo "mjpg_streamer did not start" >&2; exit 1; }
+
+echo "input: $INPUT"
+./bench/httpload -p $PORT -s $STREAMS -n $POLLERS -t $DURATION -P $PID
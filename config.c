@@ -0,0 +1,286 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+/*
+  Reads the configuration file. It describes the plugins in sections, the
+  name of a section identifies the plugin when the file is read again:
+
+    # comments start with '#' or ';'
+    [input camera1]
+    plugin = input_uvc.so
+    parameters = -d /dev/video0 -r 640x480 -f 30
+    control Brightness = 128
+
+    [output http]
+    plugin = output_http.so
+    parameters = -w ./www -p 8080
+
+  The parameters are the same as on the command line, the controls are
+  looked up by name in the controls the plugin offers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <syslog.h>
+
+#include "mjpg_streamer.h"
+#include "config.h"
+
+/* remove white space at both ends of a string in place */
+static char *trim(char *s)
+{
+    char *end;
+
+    while(isspace((unsigned char)*s))
+        s++;
+
+    end = s + strlen(s);
+    while(end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+
+    return s;
+}
+
+/******************************************************************************
+Description.: create a new section
+Input Value.: configuration, type and name of the section
+Return Value: the section or NULL if there is not enough memory
+******************************************************************************/
+static config_plugin *add_plugin(config *cfg, config_type type, const char *name)
+{
+    config_plugin *p;
+
+    if((p = realloc(cfg->plugins, (cfg->count + 1) * sizeof(config_plugin))) == NULL)
+        return NULL;
+    cfg->plugins = p;
+
+    p = &cfg->plugins[cfg->count++];
+    memset(p, 0, sizeof(config_plugin));
+    p->type = type;
+    p->name = strdup(name);
+
+    return p;
+}
+
+/******************************************************************************
+Description.: check a section and build the command line of its plugin
+Input Value.: section, file name and line for messages
+Return Value: 0 if ok, -1 if the section is not complete
+******************************************************************************/
+static int finish_plugin(config_plugin *p, const char *filename, int line)
+{
+    const char *params;
+
+    if(p->plugin == NULL) {
+        LOG("%s:%d: the section \"%s\" does not name a plugin\n", filename, line, p->name);
+        return -1;
+    }
+
+    params = (p->parameters != NULL) ? p->parameters : "";
+    if((p->cmdline = malloc(strlen(p->plugin) + strlen(params) + 2)) == NULL)
+        return -1;
+    sprintf(p->cmdline, (*params != '\0') ? "%s %s" : "%s", p->plugin, params);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: read a configuration file
+Input Value.: name of the file, configuration to fill
+Return Value: 0 if ok, -1 if the file can not be read or has errors
+              nothing needs to be freed in the case of an error
+******************************************************************************/
+int config_load(const char *filename, config *cfg)
+{
+    FILE *f;
+    char buffer[1024], name[256], *line, *key, *value, *end;
+    config_plugin *current = NULL;
+    int lineno = 0, inputs = 0, outputs = 0, rc = 0;
+
+    memset(cfg, 0, sizeof(config));
+
+    if((f = fopen(filename, "r")) == NULL) {
+        LOG("could not open the configuration file %s\n", filename);
+        return -1;
+    }
+
+    while(rc == 0 && fgets(buffer, sizeof(buffer), f) != NULL) {
+        lineno++;
+        line = trim(buffer);
+
+        if(*line == '\0' || *line == '#' || *line == ';')
+            continue;
+
+        /* section */
+        if(*line == '[') {
+            if(current != NULL && finish_plugin(current, filename, lineno - 1) < 0) {
+                rc = -1;
+                break;
+            }
+
+            if((end = strchr(line, ']')) == NULL) {
+                LOG("%s:%d: missing \"]\"\n", filename, lineno);
+                rc = -1;
+                break;
+            }
+            *end = '\0';
+            line = trim(line + 1);
+
+            if(strncmp(line, "input", 5) == 0 && (line[5] == '\0' || isspace((unsigned char)line[5]))) {
+                snprintf(name, sizeof(name), "%s", (line[5] != '\0') ? trim(line + 5) : "");
+                if(*name == '\0')
+                    snprintf(name, sizeof(name), "input%d", inputs);
+                inputs++;
+                current = add_plugin(cfg, CONFIG_INPUT, name);
+            } else if(strncmp(line, "output", 6) == 0 && (line[6] == '\0' || isspace((unsigned char)line[6]))) {
+                snprintf(name, sizeof(name), "%s", (line[6] != '\0') ? trim(line + 6) : "");
+                if(*name == '\0')
+                    snprintf(name, sizeof(name), "output%d", outputs);
+                outputs++;
+                current = add_plugin(cfg, CONFIG_OUTPUT, name);
+            } else {
+                LOG("%s:%d: unknown section \"%s\"\n", filename, lineno, line);
+                rc = -1;
+                break;
+            }
+
+            if(current == NULL) {
+                rc = -1;
+                break;
+            }
+
+            if(config_find(cfg, current->type, current->name) != current) {
+                LOG("%s:%d: the section \"%s\" exists already\n", filename, lineno, current->name);
+                rc = -1;
+            }
+            continue;
+        }
+
+        /* key = value */
+        if((value = strchr(line, '=')) == NULL) {
+            LOG("%s:%d: expected \"key = value\"\n", filename, lineno);
+            rc = -1;
+            break;
+        }
+        *value++ = '\0';
+        key = trim(line);
+        value = trim(value);
+
+        if(current == NULL) {
+            LOG("%s:%d: \"%s\" is outside of a section\n", filename, lineno, key);
+            rc = -1;
+        } else if(strcmp(key, "plugin") == 0) {
+            free(current->plugin);
+            current->plugin = strdup(value);
+        } else if(strcmp(key, "parameters") == 0) {
+            free(current->parameters);
+            current->parameters = strdup(value);
+        } else if(strncmp(key, "control", 7) == 0 && isspace((unsigned char)key[7])) {
+            if(current->control_count == CONFIG_MAX_CONTROLS) {
+                LOG("%s:%d: too many controls\n", filename, lineno);
+                rc = -1;
+                break;
+            }
+            current->controls[current->control_count].name = strdup(trim(key + 7));
+            current->controls[current->control_count].value = strtol(value, &end, 0);
+            current->control_count++;
+            if(*end != '\0') {
+                LOG("%s:%d: the value of a control must be a number\n", filename, lineno);
+                rc = -1;
+            }
+        } else {
+            LOG("%s:%d: unknown key \"%s\"\n", filename, lineno, key);
+            rc = -1;
+        }
+    }
+
+    fclose(f);
+
+    if(rc == 0 && current != NULL)
+        rc = finish_plugin(current, filename, lineno);
+
+    if(rc != 0)
+        config_free(cfg);
+
+    return rc;
+}
+
+/******************************************************************************
+Description.: free the memory of a configuration
+Input Value.: configuration
+Return Value: -
+******************************************************************************/
+void config_free(config *cfg)
+{
+    int i, j;
+
+    for(i = 0; i < cfg->count; i++) {
+        free(cfg->plugins[i].name);
+        free(cfg->plugins[i].plugin);
+        free(cfg->plugins[i].parameters);
+        free(cfg->plugins[i].cmdline);
+        for(j = 0; j < cfg->plugins[i].control_count; j++)
+            free(cfg->plugins[i].controls[j].name);
+    }
+
+    free(cfg->plugins);
+    cfg->plugins = NULL;
+    cfg->count = 0;
+}
+
+/******************************************************************************
+Description.: look up a section
+Input Value.: configuration, type and name of the section
+Return Value: the section or NULL
+******************************************************************************/
+config_plugin *config_find(config *cfg, config_type type, const char *name)
+{
+    int i;
+
+    for(i = 0; i < cfg->count; i++) {
+        if(cfg->plugins[i].type == type && strcmp(cfg->plugins[i].name, name) == 0)
+            return &cfg->plugins[i];
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: look up the value of a control of a section
+Input Value.: section, name of the control, pointer to store the value at
+Return Value: 1 if the section sets the control, 0 if not
+******************************************************************************/
+int config_control_value(config_plugin *plugin, const char *name, int *value)
+{
+    int i;
+
+    for(i = 0; plugin != NULL && i < plugin->control_count; i++) {
+        if(strcasecmp(plugin->controls[i].name, name) == 0) {
+            *value = plugin->controls[i].value;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define CONFIG_MAX_CONTROLS 32
+
+/* the type of a section */
+typedef enum {
+    CONFIG_INPUT = 0,
+    CONFIG_OUTPUT = 1,
+} config_type;
+
+/* a control that is set after the plugin started */
+typedef struct _config_control config_control;
+struct _config_control {
+    char *name;
+    int value;
+};
+
+/* one [input NAME] or [output NAME] section */
+typedef struct _config_plugin config_plugin;
+struct _config_plugin {
+    config_type type;
+    char *name;
+    char *plugin;
+    char *parameters;
+    char *cmdline;          // "plugin parameters", like the -i and -o options take it
+    config_control controls[CONFIG_MAX_CONTROLS];
+    int control_count;
+};
+
+typedef struct _config config;
+struct _config {
+    config_plugin *plugins;
+    int count;
+};
+
+int config_load(const char *filename, config *cfg);
+void config_free(config *cfg);
+config_plugin *config_find(config *cfg, config_type type, const char *name);
+int config_control_value(config_plugin *plugin, const char *name, int *value);
+
+#endif
@@ -40,10 +40,42 @@
 
 #include "utils.h"
 #include "mjpg_streamer.h"
+#include "config.h"
 
 /* globals */
 static globals global;
 
+/* where a plugin came from, a reload compares it with the file */
+typedef struct _plugin_slot plugin_slot;
+struct _plugin_slot {
+    char *cmdline;      // "plugin parameters" as for the -i and -o options
+    char *name;         // section of the configuration file, NULL for the command line
+    int loaded;         // the plugin is opened and initialized
+    int running;
+    int stuck;          // the threads did not stop in time, the slot stays as it is
+};
+
+/* allocated next to the plugin tables, with global.inmax and global.outmax entries */
+static plugin_slot *inputs;
+static plugin_slot *outputs;
+
+static char *config_file = NULL;
+static config current;
+static volatile sig_atomic_t reload = 0;
+static volatile sig_atomic_t quit = 0;
+
+/* the signal handlers set this event to wake up the main loop */
+static int wakeup_fd = -1;
+
+/* serializes the reload of the configuration file and the commands */
+static pthread_mutex_t plugins_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * the commands of the plugins hold it for reading, it is held for writing
+ * while a command becomes available and while a plugin is closed
+ */
+static pthread_rwlock_t commands_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 /******************************************************************************
 Description.: Display a help message
 Input Value.: argv[0] is the program name and the parameter progname
@@ -55,6 +87,7 @@ void help(char *progname)
     fprintf(stderr, "Usage: %s\n" \
             "  -i | --input \"<input-plugin.so> [parameters]\"\n" \
             "  -o | --output \"<output-plugin.so> [parameters]\"\n" \
+            " [-c | --config ]......: read the plugins from a file, SIGHUP reloads it\n" \
             " [-h | --help ]........: display this help\n" \
             " [-v | --version ].....: display version information\n" \
             " [-b | --background]...: fork to the background, daemon mode\n", progname);
@@ -71,6 +104,10 @@ void help(char *progname)
             " To get help for a certain input plugin:\n" \
             "  %s -i \"input_uvc.so --help\"\n", progname);
     fprintf(stderr, "-----------------------------------------------------------------------\n");
+    fprintf(stderr, "Example #4:\n" \
+            " To read the plugins from a file, \"kill -HUP\" restarts the changed ones:\n" \
+            "  %s -c /etc/mjpg_streamer.conf\n", progname);
+    fprintf(stderr, "-----------------------------------------------------------------------\n");
     fprintf(stderr, "In case the modules (=plugins) can not be found:\n" \
             " * Set the default search path for the modules with:\n" \
             "   export LD_LIBRARY_PATH=/path/to/plugins,\n" \
@@ -82,65 +119,33 @@ void help(char *progname)
 }
 
 /******************************************************************************
-Description.: pressing CTRL+C sends signals to this process instead of just
-              killing it plugins can tidily shutdown and free allocated
-              resources. The function prototype is defined by the system,
-              because it is a callback function.
-Input Value.: sig tells us which signal was received
+Description.: remember to leave, the main loop stops the plugins outside of
+              the signal handler
+Input Value.: signal number
 Return Value: -
 ******************************************************************************/
 void signal_handler(int sig)
 {
-    int i;
-
-    /* signal "stop" to threads */
-    LOG("setting signal to stop\n");
-    global.stop = 1;
-    usleep(1000 * 1000);
-
-    /* clean up threads */
-    LOG("force cancellation of threads and cleanup resources\n");
-    for(i = 0; i < global.incnt; i++) {
-        global.in[i].stop(i);
-    }
-
-    for(i = 0; i < global.outcnt; i++) {
-        global.out[i].stop(global.out[i].param.id);
-        pthread_cond_destroy(&global.in[i].db_update);
-        pthread_mutex_destroy(&global.in[i].db);
-    }
-    usleep(1000 * 1000);
-
-    /* close handles of input plugins */
-    for(i = 0; i < global.incnt; i++) {
-        dlclose(global.in[i].handle);
-    }
+    int saved_errno = errno;
 
-    for(i = 0; i < global.outcnt; i++) {
-        /* skip = 0;
-        DBG("about to decrement usage counter for handle of %s, id #%02d, handle: %p\n", \
-            global.out[i].plugin, global.out[i].param.id, global.out[i].handle);
-        for(j=i+1; j<global.outcnt; j++) {
-          if ( global.out[i].handle == global.out[j].handle ) {
-            DBG("handles are pointing to the same destination (%p == %p)\n", global.out[i].handle, global.out[j].handle);
-            skip = 1;
-          }
-        }
-        if ( skip ) {
-          continue;
-        }
-
-        DBG("closing handle %p\n", global.out[i].handle);
-        */
-        dlclose(global.out[i].handle);
-    }
-    DBG("all plugin handles closed\n");
+    quit = 1;
+    stop_event_set(wakeup_fd);
+    errno = saved_errno;
+}
 
-    LOG("done\n");
+/******************************************************************************
+Description.: remember that the configuration file has to be read again, the
+              main loop does the work outside of the signal handler
+Input Value.: signal number
+Return Value: -
+******************************************************************************/
+void reload_handler(int sig)
+{
+    int saved_errno = errno;
 
-    closelog();
-    exit(0);
-    return;
+    reload = 1;
+    stop_event_set(wakeup_fd);
+    errno = saved_errno;
 }
 
 int split_parameters(char *parameter_string, int *argc, char **argv)
@@ -172,6 +177,805 @@ int split_parameters(char *parameter_string, int *argc, char **argv)
     return 1;
 }
 
+
+/******************************************************************************
+Description.: free the arguments that split_parameters() allocated
+Input Value.: argument count and vector
+Return Value: -
+******************************************************************************/
+static void free_parameters(int argc, char **argv)
+{
+    int i;
+
+    /* argv[0] belongs to the plugin */
+    for(i = 1; i < argc; i++) {
+        free(argv[i]);
+        argv[i] = NULL;
+    }
+}
+
+/******************************************************************************
+Description.: check if another slot has a plugin loaded already that keeps one
+              state for all its instances, a second instance would overwrite
+              it. Plugins with a state for each id say so with the symbol
+              input_per_id or output_per_id.
+Input Value.: type and number of the slot, handle of the opened plugin
+Return Value: 1 if the plugin can not be loaded into this slot, else 0
+******************************************************************************/
+static int loaded_elsewhere(config_type type, int i, void *handle)
+{
+    int j;
+
+    if(dlsym(handle, (type == CONFIG_INPUT) ? "input_per_id" : "output_per_id") != NULL)
+        return 0;
+
+    for(j = 0; j < ((type == CONFIG_INPUT) ? global.incnt : global.outcnt); j++) {
+        if(j != i && handle == ((type == CONFIG_INPUT) ? global.in[j].handle : global.out[j].handle))
+            return 1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: load and initialize an input plugin, a new plugin is appended
+              if "i" equals the number of inputs, else the slot is reused
+Input Value.: i: number of the input
+              cmdline: "plugin parameters" like the -i option takes it
+Return Value: 0 if ok, -1 if the plugin could not be loaded or initialized
+******************************************************************************/
+static int open_input(int i, char *cmdline)
+{
+    size_t tmp = 0;
+    int (*cmd)(int, unsigned int, unsigned int, int);
+
+    if(i == global.incnt) {
+        /* this mutex and the conditional variable are used to synchronize access to the global picture buffer */
+        if(pthread_mutex_init(&global.in[i].db, NULL) != 0) {
+            LOG("could not initialize mutex variable\n");
+            return -1;
+        }
+        if(pthread_cond_init(&global.in[i].db_update, NULL) != 0) {
+            LOG("could not initialize condition variable\n");
+            pthread_mutex_destroy(&global.in[i].db);
+            return -1;
+        }
+    }
+
+    tmp = (size_t)(strchr(cmdline, ' ') - cmdline);
+    global.in[i].stop      = 0;
+    global.in[i].buf       = NULL;
+    global.in[i].size      = 0;
+    global.in[i].format    = 0;
+    global.in[i].plugin = (strchr(cmdline, ' ') != NULL) ? strndup(cmdline, tmp) : strdup(cmdline);
+    global.in[i].handle = dlopen(global.in[i].plugin, RTLD_LAZY);
+    if(!global.in[i].handle) {
+        LOG("ERROR: could not find input plugin\n");
+        LOG("       Perhaps you want to adjust the search path with:\n");
+        LOG("       # export LD_LIBRARY_PATH=/path/to/plugin/folder\n");
+        LOG("       dlopen: %s\n", dlerror());
+        goto failed;
+    }
+    global.in[i].init = dlsym(global.in[i].handle, "input_init");
+    global.in[i].stop = dlsym(global.in[i].handle, "input_stop");
+    global.in[i].run = dlsym(global.in[i].handle, "input_run");
+    if(global.in[i].init == NULL || global.in[i].stop == NULL || global.in[i].run == NULL) {
+        LOG("%s\n", dlerror());
+        dlclose(global.in[i].handle);
+        goto failed;
+    }
+    if(loaded_elsewhere(CONFIG_INPUT, i, global.in[i].handle)) {
+        LOG("ERROR: %s is loaded already, it can not run twice\n", global.in[i].plugin);
+        dlclose(global.in[i].handle);
+        goto failed;
+    }
+    /* try to find optional command, it is available once the plugin is initialized */
+    cmd = dlsym(global.in[i].handle, "input_cmd");
+
+    global.in[i].param.parameters = strchr(cmdline, ' ');
+    split_parameters(global.in[i].param.parameters, &global.in[i].param.argc, global.in[i].param.argv);
+    global.in[i].param.global = &global;
+    global.in[i].param.id = i;
+
+    if(global.in[i].init(&global.in[i].param, i)) {
+        LOG("input_init() return value signals to exit\n");
+        free_parameters(global.in[i].param.argc, global.in[i].param.argv);
+        global.in[i].param.parameters = NULL;
+        dlclose(global.in[i].handle);
+        goto failed;
+    }
+
+    pthread_rwlock_wrlock(&commands_lock);
+    global.in[i].cmd = cmd;
+    if(i == global.incnt)
+        global.incnt++;
+    pthread_rwlock_unlock(&commands_lock);
+
+    return 0;
+
+failed:
+    /* nothing may call into the closed library */
+    global.in[i].handle = NULL;
+    global.in[i].init = NULL;
+    global.in[i].stop = NULL;
+    global.in[i].run = NULL;
+    global.in[i].cmd = NULL;
+    free(global.in[i].plugin);
+    global.in[i].plugin = NULL;
+    pthread_mutex_lock(&global.in[i].db);
+    global.in[i].in_parameters = NULL;
+    global.in[i].parametercount = 0;
+    global.in[i].in_formats = NULL;
+    global.in[i].formatCount = 0;
+    pthread_mutex_unlock(&global.in[i].db);
+    if(i == global.incnt) {
+        pthread_cond_destroy(&global.in[i].db_update);
+        pthread_mutex_destroy(&global.in[i].db);
+    }
+    return -1;
+}
+
+/******************************************************************************
+Description.: load and initialize an output plugin, a new plugin is appended
+              if "i" equals the number of outputs, else the slot is reused
+Input Value.: i: number of the output
+              cmdline: "plugin parameters" like the -o option takes it
+Return Value: 0 if ok, -1 if the plugin could not be loaded or initialized
+******************************************************************************/
+static int open_output(int i, char *cmdline)
+{
+    size_t tmp = 0;
+    int (*cmd)(int, unsigned int, unsigned int, int);
+
+    tmp = (size_t)(strchr(cmdline, ' ') - cmdline);
+    global.out[i].plugin = (strchr(cmdline, ' ') != NULL) ? strndup(cmdline, tmp) : strdup(cmdline);
+    global.out[i].handle = dlopen(global.out[i].plugin, RTLD_LAZY);
+    if(!global.out[i].handle) {
+        LOG("ERROR: could not find output plugin %s\n", global.out[i].plugin);
+        LOG("       Perhaps you want to adjust the search path with:\n");
+        LOG("       # export LD_LIBRARY_PATH=/path/to/plugin/folder\n");
+        LOG("       dlopen: %s\n", dlerror());
+        goto failed;
+    }
+    global.out[i].init = dlsym(global.out[i].handle, "output_init");
+    global.out[i].stop = dlsym(global.out[i].handle, "output_stop");
+    global.out[i].run = dlsym(global.out[i].handle, "output_run");
+    if(global.out[i].init == NULL || global.out[i].stop == NULL || global.out[i].run == NULL) {
+        LOG("%s\n", dlerror());
+        dlclose(global.out[i].handle);
+        goto failed;
+    }
+    if(loaded_elsewhere(CONFIG_OUTPUT, i, global.out[i].handle)) {
+        LOG("ERROR: %s is loaded already, it can not run twice\n", global.out[i].plugin);
+        dlclose(global.out[i].handle);
+        goto failed;
+    }
+
+    /* try to find optional command, it is available once the plugin is initialized */
+    cmd = dlsym(global.out[i].handle, "output_cmd");
+
+    global.out[i].param.parameters = strchr(cmdline, ' ');
+    split_parameters(global.out[i].param.parameters, &global.out[i].param.argc, global.out[i].param.argv);
+
+    global.out[i].param.global = &global;
+    global.out[i].param.id = i;
+
+    if(global.out[i].init(&global.out[i].param, i)) {
+        LOG("output_init() return value signals to exit\n");
+        free_parameters(global.out[i].param.argc, global.out[i].param.argv);
+        global.out[i].param.parameters = NULL;
+        dlclose(global.out[i].handle);
+        goto failed;
+    }
+
+    pthread_rwlock_wrlock(&commands_lock);
+    global.out[i].cmd = cmd;
+    if(i == global.outcnt)
+        global.outcnt++;
+    pthread_rwlock_unlock(&commands_lock);
+
+    return 0;
+
+failed:
+    /* nothing may call into the closed library */
+    global.out[i].handle = NULL;
+    global.out[i].init = NULL;
+    global.out[i].stop = NULL;
+    global.out[i].run = NULL;
+    global.out[i].cmd = NULL;
+    global.out[i].out_parameters = NULL;
+    global.out[i].parametercount = 0;
+    free(global.out[i].plugin);
+    global.out[i].plugin = NULL;
+    return -1;
+}
+
+/******************************************************************************
+Description.: close the handle of a stopped input plugin and forget the frame
+              it published, the slot can be opened again afterwards
+Input Value.: number of the input
+Return Value: -
+******************************************************************************/
+static void close_input(int i)
+{
+    /* wait for running commands, later ones find no command */
+    pthread_rwlock_wrlock(&commands_lock);
+    global.in[i].cmd = NULL;
+    dlclose(global.in[i].handle);
+    global.in[i].handle = NULL;
+    pthread_rwlock_unlock(&commands_lock);
+
+    free_parameters(global.in[i].param.argc, global.in[i].param.argv);
+    global.in[i].param.parameters = NULL;
+    free(global.in[i].plugin);
+    global.in[i].plugin = NULL;
+
+    /* the plugin freed these, the outputs must not see them anymore */
+    pthread_mutex_lock(&global.in[i].db);
+    global.in[i].buf = NULL;
+    global.in[i].size = 0;
+    global.in[i].in_parameters = NULL;
+    global.in[i].parametercount = 0;
+    global.in[i].in_formats = NULL;
+    global.in[i].formatCount = 0;
+    pthread_mutex_unlock(&global.in[i].db);
+
+    inputs[i].loaded = 0;
+    inputs[i].running = 0;
+}
+
+/******************************************************************************
+Description.: close the handle of a stopped output plugin
+Input Value.: number of the output
+Return Value: -
+******************************************************************************/
+static void close_output(int i)
+{
+    /* wait for running commands, later ones find no command */
+    pthread_rwlock_wrlock(&commands_lock);
+    global.out[i].cmd = NULL;
+    dlclose(global.out[i].handle);
+    global.out[i].handle = NULL;
+    pthread_rwlock_unlock(&commands_lock);
+
+    free_parameters(global.out[i].param.argc, global.out[i].param.argv);
+    global.out[i].param.parameters = NULL;
+    free(global.out[i].plugin);
+    global.out[i].plugin = NULL;
+    global.out[i].out_parameters = NULL;
+    global.out[i].parametercount = 0;
+
+    outputs[i].loaded = 0;
+    outputs[i].running = 0;
+}
+
+/******************************************************************************
+Description.: open and initialize the plugin of a slot
+Input Value.: type and number of the plugin
+Return Value: 0 if ok, -1 if the plugin could not be loaded
+******************************************************************************/
+static int load_plugin(config_type type, int i)
+{
+    plugin_slot *slot = (type == CONFIG_INPUT) ? &inputs[i] : &outputs[i];
+
+    if(slot->stuck) {
+        LOG("the plugin #%02d did not stop, it can not be loaded again\n", i);
+        return -1;
+    }
+
+    if(slot->loaded)
+        return 0;
+
+    if(type == CONFIG_INPUT) {
+        if(open_input(i, slot->cmdline) < 0)
+            return -1;
+    } else {
+        if(open_output(i, slot->cmdline) < 0)
+            return -1;
+    }
+
+    slot->loaded = 1;
+    return 0;
+}
+
+/******************************************************************************
+Description.: run the loaded plugin of a slot
+Input Value.: type and number of the plugin
+Return Value: 0 if ok, -1 if the plugin did not start, it is unloaded then
+******************************************************************************/
+static int run_plugin(config_type type, int i)
+{
+    plugin_slot *slot = (type == CONFIG_INPUT) ? &inputs[i] : &outputs[i];
+
+    if(slot->running)
+        return 0;
+
+    if(type == CONFIG_INPUT) {
+        syslog(LOG_INFO, "starting input plugin %s", global.in[i].plugin);
+        if(global.in[i].run(i)) {
+            LOG("can not run input plugin %d: %s\n", i, global.in[i].plugin);
+            close_input(i);
+            return -1;
+        }
+    } else {
+        syslog(LOG_INFO, "starting output plugin: %s (ID: %02d)", global.out[i].plugin, global.out[i].param.id);
+        if(global.out[i].run(global.out[i].param.id)) {
+            LOG("can not run output plugin %d: %s\n", i, global.out[i].plugin);
+            close_output(i);
+            return -1;
+        }
+    }
+
+    slot->running = 1;
+    return 0;
+}
+
+/******************************************************************************
+Description.: stop and unload the plugin of a slot, the slot keeps its command
+              line so it can be started again. If the threads of the plugin do
+              not finish in time the plugin stays loaded and the slot is stuck.
+Input Value.: type and number of the plugin
+Return Value: 0 if ok, -1 if the plugin did not stop
+******************************************************************************/
+static int stop_plugin(config_type type, int i)
+{
+    plugin_slot *slot = (type == CONFIG_INPUT) ? &inputs[i] : &outputs[i];
+    int rc;
+
+    if(slot->stuck)
+        return -1;
+
+    /* a stopped plugin has freed what its command works on */
+    pthread_rwlock_wrlock(&commands_lock);
+    if(type == CONFIG_INPUT)
+        global.in[i].cmd = NULL;
+    else
+        global.out[i].cmd = NULL;
+    pthread_rwlock_unlock(&commands_lock);
+
+    if(slot->running) {
+        if(type == CONFIG_INPUT)
+            rc = global.in[i].stop(i);
+        else
+            rc = global.out[i].stop(global.out[i].param.id);
+
+        slot->running = 0;
+        if(rc != 0) {
+            LOG("the %s plugin #%02d did not stop in time, it stays loaded\n", (type == CONFIG_INPUT) ? "input" : "output", i);
+            slot->stuck = 1;
+            return -1;
+        }
+    } else if(slot->loaded) {
+        /* init() set up the plugin already, e.g. a camera opened its device */
+        if(type == CONFIG_INPUT)
+            global.in[i].stop(i);
+        else
+            global.out[i].stop(global.out[i].param.id);
+    }
+
+    if(slot->loaded) {
+        if(type == CONFIG_INPUT)
+            close_input(i);
+        else
+            close_output(i);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: open and run the plugin of a section
+Input Value.: type, number of the plugin and its section
+Return Value: 0 if ok, -1 if the plugin did not start
+******************************************************************************/
+static int start_plugin(config_type type, int i, config_plugin *p)
+{
+    plugin_slot *slot = (type == CONFIG_INPUT) ? &inputs[i] : &outputs[i];
+
+    if(slot->cmdline != p->cmdline) {
+        free(slot->cmdline);
+        slot->cmdline = strdup(p->cmdline);
+    }
+    if(slot->name == NULL || strcmp(slot->name, p->name) != 0) {
+        free(slot->name);
+        slot->name = strdup(p->name);
+    }
+
+    if(load_plugin(type, i) < 0)
+        return -1;
+
+    return run_plugin(type, i);
+}
+
+/******************************************************************************
+Description.: set the controls a section lists, a control is looked up by its
+              name in the controls the plugin offers
+Input Value.: type and number of the plugin
+              p: the section with the new values
+              old: the section the values were set from before or NULL, only
+                   controls whose value changed are sent again
+Return Value: -
+******************************************************************************/
+static void set_controls(config_type type, int i, config_plugin *p, config_plugin *old)
+{
+    control *ctrls;
+    int count, (*cmd)(int, unsigned int, unsigned int, int), id;
+    int c, j, value;
+
+    if(type == CONFIG_INPUT) {
+        ctrls = global.in[i].in_parameters;
+        count = global.in[i].parametercount;
+        cmd = global.in[i].cmd;
+        id = i;
+    } else {
+        ctrls = global.out[i].out_parameters;
+        count = global.out[i].parametercount;
+        cmd = global.out[i].cmd;
+        id = global.out[i].param.id;
+    }
+
+    for(c = 0; c < p->control_count; c++) {
+        if(config_control_value(old, p->controls[c].name, &value) && value == p->controls[c].value)
+            continue;
+
+        for(j = 0; j < count; j++) {
+            if(strcasecmp((char *)ctrls[j].ctrl.name, p->controls[c].name) == 0)
+                break;
+        }
+
+        if(j == count || cmd == NULL) {
+            LOG("the plugin of \"%s\" has no control \"%s\"\n", p->name, p->controls[c].name);
+            continue;
+        }
+
+        DBG("setting %s of %s to %d\n", p->controls[c].name, p->name, p->controls[c].value);
+        if(cmd(id, ctrls[j].ctrl.id, ctrls[j].group, p->controls[c].value) < 0) {
+            LOG("could not set the control \"%s\" of \"%s\"\n", p->controls[c].name, p->name);
+        }
+    }
+}
+
+/******************************************************************************
+Description.: look up the slot that runs a section of the configuration file
+Input Value.: type and name of the section
+Return Value: number of the plugin or -1
+******************************************************************************/
+static int find_slot(config_type type, const char *name)
+{
+    plugin_slot *slots = (type == CONFIG_INPUT) ? inputs : outputs;
+    int i, n = (type == CONFIG_INPUT) ? global.incnt : global.outcnt;
+
+    for(i = 0; i < n; i++) {
+        if(slots[i].name != NULL && strcmp(slots[i].name, name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+Description.: find a slot for a new plugin, this is a slot that was unloaded,
+              the slot of a section that was removed from the file or an
+              unused one at the end
+Input Value.: type of the section, the configuration that will be active
+Return Value: number of the plugin or -1 if all slots are in use
+******************************************************************************/
+static int spare_slot(config_type type, config *next)
+{
+    plugin_slot *slots = (type == CONFIG_INPUT) ? inputs : outputs;
+    int i, n = (type == CONFIG_INPUT) ? global.incnt : global.outcnt;
+
+    for(i = 0; i < n; i++) {
+        if(slots[i].stuck)
+            continue;
+        if(slots[i].cmdline == NULL)
+            return i;
+        if(!slots[i].loaded && slots[i].name != NULL && config_find(next, type, slots[i].name) == NULL)
+            return i;
+    }
+
+    return (n < ((type == CONFIG_INPUT) ? global.inmax : global.outmax)) ? n : -1;
+}
+
+/******************************************************************************
+Description.: read the configuration file again and apply the differences:
+              only the plugins whose section changed or disappeared are
+              stopped, new sections are started and changed controls are set
+              on the running plugins, everything else keeps running
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void reload_config(void)
+{
+    config next;
+    config_plugin *p, *old;
+    config_type t;
+    int i, n, incnt = global.incnt, outcnt = global.outcnt;
+    char *restart_in, *restart_out;
+
+    LOG("reading the configuration file %s again\n", config_file);
+    if(config_load(config_file, &next) < 0) {
+        LOG("keeping the running configuration\n");
+        return;
+    }
+
+    restart_in = calloc(global.inmax, 1);
+    restart_out = calloc(global.outmax, 1);
+    if(restart_in == NULL || restart_out == NULL) {
+        LOG("not enough memory to reload the configuration\n");
+        free(restart_in);
+        free(restart_out);
+        config_free(&next);
+        return;
+    }
+
+    /* stop the plugins of changed or removed sections, outputs first */
+    for(i = 0; i < global.outcnt; i++) {
+        if(outputs[i].name == NULL || !outputs[i].running)
+            continue;
+        p = config_find(&next, CONFIG_OUTPUT, outputs[i].name);
+        if(p != NULL && strcmp(p->cmdline, outputs[i].cmdline) == 0)
+            continue;
+        LOG("stopping output \"%s\"\n", outputs[i].name);
+        stop_plugin(CONFIG_OUTPUT, i);
+        restart_out[i] = 1;
+    }
+
+    for(i = 0; i < global.incnt; i++) {
+        if(inputs[i].name == NULL || !inputs[i].running)
+            continue;
+        p = config_find(&next, CONFIG_INPUT, inputs[i].name);
+        if(p != NULL && strcmp(p->cmdline, inputs[i].cmdline) == 0)
+            continue;
+        LOG("stopping input \"%s\"\n", inputs[i].name);
+        stop_plugin(CONFIG_INPUT, i);
+        restart_in[i] = 1;
+    }
+
+    /*
+     * start the sections again in the slot they had before, so the outputs
+     * and the clients keep addressing the same input number, a removed
+     * section leaves its slot unused
+     */
+    for(i = 0; i < global.incnt; i++) {
+        if(inputs[i].name == NULL || inputs[i].running || inputs[i].stuck)
+            continue;
+        if((p = config_find(&next, CONFIG_INPUT, inputs[i].name)) == NULL)
+            continue;
+        LOG("starting input \"%s\"\n", p->name);
+        restart_in[i] = 1;
+        if(start_plugin(CONFIG_INPUT, i, p) == 0)
+            set_controls(CONFIG_INPUT, i, p, NULL);
+    }
+
+    for(i = 0; i < global.outcnt; i++) {
+        if(outputs[i].name == NULL || outputs[i].running || outputs[i].stuck)
+            continue;
+        if((p = config_find(&next, CONFIG_OUTPUT, outputs[i].name)) == NULL)
+            continue;
+        LOG("starting output \"%s\"\n", p->name);
+        restart_out[i] = 1;
+        if(start_plugin(CONFIG_OUTPUT, i, p) == 0)
+            set_controls(CONFIG_OUTPUT, i, p, NULL);
+    }
+
+    /* start the new sections, inputs first so the outputs can use them */
+    for(t = CONFIG_INPUT; t <= CONFIG_OUTPUT; t++) {
+        for(i = 0; i < next.count; i++) {
+            p = &next.plugins[i];
+            if(p->type != t || find_slot(t, p->name) >= 0)
+                continue;
+            if((n = spare_slot(t, &next)) < 0) {
+                LOG("no free slot for \"%s\"\n", p->name);
+                continue;
+            }
+            LOG("starting %s \"%s\"\n", (t == CONFIG_INPUT) ? "input" : "output", p->name);
+            if(t == CONFIG_INPUT)
+                restart_in[n] = 1;
+            else
+                restart_out[n] = 1;
+            if(start_plugin(t, n, p) == 0)
+                set_controls(t, n, p, NULL);
+        }
+    }
+
+    /* the plugins that kept running get the controls that changed */
+    for(i = 0; i < incnt; i++) {
+        if(inputs[i].name == NULL || !inputs[i].running || restart_in[i])
+            continue;
+        p = config_find(&next, CONFIG_INPUT, inputs[i].name);
+        old = config_find(&current, CONFIG_INPUT, inputs[i].name);
+        if(p != NULL)
+            set_controls(CONFIG_INPUT, i, p, old);
+    }
+    for(i = 0; i < outcnt; i++) {
+        if(outputs[i].name == NULL || !outputs[i].running || restart_out[i])
+            continue;
+        p = config_find(&next, CONFIG_OUTPUT, outputs[i].name);
+        old = config_find(&current, CONFIG_OUTPUT, outputs[i].name);
+        if(p != NULL)
+            set_controls(CONFIG_OUTPUT, i, p, old);
+    }
+
+    free(restart_in);
+    free(restart_out);
+    config_free(&current);
+    current = next;
+}
+
+/******************************************************************************
+Description.: execute a command for the program itself, the output plugins
+              call it through global.control, e.g. output_http for commands
+              with the destination Dest_Program
+Input Value.: command: one of the PRG_CMD_* values
+              plugin: number of the plugin, not used to load a plugin
+              details: "plugin parameters" like the -i and -o options take
+                       it, only used to load a plugin
+Return Value: the number of the plugin if it was loaded, 0 for the other
+              commands if ok, -1 in case of an error
+******************************************************************************/
+static int program_control(int command, int plugin, char *details)
+{
+    config_type type;
+    plugin_slot *slot;
+    int rc = 0;
+
+    switch(command) {
+    case PRG_CMD_INPUT_LOAD:
+    case PRG_CMD_INPUT_START:
+    case PRG_CMD_INPUT_STOP:
+    case PRG_CMD_INPUT_UNLOAD:
+        type = CONFIG_INPUT;
+        break;
+    case PRG_CMD_OUTPUT_LOAD:
+    case PRG_CMD_OUTPUT_START:
+    case PRG_CMD_OUTPUT_STOP:
+    case PRG_CMD_OUTPUT_UNLOAD:
+        type = CONFIG_OUTPUT;
+        break;
+    default:
+        LOG("unknown program command %d\n", command);
+        return -1;
+    }
+
+    pthread_mutex_lock(&plugins_mutex);
+
+    if(command == PRG_CMD_INPUT_LOAD || command == PRG_CMD_OUTPUT_LOAD) {
+        if(details == NULL || *details == '\0' || *details == ' ') {
+            rc = -1;
+        } else if((plugin = spare_slot(type, &current)) < 0) {
+            LOG("no free slot to load %s\n", details);
+            rc = -1;
+        } else {
+            slot = (type == CONFIG_INPUT) ? &inputs[plugin] : &outputs[plugin];
+            free(slot->name);
+            slot->name = NULL;
+            free(slot->cmdline);
+            slot->cmdline = strdup(details);
+            LOG("loading %s #%02d: %s\n", (type == CONFIG_INPUT) ? "input" : "output", plugin, details);
+            rc = (load_plugin(type, plugin) == 0) ? plugin : -1;
+            if(rc < 0) {
+                free(slot->cmdline);
+                slot->cmdline = NULL;
+            }
+        }
+        pthread_mutex_unlock(&plugins_mutex);
+        return rc;
+    }
+
+    if(plugin < 0 || plugin >= ((type == CONFIG_INPUT) ? global.incnt : global.outcnt)) {
+        pthread_mutex_unlock(&plugins_mutex);
+        return -1;
+    }
+    slot = (type == CONFIG_INPUT) ? &inputs[plugin] : &outputs[plugin];
+    if(slot->cmdline == NULL) {
+        pthread_mutex_unlock(&plugins_mutex);
+        return -1;
+    }
+
+    switch(command) {
+    case PRG_CMD_INPUT_START:
+    case PRG_CMD_OUTPUT_START:
+        LOG("starting %s #%02d\n", (type == CONFIG_INPUT) ? "input" : "output", plugin);
+        if(load_plugin(type, plugin) < 0 || run_plugin(type, plugin) < 0)
+            rc = -1;
+        break;
+
+    case PRG_CMD_INPUT_STOP:
+    case PRG_CMD_OUTPUT_STOP:
+        LOG("stopping %s #%02d\n", (type == CONFIG_INPUT) ? "input" : "output", plugin);
+        rc = stop_plugin(type, plugin);
+        break;
+
+    case PRG_CMD_INPUT_UNLOAD:
+    case PRG_CMD_OUTPUT_UNLOAD:
+        LOG("unloading %s #%02d\n", (type == CONFIG_INPUT) ? "input" : "output", plugin);
+        if(stop_plugin(type, plugin) < 0) {
+            rc = -1;
+            break;
+        }
+        free(slot->cmdline);
+        slot->cmdline = NULL;
+        free(slot->name);
+        slot->name = NULL;
+        break;
+    }
+
+    pthread_mutex_unlock(&plugins_mutex);
+    return rc;
+}
+
+/******************************************************************************
+Description.: execute the command of a plugin, the output plugins call it
+              through global.command, e.g. output_http for the commands with
+              the destinations Dest_Input and Dest_Output
+Input Value.: dest......: Dest_Input or Dest_Output
+              plugin....: number of the plugin
+              control_id: control_id, group and value are passed to the plugin
+Return Value: the return value of the plugin, -1 if the plugin does not exist
+              or has no command
+******************************************************************************/
+static int plugin_command(int dest, int plugin, unsigned int control_id, unsigned int group, int value)
+{
+    int (*cmd)(int, unsigned int, unsigned int, int) = NULL;
+    int id = plugin, rc = -1;
+
+    pthread_rwlock_rdlock(&commands_lock);
+
+    if(dest == Dest_Input && plugin >= 0 && plugin < global.incnt) {
+        cmd = global.in[plugin].cmd;
+    } else if(dest == Dest_Output && plugin >= 0 && plugin < global.outcnt) {
+        cmd = global.out[plugin].cmd;
+        id = global.out[plugin].param.id;
+    }
+
+    if(cmd != NULL)
+        rc = cmd(id, control_id, group, value);
+
+    pthread_rwlock_unlock(&commands_lock);
+    return rc;
+}
+
+/******************************************************************************
+Description.: stop all plugins, outputs first because they wait for the
+              inputs, and unload those that stopped in time. The handles of
+              plugins whose threads are still running stay open.
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void stop_all(void)
+{
+    int i, stuck = 0;
+
+    /* signal "stop" to threads */
+    LOG("setting signal to stop\n");
+    global.stop = 1;
+
+    pthread_mutex_lock(&plugins_mutex);
+
+    for(i = 0; i < global.outcnt; i++) {
+        if(stop_plugin(CONFIG_OUTPUT, i) < 0)
+            stuck++;
+    }
+    for(i = 0; i < global.incnt; i++) {
+        if(stop_plugin(CONFIG_INPUT, i) < 0)
+            stuck++;
+    }
+
+    /* threads that did not stop may still use the frames of the inputs */
+    if(stuck == 0) {
+        for(i = 0; i < global.incnt; i++) {
+            pthread_cond_destroy(&global.in[i].db_update);
+            pthread_mutex_destroy(&global.in[i].db);
+        }
+        DBG("all plugin handles closed\n");
+    } else {
+        LOG("%d plugin(s) did not stop in time\n", stuck);
+    }
+
+    pthread_mutex_unlock(&plugins_mutex);
+}
+
 /******************************************************************************
 Description.:
 Input Value.:
@@ -180,12 +984,10 @@ Return Value:
 int main(int argc, char *argv[])
 {
     //char *input  = "input_uvc.so --resolution 640x480 --fps 5 --device /dev/video0";
-    char *input[MAX_INPUT_PLUGINS];
-    char *output[MAX_OUTPUT_PLUGINS];
-    int daemon = 0, i;
-    size_t tmp = 0;
+    char **input = NULL, **output = NULL, **tmp;
+    int daemon = 0, i, incnt = 0, outcnt = 0;
+    config_plugin *p;
 
-    output[0] = "output_http.so --port 8080";
     global.outcnt = 0;
 
 
@@ -204,6 +1006,8 @@ int main(int argc, char *argv[])
             {"version", no_argument, 0, 0},
             {"b", no_argument, 0, 0},
             {"background", no_argument, 0, 0},
+            {"c", required_argument, 0, 0},
+            {"config", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -229,13 +1033,23 @@ int main(int argc, char *argv[])
             /* i, input */
         case 2:
         case 3:
-            input[global.incnt++] = strdup(optarg);
+            if((tmp = realloc(input, (incnt + 1) * sizeof(char *))) == NULL) {
+                fprintf(stderr, "not enough memory\n");
+                return 1;
+            }
+            input = tmp;
+            input[incnt++] = strdup(optarg);
             break;
 
             /* o, output */
         case 4:
         case 5:
-            output[global.outcnt++] = strdup(optarg);
+            if((tmp = realloc(output, (outcnt + 1) * sizeof(char *))) == NULL) {
+                fprintf(stderr, "not enough memory\n");
+                return 1;
+            }
+            output = tmp;
+            output[outcnt++] = strdup(optarg);
             break;
 
             /* v, version */
@@ -259,6 +1073,16 @@ int main(int argc, char *argv[])
             daemon = 1;
             break;
 
+            /* c, config */
+        case 10:
+        case 11:
+            /* daemon mode changes the working directory */
+            if((config_file = realpath(optarg, NULL)) == NULL) {
+                fprintf(stderr, "could not find the configuration file %s\n", optarg);
+                return 1;
+            }
+            break;
+
         default:
             help(argv[0]);
             return 0;
@@ -269,6 +1093,11 @@ int main(int argc, char *argv[])
     //openlog("MJPG-streamer ", LOG_PID|LOG_CONS|LOG_PERROR, LOG_USER);
     syslog(LOG_INFO, "starting application");
 
+    if(config_file != NULL && config_load(config_file, &current) < 0) {
+        closelog();
+        exit(EXIT_FAILURE);
+    }
+
     /* fork to the background */
     if(daemon) {
         LOG("enabling daemon mode");
@@ -278,6 +1107,13 @@ int main(int argc, char *argv[])
     /* ignore SIGPIPE (send by OS if transmitting to closed TCP sockets) */
     signal(SIGPIPE, SIG_IGN);
 
+    /* the signal handlers wake up the main loop with this event */
+    if((wakeup_fd = stop_event_open()) < 0) {
+        LOG("could not create the wake up event\n");
+        closelog();
+        exit(EXIT_FAILURE);
+    }
+
     /* register signal handler for <CTRL>+C in order to clean up */
     if(signal(SIGINT, signal_handler) == SIG_ERR) {
         LOG("could not register signal handler\n");
@@ -285,6 +1121,13 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    /* SIGHUP reads the configuration file again */
+    if(config_file != NULL && signal(SIGHUP, reload_handler) == SIG_ERR) {
+        LOG("could not register signal handler\n");
+        closelog();
+        exit(EXIT_FAILURE);
+    }
+
     /*
      * messages like the following will only be visible on your terminal
      * if not running in daemon mode
@@ -295,120 +1138,84 @@ int main(int argc, char *argv[])
     LOG("MJPG Streamer Version.: %s\n", SOURCE_VERSION);
 #endif
 
-    /* check if at least one output plugin was selected */
-    if(global.outcnt == 0) {
-        /* no? Then use the default plugin instead */
-        global.outcnt = 1;
+    /*
+     * the plugins keep pointers into the tables, so they can not grow later,
+     * there are spare slots for plugins that commands or a reload of the
+     * configuration file add
+     */
+    global.inmax = incnt;
+    global.outmax = (outcnt > 0) ? outcnt : 1;
+    for(i = 0; i < current.count; i++) {
+        if(current.plugins[i].type == CONFIG_INPUT)
+            global.inmax++;
+        else
+            global.outmax++;
     }
+    global.inmax += SPARE_PLUGIN_SLOTS;
+    global.outmax += SPARE_PLUGIN_SLOTS;
 
-    /* open input plugin */
-    for(i = 0; i < global.incnt; i++) {
-        /* this mutex and the conditional variable are used to synchronize access to the global picture buffer */
-        if(pthread_mutex_init(&global.in[i].db, NULL) != 0) {
-            LOG("could not initialize mutex variable\n");
-            closelog();
-            exit(EXIT_FAILURE);
-        }
-        if(pthread_cond_init(&global.in[i].db_update, NULL) != 0) {
-            LOG("could not initialize condition variable\n");
-            closelog();
-            exit(EXIT_FAILURE);
-        }
+    if(posix_memalign((void **)&global.in, CACHE_LINE_SIZE, global.inmax * sizeof(*global.in)) != 0 ||
+       (global.out = calloc(global.outmax, sizeof(*global.out))) == NULL ||
+       (inputs = calloc(global.inmax, sizeof(plugin_slot))) == NULL ||
+       (outputs = calloc(global.outmax, sizeof(plugin_slot))) == NULL) {
+        LOG("not enough memory for %d input and %d output plugins\n", global.inmax, global.outmax);
+        closelog();
+        exit(EXIT_FAILURE);
+    }
+    memset(global.in, 0, global.inmax * sizeof(*global.in));
 
-        tmp = (size_t)(strchr(input[i], ' ') - input[i]);
-        global.in[i].stop      = 0;
-        global.in[i].buf       = NULL;
-        global.in[i].size      = 0;
-        global.in[i].plugin = (tmp > 0) ? strndup(input[i], tmp) : strdup(input[i]);
-        global.in[i].handle = dlopen(global.in[i].plugin, RTLD_LAZY);
-        if(!global.in[i].handle) {
-            LOG("ERROR: could not find input plugin\n");
-            LOG("       Perhaps you want to adjust the search path with:\n");
-            LOG("       # export LD_LIBRARY_PATH=/path/to/plugin/folder\n");
-            LOG("       dlopen: %s\n", dlerror());
-            closelog();
-            exit(EXIT_FAILURE);
-        }
-        global.in[i].init = dlsym(global.in[i].handle, "input_init");
-        if(global.in[i].init == NULL) {
-            LOG("%s\n", dlerror());
-            exit(EXIT_FAILURE);
-        }
-        global.in[i].stop = dlsym(global.in[i].handle, "input_stop");
-        if(global.in[i].stop == NULL) {
-            LOG("%s\n", dlerror());
-            exit(EXIT_FAILURE);
-        }
-        global.in[i].run = dlsym(global.in[i].handle, "input_run");
-        if(global.in[i].run == NULL) {
-            LOG("%s\n", dlerror());
-            exit(EXIT_FAILURE);
+    /* the plugins of the command line come first, then those of the file */
+    for(i = 0; i < incnt; i++) {
+        inputs[i].cmdline = input[i];
+    }
+    for(i = 0; i < outcnt; i++) {
+        outputs[i].cmdline = output[i];
+    }
+    free(input);
+    free(output);
+
+    for(i = 0; i < current.count; i++) {
+        p = &current.plugins[i];
+        if(p->type == CONFIG_INPUT) {
+            inputs[incnt].cmdline = strdup(p->cmdline);
+            inputs[incnt++].name = strdup(p->name);
+        } else {
+            outputs[outcnt].cmdline = strdup(p->cmdline);
+            outputs[outcnt++].name = strdup(p->name);
         }
-        /* try to find optional command */
-        global.in[i].cmd = dlsym(global.in[i].handle, "input_cmd");
+    }
+
+    /* check if at least one output plugin was selected */
+    if(outcnt == 0) {
+        /* no? Then use the default plugin instead */
+        outputs[0].cmdline = strdup("output_http.so --port 8080");
+        outcnt = 1;
+    }
 
-        global.in[i].param.parameters = strchr(input[i], ' ');
-        split_parameters(global.in[i].param.parameters, &global.in[i].param.argc, global.in[i].param.argv);
-        global.in[i].param.global = &global;
-        global.in[i].param.id = i;
+    /* the output plugins may load, start, stop and unload plugins */
+    global.control = program_control;
+    global.command = plugin_command;
 
-        if(global.in[i].init(&global.in[i].param, i)) {
-            LOG("input_init() return value signals to exit\n");
+    /* open input plugin */
+    for(i = 0; i < incnt; i++) {
+        if(load_plugin(CONFIG_INPUT, i) < 0) {
             closelog();
-            exit(0);
+            exit(EXIT_FAILURE);
         }
     }
 
     /* open output plugin */
-    for(i = 0; i < global.outcnt; i++) {
-        tmp = (size_t)(strchr(output[i], ' ') - output[i]);
-        global.out[i].plugin = (tmp > 0) ? strndup(output[i], tmp) : strdup(output[i]);
-        global.out[i].handle = dlopen(global.out[i].plugin, RTLD_LAZY);
-        if(!global.out[i].handle) {
-            LOG("ERROR: could not find output plugin %s\n", global.out[i].plugin);
-            LOG("       Perhaps you want to adjust the search path with:\n");
-            LOG("       # export LD_LIBRARY_PATH=/path/to/plugin/folder\n");
-            LOG("       dlopen: %s\n", dlerror());
+    for(i = 0; i < outcnt; i++) {
+        if(load_plugin(CONFIG_OUTPUT, i) < 0) {
             closelog();
             exit(EXIT_FAILURE);
         }
-        global.out[i].init = dlsym(global.out[i].handle, "output_init");
-        if(global.out[i].init == NULL) {
-            LOG("%s\n", dlerror());
-            exit(EXIT_FAILURE);
-        }
-        global.out[i].stop = dlsym(global.out[i].handle, "output_stop");
-        if(global.out[i].stop == NULL) {
-            LOG("%s\n", dlerror());
-            exit(EXIT_FAILURE);
-        }
-        global.out[i].run = dlsym(global.out[i].handle, "output_run");
-        if(global.out[i].run == NULL) {
-            LOG("%s\n", dlerror());
-            exit(EXIT_FAILURE);
-        }
-
-        /* try to find optional command */
-        global.out[i].cmd = dlsym(global.out[i].handle, "output_cmd");
-
-        global.out[i].param.parameters = strchr(output[i], ' ');
-        split_parameters(global.out[i].param.parameters, &global.out[i].param.argc, global.out[i].param.argv);
-
-        global.out[i].param.global = &global;
-        global.out[i].param.id = i;
-        if(global.out[i].init(&global.out[i].param, i)) {
-            LOG("output_init() return value signals to exit\n");
-            closelog();
-            exit(0);
-        }
     }
 
     /* start to read the input, push pictures into global buffer */
     DBG("starting %d input plugin\n", global.incnt);
     for(i = 0; i < global.incnt; i++) {
-        syslog(LOG_INFO, "starting input plugin %s", global.in[i].plugin);
-        if(global.in[i].run(i)) {
-            LOG("can not run input plugin %d: %s\n", i, global.in[i].plugin);
+        if(run_plugin(CONFIG_INPUT, i) < 0) {
             closelog();
             return 1;
         }
@@ -416,12 +1223,38 @@ int main(int argc, char *argv[])
 
     DBG("starting %d output plugin(s)\n", global.outcnt);
     for(i = 0; i < global.outcnt; i++) {
-        syslog(LOG_INFO, "starting output plugin: %s (ID: %02d)", global.out[i].plugin, global.out[i].param.id);
-        global.out[i].run(global.out[i].param.id);
+        run_plugin(CONFIG_OUTPUT, i);
+    }
+
+    /* the controls of the file need the running plugins */
+    for(i = 0; i < global.incnt; i++) {
+        if(inputs[i].name != NULL)
+            set_controls(CONFIG_INPUT, i, config_find(&current, CONFIG_INPUT, inputs[i].name), NULL);
+    }
+    for(i = 0; i < global.outcnt; i++) {
+        if(outputs[i].name != NULL)
+            set_controls(CONFIG_OUTPUT, i, config_find(&current, CONFIG_OUTPUT, outputs[i].name), NULL);
+    }
+
+    /*
+     * wait for signals, they may be handled by any of the plugin threads,
+     * the handlers only set a flag and the event
+     */
+    while(!quit) {
+        stop_event_wait(wakeup_fd, -1);
+        stop_event_clear(wakeup_fd);
+        if(reload && !quit) {
+            reload = 0;
+            pthread_mutex_lock(&plugins_mutex);
+            reload_config();
+            pthread_mutex_unlock(&plugins_mutex);
+        }
     }
 
-    /* wait for signals */
-    pause();
+    stop_all();
+
+    LOG("done\n");
+    closelog();
 
     return 0;
 }
@@ -24,10 +24,12 @@
 #define MJPG_STREAMER_H
 #define SOURCE_VERSION "2.0"
 
-/* FIXME take a look to the output_http clients thread marked with fixme if you want to set more then 10 plugins */
-#define MAX_INPUT_PLUGINS 10
-#define MAX_OUTPUT_PLUGINS 10
+/* free slots for plugins that are loaded at runtime */
+#define SPARE_PLUGIN_SLOTS 16
 #define MAX_PLUGIN_ARGUMENTS 32
+
+/* the input structures are aligned to it, so inputs don't share cache lines */
+#define CACHE_LINE_SIZE 64
 #include <linux/types.h>          /* for videodev2.h */
 #include <linux/videodev2.h>
 
@@ -61,6 +63,22 @@ enum _cmd_group {
     IN_CMD_JPEG_QUALITY = 3,
 };
 
+/*
+ * commands which can be send to the program itself (Dest_Program), they load
+ * a plugin into a free slot, start it, stop it or unload it and free the slot
+ */
+typedef enum _prg_cmd prg_cmd;
+enum _prg_cmd {
+    PRG_CMD_INPUT_LOAD = 1,     // details: "plugin.so parameters", returns the number of the input
+    PRG_CMD_INPUT_START = 2,
+    PRG_CMD_INPUT_STOP = 3,
+    PRG_CMD_INPUT_UNLOAD = 4,
+    PRG_CMD_OUTPUT_LOAD = 5,    // details: "plugin.so parameters", returns the number of the output
+    PRG_CMD_OUTPUT_START = 6,
+    PRG_CMD_OUTPUT_STOP = 7,
+    PRG_CMD_OUTPUT_UNLOAD = 8,
+};
+
 typedef struct _control control;
 struct _control {
     struct v4l2_queryctrl ctrl;
@@ -77,16 +95,28 @@ struct _control {
 struct _globals {
     int stop;
 
-    /* input plugin */
-    input in[MAX_INPUT_PLUGINS];
+    /*
+     * input plugin, the tables are allocated once before the plugins start
+     * because the plugins keep pointers into them, inmax and outmax are
+     * their sizes
+     */
+    input *in;
     int incnt;
+    int inmax;
 
     /* output plugin */
-    output out[MAX_OUTPUT_PLUGINS];
+    output *out;
     int outcnt;
+    int outmax;
+
+    /* pointer to control functions, executes the PRG_CMD_* commands */
+    int (*control)(int command, int plugin, char *details);
 
-    /* pointer to control functions */
-    //int (*control)(int command, char *details);
+    /*
+     * executes the command of a plugin (Dest_Input or Dest_Output), the
+     * plugin can not be unloaded meanwhile, returns -1 if it has no command
+     */
+    int (*command)(int dest, int plugin, unsigned int control_id, unsigned int group, int value);
 };
 
 #endif
@@ -49,10 +49,30 @@ struct _input_format {
     char currentResolution;
 };
 
-/* structure to store variables/functions for input plugin */
+/*
+ * result of the motion detection for an input, it is written by the
+ * output_motion plugin and protected by the "db" mutex of the input
+ */
+typedef struct _input_motion input_motion;
+struct _input_motion {
+    int enabled;                // a motion detector is attached to this input
+    unsigned int sequence;      // incremented for each analysed frame
+    int score;                  // changed blocks in permille
+    int detected;               // score is above the configured limit
+    int width, height;          // size of the mask in 8x8 pixel blocks
+    unsigned char *mask;        // width*height entries, 1 means motion
+    struct timeval timestamp;   // timestamp of the analysed frame
+};
+
+/*
+ * structure to store variables/functions for input plugin, each input
+ * starts on its own cache line so the inputs don't slow down each other
+ */
 typedef struct _input input;
 struct _input {
     char *plugin;
+    /* a plugin is loaded into several slots only if it exports
+       "const int input_per_id", its state must be kept for each id then */
     void *handle;
 
     input_parameter param; // this holds the command line arguments
@@ -72,15 +92,25 @@ struct _input {
     unsigned char *buf;
     int size;
 
+    /* V4L2 pixel format of buf, 0 for JPG frames, V4L2_PIX_FMT_H264 for H.264 access units */
+    unsigned int format;
+
     /* v4l2_buffer timestamp */
     struct timeval timestamp;
 
+    /* published by a motion detector */
+    input_motion motion;
+
     input_format *in_formats;
     int formatCount;
     int currentFormat; // holds the current format number
 
     int (*init)(input_parameter *, int id);
+    /* wakes up the threads of the plugin and joins them within STOP_TIMEOUT_MS,
+       returns 0 if they finished and the ressources are freed, otherwise -1 and
+       the plugin must not be unloaded. It is also called for an input that was
+       initialized but never run, to free what input_init() set up */
     int (*stop)(int);
     int (*run)(int);
     int (*cmd)(int plugin, unsigned int control_id, unsigned int group, int value);
-};
+} __attribute__((aligned(CACHE_LINE_SIZE)));
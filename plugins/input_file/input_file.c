@@ -23,13 +23,19 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
 #include <pthread.h>
 #include <syslog.h>
 #include <sys/types.h>
 #include <sys/inotify.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
 
 #include "../../mjpg_streamer.h"
 #include "../../utils.h"
@@ -38,10 +44,15 @@
 
 /* private functions and variables to this plugin */
 static pthread_t   worker;
+static int         stop_fd = -1;
 static globals     *pglobal;
 
 void *worker_thread(void *);
+void *playback_thread(void *);
 void worker_cleanup(void *);
+static int playback_open(void);
+static int publish_frame(const unsigned char *data, size_t len);
+static int read_file(int file, size_t filesize);
 void help(void);
 
 static int delay = 0;
@@ -54,6 +65,36 @@ static int plugin_number;
 static int fd, rc, wd, size;
 static struct inotify_event *ev;
 
+/* size of the memory allocated for in[].buf, it only grows */
+static size_t capacity = 0;
+
+/* files are read into this grow-only buffer, outside of the db lock */
+static unsigned char *file_buf = NULL;
+static size_t file_capacity = 0;
+
+/* playback of existing files instead of watching the folder */
+static int playback = 0, loop = 0;
+static double fps = 0;
+static char *mjpg_name = NULL;
+
+/* number of files that are mapped ahead of the one being published */
+#define PREFETCH_FILES 8
+/* bytes of a concatenated .mjpg file that are read ahead */
+#define PREFETCH_BYTES (4 << 20)
+
+typedef struct _mapped_file mapped_file;
+struct _mapped_file {
+    int index;              // index in files, -1 if unused
+    unsigned char *data;    // NULL if the file could not be mapped
+    size_t size;
+};
+
+static struct dirent **files = NULL;
+static int file_count = 0;
+static mapped_file window[PREFETCH_FILES];
+static unsigned char *mjpg = NULL;
+static size_t mjpg_size = 0;
+
 /*** plugin interface functions ***/
 int input_init(input_parameter *param, int id)
 {
@@ -82,6 +123,14 @@ int input_init(input_parameter *param, int id)
             {"remove", no_argument, 0, 0},
             {"n", required_argument, 0, 0},
             {"name", required_argument, 0, 0},
+            {"p", no_argument, 0, 0},
+            {"playback", no_argument, 0, 0},
+            {"m", required_argument, 0, 0},
+            {"mjpg", required_argument, 0, 0},
+            {"F", required_argument, 0, 0},
+            {"fps", required_argument, 0, 0},
+            {"l", no_argument, 0, 0},
+            {"loop", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -137,6 +186,35 @@ int input_init(input_parameter *param, int id)
             strcpy(filename, optarg);
             break;
 
+            /* p, playback */
+        case 10:
+        case 11:
+            DBG("case 10,11\n");
+            playback = 1;
+            break;
+
+            /* m, mjpg */
+        case 12:
+        case 13:
+            DBG("case 12,13\n");
+            mjpg_name = strdup(optarg);
+            playback = 1;
+            break;
+
+            /* F, fps */
+        case 14:
+        case 15:
+            DBG("case 14,15\n");
+            fps = atof(optarg);
+            break;
+
+            /* l, loop */
+        case 16:
+        case 17:
+            DBG("case 16,17\n");
+            loop = 1;
+            break;
+
         default:
             DBG("default case\n");
             help();
@@ -147,11 +225,22 @@ int input_init(input_parameter *param, int id)
     pglobal = param->global;
 
     /* check for required parameters */
-    if(folder == NULL) {
+    if(folder == NULL && mjpg_name == NULL) {
         IPRINT("ERROR: no folder specified\n");
         return 1;
     }
 
+    if(playback) {
+        IPRINT("playing...........: %s\n", (mjpg_name != NULL) ? mjpg_name : folder);
+        if(fps > 0) {
+            IPRINT("frames per second.: %.2f\n", fps);
+        } else {
+            IPRINT("frames per second.: as fast as possible\n");
+        }
+        IPRINT("loop..............: %s\n", (loop) ? "yes" : "no");
+        return 0;
+    }
+
     IPRINT("folder to watch...: %s\n", folder);
     IPRINT("forced delay......: %i\n", delay);
     IPRINT("delete file.......: %s\n", (rm) ? "yes, delete" : "no, do not delete");
@@ -162,8 +251,22 @@ int input_init(input_parameter *param, int id)
 
 int input_stop(int id)
 {
-    DBG("will cancel input thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+
+    /* loaded but never run, there is no thread and nothing opened */
+    if(stop_fd < 0)
+        return 0;
+
+    DBG("will stop input thread\n");
+    stop_deadline(&deadline);
+    stop_event_set(stop_fd);
+
+    if(join_thread(worker, &deadline) != 0) {
+        IPRINT("the input thread did not finish in time\n");
+        return -1;
+    }
+
+    worker_cleanup(NULL);
 
     return 0;
 }
@@ -171,6 +274,15 @@ int input_stop(int id)
 int input_run(int id)
 {
     pglobal->in[id].buf = NULL;
+    capacity = 0;
+
+    if((stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        return 1;
+    }
+
+    if(playback)
+        return playback_open();
 
     rc = fd = inotify_init();
     if(rc == -1) {
@@ -197,8 +309,6 @@ int input_run(int id)
         exit(EXIT_FAILURE);
     }
 
-    pthread_detach(worker);
-
     return 0;
 }
 
@@ -213,6 +323,12 @@ void help(void)
     " [-f | --folder ].......: folder to watch for new JPEG files\n" \
     " [-r | --remove ].......: remove/delete JPEG file after reading\n" \
     " [-n | --name ].........: ignore changes unless filename matches\n" \
+    " [-p | --playback ].....: play the JPEG files of the folder in\n" \
+    "                          alphabetical order instead of watching it\n" \
+    " [-m | --mjpg ].........: play a file of concatenated JPEG frames\n" \
+    " [-F | --fps ]..........: frames per second of the playback,\n" \
+    "                          0 is as fast as possible (default)\n" \
+    " [-l | --loop ].........: start again after the last frame\n" \
     " ---------------------------------------------------------------\n");
 }
 
@@ -224,12 +340,12 @@ void *worker_thread(void *arg)
     size_t filesize = 0;
     struct stat stats;
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
-
     while(!pglobal->stop) {
 
-        /* wait for new frame, read will block until something happens */
+        /* wait for new frame, or for the plugin to be stopped */
+        if(stop_event_poll(stop_fd, fd, POLLIN) != 0)
+            break;
+
         rc = read(fd, ev, size);
         if(rc == -1) {
             perror("reading inotify events failed");
@@ -274,30 +390,19 @@ void *worker_thread(void *arg)
 
         filesize = stats.st_size;
 
-        /* copy frame from file to global buffer */
-        pthread_mutex_lock(&pglobal->in[plugin_number].db);
-
-        /* allocate memory for frame */
-        if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
-        pglobal->in[plugin_number].buf = malloc(filesize + (1 << 16));
-        if(pglobal->in[plugin_number].buf == NULL) {
-            fprintf(stderr, "could not allocate memory\n");
+        /* read the file, then copy the frame to the global buffer */
+        if((rc = read_file(file, filesize)) == -1) {
+            perror("could not read from file");
+            close(file);
             break;
         }
 
-        if((pglobal->in[plugin_number].size = read(file, pglobal->in[plugin_number].buf, filesize)) == -1) {
-            perror("could not read from file");
-            free(pglobal->in[plugin_number].buf); pglobal->in[plugin_number].buf = NULL; pglobal->in[plugin_number].size = 0;
-            pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+        if(rc > 0 && publish_frame(file_buf, rc) < 0) {
             close(file);
             break;
         }
 
-        DBG("new frame copied (size: %d)\n", pglobal->in[plugin_number].size);
-
-        /* signal fresh_frame */
-        pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
-        pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+        DBG("new frame copied (size: %d)\n", rc);
 
         close(file);
 
@@ -309,29 +414,380 @@ void *worker_thread(void *arg)
             }
         }
 
-        if(delay != 0) usleep(1000 * delay);
+        if(delay != 0 && stop_event_wait(stop_fd, delay))
+            break;
     }
 
-    DBG("leaving input thread, calling cleanup function now\n");
-    /* call cleanup handler, signal with the parameter */
-    pthread_cleanup_pop(1);
+    DBG("leaving input thread\n");
 
     return NULL;
 }
 
-void worker_cleanup(void *arg)
+/******************************************************************************
+Description.: make sure in[].buf can hold a frame, the buffer only grows so
+              the steady state does not allocate. The db mutex must be held.
+Input Value.: size of the frame
+Return Value: 0 if ok, -1 if there is not enough memory
+******************************************************************************/
+static int reserve_buffer(size_t needed)
 {
-    static unsigned char first_run = 1;
+    unsigned char *tmp;
 
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
+    if(needed <= capacity && pglobal->in[plugin_number].buf != NULL)
+        return 0;
+
+    /* leave some room, the following frames are usually a bit larger */
+    needed += needed / 4 + (1 << 16);
+    if((tmp = realloc(pglobal->in[plugin_number].buf, needed)) == NULL)
+        return -1;
+
+    DBG("frame buffer grows from %zu to %zu bytes\n", capacity, needed);
+    pglobal->in[plugin_number].buf = tmp;
+    capacity = needed;
+    return 0;
+}
+
+/******************************************************************************
+Description.: copy a frame to the global buffer and wake up the consumers
+Input Value.: * data...: the JPEG frame
+              * len....: size of the frame
+Return Value: 0 if ok, -1 if there is not enough memory
+******************************************************************************/
+static int publish_frame(const unsigned char *data, size_t len)
+{
+    input *in = &pglobal->in[plugin_number];
+
+    pthread_mutex_lock(&in->db);
+
+    if(reserve_buffer(len) < 0) {
+        pthread_mutex_unlock(&in->db);
+        fprintf(stderr, "could not allocate memory\n");
+        return -1;
+    }
+
+    memcpy(in->buf, data, len);
+    in->size = len;
+    gettimeofday(&in->timestamp, NULL);
+
+    /* signal fresh_frame */
+    pthread_cond_broadcast(&in->db_update);
+    pthread_mutex_unlock(&in->db);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: read a whole file into file_buf, the buffer only grows and
+              short reads are continued
+Input Value.: * file...: the opened file
+              * filesize: size of the file
+Return Value: number of bytes read, -1 on error
+******************************************************************************/
+static int read_file(int file, size_t filesize)
+{
+    size_t got = 0;
+    ssize_t n;
+    unsigned char *tmp;
+
+    if(filesize > file_capacity || file_buf == NULL) {
+        if((tmp = realloc(file_buf, filesize + filesize / 4 + (1 << 16))) == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        file_buf = tmp;
+        file_capacity = filesize + filesize / 4 + (1 << 16);
+    }
+
+    while(got < filesize) {
+        n = read(file, file_buf + got, filesize - got);
+        if(n == -1) {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        /* the file was truncated meanwhile */
+        if(n == 0)
+            break;
+
+        got += n;
     }
 
-    first_run = 0;
+    return got;
+}
+
+/* only JPEG files are played from a folder */
+static int jpeg_filter(const struct dirent *entry)
+{
+    const char *ext = strrchr(entry->d_name, '.');
+
+    return (ext != NULL) && (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0);
+}
+
+/******************************************************************************
+Description.: prepare the playback, lists the folder or maps the .mjpg file
+Input Value.: -
+Return Value: 0 if ok, 1 on error
+******************************************************************************/
+static int playback_open(void)
+{
+    int i, file;
+    struct stat stats;
+
+    for(i = 0; i < PREFETCH_FILES; i++) {
+        window[i].index = -1;
+        window[i].data = NULL;
+    }
+
+    if(mjpg_name != NULL) {
+        if((file = open(mjpg_name, O_RDONLY)) == -1) {
+            perror("could not open file for reading");
+            return 1;
+        }
+
+        if(fstat(file, &stats) == -1 || stats.st_size == 0) {
+            fprintf(stderr, "%s is empty or can not be accessed\n", mjpg_name);
+            close(file);
+            return 1;
+        }
+
+        mjpg_size = stats.st_size;
+        mjpg = mmap(NULL, mjpg_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if(mjpg == MAP_FAILED) {
+            perror("could not map file");
+            mjpg = NULL;
+            return 1;
+        }
+
+        madvise(mjpg, mjpg_size, MADV_SEQUENTIAL);
+    } else {
+        file_count = scandir(folder, &files, jpeg_filter, alphasort);
+        if(file_count <= 0) {
+            fprintf(stderr, "no JPEG files found in %s\n", folder);
+            return 1;
+        }
+        IPRINT("files to play.....: %d\n", file_count);
+    }
+
+    if(pthread_create(&worker, 0, playback_thread, NULL) != 0) {
+        fprintf(stderr, "could not start worker thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return 0;
+}
+
+static void unmap_file(mapped_file *m)
+{
+    if(m->data != NULL)
+        munmap(m->data, m->size);
+    m->data = NULL;
+    m->index = -1;
+}
+
+/******************************************************************************
+Description.: map the files following the current one and ask the kernel to
+              read them ahead. A file keeps its slot while it is in the
+              window, so short loops stay mapped completely.
+Input Value.: index of the file that is published next
+Return Value: the mapping of this file
+******************************************************************************/
+static mapped_file *prefetch_files(int current)
+{
+    int k, j, file;
+    char path[PATH_MAX];
+    struct stat stats;
+    mapped_file *m;
+
+    for(k = 0; k < MIN(PREFETCH_FILES, file_count); k++) {
+        j = (current + k) % file_count;
+        m = &window[j % PREFETCH_FILES];
+
+        if(m->index == j)
+            continue;
+
+        unmap_file(m);
+        m->index = j;
+
+        snprintf(path, sizeof(path), "%s%s", folder, files[j]->d_name);
+        if((file = open(path, O_RDONLY)) == -1) {
+            DBG("could not open %s\n", path);
+            continue;
+        }
+
+        if(fstat(file, &stats) == 0 && stats.st_size > 0) {
+            m->data = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if(m->data == MAP_FAILED) {
+                m->data = NULL;
+            } else {
+                m->size = stats.st_size;
+                madvise(m->data, m->size, MADV_WILLNEED);
+            }
+        }
+        close(file);
+    }
+
+    return &window[current % PREFETCH_FILES];
+}
+
+/******************************************************************************
+Description.: find the next complete JPEG in a concatenated file. The marker
+              segments are skipped by their length, so thumbnails or other
+              embedded data can not end the frame too early.
+Input Value.: * p, end.: the data to search
+              * start..: receives the start of the frame
+Return Value: length of the frame, 0 if there is no further frame
+******************************************************************************/
+static size_t find_frame(const unsigned char *p, const unsigned char *end, const unsigned char **start)
+{
+    const unsigned char *q;
+
+    for(;; p += 2) {
+        /* look for the start of image */
+        while(p + 1 < end && !(p[0] == 0xff && p[1] == 0xd8))
+            p++;
+        if(p + 1 >= end)
+            return 0;
+
+        *start = p;
+        q = p + 2;
+
+        while(q + 1 < end && q[0] == 0xff) {
+            if(q[1] == 0xff) {
+                q++;
+            } else if(q[1] == 0xd9) {
+                return q + 2 - p;
+            } else if(q[1] == 0x01 || (q[1] >= 0xd0 && q[1] <= 0xd7)) {
+                q += 2;
+            } else if(q + 4 > end) {
+                return 0;
+            } else if(q[1] == 0xda) {
+                /* entropy coded data ends with any marker but RST */
+                q += 2 + ((q[2] << 8) | q[3]);
+                while(q + 1 < end && !(q[0] == 0xff && q[1] != 0x00 && q[1] != 0xff &&
+                                       !(q[1] >= 0xd0 && q[1] <= 0xd7)))
+                    q++;
+            } else {
+                q += 2 + ((q[2] << 8) | q[3]);
+            }
+        }
+
+        DBG("corrupt frame at offset %ld, searching the next one\n", (long)(p - mjpg));
+    }
+}
+
+/* wait for the next frame period, catch up at most one second, returns 1 if
+   the plugin was stopped meanwhile */
+static int pace(struct timespec *next)
+{
+    struct timespec now;
+    long long period = 1000000000LL / fps;
+
+    next->tv_sec += period / 1000000000LL;
+    next->tv_nsec += period % 1000000000LL;
+    if(next->tv_nsec >= 1000000000L) {
+        next->tv_sec++;
+        next->tv_nsec -= 1000000000L;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(now.tv_sec > next->tv_sec + 1) {
+        *next = now;
+        return stop_event_wait(stop_fd, 0);
+    }
+
+    return stop_event_wait_until(stop_fd, next);
+}
+
+/* the single writer thread of the playback */
+void *playback_thread(void *arg)
+{
+    int current = 0, frames = 0;
+    const unsigned char *pos = mjpg, *ahead = mjpg, *data;
+    size_t len;
+    struct timespec next;
+    mapped_file *m;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while(!pglobal->stop) {
+        if(mjpg != NULL) {
+            if((len = find_frame(pos, mjpg + mjpg_size, &data)) == 0) {
+                if(!loop || frames == 0)
+                    break;
+                pos = ahead = mjpg;
+                frames = 0;
+                continue;
+            }
+            pos = data + len;
+
+            /* read ahead in large chunks, the start stays page aligned */
+            if(pos + PREFETCH_BYTES / 2 > ahead && ahead < mjpg + mjpg_size) {
+                madvise((void *)ahead, MIN(PREFETCH_BYTES, mjpg + mjpg_size - ahead), MADV_WILLNEED);
+                ahead += PREFETCH_BYTES;
+            }
+        } else {
+            if(current == file_count) {
+                if(!loop || frames == 0)
+                    break;
+                current = frames = 0;
+            }
+
+            m = prefetch_files(current++);
+            if(m->data == NULL)
+                continue;
+            data = m->data;
+            len = m->size;
+        }
+
+        if(publish_frame(data, len) < 0)
+            break;
+        frames++;
+
+        if(fps > 0 && pace(&next))
+            break;
+    }
+
+    IPRINT("playback finished\n");
+
+    return NULL;
+}
+
+/* free the ressources once the worker thread finished */
+void worker_cleanup(void *arg)
+{
     DBG("cleaning up ressources allocated by input thread\n");
 
-    if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
+    close(stop_fd);
+    stop_fd = -1;
+
+    pthread_mutex_lock(&pglobal->in[plugin_number].db);
+    free(pglobal->in[plugin_number].buf);
+    pglobal->in[plugin_number].buf = NULL;
+    pglobal->in[plugin_number].size = 0;
+    capacity = 0;
+    pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+
+    free(file_buf);
+    file_buf = NULL;
+    file_capacity = 0;
+
+    if(playback) {
+        int i;
+
+        for(i = 0; i < PREFETCH_FILES; i++)
+            unmap_file(&window[i]);
+        for(i = 0; i < file_count; i++)
+            free(files[i]);
+        free(files);
+        files = NULL;
+        file_count = 0;
+        if(mjpg != NULL)
+            munmap(mjpg, mjpg_size);
+        mjpg = NULL;
+        return;
+    }
 
     free(ev);
 
@@ -27,6 +27,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "jdatatype.h"
 #include "encoder.h"
@@ -34,8 +37,15 @@
 #include "quant.h"
 #include "marker.h"
 #include "utils.h"
-static void (*read_format)(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
-                           UINT8 * input_ptr);
+
+/* the markers written by write_markers take 589 bytes at most */
+#define MARKER_MAX_SIZE 589
+/* an MCU has up to 6 blocks with at most 26 bits per coefficient, it also
+   flushes up to 32 bits of the previous MCU, twice that with the stuffing of
+   0xFF bytes */
+#define MCU_MAX_SIZE    ((6 * BLOCK_SIZE * 26 + 32) * 2 / 8)
+/* the bits left at the end, stuffed, and the EOI marker */
+#define TRAILER_MAX_SIZE 10
 static void read_400_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                             UINT8 * input_ptr);
 static void read_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
@@ -44,6 +54,10 @@ static void read_422_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                             UINT8 * input_ptr);
 static void read_444_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                             UINT8 * input_ptr);
+static void read_planar_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
+                                   UINT8 * input_ptr);
+static void read_yuyv_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
+                                 UINT8 * input_ptr);
 static void RGB_2_444(UINT8 * input_ptr, UINT8 * output_ptr,
                       UINT32 image_width, UINT32 image_height);
 static void RGB_2_422(UINT8 * input_ptr, UINT8 * output_ptr,
@@ -60,21 +74,20 @@ static void YUV_2_444(UINT8 * input_ptr, UINT8 * output_ptr,
                       UINT32 image_width, UINT32 image_height);
 static void YUV_2_422(UINT8 * input_ptr, UINT8 * output_ptr,
                       UINT32 image_width, UINT32 image_height);
-static void YUV_2_420(UINT8 * input_ptr, UINT8 * output_ptr,
-                      UINT32 image_width, UINT32 image_height);
 static void DCT(INT16 * data);
+static void DCT_vector(INT16 * data);
 static void initialization(JPEG_ENCODER_STRUCTURE * jpeg,
-                           UINT32 image_format, UINT32 image_width,
-                           UINT32 image_height);
+                           UINT32 image_format, UINT32 input_format,
+                           UINT32 image_width, UINT32 image_height);
 static UINT8 *encodeMCU(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                         UINT32 image_format, UINT8 * output_ptr);
 static void
 initialization(JPEG_ENCODER_STRUCTURE * jpeg, UINT32 image_format,
-               UINT32 image_width, UINT32 image_height)
+               UINT32 input_format, UINT32 image_width, UINT32 image_height)
 {
     UINT16 mcu_width, mcu_height, bytes_per_pixel;
-    lcode = 0;
-    bitindex = 0;
+    jpeg->lcode = 0;
+    jpeg->bitindex = 0;
     if(image_format == FOUR_ZERO_ZERO || image_format == FOUR_FOUR_FOUR)
 
     {
@@ -86,14 +99,14 @@ initialization(JPEG_ENCODER_STRUCTURE * jpeg, UINT32 image_format,
 
         {
             bytes_per_pixel = 1;
-            read_format = read_400_format;
+            jpeg->read_format = read_400_format;
         }
 
         else
 
         {
             bytes_per_pixel = 3;
-            read_format = read_444_format;
+            jpeg->read_format = read_444_format;
         }
     }
 
@@ -108,8 +121,18 @@ initialization(JPEG_ENCODER_STRUCTURE * jpeg, UINT32 image_format,
             jpeg->mcu_height = mcu_height = 16;
             jpeg->vertical_mcus =
                 (UINT16)((image_height + mcu_height - 1) >> 4);
-            bytes_per_pixel = 3;
-            read_format = read_420_format;
+
+            /* the MCUs of these are found in the luma rows */
+            if(input_format == YUVto420 || input_format == NV12to420) {
+                bytes_per_pixel = 1;
+                jpeg->read_format = read_planar_420_format;
+            } else if(input_format == YUYVto420) {
+                bytes_per_pixel = 2;
+                jpeg->read_format = read_yuyv_420_format;
+            } else {
+                bytes_per_pixel = 3;
+                jpeg->read_format = read_420_format;
+            }
         }
 
         else
@@ -119,7 +142,7 @@ initialization(JPEG_ENCODER_STRUCTURE * jpeg, UINT32 image_format,
             jpeg->vertical_mcus =
                 (UINT16)((image_height + mcu_height - 1) >> 3);
             bytes_per_pixel = 2;
-            read_format = read_422_format;
+            jpeg->read_format = read_422_format;
         }
     }
     jpeg->rows_in_bottom_mcus =
@@ -127,33 +150,72 @@ initialization(JPEG_ENCODER_STRUCTURE * jpeg, UINT32 image_format,
     jpeg->cols_in_right_mcus =
         (UINT16)(image_width - (jpeg->horizontal_mcus - 1) * mcu_width);
     jpeg->length_minus_mcu_width =
-        (UINT16)((image_width - mcu_width) * bytes_per_pixel);
+        (UINT32)((image_width - mcu_width) * bytes_per_pixel);
     jpeg->length_minus_width =
-        (UINT16)((image_width - jpeg->cols_in_right_mcus) * bytes_per_pixel);
-    jpeg->mcu_width_size = (UINT16)(mcu_width * bytes_per_pixel);
-    if(image_format != FOUR_TWO_ZERO)
+        (UINT32)((image_width - jpeg->cols_in_right_mcus) * bytes_per_pixel);
+    jpeg->mcu_width_size = (UINT32)(mcu_width * bytes_per_pixel);
+    if(jpeg->read_format != read_420_format)
         jpeg->offset =
-            (UINT16)((image_width * (mcu_height - 1) -
+            (UINT32)((image_width * (mcu_height - 1) -
                       (mcu_width - jpeg->cols_in_right_mcus)) * bytes_per_pixel);
 
     else
         jpeg->offset =
-            (UINT16)((image_width * ((mcu_height >> 1) - 1) -
+            (UINT32)((image_width * ((mcu_height >> 1) - 1) -
                       (mcu_width - jpeg->cols_in_right_mcus)) * bytes_per_pixel);
     jpeg->ldc1 = 0;
     jpeg->ldc2 = 0;
     jpeg->ldc3 = 0;
 }
 
+void encoder_init(JPEG_ENCODER_STRUCTURE * jpeg)
+{
+    memset(jpeg, 0, sizeof(*jpeg));
+    jpeg->dct = DCT_vector;
+    jpeg->quantize = quantization_vector;
+}
+
+void encoder_use_scalar(JPEG_ENCODER_STRUCTURE * jpeg)
+{
+    jpeg->dct = DCT;
+    jpeg->quantize = quantization;
+}
+
+UINT32 encoder_quality_factor(int quality)
+{
+    /* the scaling of jpeg_quality_scaling() from libjpeg, in 1/1024 */
+    if(quality <= 0)
+        quality = 1;
+    if(quality > 100)
+        quality = 100;
+    if(quality < 50)
+        return (UINT32)((5000 / quality) * 1024 / 100);
+    return (UINT32)((200 - quality * 2) * 1024 / 100);
+}
+
 UINT32 encode_image(UINT8 * input_ptr, UINT8 * output_ptr,
                     UINT32 quality_factor, UINT32 image_format,
                     UINT32 image_width, UINT32 image_height)
+{
+    JPEG_ENCODER_STRUCTURE JpegStruct;
+    encoder_init(&JpegStruct);
+    return encode_image_ctx(&JpegStruct, input_ptr, output_ptr, ~0U,
+                            quality_factor, image_format, image_width,
+                            image_height);
+}
+
+UINT32 encode_image_ctx(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
+                        UINT8 * input_ptr, UINT8 * output_ptr,
+                        UINT32 output_size, UINT32 quality_factor,
+                        UINT32 image_format, UINT32 image_width,
+                        UINT32 image_height)
 {
     UINT16 i, j;
     UINT8 * output;
-    JPEG_ENCODER_STRUCTURE JpegStruct;
-    JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure = &JpegStruct;
+    UINT32 input_format = image_format;
     output = output_ptr;
+    if(output_size < MARKER_MAX_SIZE + MCU_MAX_SIZE + TRAILER_MAX_SIZE)
+        return 0;
     switch(image_format) {
     case RGBto444:
 
@@ -214,22 +276,51 @@ UINT32 encode_image(UINT8 * input_ptr, UINT8 * output_ptr,
     case YUVto420:
 
     {
+        /* the planes are read as they are, the picture is not changed */
         image_format = FOUR_TWO_ZERO;
-        YUV_2_420(input_ptr, output_ptr, image_width, image_height);
+        jpeg_encoder_structure->y_plane = input_ptr;
+        jpeg_encoder_structure->cb_plane = input_ptr + image_width * image_height;
+        jpeg_encoder_structure->cr_plane =
+            jpeg_encoder_structure->cb_plane + (image_width * image_height >> 2);
+        jpeg_encoder_structure->chroma_step = 1;
     }
     break;
+    case NV12to420:
+
+    {
+        /* the same reader, Cb and Cr alternate in the second plane */
+        image_format = FOUR_TWO_ZERO;
+        jpeg_encoder_structure->y_plane = input_ptr;
+        jpeg_encoder_structure->cb_plane = input_ptr + image_width * image_height;
+        jpeg_encoder_structure->cr_plane = jpeg_encoder_structure->cb_plane + 1;
+        jpeg_encoder_structure->chroma_step = 2;
     }
+    break;
+    case YUYVto420:
 
-    /* Initialization of JPEG control structure */
-    initialization(jpeg_encoder_structure, image_format, image_width,
-                   image_height);
+    {
+        image_format = FOUR_TWO_ZERO;
+    }
+    break;
+    }
+    jpeg_encoder_structure->image_width = image_width;
 
-    /* Quantization Table Initialization */
-    initialize_quantization_tables(quality_factor);
+    /* Initialization of JPEG control structure */
+    initialization(jpeg_encoder_structure, image_format, input_format,
+                   image_width, image_height);
+
+    /* Quantization Table Initialization, only when the quality changed */
+    if(!jpeg_encoder_structure->tables_valid ||
+       jpeg_encoder_structure->quality_factor != quality_factor) {
+        initialize_quantization_tables(jpeg_encoder_structure, quality_factor);
+        jpeg_encoder_structure->quality_factor = quality_factor;
+        jpeg_encoder_structure->tables_valid = 1;
+    }
 
     /* Writing Marker Data */
     output_ptr =
-        write_markers(output_ptr, image_format, image_width, image_height);
+        write_markers(jpeg_encoder_structure, output_ptr, image_format,
+                      image_width, image_height);
     for(i = 1; i <= jpeg_encoder_structure->vertical_mcus; i++)
 
     {
@@ -259,7 +350,11 @@ UINT32 encode_image(UINT8 * input_ptr, UINT8 * output_ptr,
                 jpeg_encoder_structure->incr =
                     jpeg_encoder_structure->length_minus_width;
             }
-            read_format(jpeg_encoder_structure, input_ptr);
+            /* stop before an MCU could overflow the output */
+            if((UINT32)(output_ptr - output) >
+               output_size - MCU_MAX_SIZE - TRAILER_MAX_SIZE)
+                return 0;
+            jpeg_encoder_structure->read_format(jpeg_encoder_structure, input_ptr);
 
             /* Encode the data in MCU */
             output_ptr =
@@ -270,34 +365,37 @@ UINT32 encode_image(UINT8 * input_ptr, UINT8 * output_ptr,
     }
 
     /* Close Routine */
-    output_ptr = close_bitstream(output_ptr);
+    output_ptr = close_bitstream(jpeg_encoder_structure, output_ptr);
     return (UINT32)(output_ptr - output);
 }
 static UINT8 *
 encodeMCU(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
           UINT32 image_format, UINT8 * output_ptr)
 {
-    DCT(Y1);
-    quantization(Y1, ILqt);
+    JPEG_ENCODER_STRUCTURE * jpeg = jpeg_encoder_structure;
+    jpeg->dct(jpeg->Y1);
+    jpeg->quantize(jpeg, jpeg->Y1, jpeg->ILqt);
     output_ptr = huffman(jpeg_encoder_structure, 1, output_ptr);
     if(image_format == FOUR_ZERO_ZERO)
         return output_ptr;
-    DCT(Y2);
-    quantization(Y2, ILqt);
+    if(image_format == FOUR_FOUR_FOUR)
+        goto chroma;
+    jpeg->dct(jpeg->Y2);
+    jpeg->quantize(jpeg, jpeg->Y2, jpeg->ILqt);
     output_ptr = huffman(jpeg_encoder_structure, 1, output_ptr);
     if(image_format == FOUR_TWO_TWO)
         goto chroma;
-    DCT(Y3);
-    quantization(Y3, ILqt);
+    jpeg->dct(jpeg->Y3);
+    jpeg->quantize(jpeg, jpeg->Y3, jpeg->ILqt);
     output_ptr = huffman(jpeg_encoder_structure, 1, output_ptr);
-    DCT(Y4);
-    quantization(Y4, ILqt);
+    jpeg->dct(jpeg->Y4);
+    jpeg->quantize(jpeg, jpeg->Y4, jpeg->ILqt);
     output_ptr = huffman(jpeg_encoder_structure, 1, output_ptr);
-chroma: DCT(CB);
-    quantization(CB, ICqt);
+chroma: jpeg->dct(jpeg->CB);
+    jpeg->quantize(jpeg, jpeg->CB, jpeg->ICqt);
     output_ptr = huffman(jpeg_encoder_structure, 2, output_ptr);
-    DCT(CR);
-    quantization(CR, ICqt);
+    jpeg->dct(jpeg->CR);
+    jpeg->quantize(jpeg, jpeg->CR, jpeg->ICqt);
     output_ptr = huffman(jpeg_encoder_structure, 3, output_ptr);
     return output_ptr;
 }
@@ -373,26 +471,226 @@ DCT(INT16 * data)
         data++;
     }
 }
+
+
+#ifdef __SSE2__
+
+/*
+ * The passes are macros on r0 to r7 like IDCT in utils.c, the functions of
+ * the AVX2 clone do not inline helpers that are compiled for the default
+ * target.
+ */
+
+/* transpose the 8 rows of a block in r0 to r7, so that row i holds column
+   i, t0 to t7 are scratch */
+#define TRANSPOSE \
+    ( \
+        t0 = _mm_unpacklo_epi16(r0, r1), t1 = _mm_unpackhi_epi16(r0, r1), \
+        t2 = _mm_unpacklo_epi16(r2, r3), t3 = _mm_unpackhi_epi16(r2, r3), \
+        t4 = _mm_unpacklo_epi16(r4, r5), t5 = _mm_unpackhi_epi16(r4, r5), \
+        t6 = _mm_unpacklo_epi16(r6, r7), t7 = _mm_unpackhi_epi16(r6, r7), \
+        r0 = _mm_unpacklo_epi32(t0, t2), r1 = _mm_unpackhi_epi32(t0, t2), \
+        r2 = _mm_unpacklo_epi32(t1, t3), r3 = _mm_unpackhi_epi32(t1, t3), \
+        r4 = _mm_unpacklo_epi32(t4, t6), r5 = _mm_unpackhi_epi32(t4, t6), \
+        r6 = _mm_unpacklo_epi32(t5, t7), r7 = _mm_unpackhi_epi32(t5, t7), \
+        t0 = _mm_unpacklo_epi64(r0, r4), t1 = _mm_unpackhi_epi64(r0, r4), \
+        t2 = _mm_unpacklo_epi64(r1, r5), t3 = _mm_unpackhi_epi64(r1, r5), \
+        t4 = _mm_unpacklo_epi64(r2, r6), t5 = _mm_unpackhi_epi64(r2, r6), \
+        t6 = _mm_unpacklo_epi64(r3, r7), t7 = _mm_unpackhi_epi64(r3, r7), \
+        r0 = t0, r1 = t1, r2 = t2, r3 = t3, \
+        r4 = t4, r5 = t5, r6 = t6, r7 = t7 \
+    )
+
+/* the multipliers of a and b for the interleaved halves of a and b */
+#define PAIR(a, b) _mm_set_epi16(b, a, b, a, b, a, b, a)
+
+/* a * k[0] + b * k[1] in 32 bits, shifted and packed to 16 bits again, the
+   low and high halves of a and b are interleaved in ab_low and ab_high */
+#define MULTIPLY_PAIR(ab_low, ab_high, k, shift) \
+    _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(ab_low, k), shift), \
+                    _mm_srai_epi32(_mm_madd_epi16(ab_high, k), shift))
+
+/* the same for a * k01[0] + b * k01[1] + c * k23[0] + d * k23[1] */
+#define MULTIPLY_PAIRS(ab_low, ab_high, k01, cd_low, cd_high, k23, shift) \
+    _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ab_low, k01), \
+                                                 _mm_madd_epi16(cd_low, k23)), shift), \
+                    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ab_high, k01), \
+                                                 _mm_madd_epi16(cd_high, k23)), shift))
+
+/* one pass of DCT over 8 rows or columns at once, rk holds the k-th sample
+   of each of them, the shifts are those of the scalar passes. For samples in
+   -512..511 the sums fit into 16 bits in both passes and only the products
+   need 32 bits */
+#define DCT_PASS(s_even, s_odd) \
+    ( \
+        x8 = _mm_add_epi16(r0, r7), x0 = _mm_sub_epi16(r0, r7), \
+        x7 = _mm_add_epi16(r1, r6), x1 = _mm_sub_epi16(r1, r6), \
+        x6 = _mm_add_epi16(r2, r5), x2 = _mm_sub_epi16(r2, r5), \
+        x5 = _mm_add_epi16(r3, r4), x3 = _mm_sub_epi16(r3, r4), \
+        x4 = _mm_add_epi16(x8, x5), x8 = _mm_sub_epi16(x8, x5), \
+        x5 = _mm_add_epi16(x7, x6), x7 = _mm_sub_epi16(x7, x6), \
+        r0 = _mm_srai_epi16(_mm_add_epi16(x4, x5), s_even), \
+        r4 = _mm_srai_epi16(_mm_sub_epi16(x4, x5), s_even), \
+        t0 = _mm_unpacklo_epi16(x8, x7), t1 = _mm_unpackhi_epi16(x8, x7), \
+        r2 = MULTIPLY_PAIR(t0, t1, PAIR(c2, c6), s_odd), \
+        r6 = MULTIPLY_PAIR(t0, t1, PAIR(c6, -c2), s_odd), \
+        t0 = _mm_unpacklo_epi16(x0, x1), t1 = _mm_unpackhi_epi16(x0, x1), \
+        t2 = _mm_unpacklo_epi16(x2, x3), t3 = _mm_unpackhi_epi16(x2, x3), \
+        r7 = MULTIPLY_PAIRS(t0, t1, PAIR(c7, -c5), t2, t3, PAIR(c3, -c1), s_odd), \
+        r5 = MULTIPLY_PAIRS(t0, t1, PAIR(c5, -c1), t2, t3, PAIR(c7, c3), s_odd), \
+        r3 = MULTIPLY_PAIRS(t0, t1, PAIR(c3, -c7), t2, t3, PAIR(-c1, -c5), s_odd), \
+        r1 = MULTIPLY_PAIRS(t0, t1, PAIR(c1, c3), t2, t3, PAIR(c5, c7), s_odd) \
+    )
+
+/* the same as DCT, with the 8 rows and then the 8 columns transformed at once */
+SIMD_CLONES static void
+DCT_vector(INT16 * data)
+{
+    enum { c1 = 1420, c2 = 1338, c3 = 1204, c5 = 805, c6 = 554, c7 = 283 };
+    __m128i * block = (__m128i *) data;
+    __m128i r0, r1, r2, r3, r4, r5, r6, r7, t0, t1, t2, t3, t4, t5, t6, t7;
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    const __m128i bias = _mm_set1_epi16(512);
+    r0 = _mm_loadu_si128(block + 0);
+    r1 = _mm_loadu_si128(block + 1);
+    r2 = _mm_loadu_si128(block + 2);
+    r3 = _mm_loadu_si128(block + 3);
+    r4 = _mm_loadu_si128(block + 4);
+    r5 = _mm_loadu_si128(block + 5);
+    r6 = _mm_loadu_si128(block + 6);
+    r7 = _mm_loadu_si128(block + 7);
+
+    /* the readers give samples in -128..127, but the edges of pictures of an
+       odd size may repeat values from outside the rows, such a block takes
+       the scalar DCT to get the same result */
+    t0 = _mm_or_si128(_mm_or_si128(_mm_add_epi16(r0, bias), _mm_add_epi16(r1, bias)),
+                      _mm_or_si128(_mm_add_epi16(r2, bias), _mm_add_epi16(r3, bias)));
+    t1 = _mm_or_si128(_mm_or_si128(_mm_add_epi16(r4, bias), _mm_add_epi16(r5, bias)),
+                      _mm_or_si128(_mm_add_epi16(r6, bias), _mm_add_epi16(r7, bias)));
+    t0 = _mm_and_si128(_mm_or_si128(t0, t1), _mm_set1_epi16(-1024));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi16(t0, _mm_setzero_si128())) != 0xffff) {
+        DCT(data);
+        return;
+    }
+
+    /* the row pass works on the columns of the transposed block */
+    TRANSPOSE;
+    DCT_PASS(0, 10);
+    TRANSPOSE;
+    DCT_PASS(3, 13);
+    _mm_storeu_si128(block + 0, r0);
+    _mm_storeu_si128(block + 1, r1);
+    _mm_storeu_si128(block + 2, r2);
+    _mm_storeu_si128(block + 3, r3);
+    _mm_storeu_si128(block + 4, r4);
+    _mm_storeu_si128(block + 5, r5);
+    _mm_storeu_si128(block + 6, r6);
+    _mm_storeu_si128(block + 7, r7);
+}
+
+#else
+
+/* transpose the 8 rows of a block, so that row i holds column i */
+static inline void
+transpose(V8INT16 * row)
+{
+    static const V8INT16 lo16 = {0, 8, 1, 9, 2, 10, 3, 11};
+    static const V8INT16 hi16 = {4, 12, 5, 13, 6, 14, 7, 15};
+    static const V8INT16 lo32 = {0, 1, 8, 9, 2, 3, 10, 11};
+    static const V8INT16 hi32 = {4, 5, 12, 13, 6, 7, 14, 15};
+    static const V8INT16 lo64 = {0, 1, 2, 3, 8, 9, 10, 11};
+    static const V8INT16 hi64 = {4, 5, 6, 7, 12, 13, 14, 15};
+    V8INT16 a[8], b[8];
+    UINT16 i;
+    for(i = 0; i < 8; i += 2) {
+        a[i] = __builtin_shuffle(row[i], row[i + 1], lo16);
+        a[i + 1] = __builtin_shuffle(row[i], row[i + 1], hi16);
+    }
+    for(i = 0; i < 8; i += 4) {
+        b[i] = __builtin_shuffle(a[i], a[i + 2], lo32);
+        b[i + 1] = __builtin_shuffle(a[i], a[i + 2], hi32);
+        b[i + 2] = __builtin_shuffle(a[i + 1], a[i + 3], lo32);
+        b[i + 3] = __builtin_shuffle(a[i + 1], a[i + 3], hi32);
+    }
+    for(i = 0; i < 4; i++) {
+        row[2 * i] = __builtin_shuffle(b[i], b[i + 4], lo64);
+        row[2 * i + 1] = __builtin_shuffle(b[i], b[i + 4], hi64);
+    }
+}
+
+
+/* one pass of DCT over 8 rows or columns at once, in[k] holds the k-th
+   sample of each of them, the shifts are those of the scalar passes */
+static inline void
+DCT_pass(V8INT16 * in, INT32 s_even, INT32 s_odd)
+{
+    static const INT32 c1 = 1420, c2 = 1338, c3 = 1204;
+    static const INT32 c5 = 805, c6 = 554, c7 = 283;
+    V8INT32 x0, x1, x2, x3, x4, x5, x6, x7, x8, d[8];
+    UINT16 i;
+    for(i = 0; i < 8; i++)
+        d[i] = __builtin_convertvector(in[i], V8INT32);
+    x8 = d[0] + d[7];
+    x0 = d[0] - d[7];
+    x7 = d[1] + d[6];
+    x1 = d[1] - d[6];
+    x6 = d[2] + d[5];
+    x2 = d[2] - d[5];
+    x5 = d[3] + d[4];
+    x3 = d[3] - d[4];
+    x4 = x8 + x5;
+    x8 -= x5;
+    x5 = x7 + x6;
+    x7 -= x6;
+    in[0] = __builtin_convertvector((x4 + x5) >> s_even, V8INT16);
+    in[4] = __builtin_convertvector((x4 - x5) >> s_even, V8INT16);
+    in[2] = __builtin_convertvector((x8 * c2 + x7 * c6) >> s_odd, V8INT16);
+    in[6] = __builtin_convertvector((x8 * c6 - x7 * c2) >> s_odd, V8INT16);
+    in[7] = __builtin_convertvector((x0 * c7 - x1 * c5 + x2 * c3 - x3 * c1) >> s_odd, V8INT16);
+    in[5] = __builtin_convertvector((x0 * c5 - x1 * c1 + x2 * c7 + x3 * c3) >> s_odd, V8INT16);
+    in[3] = __builtin_convertvector((x0 * c3 - x1 * c7 - x2 * c1 - x3 * c5) >> s_odd, V8INT16);
+    in[1] = __builtin_convertvector((x0 * c1 + x1 * c3 + x2 * c5 + x3 * c7) >> s_odd, V8INT16);
+}
+
+
+/* the same as DCT, with the 8 rows and then the 8 columns transformed at once */
+SIMD_CLONES static void
+DCT_vector(INT16 * data)
+{
+    V8INT16 row[8];
+    memcpy(row, data, sizeof(row));
+
+    /* the row pass works on the columns of the transposed block */
+    transpose(row);
+    DCT_pass(row, 0, 10);
+    transpose(row);
+    DCT_pass(row, 3, 13);
+    memcpy(data, row, sizeof(row));
+}
+
+#endif
 static void
 read_400_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                 UINT8 * input_ptr)
 {
     INT32 i, j;
-    INT16 *Y1_Ptr = Y1;
+    INT16 *Y1_Ptr = jpeg_encoder_structure->Y1;
     UINT16 rows = jpeg_encoder_structure->rows;
     UINT16 cols = jpeg_encoder_structure->cols;
-    UINT16 incr = jpeg_encoder_structure->incr;
+    UINT32 incr = jpeg_encoder_structure->incr;
     for(i = rows; i > 0; i--) {
         for(j = cols; j > 0; j--)
             *Y1_Ptr++ = *input_ptr++ - 128;
-        for(j = 8 - cols; j > 0; j--)
+        for(j = 8 - cols; j > 0; j--) {
             *Y1_Ptr = *(Y1_Ptr - 1); Y1_Ptr++;
+        }
         input_ptr += incr;
     }
 
     for(i = 8 - rows; i > 0; i--) {
-        for(j = 8; j > 0; j--)
+        for(j = 8; j > 0; j--) {
             *Y1_Ptr = *(Y1_Ptr - 8); Y1_Ptr++;
+        }
     }
 }
 static void
@@ -401,19 +699,19 @@ read_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
 {
     INT32 i, j;
     UINT16 Y1_rows, Y3_rows, Y1_cols, Y2_cols;
-    INT16 * Y1_Ptr = Y1;
-    INT16 * Y2_Ptr = Y2;
-    INT16 * Y3_Ptr = Y3;
-    INT16 * Y4_Ptr = Y4;
-    INT16 * CB_Ptr = CB;
-    INT16 * CR_Ptr = CR;
-    INT16 * Y1Ptr = Y1 + 8;
-    INT16 * Y2Ptr = Y2 + 8;
-    INT16 * Y3Ptr = Y3 + 8;
-    INT16 * Y4Ptr = Y4 + 8;
+    INT16 * Y1_Ptr = jpeg_encoder_structure->Y1;
+    INT16 * Y2_Ptr = jpeg_encoder_structure->Y2;
+    INT16 * Y3_Ptr = jpeg_encoder_structure->Y3;
+    INT16 * Y4_Ptr = jpeg_encoder_structure->Y4;
+    INT16 * CB_Ptr = jpeg_encoder_structure->CB;
+    INT16 * CR_Ptr = jpeg_encoder_structure->CR;
+    INT16 * Y1Ptr = jpeg_encoder_structure->Y1 + 8;
+    INT16 * Y2Ptr = jpeg_encoder_structure->Y2 + 8;
+    INT16 * Y3Ptr = jpeg_encoder_structure->Y3 + 8;
+    INT16 * Y4Ptr = jpeg_encoder_structure->Y4 + 8;
     UINT16 rows = jpeg_encoder_structure->rows;
     UINT16 cols = jpeg_encoder_structure->cols;
-    UINT16 incr = jpeg_encoder_structure->incr;
+    UINT32 incr = jpeg_encoder_structure->incr;
     if(rows <= 8)
 
     {
@@ -486,7 +784,7 @@ read_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
 
             {
                 *Y2_Ptr = *(Y2_Ptr - 1); Y2_Ptr++;
-                *Y2Ptr = *(Y2Ptr - 1);Y2_Ptr++;
+                *Y2Ptr = *(Y2Ptr - 1); Y2Ptr++;
             }
         }
         for(j = (16 - cols) >> 1; j > 0; j--)
@@ -621,13 +919,13 @@ read_422_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
 {
     INT32 i, j;
     UINT16 Y1_cols, Y2_cols;
-    INT16 * Y1_Ptr = Y1;
-    INT16 * Y2_Ptr = Y2;
-    INT16 * CB_Ptr = CB;
-    INT16 * CR_Ptr = CR;
+    INT16 * Y1_Ptr = jpeg_encoder_structure->Y1;
+    INT16 * Y2_Ptr = jpeg_encoder_structure->Y2;
+    INT16 * CB_Ptr = jpeg_encoder_structure->CB;
+    INT16 * CR_Ptr = jpeg_encoder_structure->CR;
     UINT16 rows = jpeg_encoder_structure->rows;
     UINT16 cols = jpeg_encoder_structure->cols;
-    UINT16 incr = jpeg_encoder_structure->incr;
+    UINT32 incr = jpeg_encoder_structure->incr;
     if(cols <= 8)
 
     {
@@ -664,16 +962,25 @@ read_422_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
 
         {
             for(j = 8 - Y1_cols; j > 0; j--)
+
+            {
                 *Y1_Ptr = *(Y1_Ptr - 1); Y1_Ptr++;
+            }
             for(j = 8 - Y2_cols; j > 0; j--)
+
+            {
                 *Y2_Ptr = *(Y1_Ptr - 1); Y2_Ptr++;
+            }
         }
 
         else
 
         {
             for(j = 8 - Y2_cols; j > 0; j--)
+
+            {
                 *Y2_Ptr = *(Y2_Ptr - 1); Y2_Ptr++;
+            }
         }
         for(j = (16 - cols) >> 1; j > 0; j--)
 
@@ -701,12 +1008,12 @@ read_444_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                 UINT8 * input_ptr)
 {
     INT32 i, j;
-    INT16 * Y1_Ptr = Y1;
-    INT16 * CB_Ptr = CB;
-    INT16 * CR_Ptr = CR;
+    INT16 * Y1_Ptr = jpeg_encoder_structure->Y1;
+    INT16 * CB_Ptr = jpeg_encoder_structure->CB;
+    INT16 * CR_Ptr = jpeg_encoder_structure->CR;
     UINT16 rows = jpeg_encoder_structure->rows;
     UINT16 cols = jpeg_encoder_structure->cols;
-    UINT16 incr = jpeg_encoder_structure->incr;
+    UINT32 incr = jpeg_encoder_structure->incr;
     for(i = rows; i > 0; i--)
 
     {
@@ -739,6 +1046,168 @@ read_444_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
     }
 }
 
+/* one row of 16 luma samples, step bytes apart, the columns right of the
+   picture repeat the last one */
+static inline void
+read_luma_row(INT16 * left, INT16 * right, const UINT8 * src, int step, int cols)
+{
+    int c;
+    for(c = 0; c < 8; c++)
+        left[c] = src[step * (c < cols ? c : cols - 1)] - 128;
+    for(c = 8; c < 16; c++)
+        right[c - 8] = src[step * (c < cols ? c : cols - 1)] - 128;
+}
+
+#ifdef __SSE2__
+/* eight 16 bit samples less 128 to a row of a block */
+static inline void
+store_row(INT16 * row, __m128i samples)
+{
+    _mm_storeu_si128((__m128i *) row, _mm_sub_epi16(samples, _mm_set1_epi16(128)));
+}
+
+/* the luma of an MCU of 16 x 16 pixels that are all inside the picture,
+   src is the top left pixel of one byte each, stride the bytes of a row */
+static inline void
+read_luma_mcu(JPEG_ENCODER_STRUCTURE * jpeg, const UINT8 * src, UINT32 stride)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bytes;
+    INT32 r;
+    for(r = 0; r < 16; r++) {
+        bytes = _mm_loadu_si128((const __m128i *)(src + r * stride));
+        store_row((r < 8 ? jpeg->Y1 : jpeg->Y3) + 8 * (r & 7), _mm_unpacklo_epi8(bytes, zero));
+        store_row((r < 8 ? jpeg->Y2 : jpeg->Y4) + 8 * (r & 7), _mm_unpackhi_epi8(bytes, zero));
+    }
+}
+#endif
+
+/* read an MCU of YUV420 planar or NV12 without packing the picture first */
+static void
+read_planar_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
+                       UINT8 * input_ptr)
+{
+    JPEG_ENCODER_STRUCTURE * jpeg = jpeg_encoder_structure;
+    UINT32 width = jpeg->image_width, step = jpeg->chroma_step;
+    UINT32 offset = (UINT32)(input_ptr - jpeg->y_plane);
+    UINT32 chroma = ((offset / width >> 1) * (width >> 1) + (offset % width >> 1)) * step;
+    INT32 rows = jpeg->rows, cols = jpeg->cols, r, c, x, line;
+    INT32 chroma_rows = (rows + 1) >> 1, chroma_cols = (cols + 1) >> 1;
+    INT16 * left, *right;
+    UINT8 * cb, *cr;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128(), low_bytes = _mm_set1_epi16(0xff);
+    __m128i bytes;
+    if(rows == 16 && cols == 16) {
+        read_luma_mcu(jpeg, input_ptr, width);
+        for(r = 0; r < 8; r++) {
+            line = r * (width >> 1) * step;
+            if(step == 1) {
+                store_row(jpeg->CB + 8 * r, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(jpeg->cb_plane + chroma + line)), zero));
+                store_row(jpeg->CR + 8 * r, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(jpeg->cr_plane + chroma + line)), zero));
+            } else {
+                /* Cb and Cr alternate, each pair is a 16 bit lane */
+                bytes = _mm_loadu_si128((const __m128i *)(jpeg->cb_plane + chroma + line));
+                store_row(jpeg->CB + 8 * r, _mm_and_si128(bytes, low_bytes));
+                store_row(jpeg->CR + 8 * r, _mm_srli_epi16(bytes, 8));
+            }
+        }
+        return;
+    }
+#endif
+    for(r = 0; r < 16; r++) {
+        left = (r < 8 ? jpeg->Y1 : jpeg->Y3) + 8 * (r & 7);
+        right = (r < 8 ? jpeg->Y2 : jpeg->Y4) + 8 * (r & 7);
+        line = (r < rows ? r : rows - 1) * width;
+        if(cols == 16)
+            read_luma_row(left, right, input_ptr + line, 1, 16);
+        else
+            read_luma_row(left, right, input_ptr + line, 1, cols);
+    }
+    for(r = 0; r < 8; r++) {
+        line = (r < chroma_rows ? r : chroma_rows - 1) * (width >> 1) * step;
+        cb = jpeg->cb_plane + chroma + line;
+        cr = jpeg->cr_plane + chroma + line;
+        for(c = 0; c < 8; c++) {
+            x = step * (c < chroma_cols ? c : chroma_cols - 1);
+            jpeg->CB[8 * r + c] = cb[x] - 128;
+            jpeg->CR[8 * r + c] = cr[x] - 128;
+        }
+    }
+}
+
+/* the chroma of two YUYV rows averaged, 8 pairs of Cb and Cr */
+static inline void
+read_chroma_rows(INT16 * cb, INT16 * cr, const UINT8 * top, const UINT8 * bottom, int pairs)
+{
+    int c, x;
+    for(c = 0; c < 8; c++) {
+        x = 4 * (c < pairs ? c : pairs - 1);
+        cb[c] = ((top[x + 1] + bottom[x + 1] + 1) >> 1) - 128;
+        cr[c] = ((top[x + 3] + bottom[x + 3] + 1) >> 1) - 128;
+    }
+}
+
+/* read an MCU of YUYV straight into the blocks of 4:2:0, the chroma is
+   subsampled on the way instead of in a converted copy of the frame */
+static void
+read_yuyv_420_format(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
+                     UINT8 * input_ptr)
+{
+    JPEG_ENCODER_STRUCTURE * jpeg = jpeg_encoder_structure;
+    UINT32 stride = jpeg->image_width * 2;
+    INT32 rows = jpeg->rows, cols = jpeg->cols, r, line;
+    INT32 chroma_rows = (rows + 1) >> 1, pairs = (cols + 1) >> 1;
+    INT16 * left, *right;
+    UINT8 * top, *bottom;
+#ifdef __SSE2__
+    const __m128i low_bytes = _mm_set1_epi16(0xff), low_words = _mm_set1_epi32(0xffff);
+    __m128i first, second;
+    if(rows == 16 && cols == 16) {
+        for(r = 0; r < 16; r++) {
+            top = input_ptr + r * stride;
+            store_row((r < 8 ? jpeg->Y1 : jpeg->Y3) + 8 * (r & 7),
+                      _mm_and_si128(_mm_loadu_si128((const __m128i *) top), low_bytes));
+            store_row((r < 8 ? jpeg->Y2 : jpeg->Y4) + 8 * (r & 7),
+                      _mm_and_si128(_mm_loadu_si128((const __m128i *)(top + 16)), low_bytes));
+        }
+        for(r = 0; r < 8; r++) {
+            /* the chroma bytes of two rows averaged as read_chroma_rows
+               does, Cb and Cr alternate in 16 bit lanes */
+            top = input_ptr + 2 * r * stride;
+            bottom = top + stride;
+            first = _mm_avg_epu16(_mm_srli_epi16(_mm_loadu_si128((const __m128i *) top), 8),
+                                  _mm_srli_epi16(_mm_loadu_si128((const __m128i *) bottom), 8));
+            second = _mm_avg_epu16(_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(top + 16)), 8),
+                                   _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(bottom + 16)), 8));
+            store_row(jpeg->CB + 8 * r, _mm_packs_epi32(_mm_and_si128(first, low_words),
+                                                        _mm_and_si128(second, low_words)));
+            store_row(jpeg->CR + 8 * r, _mm_packs_epi32(_mm_srli_epi32(first, 16),
+                                                        _mm_srli_epi32(second, 16)));
+        }
+        return;
+    }
+#endif
+    for(r = 0; r < 16; r++) {
+        left = (r < 8 ? jpeg->Y1 : jpeg->Y3) + 8 * (r & 7);
+        right = (r < 8 ? jpeg->Y2 : jpeg->Y4) + 8 * (r & 7);
+        top = input_ptr + (r < rows ? r : rows - 1) * stride;
+        if(cols == 16)
+            read_luma_row(left, right, top, 2, 16);
+        else
+            read_luma_row(left, right, top, 2, cols);
+    }
+    for(r = 0; r < 8; r++) {
+        line = 2 * (r < chroma_rows ? r : chroma_rows - 1);
+        top = input_ptr + line * stride;
+        bottom = input_ptr + (line + 1 < rows ? line + 1 : line) * stride;
+        if(cols == 16)
+            read_chroma_rows(jpeg->CB + 8 * r, jpeg->CR + 8 * r, top, bottom, 8);
+        else
+            read_chroma_rows(jpeg->CB + 8 * r, jpeg->CR + 8 * r, top, bottom, pairs);
+    }
+}
+
 
 #define CLIP(color) (unsigned char)(((color)>0xFF)?0xff:(((color)<0)?0:(color)))
 
@@ -1054,44 +1523,3 @@ YUV_2_422(UINT8 * input_ptr, UINT8 * output_ptr, UINT32 image_width,
 }
 
 
-/* translate YUV420P to YUV420 in input */
-static void
-YUV_2_420(UINT8 * input_ptr, UINT8 * output_ptr, UINT32 image_width,
-          UINT32 image_height)
-{
-    UINT32 x, y, size;
-    UINT8 * Ytmp = NULL;
-    UINT8 * Y2tmp = NULL;
-    UINT8 * Cbtmp = NULL;
-    UINT8 * Crtmp = NULL;
-    UINT8 * Buff = NULL;
-    Buff =
-        (UINT8 *) realloc((UINT8 *) Buff,
-                          (size_t)((image_width * image_height * 3) >> 1));
-    if(Buff) {
-        memcpy(Buff, input_ptr, (image_width * image_height * 3) >> 1);
-        Ytmp = Buff;
-        Y2tmp = Buff + image_width;
-        Cbtmp = Buff + image_width * image_height;
-        Crtmp = Cbtmp + (image_width * image_height >> 2);
-        size = image_width * image_height >> 2;
-        for(y = 0; y < image_height; y += 2)
-
-        {
-            for(x = 0; x < image_width; x += 2) {
-                *input_ptr++ = (UINT8) * Ytmp++;
-                *input_ptr++ = (UINT8) * Ytmp++;
-                *input_ptr++ = (UINT8) * Y2tmp++;
-                *input_ptr++ = (UINT8) * Y2tmp++;
-                *input_ptr++ = (UINT8) * Cbtmp++;
-                *input_ptr++ = (UINT8) * Crtmp++;
-            }
-            Ytmp += image_width;
-            Y2tmp += image_width;
-        }
-        free(Buff);
-        Buff = NULL;
-    }
-}
-
-
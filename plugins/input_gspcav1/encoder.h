@@ -25,6 +25,9 @@
 
 #ifndef ENCODER_H
 #define ENCODER_H
+
+#include "jdatatype.h"
+
 /********* Image_format know by the encoder *********************/
 /* Native YUV Packet */
 #define     FOUR_ZERO_ZERO  0   // Grey scale Y00 ...
@@ -43,50 +46,103 @@
 #define     YUVto444    8   //YUV444Planar to Packet YUV444
 #define     YUVto422    9   //YUV422Planar to Packet YUV422
 #define     YUVto420    10  //YUV420Planar to Packet YUV420
+/* read YUV packet 4:2:2 straight into the blocks of 4:2:0 */
+#define     YUYVto420   13  //Y00 Cb Y01 Cr to YUV420, chroma of two rows averaged
+/* read YUV 4:2:0 with a plane of interleaved chroma as it is */
+#define     NV12to420   14  //Y plane, Cb Cr interleaved plane to YUV420
 /*****************************************************************/
 
 #define     BLOCK_SIZE  64
 
-UINT8 Lqt[BLOCK_SIZE];
-UINT8 Cqt[BLOCK_SIZE];
-UINT16 ILqt[BLOCK_SIZE];
-UINT16 ICqt[BLOCK_SIZE];
-INT16 Y1[BLOCK_SIZE];
-INT16 Y2[BLOCK_SIZE];
-INT16 Y3[BLOCK_SIZE];
-INT16 Y4[BLOCK_SIZE];
-INT16 CB[BLOCK_SIZE];
-INT16 CR[BLOCK_SIZE];
-INT16 Temp[BLOCK_SIZE];
-INT32 lcode;
-UINT16 bitindex;
-typedef struct JPEG_ENCODER_STRUCTURE {
+/*
+ * All state of one encoder lives in this structure, so every camera or thread
+ * that encodes pictures uses an encoder structure of its own and several
+ * pictures can be encoded in parallel.
+ */
+typedef struct JPEG_ENCODER_STRUCTURE JPEG_ENCODER_STRUCTURE;
+struct JPEG_ENCODER_STRUCTURE {
     UINT16 mcu_width;
     UINT16 mcu_height;
     UINT16 horizontal_mcus;
     UINT16 vertical_mcus;
     UINT16 rows_in_bottom_mcus;
     UINT16 cols_in_right_mcus;
-    UINT16 length_minus_mcu_width;
-    UINT16 length_minus_width;
-    UINT16 mcu_width_size;
-    UINT16 offset;
+    UINT32 length_minus_mcu_width;
+    UINT32 length_minus_width;
+    UINT32 mcu_width_size;
+    UINT32 offset;
     INT16 ldc1;
     INT16 ldc2;
     INT16 ldc3;
     UINT16 rows;
     UINT16 cols;
-    UINT16 incr;
-} JPEG_ENCODER_STRUCTURE;
+    UINT32 incr;
+
+    /* reads one MCU of the current image format into the blocks below */
+    void (*read_format)(JPEG_ENCODER_STRUCTURE *, UINT8 *);
+
+    /* the picture as the readers of YUVto420, NV12to420 and YUYVto420 see it,
+    chroma_step is 1 for separate chroma planes and 2 for interleaved ones */
+    UINT32 image_width;
+    UINT8 *y_plane;
+    UINT8 *cb_plane;
+    UINT8 *cr_plane;
+    UINT32 chroma_step;
+
+    /* transform and quantize a block, the vector or the scalar versions */
+    void (*dct)(INT16 *);
+    void (*quantize)(JPEG_ENCODER_STRUCTURE *, INT16 *, UINT16 *);
+
+    /* quantization tables, valid for quality_factor if tables_valid is set */
+    UINT32 quality_factor;
+    UINT16 tables_valid;
+    UINT8 Lqt[BLOCK_SIZE];
+    UINT8 Cqt[BLOCK_SIZE];
+    UINT16 ILqt[BLOCK_SIZE];
+    UINT16 ICqt[BLOCK_SIZE];
 
-/* encode picture input to output
-quality factor
+    /* blocks of the current MCU and the quantized block in zigzag order */
+    INT16 Y1[BLOCK_SIZE];
+    INT16 Y2[BLOCK_SIZE];
+    INT16 Y3[BLOCK_SIZE];
+    INT16 Y4[BLOCK_SIZE];
+    INT16 CB[BLOCK_SIZE];
+    INT16 CR[BLOCK_SIZE];
+    INT16 Temp[BLOCK_SIZE];
+
+    /* bits not yet written to the output */
+    UINT64 lcode;
+    UINT16 bitindex;
+};
+
+/* prepare an encoder structure before its first use */
+void encoder_init(JPEG_ENCODER_STRUCTURE * jpeg);
+
+/* use the scalar DCT and quantization, they give the same output as the
+vector versions and are kept to verify them */
+void encoder_use_scalar(JPEG_ENCODER_STRUCTURE * jpeg);
+
+/* encode picture input to output with the given encoder
+output_size is the size of the output buffer
+quality factor scales the standard tables by quality_factor / 1024
 image_format look the define
 image_width image_height of the input picture
-return the encoded size in Byte
+the RGB and planar formats are converted in place, input is overwritten
+return the encoded size in Byte, 0 if it might not fit into output_size
 */
+UINT32 encode_image_ctx(JPEG_ENCODER_STRUCTURE * jpeg,
+                        UINT8 * input_ptr, UINT8 * output_ptr,
+                        UINT32 output_size, UINT32 quality_factor,
+                        UINT32 image_format, UINT32 image_width,
+                        UINT32 image_height);
+
+/* same as encode_image_ctx, with an encoder structure on the stack and
+an output buffer that is assumed to be large enough */
 UINT32 encode_image(UINT8 * input_ptr, UINT8 * output_ptr,
                     UINT32 quality_factor, UINT32 image_format,
                     UINT32 image_width, UINT32 image_height);
 
+/* convert a JPEG quality in percent (1..100, like libjpeg) to a quality factor */
+UINT32 encoder_quality_factor(int quality);
+
 #endif  /* ENCODER_H */
@@ -23,343 +23,261 @@
 #***************************************************************************/
 
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "jdatatype.h"
 
 #include "encoder.h"
 #include "huffman.h"
 
-UINT16 luminance_dc_code_table[] = {
-    0x0000, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006, 0x000E, 0x001E, 0x003E,
-    0x007E, 0x00FE, 0x01FE
+static const UINT32 luminance_dc_table[] = {
+    0x00020000, 0x00030002, 0x00030003, 0x00030004, 0x00030005, 0x00030006,
+    0x0004000E, 0x0005001E, 0x0006003E, 0x0007007E, 0x000800FE, 0x000901FE
 };
-UINT16 luminance_dc_size_table[] = {
-    0x0002, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0004, 0x0005, 0x0006,
-    0x0007, 0x0008, 0x0009
+static const UINT32 chrominance_dc_table[] = {
+    0x00020000, 0x00020001, 0x00020002, 0x00030006, 0x0004000E, 0x0005001E,
+    0x0006003E, 0x0007007E, 0x000800FE, 0x000901FE, 0x000A03FE, 0x000B07FE
 };
-UINT16 chrominance_dc_code_table[] = {
-    0x0000, 0x0001, 0x0002, 0x0006, 0x000E, 0x001E, 0x003E, 0x007E, 0x00FE,
-    0x01FE, 0x03FE, 0x07FE
+static const UINT32 luminance_ac_table[256] = {
+    0x0004000A, 0x00020000, 0x00020001, 0x00030004, 0x0004000B, 0x0005001A,
+    0x00070078, 0x000800F8, 0x000A03F6, 0x0010FF82, 0x0010FF83, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0004000C,
+    0x0005001B, 0x00070079, 0x000901F6, 0x000B07F6, 0x0010FF84, 0x0010FF85,
+    0x0010FF86, 0x0010FF87, 0x0010FF88, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x0005001C, 0x000800F9, 0x000A03F7,
+    0x000C0FF4, 0x0010FF89, 0x0010FF8A, 0x0010FF8B, 0x0010FF8C, 0x0010FF8D,
+    0x0010FF8E, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x0006003A, 0x000901F7, 0x000C0FF5, 0x0010FF8F, 0x0010FF90,
+    0x0010FF91, 0x0010FF92, 0x0010FF93, 0x0010FF94, 0x0010FF95, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0006003B,
+    0x000A03F8, 0x0010FF96, 0x0010FF97, 0x0010FF98, 0x0010FF99, 0x0010FF9A,
+    0x0010FF9B, 0x0010FF9C, 0x0010FF9D, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x0007007A, 0x000B07F7, 0x0010FF9E,
+    0x0010FF9F, 0x0010FFA0, 0x0010FFA1, 0x0010FFA2, 0x0010FFA3, 0x0010FFA4,
+    0x0010FFA5, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x0007007B, 0x000C0FF6, 0x0010FFA6, 0x0010FFA7, 0x0010FFA8,
+    0x0010FFA9, 0x0010FFAA, 0x0010FFAB, 0x0010FFAC, 0x0010FFAD, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x000800FA,
+    0x000C0FF7, 0x0010FFAE, 0x0010FFAF, 0x0010FFB0, 0x0010FFB1, 0x0010FFB2,
+    0x0010FFB3, 0x0010FFB4, 0x0010FFB5, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x000901F8, 0x000F7FC0, 0x0010FFB6,
+    0x0010FFB7, 0x0010FFB8, 0x0010FFB9, 0x0010FFBA, 0x0010FFBB, 0x0010FFBC,
+    0x0010FFBD, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x000901F9, 0x0010FFBE, 0x0010FFBF, 0x0010FFC0, 0x0010FFC1,
+    0x0010FFC2, 0x0010FFC3, 0x0010FFC4, 0x0010FFC5, 0x0010FFC6, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x000901FA,
+    0x0010FFC7, 0x0010FFC8, 0x0010FFC9, 0x0010FFCA, 0x0010FFCB, 0x0010FFCC,
+    0x0010FFCD, 0x0010FFCE, 0x0010FFCF, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x000A03F9, 0x0010FFD0, 0x0010FFD1,
+    0x0010FFD2, 0x0010FFD3, 0x0010FFD4, 0x0010FFD5, 0x0010FFD6, 0x0010FFD7,
+    0x0010FFD8, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x000A03FA, 0x0010FFD9, 0x0010FFDA, 0x0010FFDB, 0x0010FFDC,
+    0x0010FFDD, 0x0010FFDE, 0x0010FFDF, 0x0010FFE0, 0x0010FFE1, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x000B07F8,
+    0x0010FFE2, 0x0010FFE3, 0x0010FFE4, 0x0010FFE5, 0x0010FFE6, 0x0010FFE7,
+    0x0010FFE8, 0x0010FFE9, 0x0010FFEA, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x0010FFEB, 0x0010FFEC, 0x0010FFED,
+    0x0010FFEE, 0x0010FFEF, 0x0010FFF0, 0x0010FFF1, 0x0010FFF2, 0x0010FFF3,
+    0x0010FFF4, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x000B07F9, 0x0010FFF5, 0x0010FFF6, 0x0010FFF7, 0x0010FFF8, 0x0010FFF9,
+    0x0010FFFA, 0x0010FFFB, 0x0010FFFC, 0x0010FFFD, 0x0010FFFE, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000
 };
-UINT16 chrominance_dc_size_table[] = {
-    0x0002, 0x0002, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006, 0x0007, 0x0008,
-    0x0009, 0x000A, 0x000B
+static const UINT32 chrominance_ac_table[256] = {
+    0x00020000, 0x00020001, 0x00030004, 0x0004000A, 0x00050018, 0x00050019,
+    0x00060038, 0x00070078, 0x000901F4, 0x000A03F6, 0x000C0FF4, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0004000B,
+    0x00060039, 0x000800F6, 0x000901F5, 0x000B07F6, 0x000C0FF5, 0x0010FF88,
+    0x0010FF89, 0x0010FF8A, 0x0010FF8B, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x0005001A, 0x000800F7, 0x000A03F7,
+    0x000C0FF6, 0x000F7FC2, 0x0010FF8C, 0x0010FF8D, 0x0010FF8E, 0x0010FF8F,
+    0x0010FF90, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x0005001B, 0x000800F8, 0x000A03F8, 0x000C0FF7, 0x0010FF91,
+    0x0010FF92, 0x0010FF93, 0x0010FF94, 0x0010FF95, 0x0010FF96, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0006003A,
+    0x000901F6, 0x0010FF97, 0x0010FF98, 0x0010FF99, 0x0010FF9A, 0x0010FF9B,
+    0x0010FF9C, 0x0010FF9D, 0x0010FF9E, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x0006003B, 0x000A03F9, 0x0010FF9F,
+    0x0010FFA0, 0x0010FFA1, 0x0010FFA2, 0x0010FFA3, 0x0010FFA4, 0x0010FFA5,
+    0x0010FFA6, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00070079, 0x000B07F7, 0x0010FFA7, 0x0010FFA8, 0x0010FFA9,
+    0x0010FFAA, 0x0010FFAB, 0x0010FFAC, 0x0010FFAD, 0x0010FFAE, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0007007A,
+    0x000B07F8, 0x0010FFAF, 0x0010FFB0, 0x0010FFB1, 0x0010FFB2, 0x0010FFB3,
+    0x0010FFB4, 0x0010FFB5, 0x0010FFB6, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x000800F9, 0x0010FFB7, 0x0010FFB8,
+    0x0010FFB9, 0x0010FFBA, 0x0010FFBB, 0x0010FFBC, 0x0010FFBD, 0x0010FFBE,
+    0x0010FFBF, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x000901F7, 0x0010FFC0, 0x0010FFC1, 0x0010FFC2, 0x0010FFC3,
+    0x0010FFC4, 0x0010FFC5, 0x0010FFC6, 0x0010FFC7, 0x0010FFC8, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x000901F8,
+    0x0010FFC9, 0x0010FFCA, 0x0010FFCB, 0x0010FFCC, 0x0010FFCD, 0x0010FFCE,
+    0x0010FFCF, 0x0010FFD0, 0x0010FFD1, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x000901F9, 0x0010FFD2, 0x0010FFD3,
+    0x0010FFD4, 0x0010FFD5, 0x0010FFD6, 0x0010FFD7, 0x0010FFD8, 0x0010FFD9,
+    0x0010FFDA, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x000901FA, 0x0010FFDB, 0x0010FFDC, 0x0010FFDD, 0x0010FFDE,
+    0x0010FFDF, 0x0010FFE0, 0x0010FFE1, 0x0010FFE2, 0x0010FFE3, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x000B07F9,
+    0x0010FFE4, 0x0010FFE5, 0x0010FFE6, 0x0010FFE7, 0x0010FFE8, 0x0010FFE9,
+    0x0010FFEA, 0x0010FFEB, 0x0010FFEC, 0x00000000, 0x00000000, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x000E3FE0, 0x0010FFED, 0x0010FFEE,
+    0x0010FFEF, 0x0010FFF0, 0x0010FFF1, 0x0010FFF2, 0x0010FFF3, 0x0010FFF4,
+    0x0010FFF5, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0x000A03FA, 0x000F7FC3, 0x0010FFF6, 0x0010FFF7, 0x0010FFF8, 0x0010FFF9,
+    0x0010FFFA, 0x0010FFFB, 0x0010FFFC, 0x0010FFFD, 0x0010FFFE, 0x00000000,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000
 };
 
-UINT16 luminance_ac_code_table[] = {
-    0x000A, 0x0000, 0x0001, 0x0004, 0x000B, 0x001A, 0x0078, 0x00F8, 0x03F6,
-    0xFF82, 0xFF83, 0x000C, 0x001B, 0x0079, 0x01F6, 0x07F6, 0xFF84, 0xFF85,
-    0xFF86, 0xFF87, 0xFF88, 0x001C, 0x00F9, 0x03F7, 0x0FF4, 0xFF89, 0xFF8A,
-    0xFF8b, 0xFF8C, 0xFF8D, 0xFF8E, 0x003A, 0x01F7, 0x0FF5, 0xFF8F, 0xFF90,
-    0xFF91, 0xFF92, 0xFF93, 0xFF94, 0xFF95, 0x003B, 0x03F8, 0xFF96, 0xFF97,
-    0xFF98, 0xFF99, 0xFF9A, 0xFF9B, 0xFF9C, 0xFF9D, 0x007A, 0x07F7, 0xFF9E,
-    0xFF9F, 0xFFA0, 0xFFA1, 0xFFA2, 0xFFA3, 0xFFA4, 0xFFA5, 0x007B, 0x0FF6,
-    0xFFA6, 0xFFA7, 0xFFA8, 0xFFA9, 0xFFAA, 0xFFAB, 0xFFAC, 0xFFAD, 0x00FA,
-    0x0FF7, 0xFFAE, 0xFFAF, 0xFFB0, 0xFFB1, 0xFFB2, 0xFFB3, 0xFFB4, 0xFFB5,
-    0x01F8, 0x7FC0, 0xFFB6, 0xFFB7, 0xFFB8, 0xFFB9, 0xFFBA, 0xFFBB, 0xFFBC,
-    0xFFBD, 0x01F9, 0xFFBE, 0xFFBF, 0xFFC0, 0xFFC1, 0xFFC2, 0xFFC3, 0xFFC4,
-    0xFFC5, 0xFFC6, 0x01FA, 0xFFC7, 0xFFC8, 0xFFC9, 0xFFCA, 0xFFCB, 0xFFCC,
-    0xFFCD, 0xFFCE, 0xFFCF, 0x03F9, 0xFFD0, 0xFFD1, 0xFFD2, 0xFFD3, 0xFFD4,
-    0xFFD5, 0xFFD6, 0xFFD7, 0xFFD8, 0x03FA, 0xFFD9, 0xFFDA, 0xFFDB, 0xFFDC,
-    0xFFDD, 0xFFDE, 0xFFDF, 0xFFE0, 0xFFE1, 0x07F8, 0xFFE2, 0xFFE3, 0xFFE4,
-    0xFFE5, 0xFFE6, 0xFFE7, 0xFFE8, 0xFFE9, 0xFFEA, 0xFFEB, 0xFFEC, 0xFFED,
-    0xFFEE, 0xFFEF, 0xFFF0, 0xFFF1, 0xFFF2, 0xFFF3, 0xFFF4, 0xFFF5, 0xFFF6,
-    0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE,
-    0x07F9
-};
-UINT16 luminance_ac_size_table[] = {
-    0x0004, 0x0002, 0x0002, 0x0003, 0x0004, 0x0005, 0x0007, 0x0008, 0x000A,
-    0x0010, 0x0010, 0x0004, 0x0005, 0x0007, 0x0009, 0x000B, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0005, 0x0008, 0x000A, 0x000C, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0006, 0x0009, 0x000C, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0006, 0x000A, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0007, 0x000B, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0007, 0x000C,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0008,
-    0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0009, 0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x000A, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x000B, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x000B
-};
-UINT16 chrominance_ac_code_table[] = {
-    0x0000, 0x0001, 0x0004, 0x000A, 0x0018, 0x0019, 0x0038, 0x0078, 0x01F4,
-    0x03F6, 0x0FF4, 0x000B, 0x0039, 0x00F6, 0x01F5, 0x07F6, 0x0FF5, 0xFF88,
-    0xFF89, 0xFF8A, 0xFF8B, 0x001A, 0x00F7, 0x03F7, 0x0FF6, 0x7FC2, 0xFF8C,
-    0xFF8D, 0xFF8E, 0xFF8F, 0xFF90, 0x001B, 0x00F8, 0x03F8, 0x0FF7, 0xFF91,
-    0xFF92, 0xFF93, 0xFF94, 0xFF95, 0xFF96, 0x003A, 0x01F6, 0xFF97, 0xFF98,
-    0xFF99, 0xFF9A, 0xFF9B, 0xFF9C, 0xFF9D, 0xFF9E, 0x003B, 0x03F9, 0xFF9F,
-    0xFFA0, 0xFFA1, 0xFFA2, 0xFFA3, 0xFFA4, 0xFFA5, 0xFFA6, 0x0079, 0x07F7,
-    0xFFA7, 0xFFA8, 0xFFA9, 0xFFAA, 0xFFAB, 0xFFAC, 0xFFAD, 0xFFAE, 0x007A,
-    0x07F8, 0xFFAF, 0xFFB0, 0xFFB1, 0xFFB2, 0xFFB3, 0xFFB4, 0xFFB5, 0xFFB6,
-    0x00F9, 0xFFB7, 0xFFB8, 0xFFB9, 0xFFBA, 0xFFBB, 0xFFBC, 0xFFBD, 0xFFBE,
-    0xFFBF, 0x01F7, 0xFFC0, 0xFFC1, 0xFFC2, 0xFFC3, 0xFFC4, 0xFFC5, 0xFFC6,
-    0xFFC7, 0xFFC8, 0x01F8, 0xFFC9, 0xFFCA, 0xFFCB, 0xFFCC, 0xFFCD, 0xFFCE,
-    0xFFCF, 0xFFD0, 0xFFD1, 0x01F9, 0xFFD2, 0xFFD3, 0xFFD4, 0xFFD5, 0xFFD6,
-    0xFFD7, 0xFFD8, 0xFFD9, 0xFFDA, 0x01FA, 0xFFDB, 0xFFDC, 0xFFDD, 0xFFDE,
-    0xFFDF, 0xFFE0, 0xFFE1, 0xFFE2, 0xFFE3, 0x07F9, 0xFFE4, 0xFFE5, 0xFFE6,
-    0xFFE7, 0xFFE8, 0xFFE9, 0xFFEA, 0xFFEb, 0xFFEC, 0x3FE0, 0xFFED, 0xFFEE,
-    0xFFEF, 0xFFF0, 0xFFF1, 0xFFF2, 0xFFF3, 0xFFF4, 0xFFF5, 0x7FC3, 0xFFF6,
-    0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE,
-    0x03FA
-};
-UINT16 chrominance_ac_size_table[] = {
-    0x0002, 0x0002, 0x0003, 0x0004, 0x0005, 0x0005, 0x0006, 0x0007, 0x0009,
-    0x000A, 0x000C, 0x0004, 0x0006, 0x0008, 0x0009, 0x000B, 0x000C, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0005, 0x0008, 0x000A, 0x000C, 0x000F, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0005, 0x0008, 0x000A, 0x000C, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0006, 0x0009, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0006, 0x000A, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0007, 0x000B,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0007,
-    0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0008, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x000B, 0x0010, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x000E, 0x0010, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x000F, 0x0010,
-    0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-    0x000A
-};
-UINT8 bitsize[] = {
-    0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5,
-    5, 5, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8
-};
-#if 0
-#define PUTBITS { \
-        bits_in_next_word = (INT16) (bitindex + numbits - 32); \
-        if (bits_in_next_word < 0) \
-        { \
-            lcode = (lcode << numbits) | data; \
-            bitindex += numbits; \
-        } \
-        else \
+/*
+ * The tables hold the length of a code above the code itself. The AC tables
+ * are indexed with run << 4 | size like the symbols of the standard, 0x00 is
+ * the end of block and 0xF0 the run of sixteen zeros.
+ */
+#define CODE(entry) ((entry) & 0xFFFF)
+#define LENGTH(entry) ((entry) >> 16)
+
+/* bit i is set for a nonzero coefficient i of the block */
+static inline UINT64 nonzero_coefficients(const INT16 * block)
+{
+#ifdef __SSE2__
+    const __m128i * row = (const __m128i *) block;
+    const __m128i zero = _mm_setzero_si128();
+    UINT64 zeros = 0;
+    int i;
+    for(i = 0; i < 4; i++) {
+        __m128i bytes = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(row + 2 * i), zero),
+                                        _mm_cmpeq_epi16(_mm_loadu_si128(row + 2 * i + 1), zero));
+        zeros |= (UINT64) _mm_movemask_epi8(bytes) << (16 * i);
+    }
+    return ~zeros;
+#else
+    UINT64 nonzero = 0;
+    int i;
+    for(i = 0; i < 64; i++)
+        nonzero |= (UINT64)(block[i] != 0) << i;
+    return nonzero;
+#endif
+}
+
+/* a byte 0xFF of the word needs a 0 after it */
+static inline UINT8 * put_word(UINT8 * output_ptr, UINT32 word)
+{
+    /* finds a 0xFF byte like a zero byte of the inverted word, without branching on every byte */
+    if((((~word) - 0x01010101) & word & 0x80808080) == 0) {
+        output_ptr[0] = (UINT8)(word >> 24);
+        output_ptr[1] = (UINT8)(word >> 16);
+        output_ptr[2] = (UINT8)(word >> 8);
+        output_ptr[3] = (UINT8) word;
+        return output_ptr + 4;
+    }
+    if((*output_ptr++ = (UINT8)(word >> 24)) == 0xff)
+        * output_ptr++ = 0;
+    if((*output_ptr++ = (UINT8)(word >> 16)) == 0xff)
+        * output_ptr++ = 0;
+    if((*output_ptr++ = (UINT8)(word >> 8)) == 0xff)
+        * output_ptr++ = 0;
+    if((*output_ptr++ = (UINT8) word) == 0xff)
+        * output_ptr++ = 0;
+    return output_ptr;
+}
+
+/*
+ * at most 31 bits wait in the accumulator and a code with its value has at
+ * most 27 bits, so the 64 bits never overflow
+ */
+#define PUTBITS(data, numbits) { \
+        lcode = (lcode << (numbits)) | (data); \
+        bitindex += (numbits); \
+        if (bitindex >= 32) \
         { \
-            lcode = (lcode << (32 - bitindex)) | (data >> bits_in_next_word); \
-            if ((*output_ptr++ = (UINT8) (lcode >> 24)) == 0xff) \
-                *output_ptr++ = 0; \
-            if ((*output_ptr++ = (UINT8) (lcode >> 16)) == 0xff) \
-                *output_ptr++ = 0; \
-            if ((*output_ptr++ = (UINT8) (lcode >> 8)) == 0xff) \
-                *output_ptr++ = 0; \
-            if ((*output_ptr++ = (UINT8) lcode) == 0xff) \
-                *output_ptr++ = 0; \
-            lcode = data; \
-            bitindex = bits_in_next_word; \
+            bitindex -= 32; \
+            output_ptr = put_word(output_ptr, (UINT32) (lcode >> bitindex)); \
         } \
     }
-#endif
+
 UINT8 * huffman(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
                 UINT16 component, UINT8 * output_ptr)
 {
-    UINT16 i;
-    UINT16 * DcCodeTable, *DcSizeTable, *AcCodeTable, *AcSizeTable;
-    INT16 * Temp_Ptr, Coeff, LastDc;
-    UINT16 AbsCoeff, HuffCode, HuffSize, RunLength = 0, DataSize = 0, index;
-    INT16 bits_in_next_word;
-    UINT16 numbits;
-    UINT32 data;
-    Temp_Ptr = Temp;
+    UINT16 k;
+    const UINT32 * DcTable, *AcTable;
+    INT16 * Temp_Ptr, Coeff, LastDc, sign;
+    UINT16 AbsCoeff, RunLength, DataSize;
+    UINT32 entry;
+    UINT64 nonzero;
+    UINT64 lcode = jpeg_encoder_structure->lcode;
+    UINT16 bitindex = jpeg_encoder_structure->bitindex;
+    Temp_Ptr = jpeg_encoder_structure->Temp;
     Coeff = *Temp_Ptr++;
-    if(component == 1)
-
-    {
-        DcCodeTable = luminance_dc_code_table;
-        DcSizeTable = luminance_dc_size_table;
-        AcCodeTable = luminance_ac_code_table;
-        AcSizeTable = luminance_ac_size_table;
+    if(component == 1) {
+        DcTable = luminance_dc_table;
+        AcTable = luminance_ac_table;
         LastDc = jpeg_encoder_structure->ldc1;
         jpeg_encoder_structure->ldc1 = Coeff;
-    }
-
-    else
-
-    {
-        DcCodeTable = chrominance_dc_code_table;
-        DcSizeTable = chrominance_dc_size_table;
-        AcCodeTable = chrominance_ac_code_table;
-        AcSizeTable = chrominance_ac_size_table;
-        if(component == 2)
-
-        {
+    } else {
+        DcTable = chrominance_dc_table;
+        AcTable = chrominance_ac_table;
+        if(component == 2) {
             LastDc = jpeg_encoder_structure->ldc2;
             jpeg_encoder_structure->ldc2 = Coeff;
-        }
-
-        else
-
-        {
+        } else {
             LastDc = jpeg_encoder_structure->ldc3;
             jpeg_encoder_structure->ldc3 = Coeff;
         }
     }
     Coeff -= LastDc;
-    AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
-    while(AbsCoeff != 0)
-
-    {
-        AbsCoeff >>= 1;
-        DataSize++;
-    }
-    HuffCode = DcCodeTable[DataSize];
-    HuffSize = DcSizeTable[DataSize];
+    /* a negative value is written as its ones' complement, without a branch on the sign */
+    sign = Coeff >> 15;
+    AbsCoeff = (Coeff ^ sign) - sign;
+    Coeff += sign;
+    DataSize = AbsCoeff ? 32 - __builtin_clz(AbsCoeff) : 0;
+    entry = DcTable[DataSize];
     Coeff &= (1 << DataSize) - 1;
-    data = (HuffCode << DataSize) | Coeff;
-    numbits = HuffSize + DataSize;
-    //PUTBITS
-    {
-        bits_in_next_word = (INT16)(bitindex + numbits - 32);
-        if(bits_in_next_word < 0) {
-            lcode = (lcode << numbits) | data;
-            bitindex += numbits;
-        } else {
-            lcode = (lcode << (32 - bitindex)) | (data >> bits_in_next_word);
-            if((*output_ptr++ = (UINT8)(lcode >> 24)) == 0xff)
-                * output_ptr++ = 0;
-            if((*output_ptr++ = (UINT8)(lcode >> 16)) == 0xff)
-                * output_ptr++ = 0;
-            if((*output_ptr++ = (UINT8)(lcode >> 8)) == 0xff)
-                * output_ptr++ = 0;
-            if((*output_ptr++ = (UINT8) lcode) == 0xff)
-                * output_ptr++ = 0;
-            lcode = data;
-            bitindex = bits_in_next_word;
-        }
-    }
-    for(i = 63; i > 0; i--)
-
-    {
-        if((Coeff = *Temp_Ptr++) != 0)
-
-        {
-            while(RunLength > 15)
-
-            {
-                RunLength -= 16;
-                data = AcCodeTable[161];
-                numbits = AcSizeTable[161];
-                //PUTBITS
-                {
-                    bits_in_next_word = (INT16)(bitindex + numbits - 32);
-                    if(bits_in_next_word < 0) {
-                        lcode = (lcode << numbits) | data;
-                        bitindex += numbits;
-                    } else {
-                        lcode = (lcode << (32 - bitindex)) | (data >> bits_in_next_word);
-                        if((*output_ptr++ = (UINT8)(lcode >> 24)) == 0xff)
-                            * output_ptr++ = 0;
-                        if((*output_ptr++ = (UINT8)(lcode >> 16)) == 0xff)
-                            * output_ptr++ = 0;
-                        if((*output_ptr++ = (UINT8)(lcode >> 8)) == 0xff)
-                            * output_ptr++ = 0;
-                        if((*output_ptr++ = (UINT8) lcode) == 0xff)
-                            * output_ptr++ = 0;
-                        lcode = data;
-                        bitindex = bits_in_next_word;
-                    }
-                }
-            }
-            AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
-            if(AbsCoeff >> 8 == 0)
-                DataSize = bitsize[AbsCoeff];
-
-            else
-                DataSize = bitsize[AbsCoeff >> 8] + 8;
-            index = RunLength * 10 + DataSize;
-            HuffCode = AcCodeTable[index];
-            HuffSize = AcSizeTable[index];
-            Coeff &= (1 << DataSize) - 1;
-            data = (HuffCode << DataSize) | Coeff;
-            numbits = HuffSize + DataSize;
-            // PUTBITS
-            {
-                bits_in_next_word = (INT16)(bitindex + numbits - 32);
-                if(bits_in_next_word < 0) {
-                    lcode = (lcode << numbits) | data;
-                    bitindex += numbits;
-                } else {
-                    lcode = (lcode << (32 - bitindex)) | (data >> bits_in_next_word);
-                    if((*output_ptr++ = (UINT8)(lcode >> 24)) == 0xff)
-                        * output_ptr++ = 0;
-                    if((*output_ptr++ = (UINT8)(lcode >> 16)) == 0xff)
-                        * output_ptr++ = 0;
-                    if((*output_ptr++ = (UINT8)(lcode >> 8)) == 0xff)
-                        * output_ptr++ = 0;
-                    if((*output_ptr++ = (UINT8) lcode) == 0xff)
-                        * output_ptr++ = 0;
-                    lcode = data;
-                    bitindex = bits_in_next_word;
-                }
-            }
-            RunLength = 0;
-        }
+    PUTBITS((CODE(entry) << DataSize) | Coeff, LENGTH(entry) + DataSize)
 
-        else
-            RunLength++;
-    }
-    if(RunLength != 0)
-
-    {
-        data = AcCodeTable[0];
-        numbits = AcSizeTable[0];
-        // PUTBITS
-        {
-            bits_in_next_word = (INT16)(bitindex + numbits - 32);
-            if(bits_in_next_word < 0) {
-                lcode = (lcode << numbits) | data;
-                bitindex += numbits;
-            } else {
-                lcode = (lcode << (32 - bitindex)) | (data >> bits_in_next_word);
-                if((*output_ptr++ = (UINT8)(lcode >> 24)) == 0xff)
-                    * output_ptr++ = 0;
-                if((*output_ptr++ = (UINT8)(lcode >> 16)) == 0xff)
-                    * output_ptr++ = 0;
-                if((*output_ptr++ = (UINT8)(lcode >> 8)) == 0xff)
-                    * output_ptr++ = 0;
-                if((*output_ptr++ = (UINT8) lcode) == 0xff)
-                    * output_ptr++ = 0;
-                lcode = data;
-                bitindex = bits_in_next_word;
-            }
+    /* the runs of zeros between the AC coefficients are counted in the bits */
+    nonzero = nonzero_coefficients(jpeg_encoder_structure->Temp) >> 1;
+    for(k = 0; nonzero != 0; nonzero >>= 1) {
+        RunLength = __builtin_ctzll(nonzero);
+        nonzero >>= RunLength;
+        k += RunLength + 1;
+        while(RunLength > 15) {
+            RunLength -= 16;
+            PUTBITS(CODE(AcTable[0xF0]), LENGTH(AcTable[0xF0]))
         }
+        Coeff = Temp_Ptr[k - 1];
+        sign = Coeff >> 15;
+        AbsCoeff = (Coeff ^ sign) - sign;
+        Coeff += sign;
+        DataSize = 32 - __builtin_clz(AbsCoeff);
+        entry = AcTable[(RunLength << 4) | DataSize];
+        Coeff &= (1 << DataSize) - 1;
+        PUTBITS((CODE(entry) << DataSize) | Coeff, LENGTH(entry) + DataSize)
     }
+    if(k != 63)
+        PUTBITS(CODE(AcTable[0x00]), LENGTH(AcTable[0x00]))
+    jpeg_encoder_structure->lcode = lcode;
+    jpeg_encoder_structure->bitindex = bitindex;
     return output_ptr;
 }
 
 
 /* For bit Stuffing and EOI marker */
-UINT8 * close_bitstream(UINT8 * output_ptr)
+UINT8 * close_bitstream(JPEG_ENCODER_STRUCTURE * jpeg_encoder_structure,
+                        UINT8 * output_ptr)
 {
     UINT16 i, count;
-    UINT8 * ptr;
-    if(bitindex > 0)
-
-    {
-        lcode <<= (32 - bitindex);
+    UINT32 word;
+    UINT8 byte;
+    UINT16 bitindex = jpeg_encoder_structure->bitindex;
+    if(bitindex > 0) {
+        word = (UINT32)(jpeg_encoder_structure->lcode << (32 - bitindex));
         count = (bitindex + 7) >> 3;
-        ptr = (UINT8 *) & lcode + 3;
-        for(i = count; i > 0; i--)
-
-        {
-            if((*output_ptr++ = *ptr--) == 0xff)
+        for(i = 0; i < count; i++) {
+            byte = (UINT8)(word >> (24 - 8 * i));
+            if((*output_ptr++ = byte) == 0xff)
                 * output_ptr++ = 0;
         }
     }
@@ -369,5 +287,3 @@ UINT8 * close_bitstream(UINT8 * output_ptr)
     *output_ptr++ = 0xD9;
     return output_ptr;
 }
-
-
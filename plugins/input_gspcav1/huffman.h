@@ -24,5 +24,5 @@
 #ifndef HUFFMAN_H
 #define HUFFMAN_H
 UINT8 * huffman(JPEG_ENCODER_STRUCTURE *, UINT16, UINT8 *);
-UINT8 * close_bitstream(UINT8 *);
+UINT8 * close_bitstream(JPEG_ENCODER_STRUCTURE *, UINT8 *);
 #endif  /*HUFFMAN_H */
@@ -22,19 +22,18 @@
 #                                                                              #
 *******************************************************************************/
 
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <syslog.h>
 #include <getopt.h>
 #include <pthread.h>
-
-#include "spcaframe.h"
-#include "spcav4l.h"
-#include "utils.h"
+#include <linux/videodev2.h>
 
 #include "../../utils.h"
-#include "../../mjpg_streamer.h"
+#include "../input_uvc/v4l2uvc.h" // the V4L2 capture core, includes ../../mjpg_streamer.h
+#include "encoder.h"
 
 #define INPUT_PLUGIN_NAME "GSPCAV1 webcam grabber"
 
@@ -76,27 +75,43 @@ static const struct {
     { "960x720", 960, 720 },
 };
 
+/*
+ * the formats of the former V4L1 palettes as the V4L2 compatibility layer
+ * translated them, uncompressed formats get compressed by the gspcav1 encoder
+ */
 static const struct {
     const char *string;
     const int format;
+    const int encode;   /* image format of the encoder, 0 for JPEG frames */
 } formats[] = {
-    { "r16", VIDEO_PALETTE_RGB565  },
-    { "r24", VIDEO_PALETTE_RGB24   },
-    { "r32", VIDEO_PALETTE_RGB32   },
-    { "yuv", VIDEO_PALETTE_YUV420P },
-    { "jpg", VIDEO_PALETTE_JPEG    }
+    { "r16",  V4L2_PIX_FMT_RGB565, RGB565to420 },
+    { "r24",  V4L2_PIX_FMT_BGR24,  RGBto420    },
+    { "r32",  V4L2_PIX_FMT_BGR32,  RGB32to420  },
+    { "yuv",  V4L2_PIX_FMT_YUV420, YUVto420    },
+    { "yuyv", V4L2_PIX_FMT_YUYV,   YUYVto420   },
+    { "nv12", V4L2_PIX_FMT_NV12,   NV12to420   },
+    { "jpg",  V4L2_PIX_FMT_JPEG,   0           },
+    { "mjpg", V4L2_PIX_FMT_MJPEG,  0           }
 };
 
 
 /* private functions and variables to this plugin */
-pthread_t cam;
-struct vdIn *videoIn;
-
-static int plugin_number;
 static globals *pglobal;
 
+/* context of each camera, allocated with global->inmax entries and freed
+   with the last camera */
+static context *cams = NULL;
+
+/* several cameras can be loaded */
+const int input_per_id = 1;
+
+/* encoder image format and quality of each camera, indexed like cams */
+static int *encode = NULL;
+static int *quality = NULL;
+
 void *cam_thread(void *);
 void cam_cleanup(void *);
+static void release_cams(int count);
 void help(void);
 
 /*** plugin interface functions ***/
@@ -106,14 +121,14 @@ Description.: This function initializes the plugin. It parses the commandline-
               appropriate variables.
 Input Value.: param contains among others the command-line string
 Return Value: 0 if everything is fine
-              1 if "--help" was triggered, in this case the calling programm
-              should stop running and leave.
+              1 if "--help" was triggered or the camera could not be set up,
+              nothing of the camera is left allocated then
 ******************************************************************************/
-int input_init(input_parameter *param, int plugin_no)
+int input_init(input_parameter *param, int id)
 {
-    plugin_number = plugin_no;
     char *dev = "/dev/video0", *s;
-    int width = 640, height = 480, format = VIDEO_PALETTE_JPEG, i;
+    int width = 640, height = 480, fps = 5, format = V4L2_PIX_FMT_JPEG, i;
+    int memory = V4L2_MEMORY_MMAP, encoding = 0, jpeg_quality = 50;
 
     param->argv[0] = INPUT_PLUGIN_NAME;
 
@@ -135,6 +150,11 @@ int input_init(input_parameter *param, int plugin_no)
             {"resolution", required_argument, 0, 0},
             {"f", required_argument, 0, 0},
             {"format", required_argument, 0, 0},
+            {"q", required_argument, 0, 0},
+            {"quality", required_argument, 0, 0},
+            {"fps", required_argument, 0, 0},
+            {"u", no_argument, 0, 0},
+            {"userptr", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -196,10 +216,31 @@ int input_init(input_parameter *param, int plugin_no)
             for(i = 0; i < LENGTH_OF(formats); i++) {
                 if(strcmp(formats[i].string, optarg) == 0) {
                     format  = formats[i].format;
+                    encoding = formats[i].encode;
                 }
             }
             break;
 
+            /* q, quality */
+        case 8:
+        case 9:
+            DBG("case 8,9\n");
+            jpeg_quality = MIN(MAX(atoi(optarg), 0), 100);
+            break;
+
+            /* fps */
+        case 10:
+            DBG("case 10\n");
+            fps = atoi(optarg);
+            break;
+
+            /* u, userptr */
+        case 11:
+        case 12:
+            DBG("case 11,12\n");
+            memory = V4L2_MEMORY_USERPTR;
+            break;
+
         default:
             DBG("default case\n");
             help();
@@ -210,73 +251,162 @@ int input_init(input_parameter *param, int plugin_no)
     /* keep a pointer to the global variables */
     pglobal = param->global;
 
+    /* one context for each slot of the input table */
+    if(cams == NULL) {
+        cams = calloc(param->global->inmax, sizeof(context));
+        encode = calloc(param->global->inmax, sizeof(int));
+        quality = calloc(param->global->inmax, sizeof(int));
+        if(cams == NULL || encode == NULL || quality == NULL) {
+            IPRINT("not enough memory for the camera contexts\n");
+            free(cams);
+            free(encode);
+            free(quality);
+            cams = NULL;
+            encode = quality = NULL;
+            return 1;
+        }
+    }
+    encode[id] = encoding;
+    quality[id] = jpeg_quality;
+
+    cams[id].id = id;
+    cams[id].pglobal = param->global;
+    cams[id].stop_fd = -1;
+
     /* allocate webcam datastructure */
-    videoIn = malloc(sizeof(struct vdIn));
-    if(videoIn == NULL) {
+    cams[id].encoder = NULL;
+    cams[id].videoIn = malloc(sizeof(struct vdIn));
+    if(cams[id].videoIn == NULL) {
         IPRINT("not enough memory for videoIn\n");
-        exit(EXIT_FAILURE);
+        goto failed;
+    }
+    memset(cams[id].videoIn, 0, sizeof(struct vdIn));
+    cams[id].videoIn->memory = memory;
+
+    /* the encode stage, only needed for uncompressed formats */
+    if(encode[id] != 0) {
+        cams[id].encoder = malloc(sizeof(JPEG_ENCODER_STRUCTURE));
+        if(cams[id].encoder == NULL) {
+            IPRINT("not enough memory for the encoder\n");
+            goto failed;
+        }
+        encoder_init(cams[id].encoder);
     }
-    memset(videoIn, 0, sizeof(struct vdIn));
 
     /* display the parsed values */
-    IPRINT("Using V4L1 device.: %s\n", dev);
+    IPRINT("Using V4L2 device.: %s\n", dev);
     IPRINT("Desired Resolution: %i x %i\n", width, height);
+    IPRINT("Frames Per Second.: %i\n", fps);
+    IPRINT("Buffers...........: %s\n", (memory == V4L2_MEMORY_USERPTR) ? "user pointer" : "mmap");
+    IPRINT("Format............: %c%c%c%c\n", format & 0xff, (format >> 8) & 0xff, (format >> 16) & 0xff, (format >> 24) & 0xff);
+    if(encode[id] != 0)
+        IPRINT("JPEG Quality......: %d\n", quality[id]);
 
     /* open video device and prepare data structure */
-    if(init_videoIn(videoIn, dev, width, height, format, 1) != 0) {
+    if(init_videoIn(cams[id].videoIn, dev, width, height, fps, format, 1, pglobal, id) < 0) {
         IPRINT("init_VideoIn failed\n");
-        closelog();
-        exit(EXIT_FAILURE);
+        goto failed;
     }
 
+    enumerateControls(cams[id].videoIn, pglobal, id);
+
     return 0;
+
+    /* a camera that fails must not take down the others, the slot can be loaded again */
+failed:
+    free(cams[id].encoder);
+    cams[id].encoder = NULL;
+    free(cams[id].videoIn);
+    cams[id].videoIn = NULL;
+    release_cams(param->global->inmax);
+    return 1;
 }
 
 /******************************************************************************
-Description.: Stops the execution of worker thread
+Description.: Stops the execution of worker thread, a camera that was loaded
+              but never run only closes its device
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the thread finished, -1 if it did not in time
 ******************************************************************************/
 int input_stop(int id)
 {
-    DBG("will cancel input thread\n");
-    pthread_cancel(cam);
+    struct timespec deadline;
+
+    if(cams[id].stop_fd < 0) {
+        cam_cleanup(&cams[id]);
+        return 0;
+    }
+
+    DBG("will stop camera thread #%02d\n", id);
+    stop_deadline(&deadline);
+    stop_event_set(cams[id].stop_fd);
+
+    if(join_thread(cams[id].threadID, &deadline) != 0) {
+        IPRINT("camera thread #%02d did not finish in time\n", id);
+        return -1;
+    }
 
+    cam_cleanup(&cams[id]);
     return 0;
 }
 
 /******************************************************************************
 Description.: spins of a worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the thread runs, 1 if it could not be started, the camera
+              is closed then
 ******************************************************************************/
 int input_run(int id)
 {
-    pglobal->in[id].buf = malloc(videoIn->framesizeIn);
+    cams[id].stop_fd = -1;
+    pglobal->in[id].buf = malloc(cams[id].videoIn->framesizeIn);
     if(pglobal->in[id].buf == NULL) {
         fprintf(stderr, "could not allocate memory\n");
-        exit(EXIT_FAILURE);
+        cam_cleanup(&cams[id]);
+        return 1;
     }
 
-    pthread_create(&cam, 0, cam_thread, NULL);
-    pthread_detach(cam);
+    if((cams[id].stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        cam_cleanup(&cams[id]);
+        return 1;
+    }
+
+    DBG("launching camera thread #%02d\n", id);
+    if(pthread_create(&cams[id].threadID, NULL, cam_thread, &cams[id]) != 0) {
+        IPRINT("could not start the camera thread\n");
+        cam_cleanup(&cams[id]);
+        return 1;
+    }
 
     return 0;
 }
 
 /******************************************************************************
-Description.: process commands, allows to set certain runtime configurations
-              and settings like pan/tilt, colors, saturation etc.
-Input Value.: * cmd specifies the command, a complete list is maintained in
-                the file "input.h"
-              * value is used for commands that make use of a parameter.
+Description.: process commands, allows to set v4l2 controls
+Input Value.: * control specifies the selected v4l2 control's id
+                see struct v4l2_queryctr in the videodev2.h
+              * value is used for control that make use of a parameter.
 Return Value: depends in the command, for most cases 0 means no errors and
               -1 signals an error. This is just rule of thumb, not more!
 ******************************************************************************/
 int input_cmd(int plugin, unsigned int control_id, unsigned int group, int value)
 {
-    DBG("Command interface is not implemented for the %s\n", INPUT_PLUGIN_NAME);
-    return 0;
+    int ret = -1;
+
+    DBG("Requested cmd (id: %d) for the %d plugin. Group: %d value: %d\n", control_id, plugin, group, value);
+    switch(group) {
+    case IN_CMD_V4L2:
+        ret = v4l2SetControl(cams[plugin].videoIn, control_id, value, plugin, pglobal);
+        if(ret != 0) {
+            DBG("v4l2SetControl failed: %d\n", ret);
+        }
+        break;
+    default:
+        DBG("Command group %d is not implemented for the %s\n", group, INPUT_PLUGIN_NAME);
+        break;
+    }
+    return ret;
 }
 
 /*** private functions for this plugin below ***/
@@ -313,77 +443,126 @@ void help(void)
             fprintf(stderr, "\n                          ");
     }
     fprintf(stderr, "\n");
-    fprintf(stderr, " ---------------------------------------------------------------\n\n");
+    fprintf(stderr, " [-q | --quality ]......: JPEG compression quality in percent of the\n" \
+    "                          formats other than 'jpg' and 'mjpg'\n" \
+    " [--fps ]...............: frames per second\n" \
+    " [-u | --userptr ]......: let the driver write into buffers of the plugin\n" \
+    "                          instead of mapping its own, which may be uncached\n" \
+    " ---------------------------------------------------------------\n\n");
 }
 
 /******************************************************************************
 Description.: this thread worker grabs a frame and copies it to the global buffer
-Input Value.: unused
+Input Value.: context of the camera
 Return Value: unused, always NULL
 ******************************************************************************/
 void *cam_thread(void *arg)
 {
-    int iframe = 0;
-    unsigned char *pictureData = NULL;
-    struct frame_t *headerframe;
-
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(cam_cleanup, NULL);
+    context *pcontext = arg;
+    struct vdIn *vd = pcontext->videoIn;
+    int id = pcontext->id, ret;
 
     while(!pglobal->stop) {
+        /* wait for the next frame, but not past a stop request */
+        if(stop_event_poll(pcontext->stop_fd, vd->fd, POLLIN) != 0)
+            break;
 
-        /* grab a frame */
-        if(v4lGrab(videoIn) < 0) {
+        /* grab a frame, it is read straight from the driver's buffer */
+        ret = uvcGrabBuffer(vd);
+        if(ret < 0) {
             IPRINT("Error grabbing frames\n");
-            exit(EXIT_FAILURE);
+            break;
         }
-
-        iframe = (videoIn->frame_cour + (OUTFRMNUMB - 1)) % OUTFRMNUMB;
-        videoIn->framelock[iframe]++;
-        headerframe = (struct frame_t*)videoIn->ptframe[iframe];
-        pictureData = videoIn->ptframe[iframe] + sizeof(struct frame_t);
-        videoIn->framelock[iframe]--;
+        if(ret > 0)
+            continue;
 
         /* copy JPG picture to global buffer */
-        pthread_mutex_lock(&pglobal->in[plugin_number].db);
+        pthread_mutex_lock(&pglobal->in[id].db);
+
+        if(pcontext->encoder != NULL) {
+            /* the encode stage for cameras without JPEG compression */
+            pglobal->in[id].size = encode_image_ctx(pcontext->encoder, vd->frame,
+                                   pglobal->in[id].buf, vd->framesizeIn,
+                                   encoder_quality_factor(quality[id]), encode[id],
+                                   vd->width, vd->height);
+        } else {
+            pglobal->in[id].size = memcpy_picture(pglobal->in[id].buf, vd->frame, vd->buf.bytesused);
+        }
+
+        if(pglobal->in[id].size == 0) {
+            DBG("dropping frame, it might not fit into the buffer\n");
+            pthread_mutex_unlock(&pglobal->in[id].db);
+        } else {
+            /* copy this frame's timestamp to user space */
+            pglobal->in[id].timestamp = vd->buf.timestamp;
 
-        pglobal->in[plugin_number].size = get_jpegsize(pictureData, headerframe->size);
-        memcpy(pglobal->in[plugin_number].buf, pictureData, pglobal->in[plugin_number].size);
+            /* signal fresh_frame */
+            pthread_cond_broadcast(&pglobal->in[id].db_update);
+            pthread_mutex_unlock(&pglobal->in[id].db);
+        }
 
-        /* signal fresh_frame */
-        pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
-        pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+        /* the driver can fill the buffer again */
+        if(uvcReleaseBuffer(vd) < 0) {
+            IPRINT("Error grabbing frames\n");
+            break;
+        }
     }
 
-    DBG("leaving input thread, calling cleanup function now\n");
-    pthread_cleanup_pop(1);
+    /* a camera that failed leaves the others running, stopping its slot releases it */
+    if(!pglobal->stop && !stop_event_wait(pcontext->stop_fd, 0))
+        IPRINT("camera #%02d stopped capturing\n", pcontext->id);
+
+    DBG("leaving input thread\n");
 
     return NULL;
 }
 
 /******************************************************************************
-Description.:
-Input Value.:
-Return Value:
+Description.: free the ressources of a camera after its thread finished
+Input Value.: context of the camera
+Return Value: -
 ******************************************************************************/
 void cam_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
+    context *pcontext = arg;
 
-    first_run = 0;
     IPRINT("cleaning up ressources allocated by input thread\n");
 
-    close_v4l(videoIn);
-    //if (videoIn->tmpbuffer != NULL) free(videoIn->tmpbuffer);
-    if(videoIn != NULL) free(videoIn);
-    if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
-}
+    close(pcontext->stop_fd);
+    pcontext->stop_fd = -1;
 
+    close_v4l2(pcontext->videoIn);
+    free(pcontext->videoIn);
+    pcontext->videoIn = NULL;
+    free(pcontext->encoder);
+    pcontext->encoder = NULL;
+
+    pthread_mutex_lock(&pglobal->in[pcontext->id].db);
+    free(pglobal->in[pcontext->id].buf);
+    pglobal->in[pcontext->id].buf = NULL;
+    pthread_mutex_unlock(&pglobal->in[pcontext->id].db);
+
+    release_cams(pglobal->inmax);
+}
 
+/******************************************************************************
+Description.: free the tables of the cameras once none is left, the plugin may
+              be unloaded then
+Input Value.: number of entries of the tables
+Return Value: -
+******************************************************************************/
+static void release_cams(int count)
+{
+    int i;
 
+    for(i = 0; i < count; i++) {
+        if(cams[i].videoIn != NULL)
+            return;
+    }
 
+    free(cams);
+    free(encode);
+    free(quality);
+    cams = NULL;
+    encode = quality = NULL;
+}
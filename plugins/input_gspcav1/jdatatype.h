@@ -7,6 +7,24 @@
 #define INT8 char
 #define UINT32 unsigned int
 #define INT32 int
+#define UINT64 unsigned long long
+
+/*
+ * eight values of a block that are processed at once, with SSE2, AVX2 or NEON
+ * where the compiler has them and with scalar code elsewhere
+ */
+typedef INT16 V8INT16 __attribute__((vector_size(16)));
+typedef UINT16 V8UINT16 __attribute__((vector_size(16)));
+typedef INT32 V8INT32 __attribute__((vector_size(32)));
+/* the bytes of eight INT32 */
+typedef UINT8 V32UINT8 __attribute__((vector_size(32)));
+
+/* functions marked with this get an AVX2 version, selected when the program is loaded */
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
 
 
 #endif
@@ -28,7 +28,7 @@
 #include "marker.h"
 
 // Header for JPEG Encoder
-static UINT16 markerdata[] = {
+static const UINT16 markerdata[] = {
     // dht
     0xFFC4, 0x1A2, 0x00,
     // luminance dc (2 - 16) + 1
@@ -66,8 +66,9 @@ static UINT16 markerdata[] = {
     0xE2E3, 0xE4E5, 0xE6E7, 0xE8E9, 0xEAF2, 0xF3F4, 0xF5F6, 0xF7F8, 0xF9FA
 };
 
-UINT8 * write_markers(UINT8 * output_ptr, UINT32 image_format,
-                      UINT32 image_width, UINT32 image_height)
+UINT8 * write_markers(JPEG_ENCODER_STRUCTURE * jpeg, UINT8 * output_ptr,
+                      UINT32 image_format, UINT32 image_width,
+                      UINT32 image_height)
 {
     UINT16 i, header_length;
     UINT8 number_of_components;
@@ -89,14 +90,14 @@ UINT8 * write_markers(UINT8 * output_ptr, UINT32 image_format,
 
     // Lqt table
     for(i = 0; i < 64; i++)
-        *output_ptr++ = Lqt[i];
+        *output_ptr++ = jpeg->Lqt[i];
 
     // Pq, Tq
     *output_ptr++ = 0x01;
 
     // Cqt table
     for(i = 0; i < 64; i++)
-        *output_ptr++ = Cqt[i];
+        *output_ptr++ = jpeg->Cqt[i];
 
     // huffman table(DHT)
     for(i = 0; i < 210; i++)
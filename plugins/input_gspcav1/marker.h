@@ -25,7 +25,8 @@
 
 #ifndef MARKER_H
 #define MARKER_H
-UINT8 * write_markers(UINT8 * output_ptr, UINT32 image_format,
-                      UINT32 image_width, UINT32 image_height);
+UINT8 * write_markers(JPEG_ENCODER_STRUCTURE * jpeg, UINT8 * output_ptr,
+                      UINT32 image_format, UINT32 image_width,
+                      UINT32 image_height);
 
 #endif  /*MARKER_H*/
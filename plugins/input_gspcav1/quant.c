@@ -23,16 +23,29 @@
 #***************************************************************************/
 
 
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "jdatatype.h"
-#include "quant.h"
 #include "encoder.h"
-static UINT8 zigzag_table[] = {
+#include "quant.h"
+static const UINT8 zigzag_table[] = {
     0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42, 3, 8, 12, 17,
     25, 30, 41, 43, 9, 11, 18, 24, 31, 40, 44, 53, 10, 19, 23, 32, 39, 45, 52,
     54, 20, 22, 33, 38, 46, 51, 55, 60, 21, 34, 37, 47, 50, 56, 59, 61, 35, 36,
     48, 49, 57, 58, 62, 63
 };
 
+/* the coefficient of the block at each position of the zigzag order */
+static const UINT8 natural_order[] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33,
+    40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43,
+    36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53,
+    60, 61, 54, 47, 55, 62, 63
+};
+
 
 /*  This function implements 16 Step division for Q.15 format data */
 UINT16 DSP_Division(UINT32 numer, UINT32 denom)
@@ -59,17 +72,18 @@ UINT16 DSP_Division(UINT32 numer, UINT32 denom)
 
 /* Multiply Quantization table with quality factor to get LQT and CQT */
 void
-initialize_quantization_tables(UINT32 quality_factor)
+initialize_quantization_tables(JPEG_ENCODER_STRUCTURE * jpeg,
+                               UINT32 quality_factor)
 {
     UINT16 i, index;
     UINT32 value;
-    UINT8 luminance_quant_table[] = {
+    static const UINT8 luminance_quant_table[] = {
         16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13,
         16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37,
         56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78,
         87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99
     };
-    UINT8 chrominance_quant_table[] = {
+    static const UINT8 chrominance_quant_table[] = {
         17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26,
         56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99,
         99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
@@ -88,8 +102,8 @@ initialize_quantization_tables(UINT32 quality_factor)
 
         else if(value > 255)
             value = 255;
-        Lqt[index] = (UINT8) value;
-        ILqt[i] = DSP_Division(0x8000, value);
+        jpeg->Lqt[index] = (UINT8) value;
+        jpeg->ILqt[i] = DSP_Division(0x8000, value);
 
         /* chrominance quantization table * quality factor */
         value = chrominance_quant_table[i] * quality_factor;
@@ -99,15 +113,16 @@ initialize_quantization_tables(UINT32 quality_factor)
 
         else if(value > 255)
             value = 255;
-        Cqt[index] = (UINT8) value;
-        ICqt[i] = DSP_Division(0x8000, value);
+        jpeg->Cqt[index] = (UINT8) value;
+        jpeg->ICqt[i] = DSP_Division(0x8000, value);
     }
 }
 
 
 /* multiply DCT Coefficients with Quantization table and store in ZigZag location */
 void
-quantization(INT16 * const data, UINT16 * const quant_table_ptr)
+quantization(JPEG_ENCODER_STRUCTURE * jpeg, INT16 * const data,
+             UINT16 * const quant_table_ptr)
 {
     INT16 i;
     INT32 value;
@@ -116,8 +131,56 @@ quantization(INT16 * const data, UINT16 * const quant_table_ptr)
     {
         value = data[i] * quant_table_ptr[i];
         value = (value + 0x4000) >> 15;
-        Temp[zigzag_table[i]] = (INT16) value;
+        jpeg->Temp[zigzag_table[i]] = (INT16) value;
     }
 }
 
+/* the same as quantization, for eight coefficients at once, the block is
+   gathered in zigzag order afterwards, that is faster than storing the
+   lanes one by one */
+SIMD_CLONES void
+quantization_vector(JPEG_ENCODER_STRUCTURE * jpeg, INT16 * const data,
+                    UINT16 * const quant_table_ptr)
+{
+    INT16 quantized[BLOCK_SIZE] __attribute__((aligned(16)));
+    INT16 i;
+#ifdef __SSE2__
+    const __m128i round = _mm_set1_epi32(0x4000);
+    __m128i coefficients, quant, low, high;
+    for(i = 0; i < 64; i += 8)
+
+    {
+        coefficients = _mm_loadu_si128((const __m128i *)(data + i));
+        quant = _mm_loadu_si128((const __m128i *)(quant_table_ptr + i));
+
+        /* the halves of the 32 bit products, the unsigned high half is
+           corrected for the negative coefficients */
+        low = _mm_mullo_epi16(coefficients, quant);
+        high = _mm_sub_epi16(_mm_mulhi_epu16(coefficients, quant),
+                             _mm_and_si128(_mm_srai_epi16(coefficients, 15), quant));
+        _mm_store_si128((__m128i *)(quantized + i),
+                        _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low, high), round), 15),
+                                        _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low, high), round), 15)));
+    }
+#else
+    V8INT16 coefficients;
+    V8UINT16 quant;
+    V8INT32 value;
+    for(i = 0; i < 64; i += 8)
+
+    {
+        memcpy(&coefficients, data + i, sizeof(coefficients));
+        memcpy(&quant, quant_table_ptr + i, sizeof(quant));
+        value = __builtin_convertvector(coefficients, V8INT32) *
+                __builtin_convertvector(quant, V8INT32);
+        value = (value + 0x4000) >> 15;
+        coefficients = __builtin_convertvector(value, V8INT16);
+        memcpy(quantized + i, &coefficients, sizeof(coefficients));
+    }
+#endif
+#pragma GCC unroll 64
+    for(i = 0; i < 64; i++)
+        jpeg->Temp[i] = quantized[natural_order[i]];
+}
+
 
@@ -24,7 +24,8 @@
 
 #ifndef QUANT_H
 #define QUANT_H
-void initialize_quantization_tables(UINT32);
-void quantization(INT16 *, UINT16 *);
+void initialize_quantization_tables(JPEG_ENCODER_STRUCTURE *, UINT32);
+void quantization(JPEG_ENCODER_STRUCTURE *, INT16 *, UINT16 *);
+void quantization_vector(JPEG_ENCODER_STRUCTURE *, INT16 *, UINT16 *);
 UINT16 DSP_Division(UINT32, UINT32);
 #endif
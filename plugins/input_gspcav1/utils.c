@@ -32,7 +32,7 @@
 
 #include "jdatatype.h"
 #include "encoder.h"
-#include <linux/videodev.h>
+#include <sys/time.h>
 #include "jconfig.h"
 
 
@@ -318,6 +318,9 @@ static void setinput __P((struct in *, unsigned char *));
 
 static void idctqtab __P((unsigned char *, PREC *));
 static void idct __P((int *, int *, PREC *, PREC, int));
+static void idct_vector(int *, int *, PREC *, PREC, int);
+static void idctqtab_scaled(unsigned char *, PREC *, int);
+static void idct_scaled(int *, int *, PREC *, PREC, int, int);
 static void scaleidctqtab __P((PREC *, PREC));
 
 /*********************************/
@@ -325,6 +328,8 @@ static void scaleidctqtab __P((PREC *, PREC));
 static void initcol __P((PREC[][64]));
 
 static void col221111 __P((int *, unsigned char *, int));
+static void col221111_vector(int *, unsigned char *, int);
+static void col_scaled(int *, unsigned char *, int, int, int);
 
 /*********************************/
 
@@ -339,21 +344,6 @@ static void col221111 __P((int *, unsigned char *, int));
 #define M_EOI   0xd9
 #define M_COM   0xfe
 
-static unsigned char *datap;
-
-static int getbyte(void)
-{
-    return *datap++;
-}
-
-static int getword(void)
-{
-    int c1, c2;
-    c1 = *datap++;
-    c2 = *datap++;
-    return c1 << 8 | c2;
-}
-
 struct comp {
     int cid;
     int hv;
@@ -369,29 +359,43 @@ struct jpginfo {
     int rm;         /* next restart marker */
 };
 
-static struct jpginfo info;
-static struct comp comps[MAXCOMP];
-
-static struct scan dscans[MAXCOMP];
-
-static unsigned char quant[4][64];
-
-static struct dec_hufftbl dhuff[4];
+/* everything the decoding of one picture changes, instead of globals */
+struct jpeg_decoder {
+    unsigned char *datap;
+    struct jpginfo info;
+    struct comp comps[MAXCOMP];
+    struct scan dscans[MAXCOMP];
+    unsigned char quant[4][64];
+    struct dec_hufftbl dhuff[4];    /* dc tables, then ac tables */
+    struct in in;
+    struct jpeg_decdata decdata;
+    /* the vector or the plain C versions */
+    void (*idct)(int *, int *, PREC *, PREC, int);
+    void (*col221111)(int *, unsigned char *, int);
+};
 
-#define dec_huffdc (dhuff + 0)
-#define dec_huffac (dhuff + 2)
+static int getbyte(struct jpeg_decoder *dec)
+{
+    return *dec->datap++;
+}
 
-static struct in in;
+static int getword(struct jpeg_decoder *dec)
+{
+    int c1, c2;
+    c1 = *dec->datap++;
+    c2 = *dec->datap++;
+    return c1 << 8 | c2;
+}
 
-static int readtables(int till)
+static int readtables(struct jpeg_decoder *dec, int till)
 {
     int m, l, i, j, lq, pq, tq;
     int tc, th, tt;
 
     for(;;) {
-        if(getbyte() != 0xff)
+        if(getbyte(dec) != 0xff)
             return -1;
-        if((m = getbyte()) == till)
+        if((m = getbyte(dec)) == till)
             break;
 
         switch(m) {
@@ -399,9 +403,9 @@ static int readtables(int till)
             return 0;
 
         case M_DQT:
-            lq = getword();
+            lq = getword(dec);
             while(lq > 2) {
-                pq = getbyte();
+                pq = getbyte(dec);
                 tq = pq & 15;
                 if(tq > 3)
                     return -1;
@@ -409,176 +413,216 @@ static int readtables(int till)
                 if(pq != 0)
                     return -1;
                 for(i = 0; i < 64; i++)
-                    quant[tq][i] = getbyte();
+                    dec->quant[tq][i] = getbyte(dec);
                 lq -= 64 + 1;
             }
             break;
 
         case M_DHT:
-            l = getword();
+            l = getword(dec);
             while(l > 2) {
                 int hufflen[16], k;
                 unsigned char huffvals[256];
 
-                tc = getbyte();
+                tc = getbyte(dec);
                 th = tc & 15;
                 tc >>= 4;
                 tt = tc * 2 + th;
                 if(tc > 1 || th > 1)
                     return -1;
                 for(i = 0; i < 16; i++)
-                    hufflen[i] = getbyte();
+                    hufflen[i] = getbyte(dec);
                 l -= 1 + 16;
                 k = 0;
                 for(i = 0; i < 16; i++) {
                     for(j = 0; j < hufflen[i]; j++)
-                        huffvals[k++] = getbyte();
+                        huffvals[k++] = getbyte(dec);
                     l -= hufflen[i];
                 }
-                dec_makehuff(dhuff + tt, hufflen,
+                dec_makehuff(dec->dhuff + tt, hufflen,
                              huffvals);
             }
             break;
 
         case M_DRI:
-            l = getword();
-            info.dri = getword();
+            l = getword(dec);
+            dec->info.dri = getword(dec);
             break;
 
         default:
-            l = getword();
+            l = getword(dec);
             while(l-- > 2)
-                getbyte();
+                getbyte(dec);
             break;
         }
     }
     return 0;
 }
 
-static void dec_initscans(void)
+static void dec_initscans(struct jpeg_decoder *dec)
 {
     int i;
 
-    info.nm = info.dri + 1;
-    info.rm = M_RST0;
-    for(i = 0; i < info.ns; i++)
-        dscans[i].dc = 0;
+    dec->info.nm = dec->info.dri + 1;
+    dec->info.rm = M_RST0;
+    for(i = 0; i < dec->info.ns; i++)
+        dec->dscans[i].dc = 0;
 }
 
-static int dec_checkmarker(void)
+static int dec_checkmarker(struct jpeg_decoder *dec)
 {
     int i;
 
-    if(dec_readmarker(&in) != info.rm)
+    if(dec_readmarker(&dec->in) != dec->info.rm)
         return -1;
-    info.nm = info.dri;
-    info.rm = (info.rm + 1) & ~0x08;
-    for(i = 0; i < info.ns; i++)
-        dscans[i].dc = 0;
+    dec->info.nm = dec->info.dri;
+    dec->info.rm = (dec->info.rm + 1) & ~0x08;
+    for(i = 0; i < dec->info.ns; i++)
+        dec->dscans[i].dc = 0;
     return 0;
 }
 
+jpeg_decoder *jpeg_decoder_new(void)
+{
+    jpeg_decoder *dec = (jpeg_decoder *) calloc(1, sizeof(jpeg_decoder));
+    if(dec) {
+        dec->idct = idct_vector;
+        dec->col221111 = col221111_vector;
+    }
+    return dec;
+}
+
+void jpeg_decoder_free(jpeg_decoder *dec)
+{
+    free(dec);
+}
+
+void jpeg_decoder_use_scalar(jpeg_decoder *dec)
+{
+    dec->idct = idct;
+    dec->col221111 = col221111;
+}
+
 int jpeg_decode(unsigned char **pic, unsigned char *buf, int *width, int *height)
 {
-    struct jpeg_decdata *decdata;
+    jpeg_decoder *dec;
+    int err;
+
+    dec = jpeg_decoder_new();
+    if(!dec)
+        return -1;
+    err = jpeg_decode_ctx(dec, pic, buf, width, height, 1);
+    jpeg_decoder_free(dec);
+    return err;
+}
+
+int jpeg_decode_ctx(jpeg_decoder *dec, unsigned char **pic, unsigned char *buf, int *width, int *height, int scale)
+{
+    struct jpeg_decdata *decdata = &dec->decdata;
+    struct scan *dscans = dec->dscans;
     int i, j, m, tac, tdc;
     int intwidth , intheight;
+    int outwidth, outheight, stride;
     int mcusx, mcusy, mx, my;
     int max[6];
     int err = 0;
-    int enc411 = 1;
-    decdata = (struct jpeg_decdata*)malloc(sizeof(struct jpeg_decdata));
-    if(!decdata) {
+    int n = 8 / scale;  /* pixels of a block in each direction */
+    int vs;             /* luma rows per chroma row */
+    int blocks, b, q;
+    unsigned char *mcu;
+
+    if(buf == NULL) {
         err = -1;
         goto error;
     }
-    if(buf == NULL) {
-        err = -1;
+    if(scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        err = ERR_BAD_SCALE;
         goto error;
     }
-    datap = buf;
-    if(getbyte() != 0xff) {
+    dec->datap = buf;
+    dec->info.dri = 0;
+    if(getbyte(dec) != 0xff) {
         err = ERR_NO_SOI;
         goto error;
     }
-    if(getbyte() != M_SOI) {
+    if(getbyte(dec) != M_SOI) {
         err = ERR_NO_SOI;
         goto error;
     }
-    if(readtables(M_SOF0)) {
+    if(readtables(dec, M_SOF0)) {
         err = ERR_BAD_TABLES;
         goto error;
     }
-    getword();
-    i = getbyte();
+    getword(dec);
+    i = getbyte(dec);
     if(i != 8) {
         err = ERR_NOT_8BIT;
         goto error;
     }
-    intheight = getword();
-    intwidth = getword();
+    intheight = getword(dec);
+    intwidth = getword(dec);
 
     //if ((intheight & 15) || (intwidth & 15)){
     if((intheight & 7) || (intwidth & 15)) {
         err = ERR_BAD_WIDTH_OR_HEIGHT;
         goto error;
     }
-    info.nc = getbyte();
-    if(info.nc > MAXCOMP) {
+    dec->info.nc = getbyte(dec);
+    if(dec->info.nc > MAXCOMP) {
         err = ERR_TOO_MANY_COMPPS;
         goto error;
     }
-    for(i = 0; i < info.nc; i++) {
+    for(i = 0; i < dec->info.nc; i++) {
         int h, v;
-        comps[i].cid = getbyte();
-        comps[i].hv = getbyte();
-        v = comps[i].hv & 15;
-        h = comps[i].hv >> 4;
-        comps[i].tq = getbyte();
+        dec->comps[i].cid = getbyte(dec);
+        dec->comps[i].hv = getbyte(dec);
+        v = dec->comps[i].hv & 15;
+        h = dec->comps[i].hv >> 4;
+        dec->comps[i].tq = getbyte(dec);
         if(h > 3 || v > 3) {
             err = ERR_ILLEGAL_HV;
             goto error;
         }
-        if(comps[i].tq > 3) {
+        if(dec->comps[i].tq > 3) {
             err = ERR_QUANT_TABLE_SELECTOR;
             goto error;
         }
     }
-    if(readtables(M_SOS)) {
+    if(readtables(dec, M_SOS)) {
         err = ERR_BAD_TABLES;
         goto error;
     }
-    getword();
-    info.ns = getbyte();
-    if(info.ns != 3) {
+    getword(dec);
+    dec->info.ns = getbyte(dec);
+    if(dec->info.ns != 3) {
         err = ERR_NOT_YCBCR_221111;
         goto error;
     }
     for(i = 0; i < 3; i++) {
-        dscans[i].cid = getbyte();
-        tdc = getbyte();
+        dscans[i].cid = getbyte(dec);
+        tdc = getbyte(dec);
         tac = tdc & 15;
         tdc >>= 4;
         if(tdc > 1 || tac > 1) {
             err = ERR_QUANT_TABLE_SELECTOR;
             goto error;
         }
-        for(j = 0; j < info.nc; j++)
-            if(comps[j].cid == dscans[i].cid)
+        for(j = 0; j < dec->info.nc; j++)
+            if(dec->comps[j].cid == dscans[i].cid)
                 break;
-        if(j == info.nc) {
+        if(j == dec->info.nc) {
             err = ERR_UNKNOWN_CID_IN_SCAN;
             goto error;
         }
-        dscans[i].hv = comps[j].hv;
-        dscans[i].tq = comps[j].tq;
-        dscans[i].hudc.dhuff = dec_huffdc + tdc;
-        dscans[i].huac.dhuff = dec_huffac + tac;
+        dscans[i].hv = dec->comps[j].hv;
+        dscans[i].tq = dec->comps[j].tq;
+        dscans[i].hudc.dhuff = dec->dhuff + tdc;
+        dscans[i].huac.dhuff = dec->dhuff + 2 + tac;
     }
 
-    i = getbyte();
-    j = getbyte();
-    m = getbyte();
+    i = getbyte(dec);
+    j = getbyte(dec);
+    m = getbyte(dec);
 
     if(i != 0 || j != 63 || m != 0) {
         err = ERR_NOT_SEQUENTIAL_DCT;
@@ -594,26 +638,18 @@ int jpeg_decode(unsigned char **pic, unsigned char *buf, int *width, int *height
         err = ERR_NOT_YCBCR_221111;
         goto error;
     }
-    /* if internal width and external are not the same or heigth too
-    and pic not allocated realloc the good size and mark the change
-    need 1 macroblock line more ?? */
-    if(intwidth != *width || intheight != *height || *pic == NULL) {
-        *width = intwidth;
-        *height = intheight;
-        *pic = (unsigned char *) realloc((unsigned char*) * pic, (size_t) intwidth * (intheight + 8) * 3);
-    }
-
 
     switch(dscans[0].hv) {
     case 0x22:
-        mcusx = *width >> 4;
-        mcusy = *height >> 4;
-        enc411 = 1;
+        /* the last row of MCUs may be half below the picture */
+        mcusx = intwidth >> 4;
+        mcusy = (intheight + 15) >> 4;
+        vs = 2;
         break ;
     case 0x21:
-        mcusx = *width >> 4;
-        mcusy = *height >> 3;
-        enc411 = 0;
+        mcusx = intwidth >> 4;
+        mcusy = intheight >> 3;
+        vs = 1;
         break;
     default:
         err = ERR_NOT_YCBCR_221111;
@@ -621,60 +657,74 @@ int jpeg_decode(unsigned char **pic, unsigned char *buf, int *width, int *height
         break;
     }
 
+    /* if internal width and external are not the same or heigth too
+    and pic not allocated realloc the good size and mark the change
+    one row of blocks more for the MCUs below the picture */
+    outwidth = intwidth / scale;
+    outheight = intheight / scale;
+    if(outwidth != *width || outheight != *height || *pic == NULL) {
+        *width = outwidth;
+        *height = outheight;
+        *pic = (unsigned char *) realloc((unsigned char*) * pic, (size_t) outwidth * (outheight + n) * 3);
+        if(*pic == NULL) {
+            err = -1;
+            goto error;
+        }
+    }
+    stride = outwidth * 3;
 
-    idctqtab(quant[dscans[0].tq], decdata->dquant[0]);
-    idctqtab(quant[dscans[1].tq], decdata->dquant[1]);
-    idctqtab(quant[dscans[2].tq], decdata->dquant[2]);
+    for(i = 0; i < 3; i++) {
+        if(scale == 1)
+            idctqtab(dec->quant[dscans[i].tq], decdata->dquant[i]);
+        else
+            idctqtab_scaled(dec->quant[dscans[i].tq], decdata->dquant[i], n);
+    }
     initcol(decdata->dquant);
-    setinput(&in, datap);
+    setinput(&dec->in, dec->datap);
 
 
-    dec_initscans();
+    dec_initscans(dec);
 
-    dscans[0].next = 6 - 4;
-    dscans[1].next = 6 - 4 - 1;
-    dscans[2].next = 6 - 4 - 1 - 1; /* 411 encoding */
+    /* 2 or 4 luma blocks, then one of each chroma */
+    blocks = 2 * vs + 2;
+    dscans[0].next = blocks - 2 * vs;
+    dscans[1].next = blocks - 2 * vs - 1;
+    dscans[2].next = blocks - 2 * vs - 1 - 1;
     for(my = 0; my < mcusy; my++) {
         for(mx = 0; mx < mcusx; mx++) {
-            if(info.dri && !--info.nm)
-                if(dec_checkmarker()) {
+            if(dec->info.dri && !--dec->info.nm)
+                if(dec_checkmarker(dec)) {
                     err = ERR_WRONG_MARKER;
                     goto error;
                 }
-            if(enc411) {
-                decode_mcus(&in, decdata->dcts, 6, dscans, max);
-                idct(decdata->dcts, decdata->out, decdata->dquant[0], IFIX(128.5), max[0]);
-                idct(decdata->dcts + 64, decdata->out + 64, decdata->dquant[0], IFIX(128.5), max[1]);
-                idct(decdata->dcts + 128, decdata->out + 128, decdata->dquant[0], IFIX(128.5), max[2]);
-                idct(decdata->dcts + 192, decdata->out + 192, decdata->dquant[0], IFIX(128.5), max[3]);
-                idct(decdata->dcts + 256, decdata->out + 256, decdata->dquant[1], IFIX(0.5), max[4]);
-                idct(decdata->dcts + 320, decdata->out + 320, decdata->dquant[2], IFIX(0.5), max[5]);
-
-                col221111(decdata->out, *pic + (my * 16 * mcusx + mx) * 16 * 3, mcusx * 16 * 3);
-            } else {
-                decode_mcus(&in, decdata->dcts, 4, dscans, max);
-                idct(decdata->dcts, decdata->out, decdata->dquant[0], IFIX(128.5), max[0]);
-                idct(decdata->dcts + 64, decdata->out + 64, decdata->dquant[0], IFIX(128.5), max[1]);
-                idct(decdata->dcts + 128, decdata->out + 256, decdata->dquant[1], IFIX(0.5), max[4]);
-                idct(decdata->dcts + 192, decdata->out + 320, decdata->dquant[2], IFIX(0.5), max[5]);
-
-                col221111(decdata->out, *pic + (my * 8 * mcusx + mx) * 16 * 3, mcusx * 16 * 3);
+            decode_mcus(&dec->in, decdata->dcts, blocks, dscans, max);
+            /* out holds 4 luma blocks, then cb and cr */
+            for(i = 0; i < blocks; i++) {
+                b = (i < 2 * vs) ? i : i - 2 * vs + 4;
+                q = (i < 2 * vs) ? 0 : i - 2 * vs + 1;
+                if(scale == 1)
+                    dec->idct(decdata->dcts + 64 * i, decdata->out + 64 * b, decdata->dquant[q],
+                              q ? IFIX(0.5) : IFIX(128.5), max[i]);
+                else
+                    idct_scaled(decdata->dcts + 64 * i, decdata->out + n * n * b, decdata->dquant[q],
+                                q ? IFIX(0.5) : IFIX(128.5), n, max[i]);
             }
 
+            mcu = *pic + my * vs * n * stride + mx * 2 * n * 3;
+            if(scale == 1 && vs == 2)
+                dec->col221111(decdata->out, mcu, stride);
+            else
+                col_scaled(decdata->out, mcu, stride, n, vs);
         }
     }
 
-    m = dec_readmarker(&in);
+    m = dec_readmarker(&dec->in);
     if(m != M_EOI) {
         err = ERR_NO_EOI;
         goto error;
     }
-    if(decdata)
-        free(decdata);
     return 0;
 error:
-    if(decdata)
-        free(decdata);
     return err;
 }
 
@@ -808,6 +858,25 @@ int c, i;
                                     )                   \
                                  )
 
+/*
+ * position of the zigzag coefficients in the blocks decode_mcus fills: the
+ * natural order with the rows and columns in the order t0 .. t7 of IDCT take
+ * the frequencies, so each of them loads a row. A run too long for the block
+ * goes on into the next one as it always did
+ */
+static const unsigned char zig2idct[64 + 16] = {
+    0, 5, 40, 16, 45, 2, 7, 42,
+    21, 56, 8, 61, 18, 47, 1, 4,
+    41, 23, 58, 13, 32, 24, 37, 10,
+    63, 17, 44, 3, 6, 43, 20, 57,
+    15, 34, 29, 48, 53, 26, 39, 9,
+    60, 19, 46, 22, 59, 12, 33, 31,
+    50, 55, 25, 36, 11, 62, 14, 35,
+    28, 49, 52, 27, 38, 30, 51, 54,
+    64, 65, 66, 67, 68, 69, 70, 71,
+    72, 73, 74, 75, 76, 77, 78, 79
+};
+
 static void decode_mcus(in, dct, n, sc, maxp)
 struct in *in;
 int *dct;
@@ -823,20 +892,19 @@ int *maxp;
     LEBI_GET(in);
     while(n-- > 0) {
         hu = sc->hudc.dhuff;
-        *dct++ = (sc->dc += DEC_REC(in, hu, r, t));
+        dct[0] = (sc->dc += DEC_REC(in, hu, r, t));
 
         hu = sc->huac.dhuff;
         i = 63;
         while(i > 0) {
             t = DEC_REC(in, hu, r, t);
-            if(t == 0 && r == 0) {
-                dct += i;
+            if(t == 0 && r == 0)
                 break;
-            }
-            dct += r;
-            *dct++ = t;
-            i -= r + 1;
+            i -= r;
+            dct[zig2idct[64 - i]] = t;
+            i--;
         }
+        dct += 64;
         *maxp++ = 64 - i;
         if(n == sc->next)
             sc++;
@@ -940,16 +1008,8 @@ unsigned char *huffvals;
                 XPP(t3, t4)       \
     )
 
-static unsigned char zig2[64] = {
-    0, 2, 3, 9, 10, 20, 21, 35,
-    14, 16, 25, 31, 39, 46, 50, 57,
-    5, 7, 12, 18, 23, 33, 37, 48,
-    27, 29, 41, 44, 52, 55, 59, 62,
-    15, 26, 30, 40, 45, 51, 56, 58,
-    1, 4, 8, 11, 19, 22, 34, 36,
-    28, 42, 43, 53, 54, 60, 61, 63,
-    6, 13, 17, 24, 32, 38, 47, 49
-};
+/* the frequency u of a block is t<idct_t[u]> of IDCT */
+static const unsigned char idct_t[8] = {0, 5, 2, 7, 1, 4, 3, 6};
 
 void idct(in, out, quant, off, max)
 int *in;
@@ -960,8 +1020,7 @@ int max;
 {
     PREC t0, t1, t2, t3, t4, t5, t6, t7, t;
     PREC tmp[64], *tmpp;
-    int i, j;
-    unsigned char *zig2p;
+    int i;
 
     t0 = off;
     if(max == 1) {
@@ -970,25 +1029,16 @@ int max;
             out[i] = ITOINT(t0);
         return;
     }
-    zig2p = zig2;
     tmpp = tmp;
     for(i = 0; i < 8; i++) {
-        j = *zig2p++;
-        t0 += in[j] * quant[j];
-        j = *zig2p++;
-        t5 = in[j] * quant[j];
-        j = *zig2p++;
-        t2 = in[j] * quant[j];
-        j = *zig2p++;
-        t7 = in[j] * quant[j];
-        j = *zig2p++;
-        t1 = in[j] * quant[j];
-        j = *zig2p++;
-        t4 = in[j] * quant[j];
-        j = *zig2p++;
-        t3 = in[j] * quant[j];
-        j = *zig2p++;
-        t6 = in[j] * quant[j];
+        t0 += in[0 * 8 + i] * quant[0 * 8 + i];
+        t1 = in[1 * 8 + i] * quant[1 * 8 + i];
+        t2 = in[2 * 8 + i] * quant[2 * 8 + i];
+        t3 = in[3 * 8 + i] * quant[3 * 8 + i];
+        t4 = in[4 * 8 + i] * quant[4 * 8 + i];
+        t5 = in[5 * 8 + i] * quant[5 * 8 + i];
+        t6 = in[6 * 8 + i] * quant[6 * 8 + i];
+        t7 = in[7 * 8 + i] * quant[7 * 8 + i];
         IDCT;
         tmpp[0 * 8] = t0;
         tmpp[1 * 8] = t1;
@@ -1033,6 +1083,141 @@ static unsigned char zig[64] = {
     35, 36, 48, 49, 57, 58, 62, 63
 };
 
+/* transpose the 8 rows of a block, so that row i holds column i */
+static inline void transpose_int(V8INT32 *row)
+{
+    /* the shuffles stay in the halves of 128 bit until the last step */
+    static const V8INT32 lo32 = {0, 8, 1, 9, 4, 12, 5, 13};
+    static const V8INT32 hi32 = {2, 10, 3, 11, 6, 14, 7, 15};
+    static const V8INT32 lo64 = {0, 1, 8, 9, 4, 5, 12, 13};
+    static const V8INT32 hi64 = {2, 3, 10, 11, 6, 7, 14, 15};
+    static const V8INT32 lo128 = {0, 1, 2, 3, 8, 9, 10, 11};
+    static const V8INT32 hi128 = {4, 5, 6, 7, 12, 13, 14, 15};
+    V8INT32 a[8], b[8];
+    int i;
+    for(i = 0; i < 8; i += 2) {
+        a[i] = __builtin_shuffle(row[i], row[i + 1], lo32);
+        a[i + 1] = __builtin_shuffle(row[i], row[i + 1], hi32);
+    }
+    for(i = 0; i < 8; i += 4) {
+        b[i] = __builtin_shuffle(a[i], a[i + 2], lo64);
+        b[i + 1] = __builtin_shuffle(a[i], a[i + 2], hi64);
+        b[i + 2] = __builtin_shuffle(a[i + 1], a[i + 3], lo64);
+        b[i + 3] = __builtin_shuffle(a[i + 1], a[i + 3], hi64);
+    }
+    for(i = 0; i < 4; i++) {
+        row[i] = __builtin_shuffle(b[i], b[i + 4], lo128);
+        row[i + 4] = __builtin_shuffle(b[i], b[i + 4], hi128);
+    }
+}
+
+/* the same as idct with the 8 runs of each pass at once, IDCT works on
+   vectors as it does on ints, so the result is identical */
+SIMD_CLONES static void idct_vector(int *in, int *out, PREC *quant, PREC off, int max)
+{
+    V8INT32 t0, t1, t2, t3, t4, t5, t6, t7, t;
+    V8INT32 row[8], q[8];
+    int i;
+
+    if(max == 1) {
+        idct(in, out, quant, off, max);
+        return;
+    }
+    memcpy(row, in, sizeof(row));
+    memcpy(q, quant, sizeof(q));
+    for(i = 0; i < 8; i++)
+        row[i] *= q[i];
+    row[0][0] += off;
+
+    t0 = row[0], t1 = row[1], t2 = row[2], t3 = row[3];
+    t4 = row[4], t5 = row[5], t6 = row[6], t7 = row[7];
+    IDCT;
+    row[0] = t0, row[1] = t1, row[2] = t2, row[3] = t3;
+    row[4] = t4, row[5] = t5, row[6] = t6, row[7] = t7;
+
+    /* the second pass works on the rows of the first one */
+    transpose_int(row);
+    t0 = row[0], t1 = row[1], t2 = row[2], t3 = row[3];
+    t4 = row[4], t5 = row[5], t6 = row[6], t7 = row[7];
+    IDCT;
+    row[0] = ITOINT(t0), row[1] = ITOINT(t1), row[2] = ITOINT(t2), row[3] = ITOINT(t3);
+    row[4] = ITOINT(t4), row[5] = ITOINT(t5), row[6] = ITOINT(t6), row[7] = ITOINT(t7);
+    transpose_int(row);
+    memcpy(out, row, sizeof(row));
+}
+
+/*
+ * reduced idct: the n x n lowest frequencies of a block give its n x n
+ * pixels, with the 4 and 2 point versions of the transform, C(u) / 2 is in
+ * the quantization table as the scaling of idct is
+ */
+#define IDCT4       \
+    (           \
+                t = IMULT(a2, C4),        \
+                e = a0 - t,       \
+                a0 += t,      \
+                o0 = IMULT(a1, C2) + IMULT(a3, S2), \
+                o1 = IMULT(a1, S2) - IMULT(a3, C2), \
+                a3 = a0 - o0,     \
+                a0 += o0,     \
+                a1 = e + o1,      \
+                a2 = e - o1       \
+    )
+
+static void idct_scaled(int *in, int *out, PREC *quant, PREC off, int n, int max)
+{
+    PREC a0, a1, a2, a3, e, o0, o1, t;
+    PREC tmp[16];
+    int i, j;
+
+    if(max == 1 || n == 1) {
+        t = ITOINT(off + in[0] * quant[0]);
+        for(i = 0; i < n * n; i++)
+            out[i] = t;
+        return;
+    }
+    if(n == 2) {
+        /* columns, then rows */
+        for(i = 0; i < 2; i++) {
+            j = idct_t[i];
+            a0 = in[j] * quant[j];
+            a1 = IMULT(in[idct_t[1] * 8 + j] * quant[idct_t[1] * 8 + j], C4);
+            tmp[i] = a0 + a1;
+            tmp[2 + i] = a0 - a1;
+        }
+        for(i = 0; i < 2; i++) {
+            a0 = tmp[2 * i] + off;
+            a1 = IMULT(tmp[2 * i + 1], C4);
+            out[2 * i] = ITOINT(a0 + a1);
+            out[2 * i + 1] = ITOINT(a0 - a1);
+        }
+        return;
+    }
+    for(i = 0; i < 4; i++) {
+        j = idct_t[i];
+        a0 = in[idct_t[0] * 8 + j] * quant[idct_t[0] * 8 + j];
+        a1 = in[idct_t[1] * 8 + j] * quant[idct_t[1] * 8 + j];
+        a2 = in[idct_t[2] * 8 + j] * quant[idct_t[2] * 8 + j];
+        a3 = in[idct_t[3] * 8 + j] * quant[idct_t[3] * 8 + j];
+        IDCT4;
+        tmp[0 * 4 + i] = a0;
+        tmp[1 * 4 + i] = a1;
+        tmp[2 * 4 + i] = a2;
+        tmp[3 * 4 + i] = a3;
+    }
+    for(i = 0; i < 4; i++) {
+        a0 = tmp[4 * i + 0] + off;
+        a1 = tmp[4 * i + 1];
+        a2 = tmp[4 * i + 2];
+        a3 = tmp[4 * i + 3];
+        IDCT4;
+        out[4 * i + 0] = ITOINT(a0);
+        out[4 * i + 1] = ITOINT(a1);
+        out[4 * i + 2] = ITOINT(a2);
+        out[4 * i + 3] = ITOINT(a3);
+    }
+}
+
 static PREC aaidct[8] = {
     IFIX(0.3535533906), IFIX(0.4903926402),
     IFIX(0.4619397663), IFIX(0.4157348062),
@@ -1049,7 +1234,7 @@ PREC *qout;
 
     for(i = 0; i < 8; i++)
         for(j = 0; j < 8; j++)
-            qout[zig[i * 8 + j]] = qin[zig[i * 8 + j]] *
+            qout[idct_t[i] * 8 + idct_t[j]] = qin[zig[i * 8 + j]] *
                                    IMULT(aaidct[i], aaidct[j]);
 }
 
@@ -1063,6 +1248,23 @@ PREC sc;
         q[i] = IMULT(q[i], sc);
 }
 
+/* C(u) / 2 */
+static PREC aaidct_scaled[4] = {
+    IFIX(0.3535533906), IFIX(0.5), IFIX(0.5), IFIX(0.5)
+};
+
+/* quantization table of idct_scaled, only the n x n lowest frequencies */
+static void idctqtab_scaled(unsigned char *qin, PREC *qout, int n)
+{
+    int i, j;
+
+    memset(qout, 0, 64 * sizeof(*qout));
+    for(i = 0; i < n; i++)
+        for(j = 0; j < n; j++)
+            qout[idct_t[i] * 8 + idct_t[j]] = qin[zig[i * 8 + j]] *
+                                   IMULT(aaidct_scaled[i], aaidct_scaled[j]);
+}
+
 /****************************************************************/
 /**************          color decoder            ***************/
 /****************************************************************/
@@ -1177,6 +1379,65 @@ int width;
         outy += 64 * 2 - 16 * 4;
     }
 }
+
+/* clamp to 0 .. 255 as STORECLAMP does, what is above 255 becomes -1 first */
+#define CLAMP_VECTOR(x) (x &= ~(x >> 31), x = (x | (V8INT32)(x > 255)) & 255)
+
+/* col221111 with the 8 pixels of a block row at once, the result is the same */
+SIMD_CLONES static void col221111_vector(int *out, unsigned char *pic, int width)
+{
+    static const V8INT32 left = {0, 0, 1, 1, 2, 2, 3, 3};
+    static const V8INT32 right = {4, 4, 5, 5, 6, 6, 7, 7};
+    /* the first three bytes of each pixel */
+    static const V32UINT8 bgr = {
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+        16, 17, 18, 20, 21, 22, 24, 25, 26, 28, 29, 30
+    };
+    V8INT32 y, cb, cr, cg, r, g, b;
+    V32UINT8 pixels;
+    int i, j;
+
+    for(i = 0; i < 16; i++) {
+        memcpy(&cb, out + 64 * 4 + (i >> 1) * 8, sizeof(cb));
+        memcpy(&cr, out + 64 * 5 + (i >> 1) * 8, sizeof(cr));
+        cg = (50 * cb + 130 * cr + 128) >> 8;
+        for(j = 0; j < 2; j++) {
+            memcpy(&y, out + ((i >> 3) * 2 + j) * 64 + (i & 7) * 8, sizeof(y));
+            r = y + __builtin_shuffle(cr, j ? right : left);
+            g = y - __builtin_shuffle(cg, j ? right : left);
+            b = y + __builtin_shuffle(cb, j ? right : left);
+            CLAMP_VECTOR(r);
+            CLAMP_VECTOR(g);
+            CLAMP_VECTOR(b);
+            pixels = __builtin_shuffle((V32UINT8)(b | g << 8 | r << 16), bgr);
+            memcpy(pic + j * 8 * 3, &pixels, 8 * 3);
+        }
+        pic += width;
+    }
+}
+
+/* the same for the reduced blocks of n x n pixels and for 4:2:2, the MCU is
+   2n pixels wide and vs * n high, vs luma rows share a chroma row */
+static void col_scaled(int *out, unsigned char *pic, int width, int n, int vs)
+{
+    int i, j, x;
+    int *outy, *outc;
+    int cr, cg, cb, y;
+
+    for(i = 0; i < vs * n; i++) {
+        outc = out + 4 * n * n + (vs == 2 ? i >> 1 : i) * n;
+        for(j = 0; j < 2; j++) {
+            outy = out + ((i >= n) * 2 + j) * n * n + (i & (n - 1)) * n;
+            for(x = 0; x < n; x++) {
+                cb = outc[(j * n + x) >> 1];
+                cr = outc[n * n + ((j * n + x) >> 1)];
+                cg = (50 * cb + 130 * cr + 128) >> 8;
+                PIC(0, x, pic, j * n + x);
+            }
+        }
+        pic += width;
+    }
+}
 void equalize(unsigned char *src, int width, int height, int format)
 {
     unsigned int histo[256];
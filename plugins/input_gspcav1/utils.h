@@ -42,6 +42,7 @@ typedef enum { PICTURE = 0, AVIPICT, PICTWRD, PICFTP, PICTHTTP} SPCAPICT;
 #define ERR_NO_EOI 13
 #define ERR_BAD_TABLES 14
 #define ERR_DEPTH_MISMATCH 15
+#define ERR_BAD_SCALE 16
 
 typedef short indata;
 typedef struct Myrgb16 {
@@ -80,6 +81,23 @@ If change are detected in size jpeg_decode realloc the needed buffer and
  to avoid memory leak caller did free the pic buffer after used
  */
 int jpeg_decode(unsigned char **pic, unsigned char *buf, int *width, int *height);
+
+/*
+the state of the decoder, every thread that decodes pictures needs its own one
+ */
+typedef struct jpeg_decoder jpeg_decoder;
+jpeg_decoder *jpeg_decoder_new(void);
+void jpeg_decoder_free(jpeg_decoder *dec);
+/* decode with the plain C idct, to compare the vector one with it */
+void jpeg_decoder_use_scalar(jpeg_decoder *dec);
+
+/*
+the same as jpeg_decode with the state in dec, the picture is reduced by scale
+which is 1, 2, 4 or 8 in the DCT domain: only the low frequencies of a block are
+transformed, at 1/8 every block is one pixel of its DC value. width and height
+return the reduced size
+ */
+int jpeg_decode_ctx(jpeg_decoder *dec, unsigned char **pic, unsigned char *buf, int *width, int *height, int scale);
 double ms_time(void);
 /* eqalize the picture only works on yuv420p */
 void equalize(unsigned char *src, int width, int height, int format);
@@ -19,6 +19,17 @@
 # Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
 #                                                                              #
 *******************************************************************************/
+
+/*
+  Besides the pictures compiled into the plugin, this plugin can generate
+  a test pattern of any resolution. All frames are encoded once at startup,
+  publishing a frame is a copy into the global buffer. A COM segment after
+  the SOI marker can carry the sequence number and timestamp of the frame,
+  further COM segments pad the frames to sizes drawn from a range. Frames
+  are paced by absolute deadlines, so the frame rate does not drift with
+  the time it takes to publish them.
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -31,9 +42,12 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <getopt.h>
 #include <pthread.h>
 #include <syslog.h>
+#include <time.h>
+#include <jpeglib.h>
 
 #include "../../mjpg_streamer.h"
 #include "../../utils.h"
@@ -42,8 +56,13 @@
 
 #define INPUT_PLUGIN_NAME "TESTPICTURE input plugin"
 
+/* fixed width, so the segment can be patched in place for every frame */
+#define OVERLAY_TEXT "mjpg-streamer seq=%010u ts=%010ld.%06ld"
+
 /* private functions and variables to this plugin */
 static pthread_t   worker;
+static int         stop_fd = -1;
+static volatile int stopping = 0;
 static globals     *pglobal;
 static pthread_mutex_t controls_mutex;
 static int plugin_number;
@@ -53,11 +72,14 @@ void worker_cleanup(void *);
 void help(void);
 
 static int delay = 1000;
+static int fps = -1, quality = 80, nframes = 8, overlay = 0, overlay_len = 0;
+static int size_min = 0, size_max = 0;
+static int width = 0, height = 0;
 
 /* details of converted JPG pictures */
 struct pic {
     const unsigned char *data;
-    const int size;
+    int size;
 };
 
 /* lookup pictures by resolution */
@@ -74,6 +96,138 @@ static struct pictures {
 
 struct pictures *pics;
 
+/* the frames to publish, either the compiled in or generated pictures */
+static struct pic *frames;
+static int frame_count;
+static int generated = 0;
+
+/******************************************************************************
+Description.: fill one row of the test pattern, color bars that move with
+              the frame number above a gray ramp, with a little noise
+Input Value.: row buffer for width RGB pixels, row and frame number
+Return Value: -
+******************************************************************************/
+static void pattern_row(unsigned char *rgb, int y, int k)
+{
+    static const unsigned char bars[8][3] = {
+        {255, 255, 255}, {255, 255, 0}, {0, 255, 255}, {0, 255, 0},
+        {255, 0, 255}, {255, 0, 0}, {0, 0, 255}, {0, 0, 0}
+    };
+    int x, c, v, shift = (long)k * width / nframes;
+    unsigned int h;
+
+    for(x = 0; x < width; x++) {
+        h = x * 1103515245u + y * 12345u + k * 2654435761u;
+        h ^= h >> 15;
+
+        for(c = 0; c < 3; c++) {
+            if(y < height * 3 / 4)
+                v = bars[((x + shift) % width) * 8 / width][c];
+            else
+                v = (long)x * 255 / width;
+
+            v += (int)(h >> (8 * c) & 7) - 4;
+            rgb[3 * x + c] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+        }
+    }
+}
+
+/******************************************************************************
+Description.: encode the frames of the test pattern
+Input Value.: -
+Return Value: 0 if ok, -1 if there is not enough memory
+******************************************************************************/
+static int generate_frames(void)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    JSAMPROW row;
+    unsigned char *rgb, *out;
+    unsigned long len;
+    int k;
+
+    if((frames = calloc(nframes, sizeof(struct pic))) == NULL ||
+       (rgb = malloc(width * 3)) == NULL)
+        return -1;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    for(k = 0; k < nframes; k++) {
+        out = NULL;
+        len = 0;
+        jpeg_mem_dest(&cinfo, &out, &len);
+
+        cinfo.image_width = width;
+        cinfo.image_height = height;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+
+        jpeg_start_compress(&cinfo, TRUE);
+        row = rgb;
+        while(cinfo.next_scanline < cinfo.image_height) {
+            pattern_row(rgb, cinfo.next_scanline, k);
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+
+        frames[k].data = out;
+        frames[k].size = len;
+    }
+
+    jpeg_destroy_compress(&cinfo);
+    free(rgb);
+
+    frame_count = nframes;
+    generated = 1;
+    return 0;
+}
+
+/******************************************************************************
+Description.: write a frame to the global buffer, with the overlay segment
+              and padded to the requested size
+Input Value.: destination, frame, sequence number, timestamp and target size
+Return Value: size of the frame written
+******************************************************************************/
+static int compose_frame(unsigned char *dst, const struct pic *p, unsigned int seq, const struct timeval *ts, int target)
+{
+    char text[64];
+    unsigned char *d = dst;
+    int pad, seg;
+
+    /* SOI */
+    *d++ = 0xff;
+    *d++ = 0xd8;
+
+    if(overlay) {
+        snprintf(text, sizeof(text), OVERLAY_TEXT, seq, (long)ts->tv_sec, (long)ts->tv_usec);
+        *d++ = 0xff;
+        *d++ = 0xfe;
+        *d++ = (overlay_len + 2) >> 8;
+        *d++ = overlay_len + 2;
+        memcpy(d, text, overlay_len);
+        d += overlay_len;
+    }
+
+    /* a segment holds up to 65533 bytes, the smallest one takes 4 */
+    for(pad = target - (d - dst) - p->size + 2; pad > 0; pad -= seg) {
+        seg = MIN(MAX(pad, 4), 65537);
+        *d++ = 0xff;
+        *d++ = 0xfe;
+        *d++ = (seg - 2) >> 8;
+        *d++ = seg - 2;
+        memset(d, 0, seg - 4);
+        d += seg - 4;
+    }
+
+    memcpy(d, p->data + 2, p->size - 2);
+    d += p->size - 2;
+
+    return d - dst;
+}
+
 /*** plugin interface functions ***/
 
 /******************************************************************************
@@ -86,6 +240,7 @@ int input_init(input_parameter *param, int plugin_no)
     int i;
 
     pics = &picture_lookup[1];
+    plugin_number = plugin_no;
 
     if(pthread_mutex_init(&controls_mutex, NULL) != 0) {
         IPRINT("could not initialize mutex variable\n");
@@ -110,6 +265,16 @@ int input_init(input_parameter *param, int plugin_no)
             {"delay", required_argument, 0, 0},
             {"r", required_argument, 0, 0},
             {"resolution", required_argument, 0, 0},
+            {"f", required_argument, 0, 0},
+            {"fps", required_argument, 0, 0},
+            {"s", required_argument, 0, 0},
+            {"size", required_argument, 0, 0},
+            {"n", required_argument, 0, 0},
+            {"frames", required_argument, 0, 0},
+            {"q", required_argument, 0, 0},
+            {"quality", required_argument, 0, 0},
+            {"o", no_argument, 0, 0},
+            {"overlay", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -144,12 +309,64 @@ int input_init(input_parameter *param, int plugin_no)
         case 4:
         case 5:
             DBG("case 4,5\n");
+            pics = NULL;
             for(i = 0; i < LENGTH_OF(picture_lookup); i++) {
                 if(strcmp(picture_lookup[i].resolution, optarg) == 0) {
                     pics = &picture_lookup[i];
                     break;
                 }
             }
+            if(pics == NULL && (sscanf(optarg, "%dx%d", &width, &height) != 2 ||
+                                width < 16 || height < 16 || width > 8192 || height > 8192)) {
+                IPRINT("resolution %s is not valid\n", optarg);
+                help();
+                return 1;
+            }
+            break;
+
+            /* f, fps */
+        case 6:
+        case 7:
+            DBG("case 6,7\n");
+            fps = atoi(optarg);
+            break;
+
+            /* s, size */
+        case 8:
+        case 9:
+            DBG("case 8,9\n");
+            if(sscanf(optarg, "%d:%d", &size_min, &size_max) < 2)
+                size_max = size_min;
+            if(size_min < 0 || size_max < size_min || size_max > 64 * 1024) {
+                IPRINT("size range %s is not valid\n", optarg);
+                help();
+                return 1;
+            }
+            size_min *= 1024;
+            size_max *= 1024;
+            break;
+
+            /* n, frames */
+        case 10:
+        case 11:
+            DBG("case 10,11\n");
+            nframes = atoi(optarg);
+            if(nframes < 1)
+                nframes = 1;
+            break;
+
+            /* q, quality */
+        case 12:
+        case 13:
+            DBG("case 12,13\n");
+            quality = MIN(MAX(atoi(optarg), 1), 100);
+            break;
+
+            /* o, overlay */
+        case 14:
+        case 15:
+            DBG("case 14,15\n");
+            overlay = 1;
             break;
 
         default:
@@ -161,21 +378,61 @@ int input_init(input_parameter *param, int plugin_no)
 
     pglobal = param->global;
 
-    IPRINT("delay.............: %i\n", delay);
-    IPRINT("resolution........: %s\n", pics->resolution);
+    if(overlay)
+        overlay_len = snprintf(NULL, 0, OVERLAY_TEXT, 0u, 0L, 0L);
+
+    if(pics != NULL) {
+        frames = pics->sequence;
+        frame_count = LENGTH_OF(pics->sequence);
+    } else if(generate_frames() < 0) {
+        IPRINT("could not allocate memory\n");
+        return 1;
+    }
+
+    if(fps >= 0) {
+        IPRINT("frames per second.: %i%s\n", fps, (fps == 0) ? " (as fast as possible)" : "");
+    } else {
+        IPRINT("delay.............: %i\n", delay);
+    }
+    if(pics != NULL) {
+        IPRINT("resolution........: %s\n", pics->resolution);
+    } else {
+        IPRINT("resolution........: %dx%d, %d generated frames, quality %d\n", width, height, nframes, quality);
+    }
+    if(size_max > 0) {
+        IPRINT("frame size........: %d to %d KiB\n", size_min / 1024, size_max / 1024);
+    }
+    IPRINT("overlay...........: %s\n", overlay ? "sequence number and timestamp" : "disabled");
 
     return 0;
 }
 
 /******************************************************************************
-Description.: stops the execution of the worker thread
+Description.: stops the execution of the worker thread, the pictures of an
+              input that was loaded but never run are freed as well
 Input Value.: -
-Return Value: 0
+Return Value: 0 if the thread finished, -1 if it did not in time
 ******************************************************************************/
 int input_stop(int id)
 {
-    DBG("will cancel input thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+
+    if(stop_fd < 0) {
+        worker_cleanup(NULL);
+        return 0;
+    }
+
+    DBG("will stop input thread\n");
+    stop_deadline(&deadline);
+    stopping = 1;
+    stop_event_set(stop_fd);
+
+    if(join_thread(worker, &deadline) != 0) {
+        IPRINT("the input thread did not finish in time\n");
+        return -1;
+    }
+
+    worker_cleanup(NULL);
 
     return 0;
 }
@@ -187,18 +444,31 @@ Return Value: 0
 ******************************************************************************/
 int input_run(int id)
 {
-    pglobal->in[id].buf = malloc(256 * 1024);
+    int i, largest = 0;
+
+    /* the largest frame with all segments added to it */
+    for(i = 0; i < frame_count; i++)
+        largest = MAX(largest, frames[i].size);
+    largest += 4 + overlay_len + size_max + 4;
+
+    pglobal->in[id].buf = malloc(largest);
     if(pglobal->in[id].buf == NULL) {
         fprintf(stderr, "could not allocate memory\n");
         exit(EXIT_FAILURE);
     }
 
+    stopping = 0;
+    if((stop_fd = stop_event_open()) < 0) {
+        free(pglobal->in[id].buf);
+        perror("could not create the stop event");
+        return 1;
+    }
+
     if(pthread_create(&worker, 0, worker_thread, NULL) != 0) {
         free(pglobal->in[id].buf);
         fprintf(stderr, "could not start worker thread\n");
         exit(EXIT_FAILURE);
     }
-    pthread_detach(worker);
 
     return 0;
 }
@@ -215,7 +485,16 @@ void help(void)
     " ---------------------------------------------------------------\n" \
     " The following parameters can be passed to this plugin:\n\n" \
     " [-d | --delay ]........: delay to pause between frames\n" \
-    " [-r | --resolution]....: can be 960x720, 640x480, 320x240, 160x120\n"
+    " [-r | --resolution]....: can be 960x720, 640x480, 320x240, 160x120 for the\n" \
+    "                          compiled in pictures, any other WIDTHxHEIGHT\n" \
+    "                          generates a test pattern\n" \
+    " [-f | --fps ]..........: frames per second instead of the delay,\n" \
+    "                          0 publishes the frames as fast as possible\n" \
+    " [-s | --size ].........: pad the frames to MIN[:MAX] KiB, the size of each\n" \
+    "                          frame is drawn uniformly from that range\n" \
+    " [-n | --frames ].......: number of different frames of the test pattern\n" \
+    " [-q | --quality ]......: JPEG quality of the test pattern\n" \
+    " [-o | --overlay ]......: add a comment with sequence number and timestamp\n" \
     " ---------------------------------------------------------------\n");
 }
 
@@ -227,51 +506,80 @@ Return Value: NULL
 ******************************************************************************/
 void *worker_thread(void *arg)
 {
-    int i = 0;
+    int i = 0, target = 0;
+    unsigned int seq = 0, seed = 1;
+    long long period, late;
+    struct timespec next, now;
+    input *in = &pglobal->in[plugin_number];
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
+    period = (fps > 0) ? 1000000000LL / fps : (fps == 0) ? 0 : delay * 1000000LL;
+    clock_gettime(CLOCK_MONOTONIC, &next);
 
-    while(!pglobal->stop) {
+    while(!pglobal->stop && !stopping) {
+
+        if(size_max > 0)
+            target = size_min + rand_r(&seed) % (size_max - size_min + 1);
 
         /* copy JPG picture to global buffer */
-        pthread_mutex_lock(&pglobal->in[plugin_number].db);
+        pthread_mutex_lock(&in->db);
 
-        i = (i + 1) % LENGTH_OF(pics->sequence);
-        pglobal->in[plugin_number].size = pics->sequence[i].size;
-        memcpy(pglobal->in[plugin_number].buf, pics->sequence[i].data, pglobal->in[plugin_number].size);
+        i = (i + 1) % frame_count;
+        gettimeofday(&in->timestamp, NULL);
+        in->size = compose_frame(in->buf, &frames[i], seq++, &in->timestamp, target);
 
         /* signal fresh_frame */
-        pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
-        pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+        pthread_cond_broadcast(&in->db_update);
+        pthread_mutex_unlock(&in->db);
+
+        if(period == 0)
+            continue;
+
+        next.tv_sec += (next.tv_nsec + period) / 1000000000LL;
+        next.tv_nsec = (next.tv_nsec + period) % 1000000000LL;
 
-        usleep(1000 * delay);
+        /* more than a frame behind, skip the missed deadlines instead of bursting */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        late = (now.tv_sec - next.tv_sec) * 1000000000LL + now.tv_nsec - next.tv_nsec;
+        if(late > period)
+            next = now;
+
+        if(stop_event_wait_until(stop_fd, &next))
+            break;
     }
 
-    IPRINT("leaving input thread, calling cleanup function now\n");
-    pthread_cleanup_pop(1);
+    DBG("leaving input thread\n");
 
     return NULL;
 }
 
 /******************************************************************************
-Description.: this functions cleans up allocated ressources
+Description.: this functions cleans up allocated ressources, the worker thread
+              must have finished
 Input Value.: arg is unused
 Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
+    int i;
 
-    first_run = 0;
     DBG("cleaning up ressources allocated by input thread\n");
 
-    if(pglobal->in[plugin_number].buf != NULL) free(pglobal->in[plugin_number].buf);
+    close(stop_fd);
+    stop_fd = -1;
+
+    pthread_mutex_lock(&pglobal->in[plugin_number].db);
+    free(pglobal->in[plugin_number].buf);
+    pglobal->in[plugin_number].buf = NULL;
+    pglobal->in[plugin_number].size = 0;
+    pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+
+    if(generated) {
+        for(i = 0; i < frame_count; i++)
+            free((void *)frames[i].data);
+        free(frames);
+        frames = NULL;
+        generated = 0;
+    }
 }
 
 
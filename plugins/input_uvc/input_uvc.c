@@ -45,7 +45,10 @@
 #include "huffman.h"
 #include "jpeg_utils.h"
 #include "dynctrl.h"
+#include "ratectrl.h"
+#include "stillframe.h"
 //#include "uvcvideo.h"
+#include "../input_gspcav1/encoder.h"
 
 #define INPUT_PLUGIN_NAME "UVC webcam grabber"
 
@@ -68,16 +71,47 @@ static const struct {
     { "SXGA", 1280, 1024 }
 };
 
+/*
+ * formats that can be captured, the uncompressed ones get compressed here,
+ * H.264 access units are passed through to the outputs that can carry them
+ */
+static const struct {
+    const char *string;
+    const unsigned int format;
+    const int encode;   /* image format of the builtin encoder, 0 if none */
+} formats[] = {
+    { "mjpeg",  V4L2_PIX_FMT_MJPEG,  0           },
+    { "yuyv",   V4L2_PIX_FMT_YUYV,   YUYVto420   },
+    { "yuv420", V4L2_PIX_FMT_YUV420, YUVto420    },
+    { "nv12",   V4L2_PIX_FMT_NV12,   NV12to420   },
+    { "h264",   V4L2_PIX_FMT_H264,   0           }
+};
+
+/* range of the quality the rate control chooses from for uncompressed frames */
+#define RATE_MIN_QUALITY 5
+#define RATE_MAX_QUALITY 95
+
 /* private functions and variables to this plugin */
 static globals *pglobal;
 static int gquality = 80;
 static unsigned int minimum_size = 0;
 static int dynctrls = 1;
 
+/* context of each camera, allocated with global->inmax entries and freed
+   with the last camera */
+static context *cams = NULL;
+
+/* several cameras can be loaded */
+const int input_per_id = 1;
+
 void *cam_thread(void *);
 void cam_cleanup(void *);
 void help(void);
 int input_cmd(int plugin, unsigned int control, unsigned int group, int value);
+static int init_rate_control(context *pcontext, unsigned int target);
+static void adapt_quality(context *pcontext, int size);
+static int frame_is_still(context *pcontext, int *size);
+static void release_cams(int count);
 
 
 /*** plugin interface functions ***/
@@ -87,18 +121,16 @@ Description.: This function ializes the plugin. It parses the commandline-
               appropriate variables.
 Input Value.: param contains among others the command-line string
 Return Value: 0 if everything is fine
-              1 if "--help" was triggered, in this case the calling programm
-              should stop running and leave.
+              1 if "--help" was triggered or the camera could not be set up,
+              nothing of the camera is left allocated then
 ******************************************************************************/
 int input_init(input_parameter *param, int id)
 {
     char *dev = "/dev/video0", *s;
     int width = 640, height = 480, fps = 5, format = V4L2_PIX_FMT_MJPEG, i;
-    /* initialize the mutes variable */
-    if(pthread_mutex_init(&cams[id].controls_mutex, NULL) != 0) {
-        IPRINT("could not initialize mutex variable\n");
-        exit(EXIT_FAILURE);
-    }
+    int builtin = 0, memory = V4L2_MEMORY_MMAP;
+    unsigned int bitrate = 0, frame_size = 0;
+    int still_threshold = -1, max_idle = 1000;
 
     param->argv[0] = INPUT_PLUGIN_NAME;
 
@@ -131,6 +163,15 @@ int input_init(input_parameter *param, int id)
             {"no_dynctrl", no_argument, 0, 0},
             {"l", required_argument, 0, 0},
             {"led", required_argument, 0, 0},
+            {"e", required_argument, 0, 0},
+            {"encoder", required_argument, 0, 0},
+            {"u", no_argument, 0, 0},
+            {"userptr", no_argument, 0, 0},
+            {"format", required_argument, 0, 0},
+            {"bitrate", required_argument, 0, 0},
+            {"frame_size", required_argument, 0, 0},
+            {"still_threshold", required_argument, 0, 0},
+            {"max_idle", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -203,7 +244,8 @@ int input_init(input_parameter *param, int id)
         case 10:
         case 11:
             DBG("case 10,11\n");
-            format = V4L2_PIX_FMT_YUYV;
+            if(format == V4L2_PIX_FMT_MJPEG)
+                format = V4L2_PIX_FMT_YUYV;
             gquality = MIN(MAX(atoi(optarg), 0), 100);
             break;
 
@@ -236,6 +278,65 @@ int input_init(input_parameter *param, int id)
         }*/
             break;
 
+            /* e, encoder */
+        case 18:
+        case 19:
+            DBG("case 18,19\n");
+            if(strcmp("builtin", optarg) == 0) {
+                builtin = 1;
+            } else if(strcmp("libjpeg", optarg) == 0) {
+                builtin = 0;
+            } else {
+                help();
+                return 1;
+            }
+            break;
+
+            /* u, userptr */
+        case 20:
+        case 21:
+            DBG("case 20,21\n");
+            memory = V4L2_MEMORY_USERPTR;
+            break;
+
+            /* format */
+        case 22:
+            DBG("case 22\n");
+            for(i = 0; i < LENGTH_OF(formats); i++) {
+                if(strcmp(formats[i].string, optarg) == 0)
+                    break;
+            }
+            if(i == LENGTH_OF(formats)) {
+                help();
+                return 1;
+            }
+            format = formats[i].format;
+            break;
+
+            /* bitrate */
+        case 23:
+            DBG("case 23\n");
+            bitrate = MAX(atoi(optarg), 0);
+            break;
+
+            /* frame_size */
+        case 24:
+            DBG("case 24\n");
+            frame_size = MAX(atoi(optarg), 0);
+            break;
+
+            /* still_threshold */
+        case 25:
+            DBG("case 25\n");
+            still_threshold = MIN(MAX(atoi(optarg), 0), 255);
+            break;
+
+            /* max_idle */
+        case 26:
+            DBG("case 26\n");
+            max_idle = MAX(atoi(optarg), 0);
+            break;
+
         default:
             DBG("default case\n");
             help();
@@ -243,32 +344,74 @@ int input_init(input_parameter *param, int id)
         }
     }
     DBG("input id: %d\n", id);
+
+    /* one context for each slot of the input table */
+    if(cams == NULL && (cams = calloc(param->global->inmax, sizeof(context))) == NULL) {
+        IPRINT("not enough memory for the camera contexts\n");
+        return 1;
+    }
+
+    /* initialize the mutes variable */
+    if(pthread_mutex_init(&cams[id].controls_mutex, NULL) != 0) {
+        IPRINT("could not initialize mutex variable\n");
+        release_cams(param->global->inmax);
+        return 1;
+    }
+
     cams[id].id = id;
     cams[id].pglobal = param->global;
+    cams[id].stop_fd = -1;
+
+    /* input_cmd needs it before the camera thread runs, a loaded camera takes commands */
+    pglobal = param->global;
 
     /* allocate webcam datastructure */
+    cams[id].encoder = NULL;
+    cams[id].rate = NULL;
+    cams[id].still = NULL;
     cams[id].videoIn = malloc(sizeof(struct vdIn));
     if(cams[id].videoIn == NULL) {
         IPRINT("not enough memory for videoIn\n");
-        exit(EXIT_FAILURE);
+        goto failed;
     }
     memset(cams[id].videoIn, 0, sizeof(struct vdIn));
+    cams[id].videoIn->memory = memory;
+
+    /* each camera gets an encoder of its own, so they can compress in parallel */
+    if(builtin) {
+        cams[id].encoder = malloc(sizeof(JPEG_ENCODER_STRUCTURE));
+        if(cams[id].encoder == NULL) {
+            IPRINT("not enough memory for the encoder\n");
+            goto failed;
+        }
+        encoder_init(cams[id].encoder);
+    }
 
     /* display the parsed values */
     IPRINT("Using V4L2 device.: %s\n", dev);
     IPRINT("Desired Resolution: %i x %i\n", width, height);
     IPRINT("Frames Per Second.: %i\n", fps);
-    IPRINT("Format............: %s\n", (format == V4L2_PIX_FMT_YUYV) ? "YUV" : "MJPEG");
-    if(format == V4L2_PIX_FMT_YUYV)
+    for(i = 0; i < LENGTH_OF(formats) - 1; i++) {
+        if(formats[i].format == format)
+            break;
+    }
+    IPRINT("Format............: %s\n", formats[i].string);
+    IPRINT("Buffers...........: %s\n", (memory == V4L2_MEMORY_USERPTR) ? "user pointer" : "mmap");
+    if(formats[i].encode != 0) {
         IPRINT("JPEG Quality......: %d\n", gquality);
+        IPRINT("JPEG Encoder......: %s\n", builtin ? "builtin" : "libjpeg");
+    }
 
     DBG("vdIn pn: %d\n", id);
     /* open video device and prepare data structure */
     if(init_videoIn(cams[id].videoIn, dev, width, height, fps, format, 1, cams[id].pglobal, id) < 0) {
         IPRINT("init_VideoIn failed\n");
-        closelog();
-        exit(EXIT_FAILURE);
+        goto failed;
     }
+
+    /* everything but H.264 reaches the outputs as JPG frames */
+    cams[id].pglobal->in[id].format = (format == V4L2_PIX_FMT_H264) ? V4L2_PIX_FMT_H264 : 0;
+
     /*
      * recent linux-uvc driver (revision > ~#125) requires to use dynctrls
      * for pan/tilt/focus/...
@@ -279,42 +422,223 @@ int input_init(input_parameter *param, int id)
 
     enumerateControls(cams[id].videoIn, cams[id].pglobal, id); // enumerate V4L2 controls after UVC extended mapping
 
+    /* the bitrate is spread evenly over the frames */
+    if(bitrate > 0)
+        frame_size = bitrate * 1000 / 8 / cams[id].videoIn->fps;
+    if(frame_size > 0) {
+        IPRINT("Target frame size.: %u bytes\n", frame_size);
+        if(init_rate_control(&cams[id], frame_size) != 0)
+            goto failed_device;
+    }
+
+    /* the detector needs the luminance of the frames */
+    if(still_threshold >= 0) {
+        IPRINT("Still threshold...: %d, published again after %d ms\n", still_threshold, max_idle);
+        if(format == V4L2_PIX_FMT_H264) {
+            IPRINT("still frames of H.264 can not be detected\n");
+            goto failed_device;
+        }
+        if((cams[id].still = malloc(sizeof(still_detector))) == NULL) {
+            IPRINT("not enough memory for the still detector\n");
+            goto failed_device;
+        }
+        still_init(cams[id].still, still_threshold, max_idle);
+    }
+
     return 0;
+
+    /* a camera that fails must not take down the others, the slot can be loaded again */
+failed_device:
+    close_v4l2(cams[id].videoIn);
+failed:
+    free(cams[id].rate);
+    cams[id].rate = NULL;
+    free(cams[id].encoder);
+    cams[id].encoder = NULL;
+    free(cams[id].videoIn);
+    cams[id].videoIn = NULL;
+    pthread_mutex_destroy(&cams[id].controls_mutex);
+    release_cams(param->global->inmax);
+    return 1;
 }
 
 /******************************************************************************
-Description.: Stops the execution of worker thread
+Description.: Stops the execution of worker thread, a camera that was loaded
+              but never run only closes its device
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the thread finished, -1 if it did not in time
 ******************************************************************************/
 int input_stop(int id)
 {
-    DBG("will cancel camera thread #%02d\n", id);
-    pthread_cancel(cams[id].threadID);
+    struct timespec deadline;
+
+    if(cams[id].stop_fd < 0) {
+        cam_cleanup(&cams[id]);
+        return 0;
+    }
+
+    DBG("will stop camera thread #%02d\n", id);
+    stop_deadline(&deadline);
+    stop_event_set(cams[id].stop_fd);
+
+    if(join_thread(cams[id].threadID, &deadline) != 0) {
+        IPRINT("camera thread #%02d did not finish in time\n", id);
+        return -1;
+    }
+
+    cam_cleanup(&cams[id]);
     return 0;
 }
 
 /******************************************************************************
 Description.: spins of a worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if ok, 1 if the thread did not start, the camera is closed
+              then
 ******************************************************************************/
 int input_run(int id)
 {
+    cams[id].stop_fd = -1;
     cams[id].pglobal->in[id].buf = malloc(cams[id].videoIn->framesizeIn);
     if(cams[id].pglobal->in[id].buf == NULL) {
         fprintf(stderr, "could not allocate memory\n");
-        exit(EXIT_FAILURE);
+        cam_cleanup(&cams[id]);
+        return 1;
+    }
+
+    if((cams[id].stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        cam_cleanup(&cams[id]);
+        return 1;
     }
 
     DBG("launching camera thread #%02d\n", id);
     /* create thread and pass context to thread function */
-    pthread_create(&(cams[id].threadID), NULL, cam_thread, &(cams[id]));
-    pthread_detach(cams[id].threadID);
+    if(pthread_create(&(cams[id].threadID), NULL, cam_thread, &(cams[id])) != 0) {
+        IPRINT("could not start the camera thread\n");
+        cam_cleanup(&cams[id]);
+        return 1;
+    }
     return 0;
 }
 
 /*** private functions for this plugin below ***/
+/******************************************************************************
+Description.: set up the rate control of a camera, uncompressed frames get
+              the quality of the encoder adapted, MJPEG cameras the one of
+              their compression control
+Input Value.: * pcontext: camera with enumerated controls
+              * target..: size of a frame in bytes to aim for
+Return Value: 0 if the quality can be controlled, -1 otherwise
+******************************************************************************/
+static int init_rate_control(context *pcontext, unsigned int target)
+{
+    input *in = &pcontext->pglobal->in[pcontext->id];
+    int i;
+
+    if((pcontext->rate = malloc(sizeof(rate_control))) == NULL) {
+        IPRINT("not enough memory for the rate control\n");
+        return -1;
+    }
+
+    switch(pcontext->videoIn->formatIn) {
+    case V4L2_PIX_FMT_MJPEG:
+    case V4L2_PIX_FMT_JPEG:
+        for(i = 0; i < in->parametercount; i++) {
+            if(in->in_parameters[i].ctrl.id == V4L2_CID_JPEG_COMPRESSION_QUALITY)
+                break;
+        }
+        if(i == in->parametercount) {
+            IPRINT("the camera has no control for the compression quality\n");
+            break;
+        }
+        /* the buffers queued with the driver still get the old quality */
+        rate_control_init(pcontext->rate, target, in->in_parameters[i].value,
+                          in->in_parameters[i].ctrl.minimum, in->in_parameters[i].ctrl.maximum, NB_BUFFER);
+        return 0;
+
+    case V4L2_PIX_FMT_H264:
+        IPRINT("the size of H.264 access units is not controlled\n");
+        break;
+
+    default:
+        rate_control_init(pcontext->rate, target, gquality, RATE_MIN_QUALITY, RATE_MAX_QUALITY, 0);
+        return 0;
+    }
+
+    free(pcontext->rate);
+    pcontext->rate = NULL;
+    return -1;
+}
+
+/******************************************************************************
+Description.: check whether the grabbed frame shows the same scene as the last
+              published one, JPEG frames get their Huffman tables added in
+              vd->tmpbuffer first, the decoder of the detector needs them
+Input Value.: * pcontext: camera with a still detector and a grabbed frame
+              * size....: set to the size of the frame in vd->tmpbuffer, 0 if
+                          it was not copied
+Return Value: 1 if the frame may be dropped, 0 if it has to be published
+******************************************************************************/
+static int frame_is_still(context *pcontext, int *size)
+{
+    struct vdIn *vd = pcontext->videoIn;
+
+    *size = 0;
+    switch(vd->formatIn) {
+    case V4L2_PIX_FMT_YUYV:
+        return still_luma(pcontext->still, vd->frame, vd->width, vd->height, 2, &vd->buf.timestamp);
+
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_NV12:
+        return still_luma(pcontext->still, vd->frame, vd->width, vd->height, 1, &vd->buf.timestamp);
+
+    default:
+        *size = memcpy_picture(vd->tmpbuffer, vd->frame, vd->buf.bytesused);
+        return still_jpeg(pcontext->still, vd->tmpbuffer, *size, &vd->buf.timestamp);
+    }
+}
+
+/******************************************************************************
+Description.: feed the size of a published frame to the rate control, a new
+              quality is passed on to MJPEG cameras
+Input Value.: * pcontext: camera with a rate control
+              * size....: size of the frame in bytes
+Return Value: -
+******************************************************************************/
+static void adapt_quality(context *pcontext, int size)
+{
+    int quality = pcontext->rate->quality;
+
+    if(rate_control_update(pcontext->rate, size) == quality)
+        return;
+
+    DBG("quality of input %d changes from %d to %d\n", pcontext->id, quality, pcontext->rate->quality);
+    if(pcontext->videoIn->formatIn != V4L2_PIX_FMT_MJPEG && pcontext->videoIn->formatIn != V4L2_PIX_FMT_JPEG)
+        return;
+
+    pthread_mutex_lock(&pcontext->controls_mutex);
+    if(v4l2SetControl(pcontext->videoIn, V4L2_CID_JPEG_COMPRESSION_QUALITY, pcontext->rate->quality, pcontext->id, pcontext->pglobal) != 0)
+        DBG("could not set the compression quality\n");
+    pthread_mutex_unlock(&pcontext->controls_mutex);
+}
+
+/******************************************************************************
+Description.: image format of the builtin encoder for a V4L2 pixel format
+Input Value.: pixel format of the frames
+Return Value: the image format, 0 for formats that are not compressed here
+******************************************************************************/
+static int encoder_format(unsigned int format)
+{
+    int i;
+
+    for(i = 0; i < LENGTH_OF(formats); i++) {
+        if(formats[i].format == format)
+            return formats[i].encode;
+    }
+    return 0;
+}
+
 /******************************************************************************
 Description.: print a help message to stderr
 Input Value.: -
@@ -351,6 +675,23 @@ void help(void)
     " [-n | --no_dynctrl ]...: do not initalize dynctrls of Linux-UVC driver\n" \
     " [-l | --led ]..........: switch the LED \"on\", \"off\", let it \"blink\" or leave\n" \
     "                          it up to the driver using the value \"auto\"\n" \
+    " [-e | --encoder ]......: compress YUYV frames with \"libjpeg\" (default) or\n" \
+    "                          the \"builtin\" encoder, which needs no libjpeg but\n" \
+    "                          writes no EXIF header\n" \
+    " [-u | --userptr ]......: let the driver write into buffers of the plugin\n" \
+    "                          instead of mapping its own, which may be uncached\n" \
+    " [--format ]............: capture \"mjpeg\" (default), \"yuyv\", \"yuv420\" or\n" \
+    "                          \"nv12\" and compress it, or pass \"h264\" through\n" \
+    "                          to the outputs that can carry it\n" \
+    " [--bitrate ]...........: adapt the JPEG quality to this many kbit/s at the\n" \
+    "                          configured fps, MJPEG cameras need a control for\n" \
+    "                          the compression quality\n" \
+    " [--frame_size ]........: the same for a size of the frames in bytes\n" \
+    " [--still_threshold ]...: drop frames that show the same scene as the last\n" \
+    "                          published one, no 8x8 block may differ by more\n" \
+    "                          than this many brightness levels\n" \
+    " [--max_idle ]..........: publish a still scene every this many ms anyway,\n" \
+    "                          default 1000, 0 to publish changes only\n" \
     " ---------------------------------------------------------------\n\n");
 }
 
@@ -363,21 +704,27 @@ void *cam_thread(void *arg)
 {
 
     context *pcontext = arg;
+    int ret, quality, size, copied;
     pglobal = pcontext->pglobal;
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(cam_cleanup, pcontext);
-
     while(!pglobal->stop) {
         while(pcontext->videoIn->streamingState == STREAMING_PAUSED) {
-            usleep(1); // maybe not the best way so FIXME
+            if(stop_event_wait(pcontext->stop_fd, 1))
+                break;
         }
 
-        /* grab a frame */
-        if(uvcGrab(pcontext->videoIn) < 0) {
+        /* wait for the next frame, but not past a stop request */
+        if(stop_event_poll(pcontext->stop_fd, pcontext->videoIn->fd, POLLIN) != 0)
+            break;
+
+        /* grab a frame, it is read straight from the driver's buffer */
+        ret = uvcGrabBuffer(pcontext->videoIn);
+        if(ret < 0) {
             IPRINT("Error grabbing frames\n");
-            exit(EXIT_FAILURE);
+            break;
         }
+        if(ret > 0)
+            continue;
 
         DBG("received frame of size: %d from plugin: %d\n", pcontext->videoIn->buf.bytesused, pcontext->id);
 
@@ -390,9 +737,26 @@ void *cam_thread(void *arg)
          */
         if(pcontext->videoIn->buf.bytesused < minimum_size) {
             DBG("dropping too small frame, assuming it as broken\n");
+            if(uvcReleaseBuffer(pcontext->videoIn) < 0) {
+                IPRINT("Error grabbing frames\n");
+                break;
+            }
             continue;
         }
 
+        /* frames of a still scene are dropped, uncompressed ones before they get compressed */
+        copied = 0;
+        if(pcontext->still != NULL && frame_is_still(pcontext, &copied)) {
+            DBG("dropping still frame\n");
+            if(uvcReleaseBuffer(pcontext->videoIn) < 0) {
+                IPRINT("Error grabbing frames\n");
+                break;
+            }
+            continue;
+        }
+
+        quality = (pcontext->rate != NULL) ? pcontext->rate->quality : gquality;
+
         /* copy JPG picture to global buffer */
         pthread_mutex_lock(&pglobal->in[pcontext->id].db);
 
@@ -402,12 +766,52 @@ void *cam_thread(void *arg)
          * Getting JPEGs straight from the webcam, is one of the major advantages of
          * Linux-UVC compatible devices.
          */
-        if(pcontext->videoIn->formatIn == V4L2_PIX_FMT_YUYV) {
+        switch(pcontext->videoIn->formatIn) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_NV12:
             DBG("compressing frame from input: %d\n", (int)pcontext->id);
-            pglobal->in[pcontext->id].size = compress_yuyv_to_jpeg(pcontext->videoIn, pglobal->in[pcontext->id].buf, pcontext->videoIn->framesizeIn, gquality);
-        } else {
+            if(pcontext->encoder != NULL) {
+                /* the encoder reads the MCUs straight from the frame and subsamples YUYV to 4:2:0 like libjpeg */
+                pglobal->in[pcontext->id].size = encode_image_ctx(pcontext->encoder, pcontext->videoIn->frame,
+                                                 pglobal->in[pcontext->id].buf, pcontext->videoIn->framesizeIn,
+                                                 encoder_quality_factor(quality), encoder_format(pcontext->videoIn->formatIn),
+                                                 pcontext->videoIn->width, pcontext->videoIn->height);
+            } else if(pcontext->videoIn->formatIn == V4L2_PIX_FMT_YUYV) {
+                pglobal->in[pcontext->id].size = compress_yuyv_to_jpeg(pcontext->videoIn, pcontext->videoIn->frame, pglobal->in[pcontext->id].buf, pcontext->videoIn->framesizeIn, quality);
+            } else {
+                /* the planes go to libjpeg as they are, there is no RGB step */
+                pglobal->in[pcontext->id].size = compress_yuv420_to_jpeg(pcontext->videoIn, pcontext->videoIn->frame, pglobal->in[pcontext->id].buf, pcontext->videoIn->framesizeIn, quality,
+                                                 pcontext->videoIn->formatIn == V4L2_PIX_FMT_NV12);
+            }
+            break;
+
+        case V4L2_PIX_FMT_H264:
+            DBG("passing frame through from input: %d\n", (int)pcontext->id);
+            pglobal->in[pcontext->id].size = MIN((int)pcontext->videoIn->buf.bytesused, pcontext->videoIn->framesizeIn);
+            memcpy(pglobal->in[pcontext->id].buf, pcontext->videoIn->frame, pglobal->in[pcontext->id].size);
+            break;
+
+        default:
             DBG("copying frame from input: %d\n", (int)pcontext->id);
-            pglobal->in[pcontext->id].size = memcpy_picture(pglobal->in[pcontext->id].buf, pcontext->videoIn->tmpbuffer, pcontext->videoIn->buf.bytesused);
+            if(copied > 0) {
+                /* the still detection completed it already */
+                memcpy(pglobal->in[pcontext->id].buf, pcontext->videoIn->tmpbuffer, copied);
+                pglobal->in[pcontext->id].size = copied;
+            } else {
+                pglobal->in[pcontext->id].size = memcpy_picture(pglobal->in[pcontext->id].buf, pcontext->videoIn->frame, pcontext->videoIn->buf.bytesused);
+            }
+            break;
+        }
+
+        if(pglobal->in[pcontext->id].size == 0) {
+            DBG("dropping frame, it might not fit into the buffer\n");
+            pthread_mutex_unlock(&pglobal->in[pcontext->id].db);
+            if(uvcReleaseBuffer(pcontext->videoIn) < 0) {
+                IPRINT("Error grabbing frames\n");
+                break;
+            }
+            continue;
         }
 
 #if 0
@@ -422,48 +826,92 @@ void *cam_thread(void *arg)
         pglobal->in[pcontext->id].timestamp = pcontext->videoIn->buf.timestamp;
 
         /* signal fresh_frame */
+        size = pglobal->in[pcontext->id].size;
         pthread_cond_broadcast(&pglobal->in[pcontext->id].db_update);
         pthread_mutex_unlock(&pglobal->in[pcontext->id].db);
 
+        /* the driver can fill the buffer again */
+        if(uvcReleaseBuffer(pcontext->videoIn) < 0) {
+            IPRINT("Error grabbing frames\n");
+            break;
+        }
+
+        if(pcontext->rate != NULL)
+            adapt_quality(pcontext, size);
 
         /* only use usleep if the fps is below 5, otherwise the overhead is too long */
         if(pcontext->videoIn->fps < 5) {
             DBG("waiting for next frame for %d us\n", 1000 * 1000 / pcontext->videoIn->fps);
-            usleep(1000 * 1000 / pcontext->videoIn->fps);
+            if(stop_event_wait(pcontext->stop_fd, 1000 / pcontext->videoIn->fps))
+                break;
         } else {
             DBG("waiting for next frame\n");
         }
     }
 
-    DBG("leaving input thread, calling cleanup function now\n");
-    pthread_cleanup_pop(1);
+    /* a camera that failed leaves the others running, stopping its slot releases it */
+    if(!pglobal->stop && !stop_event_wait(pcontext->stop_fd, 0))
+        IPRINT("camera #%02d stopped capturing\n", pcontext->id);
+
+    DBG("leaving input thread\n");
 
     return NULL;
 }
 
 /******************************************************************************
-Description.:
-Input Value.:
-Return Value:
+Description.: free the ressources of a camera after its thread finished
+Input Value.: context of the camera
+Return Value: -
 ******************************************************************************/
 void cam_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
     context *pcontext = arg;
     pglobal = pcontext->pglobal;
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
 
-    first_run = 0;
     IPRINT("cleaning up ressources allocated by input thread\n");
 
+    close(pcontext->stop_fd);
+    pcontext->stop_fd = -1;
+
     close_v4l2(pcontext->videoIn);
     if(pcontext->videoIn->tmpbuffer != NULL) free(pcontext->videoIn->tmpbuffer);
     if(pcontext->videoIn != NULL) free(pcontext->videoIn);
-    if(pglobal->in[pcontext->id].buf != NULL)
-        free(pglobal->in[pcontext->id].buf);
+    pcontext->videoIn = NULL;
+    free(pcontext->encoder);
+    pcontext->encoder = NULL;
+    free(pcontext->rate);
+    pcontext->rate = NULL;
+    if(pcontext->still != NULL)
+        still_free(pcontext->still);
+    free(pcontext->still);
+    pcontext->still = NULL;
+
+    pthread_mutex_lock(&pglobal->in[pcontext->id].db);
+    free(pglobal->in[pcontext->id].buf);
+    pglobal->in[pcontext->id].buf = NULL;
+    pthread_mutex_unlock(&pglobal->in[pcontext->id].db);
+
+    pthread_mutex_destroy(&pcontext->controls_mutex);
+    release_cams(pglobal->inmax);
+}
+
+/******************************************************************************
+Description.: free the table of the cameras once none is left, the plugin may
+              be unloaded then
+Input Value.: number of entries of the table
+Return Value: -
+******************************************************************************/
+static void release_cams(int count)
+{
+    int i;
+
+    for(i = 0; i < count; i++) {
+        if(cams[i].videoIn != NULL)
+            return;
+    }
+
+    free(cams);
+    cams = NULL;
 }
 
 /******************************************************************************
@@ -477,7 +925,6 @@ Return Value: depends in the command, for most cases 0 means no errors and
 int input_cmd(int plugin_number, unsigned int control_id, unsigned int group, int value)
 {
     int ret = -1;
-    int i = 0;
     DBG("Requested cmd (id: %d) for the %d plugin. Group: %d value: %d\n", control_id, plugin_number, group, value);
     switch(group) {
     case IN_CMD_GENERIC: {
@@ -494,10 +941,10 @@ int input_cmd(int plugin_number, unsigned int control_id, unsigned int group, in
             return -1;
         } break;
     case IN_CMD_V4L2: {
+            pthread_mutex_lock(&cams[plugin_number].controls_mutex);
             ret = v4l2SetControl(cams[plugin_number].videoIn, control_id, value, plugin_number, pglobal);
-            if(ret == 0) {
-                pglobal->in[plugin_number].in_parameters[i].value = value;
-            } else {
+            pthread_mutex_unlock(&cams[plugin_number].controls_mutex);
+            if(ret != 0) {
                 DBG("v4l2SetControl failed: %d\n", ret);
             }
             return ret;
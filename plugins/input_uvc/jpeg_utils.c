@@ -72,11 +72,9 @@ static void put_jpeg_exif(j_compress_ptr cinfo,
     } else
     	subtime = NULL;
 
-    if (cnt->conf.exif_text) {
+    if (cnt && cnt->conf.exif_text && timestamp) {
 	description = malloc(PATH_MAX);
-	mystrftime(cnt, description, PATH_MAX-1,
-		   cnt->conf.exif_text,
-		   timestamp, NULL, 0);
+	strftime(description, PATH_MAX-1, cnt->conf.exif_text, timestamp);
     } else {
 	description = NULL;
     }
@@ -302,11 +300,12 @@ Description.: yuv2jpeg function is based on compress_yuyv_to_jpeg written by
               YUYV data to JPEG. Most other implementations use the
               "jpeg_stdio_dest" from libjpeg, which can not store compressed
               pictures to memory instead of a file.
-Input Value.: video structure from v4l2uvc.c/h, destination buffer and buffersize
+Input Value.: video structure from v4l2uvc.c/h, the YUYV frame, destination
+              buffer and buffersize
               the buffer must be large enough, no error/size checking is done!
 Return Value: the buffer will contain the compressed data
 ******************************************************************************/
-int compress_yuyv_to_jpeg(struct vdIn *vd, unsigned char *buffer, int size, int quality)
+int compress_yuyv_to_jpeg(struct vdIn *vd, unsigned char *frame, unsigned char *buffer, int size, int quality)
 {
     struct jpeg_compress_struct cinfo;
     struct jpeg_error_mgr jerr;
@@ -316,7 +315,7 @@ int compress_yuyv_to_jpeg(struct vdIn *vd, unsigned char *buffer, int size, int
     static int written;
 
     line_buffer = calloc(vd->width * 3, 1);
-    yuyv = vd->framebuffer;
+    yuyv = frame;
 
     cinfo.err = jpeg_std_error(&jerr);
     jpeg_create_compress(&cinfo);
@@ -379,3 +378,103 @@ int compress_yuyv_to_jpeg(struct vdIn *vd, unsigned char *buffer, int size, int
     return (written);
 }
 
+
+/******************************************************************************
+Description.: compress YUV 4:2:0 frames to JPEG without converting them to RGB
+              first, libjpeg gets the planes as raw data of a 2x2, 1x1, 1x1
+              sampled YCbCr picture.
+Input Value.: video structure from v4l2uvc.c/h, the frame, destination buffer
+              and buffersize, quality, nv12 is set if Cb and Cr are
+              interleaved in one plane instead of two separate planes
+              the buffer must be large enough, no error/size checking is done!
+Return Value: the size of the compressed data
+******************************************************************************/
+int compress_yuv420_to_jpeg(struct vdIn *vd, unsigned char *frame, unsigned char *buffer, int size, int quality, int nv12)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    JSAMPROW y_rows[16], cb_rows[8], cr_rows[8];
+    JSAMPARRAY planes[3] = { y_rows, cb_rows, cr_rows };
+    int width = vd->width, height = vd->height, cwidth = width / 2, cheight = height / 2;
+    int padded = (width + 15) & ~15, written, row, r, x, line;
+    unsigned char *y_plane = frame, *u_plane = frame + width * height;
+    unsigned char *v_plane = u_plane + cwidth * cheight;
+    unsigned char *lines, *src;
+    struct timeval tv;
+
+    /*
+     * libjpeg reads whole MCUs, so rows of a width that is no multiple of 16
+     * and interleaved chroma are copied to these lines
+     */
+    lines = malloc(16 * padded + 16 * padded / 2);
+    if(lines == NULL)
+        return 0;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    dest_buffer(&cinfo, buffer, size, &written);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    gettimeofday(&tv, NULL);
+    put_jpeg_exif(&cinfo, NULL, &tv);
+
+    for(row = 0; row < height; row += 16) {
+        /* rows below the picture repeat the last one */
+        for(r = 0; r < 16; r++) {
+            src = y_plane + (row + r < height ? row + r : height - 1) * width;
+            if(width != padded) {
+                y_rows[r] = lines + r * padded;
+                memcpy(y_rows[r], src, width);
+                memset(y_rows[r] + width, src[width - 1], padded - width);
+            } else {
+                y_rows[r] = src;
+            }
+        }
+        for(r = 0; r < 8; r++) {
+            line = (row / 2 + r < cheight ? row / 2 + r : cheight - 1) * cwidth;
+            if(nv12 || width != padded) {
+                cb_rows[r] = lines + 16 * padded + r * padded;
+                cr_rows[r] = cb_rows[r] + padded / 2;
+                if(nv12) {
+                    src = u_plane + 2 * line;
+                    for(x = 0; x < cwidth; x++) {
+                        cb_rows[r][x] = src[2 * x];
+                        cr_rows[r][x] = src[2 * x + 1];
+                    }
+                } else {
+                    memcpy(cb_rows[r], u_plane + line, cwidth);
+                    memcpy(cr_rows[r], v_plane + line, cwidth);
+                }
+                memset(cb_rows[r] + cwidth, cb_rows[r][cwidth - 1], padded / 2 - cwidth);
+                memset(cr_rows[r] + cwidth, cr_rows[r][cwidth - 1], padded / 2 - cwidth);
+            } else {
+                cb_rows[r] = u_plane + line;
+                cr_rows[r] = v_plane + line;
+            }
+        }
+        jpeg_write_raw_data(&cinfo, planes, 16);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    free(lines);
+
+    return written;
+}
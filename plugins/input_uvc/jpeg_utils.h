@@ -1 +1,2 @@
-int compress_yuyv_to_jpeg(struct vdIn *vd, unsigned char *buffer, int size, int quality);
+int compress_yuyv_to_jpeg(struct vdIn *vd, unsigned char *frame, unsigned char *buffer, int size, int quality);
+int compress_yuv420_to_jpeg(struct vdIn *vd, unsigned char *frame, unsigned char *buffer, int size, int quality, int nv12);
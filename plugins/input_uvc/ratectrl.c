@@ -0,0 +1,102 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdlib.h>
+
+#include "ratectrl.h"
+
+/******************************************************************************
+Description.: prepare the rate control of a camera
+Input Value.: * rc......: the state to initialize
+              * target..: size of a frame in bytes to aim for
+              * quality.: quality to start with
+              * min, max: range of the quality
+              * hold....: frames still compressed with the old quality after
+                          a change
+Return Value: -
+******************************************************************************/
+void rate_control_init(rate_control *rc, unsigned int target, int quality, int min, int max, int hold)
+{
+    rc->target = target;
+    rc->min = min;
+    rc->max = max;
+    rc->quality = (quality < min) ? min : (quality > max) ? max : quality;
+    rc->hold = hold;
+    rc->average = 0;
+    rc->frames = 0;
+    rc->wait = 0;
+}
+
+/******************************************************************************
+Description.: account for a frame and adapt the quality if the average size
+              left the band around the target, the step grows with the
+              distance to the target
+Input Value.: * rc....: the state of the camera
+              * size..: size of the published frame in bytes
+Return Value: the quality for the next frames
+******************************************************************************/
+int rate_control_update(rate_control *rc, unsigned int size)
+{
+    long long deviation;
+    int step, quality;
+
+    if(rc->wait > 0) {
+        rc->wait--;
+        return rc->quality;
+    }
+
+    /* the average follows with a weight of 1/4 per frame */
+    if(rc->frames++ == 0)
+        rc->average = size;
+    else
+        rc->average = rc->average + ((long long)size - rc->average) / 4;
+
+    if(rc->frames < RATE_CONTROL_FRAMES)
+        return rc->quality;
+
+    /* percent above or below the target */
+    deviation = ((long long)rc->average - rc->target) * 100 / rc->target;
+    if(llabs(deviation) <= RATE_CONTROL_BAND)
+        return rc->quality;
+
+    step = deviation / 10;
+    if(step == 0)
+        step = (deviation > 0) ? 1 : -1;
+    if(step > RATE_CONTROL_MAX_STEP)
+        step = RATE_CONTROL_MAX_STEP;
+    if(step < -RATE_CONTROL_MAX_STEP)
+        step = -RATE_CONTROL_MAX_STEP;
+
+    quality = rc->quality - step;
+    if(quality < rc->min)
+        quality = rc->min;
+    if(quality > rc->max)
+        quality = rc->max;
+    if(quality == rc->quality)
+        return rc->quality;
+
+    /* start a new average with the frames of the new quality */
+    rc->quality = quality;
+    rc->frames = 0;
+    rc->wait = rc->hold;
+    return rc->quality;
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef RATECTRL_H
+#define RATECTRL_H
+
+/*
+ * Rate control of the JPEG quality.
+ *
+ * The sizes of the published frames are averaged and the quality is stepped
+ * towards the target size whenever the average leaves a band around it. The
+ * frames that are still on their way with the old quality are ignored after
+ * a change, with MJPEG cameras these are the queued buffers.
+ */
+
+/* the average may deviate this many percent from the target */
+#define RATE_CONTROL_BAND 10
+
+/* frames averaged before the quality changes again */
+#define RATE_CONTROL_FRAMES 4
+
+/* the quality changes by at most this much at once */
+#define RATE_CONTROL_MAX_STEP 10
+
+typedef struct _rate_control rate_control;
+struct _rate_control {
+    unsigned int target;    /* bytes per frame */
+    int quality;            /* quality of the next frames */
+    int min, max;           /* range of the quality */
+    int hold;               /* frames to ignore after a change */
+
+    unsigned int average;   /* moving average of the frame sizes */
+    int frames;             /* frames in the average */
+    int wait;               /* frames left to ignore */
+};
+
+void rate_control_init(rate_control *rc, unsigned int target, int quality, int min, int max, int hold);
+int rate_control_update(rate_control *rc, unsigned int size);
+
+#endif
@@ -0,0 +1,201 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stillframe.h"
+
+/******************************************************************************
+Description.: prepare the detection of still frames
+Input Value.: * sd.......: the detector
+              * threshold: brightness difference in pixel levels (0..255) a
+                           block must differ to count as changed
+              * max_idle.: publish a still scene again after this many ms,
+                           0 to publish only changes
+Return Value: -
+******************************************************************************/
+void still_init(still_detector *sd, int threshold, int max_idle)
+{
+    memset(sd, 0, sizeof(still_detector));
+    sd->threshold = threshold;
+    sd->max_idle = max_idle;
+}
+
+/******************************************************************************
+Description.: the blocks of the current frame become the reference
+Input Value.: * sd.......: detector with the blocks of the current frame
+              * timestamp: capture time of the frame
+Return Value: 0, the frame has to be published
+******************************************************************************/
+static int publish_blocks(still_detector *sd, const struct timeval *timestamp)
+{
+    int *tmp = sd->reference;
+
+    sd->reference = sd->blocks;
+    sd->blocks = tmp;
+    sd->published = *timestamp;
+    return 0;
+}
+
+/******************************************************************************
+Description.: compare sd->blocks against the reference, which takes over the
+              blocks if the frame gets published
+Input Value.: * sd.......: detector with the blocks of the current frame
+              * threshold: difference in units of sd->blocks
+              * timestamp: capture time of the frame
+Return Value: 1 if the frame may be dropped, 0 if it has to be published
+******************************************************************************/
+static int compare_blocks(still_detector *sd, int threshold, const struct timeval *timestamp)
+{
+    int i, d, n = sd->bw * sd->bh;
+    long long idle;
+
+    for(i = 0; i < n; i++) {
+        d = sd->blocks[i] - sd->reference[i];
+        if(d > threshold || d < -threshold)
+            break;
+    }
+
+    if(i == n) {
+        idle = (timestamp->tv_sec - sd->published.tv_sec) * 1000LL +
+               (timestamp->tv_usec - sd->published.tv_usec) / 1000;
+        if(sd->max_idle == 0 || idle < sd->max_idle)
+            return 1;
+    }
+
+    return publish_blocks(sd, timestamp);
+}
+
+/******************************************************************************
+Description.: make room for the blocks of a frame, a new size starts without
+              a reference
+Input Value.: * sd....: the detector
+              * bw, bh: size of the frame in 8x8 blocks
+Return Value: 1 if there is a reference of this size, 0 if there is none
+              yet, -1 if there is not enough memory
+******************************************************************************/
+static int resize_blocks(still_detector *sd, int bw, int bh)
+{
+    if(sd->bw == bw && sd->bh == bh)
+        return 1;
+
+    free(sd->blocks);
+    free(sd->reference);
+    sd->blocks = malloc(bw * bh * sizeof(int));
+    sd->reference = malloc(bw * bh * sizeof(int));
+    if(sd->blocks == NULL || sd->reference == NULL) {
+        free(sd->blocks);
+        free(sd->reference);
+        sd->blocks = sd->reference = NULL;
+        sd->bw = sd->bh = 0;
+        return -1;
+    }
+    sd->bw = bw;
+    sd->bh = bh;
+    return 0;
+}
+
+/******************************************************************************
+Description.: check an uncompressed frame, the blocks at the right and the
+              bottom edge that are not complete are left out
+Input Value.: * sd.......: the detector
+              * luma.....: first luminance sample of the frame
+              * width....: width of the frame in pixels
+              * height...: height of the frame in pixels
+              * step.....: distance of the luminance samples, 1 for planar
+                           formats and 2 for YUYV
+              * timestamp: capture time of the frame
+Return Value: 1 if the frame may be dropped, 0 if it has to be published
+******************************************************************************/
+int still_luma(still_detector *sd, const unsigned char *luma, int width, int height, int step, const struct timeval *timestamp)
+{
+    int x, y, i, bw = width / 8, bh = height / 8, ret;
+    const unsigned char *line;
+    int *row;
+
+    if((ret = resize_blocks(sd, bw, bh)) < 0)
+        return 0;
+
+    memset(sd->blocks, 0, bw * bh * sizeof(int));
+    for(y = 0; y < bh * 8; y++) {
+        line = luma + y * width * step;
+        row = sd->blocks + (y / 8) * bw;
+        for(x = 0; x < bw; x++) {
+            for(i = 0; i < 8; i++)
+                row[x] += line[(x * 8 + i) * step];
+        }
+    }
+
+    /* the sum of 64 samples divided by 8, the scale of a DC coefficient */
+    for(i = 0; i < bw * bh; i++)
+        sd->blocks[i] >>= 3;
+
+    if(ret == 0)
+        return publish_blocks(sd, timestamp);
+
+    return compare_blocks(sd, sd->threshold * 8, timestamp);
+}
+
+/******************************************************************************
+Description.: check a JPEG frame, it has to bring its Huffman tables
+Input Value.: * sd.......: the detector
+              * data.....: the JPEG picture
+              * len......: size of the picture in bytes
+              * timestamp: capture time of the frame
+Return Value: 1 if the frame may be dropped, 0 if it has to be published
+******************************************************************************/
+int still_jpeg(still_detector *sd, const unsigned char *data, int len, const struct timeval *timestamp)
+{
+    int ret, threshold;
+
+    if(dc_decode(&sd->dec, data, len) < 0)
+        return 0;
+
+    if((ret = resize_blocks(sd, sd->dec.bw, sd->dec.bh)) < 0)
+        return 0;
+    memcpy(sd->blocks, sd->dec.dc, sd->bw * sd->bh * sizeof(int));
+
+    if(ret == 0)
+        return publish_blocks(sd, timestamp);
+
+    /* a block close to a step of the quantizer flips between two steps */
+    threshold = sd->threshold * 8;
+    if(threshold < sd->dec.hdr.qt[sd->dec.hdr.comp[0].tq][0])
+        threshold = sd->dec.hdr.qt[sd->dec.hdr.comp[0].tq][0];
+
+    return compare_blocks(sd, threshold, timestamp);
+}
+
+/******************************************************************************
+Description.: free the buffers of the detector
+Input Value.: the detector
+Return Value: -
+******************************************************************************/
+void still_free(still_detector *sd)
+{
+    dc_decoder_free(&sd->dec);
+    free(sd->blocks);
+    free(sd->reference);
+    sd->blocks = sd->reference = NULL;
+    sd->bw = sd->bh = 0;
+}
@@ -0,0 +1,57 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef STILLFRAME_H
+#define STILLFRAME_H
+
+#include <sys/time.h>
+
+#include "../output_motion/motion.h"
+
+/*
+ * Detection of frames that show the same scene as the last published one.
+ *
+ * The frames are compared by the averages of their 8x8 luminance blocks,
+ * uncompressed frames are summed up and JPEG frames deliver them as their
+ * DC coefficients. The averages hardly change with the noise of the sensor,
+ * unlike the bytes of a compressed frame. Every frame is compared against
+ * the last published one, so a slow change adds up until it gets published.
+ */
+
+typedef struct _still_detector still_detector;
+struct _still_detector {
+    int threshold;          /* brightness difference of a block in pixel levels */
+    int max_idle;           /* ms after which a still scene is published again, 0 never */
+
+    dc_decoder dec;
+    int *blocks;            /* eight times the block averages of the current frame */
+    int *reference;         /* the same of the last published frame */
+    int bw, bh;             /* size of the tables in 8x8 blocks */
+    struct timeval published;
+};
+
+void still_init(still_detector *sd, int threshold, int max_idle);
+int still_luma(still_detector *sd, const unsigned char *luma, int width, int height, int step, const struct timeval *timestamp);
+int still_jpeg(still_detector *sd, const unsigned char *data, int len, const struct timeval *timestamp);
+void still_free(still_detector *sd);
+
+#endif
@@ -55,6 +55,49 @@ int xioctl(int fd, int IOCTL_X, void *arg)
 }
 
 static int init_v4l2(struct vdIn *vd);
+static void prepare_buffer(struct vdIn *vd, int index);
+static void free_buffers(struct vdIn *vd);
+
+/******************************************************************************
+Description.: length of a line of an uncompressed frame without padding
+Input Value.: vd: device with the format set by init_v4l2()
+Return Value: bytes of a line of the first plane, 0 for compressed formats
+******************************************************************************/
+static unsigned int packed_bytesperline(struct vdIn *vd)
+{
+    switch(vd->formatIn) {
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_NV12:   return vd->width;
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_RGB565: return vd->width * 2;
+    case V4L2_PIX_FMT_BGR24:  return vd->width * 3;
+    case V4L2_PIX_FMT_BGR32:  return vd->width * 4;
+    default:                  return 0;
+    }
+}
+
+/******************************************************************************
+Description.: size of an uncompressed frame in the negotiated format
+Input Value.: vd: device with the format set by init_v4l2()
+Return Value: bytes of one frame
+******************************************************************************/
+static int raw_framesize(struct vdIn *vd)
+{
+    int bpp;
+
+    if(vd->sizeimage != 0)
+        return vd->sizeimage;
+
+    /* some drivers do not fill in sizeimage */
+    switch(vd->formatIn) {
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_NV12:   return vd->width * vd->height * 3 / 2;
+    case V4L2_PIX_FMT_BGR24:  bpp = 3; break;
+    case V4L2_PIX_FMT_BGR32:  bpp = 4; break;
+    default:                  bpp = 2; break;
+    }
+    return vd->width * vd->height * bpp;
+}
 
 int init_videoIn(struct vdIn *vd, char *device, int width,
                  int height, int fps, int format, int grabmethod, globals *pglobal, int id)
@@ -89,7 +132,7 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
     // enumerating formats
     int currentWidth, currentHeight = 0;
     struct v4l2_format currentFormat;
-    currentFormat.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    currentFormat.type = vd->type;
     if(xioctl(vd->fd, VIDIOC_G_FMT, &currentFormat) == 0) {
         currentWidth = currentFormat.fmt.pix.width;
         currentHeight = currentFormat.fmt.pix.height;
@@ -100,7 +143,7 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
     for(pglobal->in[id].formatCount = 0; 1; pglobal->in[id].formatCount++) {
         struct v4l2_fmtdesc fmtdesc;
         fmtdesc.index = pglobal->in[id].formatCount;
-        fmtdesc.type  = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmtdesc.type  = vd->type;
         if(xioctl(vd->fd, VIDIOC_ENUM_FMT, &fmtdesc) < 0) {
             break;
         }
@@ -166,6 +209,8 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
     vd->framesizeIn = (vd->width * vd->height << 1);
     switch(vd->formatIn) {
     case V4L2_PIX_FMT_MJPEG:
+    case V4L2_PIX_FMT_JPEG:
+    case V4L2_PIX_FMT_H264:
         vd->tmpbuffer = (unsigned char *) calloc(1, (size_t) vd->framesizeIn);
         if(!vd->tmpbuffer)
             goto error;
@@ -176,6 +221,15 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
         vd->framebuffer =
             (unsigned char *) calloc(1, (size_t) vd->framesizeIn);
         break;
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_RGB565:
+    case V4L2_PIX_FMT_BGR24:
+    case V4L2_PIX_FMT_BGR32:
+        /* uncompressed frames of other sizes, compressed by the caller */
+        vd->framebuffer =
+            (unsigned char *) calloc(1, (size_t) raw_framesize(vd));
+        break;
     default:
         fprintf(stderr, " should never arrive exit fatal !!\n");
         goto error;
@@ -188,17 +242,27 @@ int init_videoIn(struct vdIn *vd, char *device, int width,
     return 0;
 error:
     free(pglobal->in[id].in_parameters);
+    pglobal->in[id].in_parameters = NULL;
+    free_buffers(vd);
+    free(vd->tmpbuffer);
+    vd->tmpbuffer = NULL;
     free(vd->videodevice);
     free(vd->status);
     free(vd->pictName);
-    CLOSE_VIDEO(vd->fd);
+    vd->videodevice = NULL;
+    vd->status = NULL;
+    vd->pictName = NULL;
+    if(vd->fd >= 0)
+        CLOSE_VIDEO(vd->fd);
+    vd->fd = -1;
     return -1;
 }
 
 static int init_v4l2(struct vdIn *vd)
 {
-    int i;
+    int i, width, height;
     int ret = 0;
+    unsigned int caps, pixelformat, bytesperline, offset;
     if((vd->fd = OPEN_VIDEO(vd->videodevice, O_RDWR)) == -1) {
         perror("ERROR opening V4L interface");
         DBG("errno: %d", errno);
@@ -212,7 +276,16 @@ static int init_v4l2(struct vdIn *vd)
         goto fatal;
     }
 
-    if((vd->cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) == 0) {
+    /* devices that only know the multi-planar API are used with one plane */
+    if(vd->cap.capabilities & V4L2_CAP_DEVICE_CAPS)
+        caps = vd->cap.device_caps;
+    else
+        caps = vd->cap.capabilities;
+    if(caps & V4L2_CAP_VIDEO_CAPTURE) {
+        vd->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    } else if(caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
+        vd->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    } else {
         fprintf(stderr, "Error opening device %s: video capture not supported.\n",
                 vd->videodevice);
         goto fatal;;
@@ -234,36 +307,77 @@ static int init_v4l2(struct vdIn *vd)
      * set format in
      */
     memset(&vd->fmt, 0, sizeof(struct v4l2_format));
-    vd->fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vd->fmt.fmt.pix.width = vd->width;
-    vd->fmt.fmt.pix.height = vd->height;
-    vd->fmt.fmt.pix.pixelformat = vd->formatIn;
-    vd->fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    vd->fmt.type = vd->type;
+    if(vd->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        vd->fmt.fmt.pix_mp.width = vd->width;
+        vd->fmt.fmt.pix_mp.height = vd->height;
+        vd->fmt.fmt.pix_mp.pixelformat = vd->formatIn;
+        vd->fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+        vd->fmt.fmt.pix_mp.num_planes = 1;
+    } else {
+        vd->fmt.fmt.pix.width = vd->width;
+        vd->fmt.fmt.pix.height = vd->height;
+        vd->fmt.fmt.pix.pixelformat = vd->formatIn;
+        vd->fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    }
     ret = xioctl(vd->fd, VIDIOC_S_FMT, &vd->fmt);
     if(ret < 0) {
         fprintf(stderr, "Unable to set format: %d res: %dx%d\n", vd->formatIn, vd->width, vd->height);
         goto fatal;
     }
 
-    if((vd->fmt.fmt.pix.width != vd->width) ||
-            (vd->fmt.fmt.pix.height != vd->height)) {
-        fprintf(stderr, "i: The format asked unavailable, so the width %d height %d \n", vd->fmt.fmt.pix.width, vd->fmt.fmt.pix.height);
-        vd->width = vd->fmt.fmt.pix.width;
-        vd->height = vd->fmt.fmt.pix.height;
-        /*
-         * look the format is not part of the deal ???
-         */
-        if(vd->formatIn != vd->fmt.fmt.pix.pixelformat) {
-            if(vd->formatIn == V4L2_PIX_FMT_MJPEG) {
-                fprintf(stderr, "The inpout device does not supports MJPEG mode\nYou may also try the YUV mode (-yuv option), but it requires a much more CPU power\n");
-                goto fatal;
-            } else if(vd->formatIn == V4L2_PIX_FMT_YUYV) {
-                fprintf(stderr, "The input device does not supports YUV mode\n");
-                goto fatal;
-            }
+    if(vd->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        if(vd->fmt.fmt.pix_mp.num_planes != 1) {
+            fprintf(stderr, "Formats with %d planes in separate buffers are not supported\n", vd->fmt.fmt.pix_mp.num_planes);
+            goto fatal;
+        }
+        width = vd->fmt.fmt.pix_mp.width;
+        height = vd->fmt.fmt.pix_mp.height;
+        pixelformat = vd->fmt.fmt.pix_mp.pixelformat;
+        vd->sizeimage = vd->fmt.fmt.pix_mp.plane_fmt[0].sizeimage;
+        bytesperline = vd->fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+    } else {
+        width = vd->fmt.fmt.pix.width;
+        height = vd->fmt.fmt.pix.height;
+        pixelformat = vd->fmt.fmt.pix.pixelformat;
+        vd->sizeimage = vd->fmt.fmt.pix.sizeimage;
+        bytesperline = vd->fmt.fmt.pix.bytesperline;
+    }
+
+    /*
+     * the driver picks another format if it does not know the one asked for,
+     * the frames could not be read as they are expected
+     */
+    if(vd->formatIn != pixelformat) {
+        if(vd->formatIn == V4L2_PIX_FMT_MJPEG) {
+            fprintf(stderr, "The inpout device does not supports MJPEG mode\nYou may also try the YUV mode (-yuv option), but it requires a much more CPU power\n");
+        } else if(vd->formatIn == V4L2_PIX_FMT_YUYV) {
+            fprintf(stderr, "The input device does not supports YUV mode\n");
         } else {
-            vd->formatIn = vd->fmt.fmt.pix.pixelformat;
+            fprintf(stderr, "The input device does not support the format %c%c%c%c\n",
+                    vd->formatIn & 0xff, (vd->formatIn >> 8) & 0xff,
+                    (vd->formatIn >> 16) & 0xff, (vd->formatIn >> 24) & 0xff);
         }
+        goto fatal;
+    }
+
+    if((width != vd->width) || (height != vd->height)) {
+        fprintf(stderr, "i: The format asked unavailable, so the width %d height %d \n", width, height);
+        vd->width = width;
+        vd->height = height;
+    }
+
+    /*
+     * uncompressed frames are read with lines of width pixels and the chroma
+     * right after the luma, the lines of a driver that pads them would come
+     * out skewed
+     */
+    if(bytesperline != 0 && packed_bytesperline(vd) != 0 &&
+       bytesperline != packed_bytesperline(vd)) {
+        fprintf(stderr, "The driver pads the lines of %d pixels to %u bytes, this is not supported\n"
+                "You may try another width, a multiple of 16 or 32 pixels is often not padded\n",
+                vd->width, bytesperline);
+        goto fatal;
     }
 
     /*
@@ -272,7 +386,7 @@ static int init_v4l2(struct vdIn *vd)
     struct v4l2_streamparm *setfps;
     setfps = (struct v4l2_streamparm *) calloc(1, sizeof(struct v4l2_streamparm));
     memset(setfps, 0, sizeof(struct v4l2_streamparm));
-    setfps->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    setfps->type = vd->type;
     setfps->parm.capture.timeperframe.numerator = 1;
     setfps->parm.capture.timeperframe.denominator = vd->fps;
     ret = xioctl(vd->fd, VIDIOC_S_PARM, setfps);
@@ -280,38 +394,60 @@ static int init_v4l2(struct vdIn *vd)
     /*
      * request buffers
      */
+    if(vd->memory != V4L2_MEMORY_USERPTR)
+        vd->memory = V4L2_MEMORY_MMAP;
     memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
     vd->rb.count = NB_BUFFER;
-    vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vd->rb.memory = V4L2_MEMORY_MMAP;
+    vd->rb.type = vd->type;
+    vd->rb.memory = vd->memory;
 
     ret = xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb);
     if(ret < 0) {
+        if(vd->memory == V4L2_MEMORY_USERPTR)
+            fprintf(stderr, "%s does not support user pointer i/o\n", vd->videodevice);
         perror("Unable to allocate buffers");
         goto fatal;
     }
 
     /*
-     * map the buffers
+     * map the buffers, or allocate them page aligned for user pointer i/o
      */
     for(i = 0; i < NB_BUFFER; i++) {
-        memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
-        vd->buf.index = i;
-        vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        vd->buf.memory = V4L2_MEMORY_MMAP;
+        if(vd->memory == V4L2_MEMORY_USERPTR) {
+            long page = sysconf(_SC_PAGESIZE);
+
+            vd->length[i] = (raw_framesize(vd) + page - 1) & ~(page - 1);
+            if(posix_memalign(&vd->mem[i], page, vd->length[i]) != 0) {
+                vd->mem[i] = NULL;
+                perror("Unable to allocate buffer");
+                goto fatal;
+            }
+            continue;
+        }
+
+        prepare_buffer(vd, i);
         ret = xioctl(vd->fd, VIDIOC_QUERYBUF, &vd->buf);
         if(ret < 0) {
             perror("Unable to query buffer");
             goto fatal;
         }
 
+        if(vd->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+            vd->length[i] = vd->plane.length;
+            offset = vd->plane.m.mem_offset;
+        } else {
+            vd->length[i] = vd->buf.length;
+            offset = vd->buf.m.offset;
+        }
+
         if(debug)
-            fprintf(stderr, "length: %u offset: %u\n", vd->buf.length, vd->buf.m.offset);
+            fprintf(stderr, "length: %u offset: %u\n", (unsigned int)vd->length[i], offset);
 
         vd->mem[i] = mmap(0 /* start anywhere */ ,
-                          vd->buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, vd->fd,
-                          vd->buf.m.offset);
+                          vd->length[i], PROT_READ | PROT_WRITE, MAP_SHARED, vd->fd,
+                          offset);
         if(vd->mem[i] == MAP_FAILED) {
+            vd->mem[i] = NULL;
             perror("Unable to map buffer");
             goto fatal;
         }
@@ -323,10 +459,14 @@ static int init_v4l2(struct vdIn *vd)
      * Queue the buffers.
      */
     for(i = 0; i < NB_BUFFER; ++i) {
-        memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
-        vd->buf.index = i;
-        vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        vd->buf.memory = V4L2_MEMORY_MMAP;
+        prepare_buffer(vd, i);
+        if(vd->memory == V4L2_MEMORY_USERPTR && vd->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+            vd->plane.m.userptr = (unsigned long)vd->mem[i];
+            vd->plane.length = vd->length[i];
+        } else if(vd->memory == V4L2_MEMORY_USERPTR) {
+            vd->buf.m.userptr = (unsigned long)vd->mem[i];
+            vd->buf.length = vd->length[i];
+        }
         ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
         if(ret < 0) {
             perror("Unable to queue buffer");
@@ -339,9 +479,48 @@ fatal:
 
 }
 
+/******************************************************************************
+Description.: clear vd->buf for an ioctl on buffer index, the multi-planar API
+              gets the single plane of vd->plane
+Input Value.: vd: device, index: number of the buffer
+Return Value: -
+******************************************************************************/
+static void prepare_buffer(struct vdIn *vd, int index)
+{
+    memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
+    vd->buf.index = index;
+    vd->buf.type = vd->type;
+    vd->buf.memory = vd->memory;
+    if(vd->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        memset(&vd->plane, 0, sizeof(struct v4l2_plane));
+        vd->buf.m.planes = &vd->plane;
+        vd->buf.length = 1;
+    }
+}
+
+/******************************************************************************
+Description.: unmap the buffers or free them for user pointer i/o
+Input Value.: vd: device with stopped streaming
+Return Value: -
+******************************************************************************/
+static void free_buffers(struct vdIn *vd)
+{
+    int i;
+
+    for(i = 0; i < NB_BUFFER; i++) {
+        if(vd->mem[i] == NULL)
+            continue;
+        if(vd->memory == V4L2_MEMORY_USERPTR)
+            free(vd->mem[i]);
+        else
+            munmap(vd->mem[i], vd->length[i]);
+        vd->mem[i] = NULL;
+    }
+}
+
 static int video_enable(struct vdIn *vd)
 {
-    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    int type = vd->type;
     int ret;
 
     ret = xioctl(vd->fd, VIDIOC_STREAMON, &type);
@@ -355,7 +534,7 @@ static int video_enable(struct vdIn *vd)
 
 static int video_disable(struct vdIn *vd, streaming_state disabledState)
 {
-    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    int type = vd->type;
     int ret;
     DBG("STopping capture\n");
     ret = xioctl(vd->fd, VIDIOC_STREAMOFF, &type);
@@ -597,7 +776,15 @@ int memcpy_picture(unsigned char *out, unsigned char *buf, int size)
     return pos;
 }
 
-int uvcGrab(struct vdIn *vd)
+/******************************************************************************
+Description.: dequeue the next frame without copying it, the frame stays in the
+              driver's buffer at vd->frame until uvcReleaseBuffer() is called
+Input Value.: vd: streaming device
+Return Value: 0 if a frame was dequeued
+              1 if an empty frame was dropped, nothing needs to be released
+              -1 on errors
+******************************************************************************/
+int uvcGrabBuffer(struct vdIn *vd)
 {
 #define HEADERFRAME1 0xaf
     int ret;
@@ -606,9 +793,7 @@ int uvcGrab(struct vdIn *vd)
         if(video_enable(vd))
             goto err;
     }
-    memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
-    vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vd->buf.memory = V4L2_MEMORY_MMAP;
+    prepare_buffer(vd, 0);
 
     ret = xioctl(vd->fd, VIDIOC_DQBUF, &vd->buf);
     if(ret < 0) {
@@ -616,57 +801,99 @@ int uvcGrab(struct vdIn *vd)
         goto err;
     }
 
-    switch(vd->formatIn) {
-    case V4L2_PIX_FMT_MJPEG:
-        if(vd->buf.bytesused <= HEADERFRAME1) {
-            /* Prevent crash
-                                                        * on empty image */
-            fprintf(stderr, "Ignoring empty buffer ...\n");
-            return 0;
-        }
+    if(vd->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        /* the callers find the size of the single plane in vd->buf,
+           vd->mem holds the user pointers as well */
+        vd->frame = vd->mem[vd->buf.index] + vd->plane.data_offset;
+        vd->buf.bytesused = vd->plane.bytesused - vd->plane.data_offset;
+    } else if(vd->memory == V4L2_MEMORY_USERPTR) {
+        vd->frame = (unsigned char *)vd->buf.m.userptr;
+    } else {
+        vd->frame = vd->mem[vd->buf.index];
+    }
 
-        /* memcpy(vd->tmpbuffer, vd->mem[vd->buf.index], vd->buf.bytesused);
+    /* uncompressed frames can not be longer than the format says */
+    if(vd->formatIn == V4L2_PIX_FMT_H264) {
+        /* access units have no fixed size, the callers clamp them to their buffers */
+    } else if(vd->formatIn != V4L2_PIX_FMT_MJPEG && vd->formatIn != V4L2_PIX_FMT_JPEG) {
+        if(vd->buf.bytesused > raw_framesize(vd))
+            vd->buf.bytesused = raw_framesize(vd);
+    } else if(vd->buf.bytesused <= HEADERFRAME1) {
+        /* Prevent crash on empty image */
+        fprintf(stderr, "Ignoring empty buffer ...\n");
+        return uvcReleaseBuffer(vd) < 0 ? -1 : 1;
+    }
 
-        memcpy (vd->tmpbuffer, vd->mem[vd->buf.index], HEADERFRAME1);
-        memcpy (vd->tmpbuffer + HEADERFRAME1, dht_data, sizeof(dht_data));
-        memcpy (vd->tmpbuffer + HEADERFRAME1 + sizeof(dht_data), vd->mem[vd->buf.index] + HEADERFRAME1, (vd->buf.bytesused - HEADERFRAME1));
-        */
+    if(debug)
+        fprintf(stderr, "bytes in used %d \n", vd->buf.bytesused);
 
-        memcpy(vd->tmpbuffer, vd->mem[vd->buf.index], vd->buf.bytesused);
+    return 0;
 
-        if(debug)
-            fprintf(stderr, "bytes in used %d \n", vd->buf.bytesused);
+err:
+    vd->signalquit = 0;
+    return -1;
+}
+
+/******************************************************************************
+Description.: give the frame of uvcGrabBuffer() back to the driver
+Input Value.: vd: streaming device
+Return Value: 0 if the buffer was queued again, -1 on errors
+******************************************************************************/
+int uvcReleaseBuffer(struct vdIn *vd)
+{
+    vd->frame = NULL;
+    if(xioctl(vd->fd, VIDIOC_QBUF, &vd->buf) < 0) {
+        perror("Unable to requeue buffer");
+        vd->signalquit = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+Description.: grab a frame and copy it, JPEG frames to vd->tmpbuffer and
+              uncompressed ones to vd->framebuffer
+Input Value.: vd: streaming device
+Return Value: 0 if everything is fine, -1 on errors
+******************************************************************************/
+int uvcGrab(struct vdIn *vd)
+{
+    int ret = uvcGrabBuffer(vd);
+
+    if(ret != 0)
+        return ret < 0 ? -1 : 0;
+
+    switch(vd->formatIn) {
+    case V4L2_PIX_FMT_MJPEG:
+    case V4L2_PIX_FMT_JPEG:
+    case V4L2_PIX_FMT_H264:
+        if(vd->buf.bytesused > vd->framesizeIn)
+            memcpy(vd->tmpbuffer, vd->frame, (size_t) vd->framesizeIn);
+        else
+            memcpy(vd->tmpbuffer, vd->frame, (size_t) vd->buf.bytesused);
         break;
 
     case V4L2_PIX_FMT_YUYV:
         if(vd->buf.bytesused > vd->framesizeIn)
-            memcpy(vd->framebuffer, vd->mem[vd->buf.index], (size_t) vd->framesizeIn);
+            memcpy(vd->framebuffer, vd->frame, (size_t) vd->framesizeIn);
         else
-            memcpy(vd->framebuffer, vd->mem[vd->buf.index], (size_t) vd->buf.bytesused);
+            memcpy(vd->framebuffer, vd->frame, (size_t) vd->buf.bytesused);
         break;
 
     default:
-        goto err;
+        memcpy(vd->framebuffer, vd->frame, (size_t) vd->buf.bytesused);
         break;
     }
 
-    ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
-    if(ret < 0) {
-        perror("Unable to requeue buffer");
-        goto err;
-    }
-
-    return 0;
-
-err:
-    vd->signalquit = 0;
-    return -1;
+    return uvcReleaseBuffer(vd);
 }
 
 int close_v4l2(struct vdIn *vd)
 {
     if(vd->streamingState == STREAMING_ON)
         video_disable(vd, STREAMING_OFF);
+    free_buffers(vd);
+    CLOSE_VIDEO(vd->fd);
     if(vd->tmpbuffer)
         free(vd->tmpbuffer);
     vd->tmpbuffer = NULL;
@@ -797,6 +1024,7 @@ int v4l2SetControl(struct vdIn *vd, int control_id, int value, int plugin_number
                 return -1;
             } else {
                 DBG("control id: %d new value: %d\n", ext_ctrl.id, ext_ctrl.value);
+                pglobal->in[plugin_number].in_parameters[i].value = value;
             }
             return 0;
         }
@@ -936,9 +1164,7 @@ int setResolution(struct vdIn *vd, int width, int height)
     vd->streamingState = STREAMING_PAUSED;
     if(video_disable(vd, STREAMING_PAUSED) == 0) {  // do streamoff
         DBG("Unmap buffers\n");
-        int i;
-        for(i = 0; i < NB_BUFFER; i++)
-            munmap(vd->mem[i], vd->buf.length);
+        free_buffers(vd);
 
         if(CLOSE_VIDEO(vd->fd) == 0) {
             DBG("Device closed successfully\n");
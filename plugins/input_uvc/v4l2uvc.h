@@ -76,9 +76,14 @@ struct vdIn {
     char *pictName;
     struct v4l2_capability cap;
     struct v4l2_format fmt;
+    int type;                   /* V4L2_BUF_TYPE_VIDEO_CAPTURE or the _MPLANE one */
     struct v4l2_buffer buf;
+    struct v4l2_plane plane;    /* the plane of buf for the multi-planar API */
     struct v4l2_requestbuffers rb;
+    int memory;                 /* V4L2_MEMORY_MMAP (default) or V4L2_MEMORY_USERPTR */
     void *mem[NB_BUFFER];
+    size_t length[NB_BUFFER];
+    unsigned char *frame;       /* frame dequeued by uvcGrabBuffer() */
     unsigned char *tmpbuffer;
     unsigned char *framebuffer;
     streaming_state streamingState;
@@ -89,6 +94,7 @@ struct vdIn {
     int formatIn;
     int formatOut;
     int framesizeIn;
+    int sizeimage;              /* frame size the driver reported, may be 0 */
     int signalquit;
     int toggleAvi;
     int getPict;
@@ -114,17 +120,23 @@ typedef struct {
     pthread_t threadID;
     pthread_mutex_t controls_mutex;
     struct vdIn *videoIn;
+    int stop_fd;
+    struct JPEG_ENCODER_STRUCTURE *encoder; /* compresses YUYV frames, NULL to use libjpeg */
+    struct _rate_control *rate; /* adapts the quality to a frame size, NULL for a fixed quality */
+    struct _still_detector *still; /* drops the frames of a still scene, NULL to publish all */
 } context;
 
-context cams[MAX_INPUT_PLUGINS];
-
 int init_videoIn(struct vdIn *vd, char *device, int width, int height, int fps, int format, int grabmethod, globals *pglobal, int id);
 void enumerateControls(struct vdIn *vd, globals *pglobal, int id);
 void control_readed(struct vdIn *vd, struct v4l2_queryctrl *ctrl, globals *pglobal, int id);
 int setResolution(struct vdIn *vd, int width, int height);
 
+int is_huffman(unsigned char *buf);
+int put_v4l2_exif(unsigned char *out, const struct timeval *time);
 int memcpy_picture(unsigned char *out, unsigned char *buf, int size);
 int uvcGrab(struct vdIn *vd);
+int uvcGrabBuffer(struct vdIn *vd);
+int uvcReleaseBuffer(struct vdIn *vd);
 int close_v4l2(struct vdIn *vd);
 
 int v4l2GetControl(struct vdIn *vd, int control);
@@ -40,6 +40,8 @@ struct _output_parameter {
 typedef struct _output output;
 struct _output {
     char *plugin;
+    /* a plugin is loaded into several slots only if it exports
+       "const int output_per_id", its state must be kept for each id then */
     void *handle;
     output_parameter param;
 
@@ -48,6 +50,10 @@ struct _output {
     int parametercount;
 
     int (*init)(output_parameter *param, int id);
+    /* wakes up the threads of the plugin and joins them within STOP_TIMEOUT_MS,
+       returns 0 if they finished and the ressources are freed, otherwise -1 and
+       the plugin must not be unloaded. It is also called for an output that
+       was initialized but never run, to free what output_init() set up */
     int (*stop)(int);
     int (*run)(int);
     int (*cmd)(int plugin, unsigned int control_id, unsigned int group, int value);
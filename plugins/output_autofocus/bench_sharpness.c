@@ -0,0 +1,107 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+/*
+ * Measures the time getFrameSharpnessValue needs per frame.
+ * usage: bench_sharpness [-n iterations] picture.jpg [picture.jpg ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "processJPEG_onlyCenter.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *load(const char *name, int *len)
+{
+    FILE *f;
+    long size;
+    unsigned char *buf;
+
+    if((f = fopen(name, "rb")) == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if(size <= 0 || (buf = malloc(size)) == NULL || fread(buf, 1, size, f) != (size_t)size) {
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    *len = size;
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    int i, j, len, iterations = 1000, first = 1;
+    unsigned char *buf;
+    double start, elapsed, sv = 0.0;
+    sharpness_ctx ctx;
+
+    if(argc > 2 && strcmp(argv[1], "-n") == 0) {
+        iterations = atoi(argv[2]);
+        first = 3;
+    }
+
+    if(first >= argc || iterations < 1) {
+        fprintf(stderr, "usage: %s [-n iterations] picture.jpg [picture.jpg ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    sharpness_init(&ctx);
+
+    for(i = first; i < argc; i++) {
+        if((buf = load(argv[i], &len)) == NULL) {
+            fprintf(stderr, "could not read %s\n", argv[i]);
+            continue;
+        }
+
+        /* warm up the caches and the weights of the context */
+        getFrameSharpnessValue(&ctx, buf, len);
+
+        start = now();
+        for(j = 0; j < iterations; j++)
+            sv = getFrameSharpnessValue(&ctx, buf, len);
+        elapsed = now() - start;
+
+        printf("%-40s %4dx%-4d %8d bytes %10.2f us/frame  sharpness %.1f\n",
+               argv[i], ctx.hdr.width, ctx.hdr.height, len, elapsed * 1e6 / iterations, sv);
+
+        free(buf);
+    }
+
+    sharpness_free(&ctx);
+
+    return EXIT_SUCCESS;
+}
@@ -36,6 +36,8 @@
 #include <fcntl.h>
 #include <time.h>
 #include <syslog.h>
+#include <math.h>
+#include <sys/time.h>
 
 #include "../../utils.h"
 #include "../../mjpg_streamer.h"
@@ -45,10 +47,45 @@
 #define OUTPUT_PLUGIN_NAME "autofocus output plugin"
 
 static pthread_t worker;
+static int stop_fd = -1, stopping = 0;
 static globals *pglobal;
-static int fd, delay;
+static int delay, settle, coarse, threshold;
 static unsigned char *frame = NULL;
+static int max_frame_size;
 static int input_number;
+static sharpness_ctx sharpness;
+
+/* 1/phi, ratio of the golden section */
+#define INVPHI 0.6180339887498949
+
+/* remembered measurements, positions are not measured twice during a search */
+#define AF_HISTORY 32
+
+typedef enum _af_state af_state;
+enum _af_state {
+    AF_COARSE,  // sample the whole range at equidistant positions
+    AF_FINE,    // golden section search around the best coarse position
+    AF_FINAL,   // move to the best position and measure the reference
+    AF_LOCKED   // watch the sharpness and restart if the scene changed
+};
+
+typedef struct _autofocus autofocus;
+struct _autofocus {
+    af_state state;
+    int lo, hi;             // range of V4L2_CID_FOCUS_ABSOLUTE
+    int tolerance;          // the search ends if the interval gets smaller
+    int sample;             // index of the coarse sample
+    int best;               // sharpest position found so far
+    double best_sv;
+    int a, b, c, d;         // golden section interval a..b and its inner points
+    double fc, fd;
+    double locked_sv;       // sharpness after the search finished
+    int position;           // position commanded last
+
+    int history_pos[AF_HISTORY];
+    double history_sv[AF_HISTORY];
+    int history_count;
+};
 
 /******************************************************************************
 Description.: print a help message
@@ -61,7 +98,12 @@ void help(void)
             " Help for output plugin..: "OUTPUT_PLUGIN_NAME"\n" \
             " ---------------------------------------------------------------\n" \
             " The following parameters can be passed to this plugin:\n\n" \
-            " [-d | --delay ].........: delay after saving pictures in ms\n" \
+            " [-d | --delay ].........: delay between checks once focused in ms\n" \
+            " [-i | --input ].........: read frames from the specified input plugin\n" \
+            " [-s | --settle ]........: time the lens needs to settle in ms\n" \
+            " [-c | --coarse ]........: number of coarse samples of the range\n" \
+            " [-t | --threshold ].....: refocus if the sharpness changes more\n" \
+            "                           than this (in percent)\n" \
             " ---------------------------------------------------------------\n");
 }
 
@@ -72,21 +114,165 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
+    OPRINT("cleaning up ressources allocated by worker thread\n");
+
+    free(frame);
+    frame = NULL;
+    max_frame_size = 0;
+    sharpness_free(&sharpness);
+    close(stop_fd);
+    stop_fd = -1;
+}
 
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
+/******************************************************************************
+Description.: look for a position in the measurements of the current search
+Input Value.: * af.....: the autofocus state
+              * pos....: the focus position
+              * sv.....: receives the sharpness if found
+Return Value: 1 if the position was measured already, 0 otherwise
+******************************************************************************/
+static int af_lookup(autofocus *af, int pos, double *sv)
+{
+    int i, n = MIN(af->history_count, AF_HISTORY);
+
+    for(i = 0; i < n; i++) {
+        if(af->history_pos[i] == pos) {
+            *sv = af->history_sv[i];
+            return 1;
+        }
     }
 
-    first_run = 0;
-    OPRINT("cleaning up ressources allocated by worker thread\n");
+    return 0;
+}
 
-    free(frame);
-    close(fd);
+static void af_remember(autofocus *af, int pos, double sv)
+{
+    af->history_pos[af->history_count % AF_HISTORY] = pos;
+    af->history_sv[af->history_count % AF_HISTORY] = sv;
+    af->history_count++;
+
+    if(sv > af->best_sv) {
+        af->best = pos;
+        af->best_sv = sv;
+    }
+}
+
+/******************************************************************************
+Description.: begin a new search over the whole range
+Input Value.: the autofocus state
+Return Value: the first position to measure
+******************************************************************************/
+static int af_restart(autofocus *af)
+{
+    af->state = AF_COARSE;
+    af->sample = 0;
+    af->best = af->lo;
+    af->best_sv = -1.0;
+    af->history_count = 0;
+
+    return af->lo;
 }
 
+/******************************************************************************
+Description.: the golden section interval shrank, pick the inner points and
+              return the first one that still needs a measurement
+Input Value.: the autofocus state
+Return Value: the next position to measure, -1 if the search is finished
+******************************************************************************/
+static int af_golden(autofocus *af)
+{
+    while(af->b - af->a > af->tolerance) {
+        af->c = af->b - (int)lround((af->b - af->a) * INVPHI);
+        af->d = af->a + (int)lround((af->b - af->a) * INVPHI);
 
+        if(af->c >= af->d)
+            break;
+        if(!af_lookup(af, af->c, &af->fc))
+            return af->c;
+        if(!af_lookup(af, af->d, &af->fd))
+            return af->d;
+
+        /* the maximum is within the interval around the better point */
+        if(af->fc >= af->fd)
+            af->b = af->d;
+        else
+            af->a = af->c;
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+Description.: feed the sharpness of a frame taken at the commanded position
+              and get the next position
+Input Value.: * af.....: the autofocus state
+              * sv.....: sharpness measured at af->position
+Return Value: the next position to command, -1 to keep the current one
+******************************************************************************/
+static int af_step(autofocus *af, double sv)
+{
+    int pos, span;
+
+    switch(af->state) {
+    case AF_COARSE:
+        af_remember(af, af->position, sv);
+
+        if(++af->sample < coarse) {
+            return af->lo + (int)((long long)(af->hi - af->lo) * af->sample / (coarse - 1));
+        }
+
+        /* the sharpness peak is next to the best coarse sample */
+        span = (af->hi - af->lo) / (coarse - 1);
+        af->a = MAX(af->best - span, af->lo);
+        af->b = MIN(af->best + span, af->hi);
+        af->state = AF_FINE;
+        DBG("coarse best at %d, searching %d..%d\n", af->best, af->a, af->b);
+
+        if((pos = af_golden(af)) >= 0)
+            return pos;
+        break;
+
+    case AF_FINE:
+        af_remember(af, af->position, sv);
+
+        if((pos = af_golden(af)) >= 0)
+            return pos;
+        break;
+
+    case AF_FINAL:
+        af->locked_sv = sv;
+        af->state = AF_LOCKED;
+        OPRINT("focus locked at %d (sharpness %.1f)\n", af->position, sv);
+        return -1;
+
+    case AF_LOCKED:
+        if(fabs(sv - af->locked_sv) > af->locked_sv * threshold / 100.0) {
+            DBG("sharpness changed from %.1f to %.1f, refocusing\n", af->locked_sv, sv);
+            return af_restart(af);
+        }
+        return -1;
+    }
+
+    /* the search ended, the reference is measured at the best position */
+    af->state = AF_FINAL;
+    return af->best;
+}
+
+/******************************************************************************
+Description.: time of a frame in the clock of the input, inputs that do not
+              provide a timestamp are given the time the frame arrived
+Input Value.: the timestamp of the input
+Return Value: microseconds
+******************************************************************************/
+static long long frame_time(struct timeval *timestamp)
+{
+    struct timeval tv = *timestamp;
+
+    if(tv.tv_sec == 0 && tv.tv_usec == 0)
+        gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
 
 /******************************************************************************
 Description.: this is the main worker thread
@@ -96,72 +282,116 @@ Return Value:
 ******************************************************************************/
 void *worker_thread(void *arg)
 {
-    int frame_size = 0;
-    double sv = -1.0, max_sv = 100.0, delta = 500;
-    int focus = 255, step = 10, max_focus = 100, search_focus = 1;
+    int frame_size = 0, i, pos;
+    unsigned char *tmp = NULL;
+    long long ts, last_ts = 0, settled = 0;
+    double sv;
+    input *in = &pglobal->in[input_number];
+    autofocus af;
+
+    sharpness_init(&sharpness);
+
+    memset(&af, 0, sizeof(af));
+    af.lo = 0;
+    af.hi = 255;
+    af.tolerance = 1;
+
+    /* take the range of the focus from the controls of the input */
+    for(i = 0; i < in->parametercount; i++) {
+        if(in->in_parameters[i].ctrl.id == V4L2_CID_FOCUS_ABSOLUTE) {
+            af.lo = in->in_parameters[i].ctrl.minimum;
+            af.hi = in->in_parameters[i].ctrl.maximum;
+            af.tolerance = MAX(in->in_parameters[i].ctrl.step, 1);
+        }
+        if(in->in_parameters[i].ctrl.id == V4L2_CID_FOCUS_AUTO) {
+            pglobal->command(Dest_Input, input_number, V4L2_CID_FOCUS_AUTO, IN_CMD_V4L2, 0);
+        }
+    }
 
-    if((frame = malloc(256 * 1024)) == NULL) {
-        OPRINT("not enough memory for worker thread\n");
-        exit(EXIT_FAILURE);
+    /* the last steps of the search are below the resolution of the sharpness */
+    af.tolerance = MAX(af.tolerance, (af.hi - af.lo) / 32);
+    OPRINT("focus range.......: %d..%d\n", af.lo, af.hi);
+
+    /* the first frame starts the clock the settle time refers to */
+    pthread_mutex_lock(&in->db);
+    if(!stopping)
+        pthread_cond_wait(&in->db_update, &in->db);
+    if(stopping) {
+        pthread_mutex_unlock(&in->db);
+        return NULL;
     }
+    last_ts = frame_time(&in->timestamp);
+    pthread_mutex_unlock(&in->db);
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
+    pos = af_restart(&af);
 
     while(!pglobal->stop) {
+        /* move the lens, only frames taken after it settled are evaluated */
+        if(pos >= 0) {
+            if(pglobal->command(Dest_Input, input_number, V4L2_CID_FOCUS_ABSOLUTE, IN_CMD_V4L2, pos) != 0) {
+                OPRINT("input %d can not set V4L2_CID_FOCUS_ABSOLUTE, giving up\n", input_number);
+                break;
+            }
+            af.position = pos;
+            settled = last_ts + settle * 1000LL;
+            DBG("focus set to %d\n", pos);
+        }
+
         DBG("waiting for fresh frame\n");
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        pthread_mutex_lock(&in->db);
+        if(!stopping)
+            pthread_cond_wait(&in->db_update, &in->db);
+        if(stopping) {
+            pthread_mutex_unlock(&in->db);
+            break;
+        }
+
+        /* a frame that is not used is not copied either */
+        ts = frame_time(&in->timestamp);
+        if(ts < settled) {
+            pthread_mutex_unlock(&in->db);
+            last_ts = MAX(last_ts, ts);
+            pos = -1;
+            continue;
+        }
 
         /* read buffer */
-        frame_size = pglobal->in[input_number].size;
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
+        frame_size = in->size;
 
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        /* check if buffer for frame is large enough, increase it if necessary */
+        if(frame_size > max_frame_size) {
+            DBG("increasing buffer size to %d\n", frame_size);
 
-        /* process frame */
-        sv = getFrameSharpnessValue(frame, frame_size);
-        DBG("sharpness is: %f\n", sv);
-
-        if(search_focus || (ABS(sv - max_sv) > delta)) {
-            DBG("adjusting focus: %d\n", focus);
-
-            /* entered because focus changed */
-            if(!search_focus) {
-                DBG("starting to search for focus\n");
-                max_focus    = 255;
-                focus        = 255;
-                max_sv       = -1.0;
-                search_focus = 1;
+            if((tmp = realloc(frame, frame_size + (1 << 16))) == NULL) {
+                pthread_mutex_unlock(&in->db);
+                LOG("not enough memory\n");
+                break;
             }
+            frame = tmp;
+            max_frame_size = frame_size + (1 << 16);
+        }
 
-            if(focus <= 0) {
-                focus = max_focus;
-                DBG("max focus found at: %d\n", max_focus);
-                search_focus = 0;
-            }
+        memcpy(frame, in->buf, frame_size);
 
-            if(search_focus) {
-                if(sv > max_sv) {
-                    /* sharpness is better then max now */
-                    DBG("found better focus at: %d\n", focus);
-                    max_focus = focus;
-                    max_sv = sv;
-                }
-
-                focus = MIN(MAX(focus - step, 0), 255);
-                DBG("decrement focus now to: %d\n", focus);
-                //focus = pglobal->in.cmd(IN_CMD_FOCUS_SET, focus);
-            }
+        pthread_mutex_unlock(&in->db);
+        last_ts = ts;
+
+        /* process frame */
+        sv = getFrameSharpnessValue(&sharpness, frame, frame_size);
+        DBG("sharpness at %d is: %f\n", af.position, sv);
+        if(sv < 0) {
+            pos = -1;
+            continue;
         }
 
-        if((delay > 0) && !search_focus) {
-            usleep(1000 * delay);
+        pos = af_step(&af, sv);
+
+        if((delay > 0) && af.state == AF_LOCKED && pos < 0) {
+            if(stop_event_wait(stop_fd, delay))
+                break;
         }
     }
 
-    pthread_cleanup_pop(1);
-
     return NULL;
 }
 
@@ -177,6 +407,9 @@ int output_init(output_parameter *param)
     int i;
 
     delay = 10000;
+    settle = 100;
+    coarse = 5;
+    threshold = 30;
 
     param->argv[0] = OUTPUT_PLUGIN_NAME;
 
@@ -196,6 +429,12 @@ int output_init(output_parameter *param)
             {"delay", required_argument, 0, 0},
             {"i", required_argument, 0, 0},
             {"input", required_argument, 0, 0},
+            {"s", required_argument, 0, 0},
+            {"settle", required_argument, 0, 0},
+            {"c", required_argument, 0, 0},
+            {"coarse", required_argument, 0, 0},
+            {"t", required_argument, 0, 0},
+            {"threshold", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -230,36 +469,88 @@ int output_init(output_parameter *param)
         case 5:
             input_number = atoi(optarg);
             break;
+
+            /* s, settle */
+        case 6:
+        case 7:
+            settle = atoi(optarg);
+            break;
+
+            /* c, coarse */
+        case 8:
+        case 9:
+            coarse = MAX(atoi(optarg), 2);
+            break;
+
+            /* t, threshold */
+        case 10:
+        case 11:
+            threshold = atoi(optarg);
+            break;
         }
     }
 
     pglobal = param->global;
 
+    if(input_number < 0 || input_number >= pglobal->incnt) {
+        OPRINT("ERROR: the %d input_plugin number is too much only %d plugins loaded\n", input_number, pglobal->incnt);
+        return 1;
+    }
+
+    OPRINT("input plugin......: %d: %s\n", input_number, pglobal->in[input_number].plugin);
     OPRINT("delay.............: %d\n", delay);
+    OPRINT("settle time.......: %d ms\n", settle);
+    OPRINT("coarse samples....: %d\n", coarse);
+    OPRINT("threshold.........: %d%%\n", threshold);
     return 0;
 }
 
 /******************************************************************************
 Description.: calling this function stops the worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the thread finished, -1 if it did not in time
 ******************************************************************************/
 int output_stop(int id)
 {
-    DBG("will cancel worker thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+
+    /* loaded but never run, there is no thread */
+    if(stop_fd < 0)
+        return 0;
+
+    DBG("will stop worker thread\n");
+    stop_deadline(&deadline);
+
+    /* the thread waits for a frame or sleeps while the focus is locked */
+    pthread_mutex_lock(&pglobal->in[input_number].db);
+    stopping = 1;
+    pthread_cond_broadcast(&pglobal->in[input_number].db_update);
+    pthread_mutex_unlock(&pglobal->in[input_number].db);
+    stop_event_set(stop_fd);
+
+    if(join_thread(worker, &deadline) != 0) {
+        OPRINT("worker thread did not finish in time\n");
+        return -1;
+    }
+
+    worker_cleanup(NULL);
     return 0;
 }
 
 /******************************************************************************
 Description.: calling this function creates and starts the worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if ok, 1 if the stop event could not be created
 ******************************************************************************/
 int output_run(int id)
 {
+    stopping = 0;
+    if((stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        return 1;
+    }
+
     DBG("launching worker thread\n");
     pthread_create(&worker, 0, worker_thread, NULL);
-    pthread_detach(worker);
     return 0;
 }
@@ -21,308 +21,241 @@
 #                                                                              #
 *******************************************************************************/
 
-#include <stdio.h>
-#include <assert.h>
-#include <malloc.h>
-#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #include "processJPEG_onlyCenter.h"
 
-double getFrameSharpnessValue(unsigned char *data, int len)
+/* only the low frequency AC coefficients 1..SHARPNESS_COEFFS are evaluated */
+#define SHARPNESS_COEFFS 20
+
+/* number of the anti-diagonal a coefficient in zig-zag order belongs to */
+static const int diagonal[SHARPNESS_COEFFS + 1] = {
+    0, 1, 1, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5
+};
+
+/******************************************************************************
+Description.: decode one 8x8 block and calculate the weighted energy of its
+              low frequency AC coefficients
+Input Value.: * br.....: bitreader at the start of the block
+              * c......: component this block belongs to
+              * q......: quantization table of the component
+              * energy.: receives the energy, NULL to skip the block only
+Return Value: 0 if ok, -1 for corrupt data
+******************************************************************************/
+static inline int scan_block(bitreader *br, const scan_huff *dct, const scan_huff *act,
+                             scan_component *c, const unsigned short *q, double *energy)
 {
-    int Gpos = 0;
-    char c; unsigned short int cnt; int i;
-    int cnt2 = 0;
-    unsigned char uc;
-    assert(sizeof(cnt) == 2);
-    assert(sizeof(int) == 4);
-    unsigned char *buffer;
-    double sumAC[64];
-    double sumSqrAC[64];
-
-    int width = -1; int height = -1;
-    int huffman_DCY = -1; int huffman_ACY = -1;
-    int quant_Y = -1;
-    int scaleH_Y = 0; int scaleV_Y = 0;
-
-    unsigned char dht_lookup_bitlen[4][162];
-    unsigned int dht_lookup_bits[4][162];
-    unsigned int dht_lookup_mask[4][162];
-    unsigned char dht_lookup_code[4][162];
-    unsigned char dht_lookup_size[4];
-
-    float *QT[4] = { NULL, NULL, NULL, NULL };
-
-    unsigned int mask[17] = { 0x00000000, 0x00000001, 0x00000003, 0x00000007, 0x0000000f, 0x0000001f, 0x0000003f, 0x0000007f, 0x000000ff, 0x000001ff, 0x000003ff, 0x000007ff, 0x00000fff, 0x00001fff, 0x00003fff, 0x00007fff, 0x0000ffff };
-
-    char fgetc_(void) {
-        return data[Gpos++];
+    int s, r, rs, k, v, idx, f;
+    double x, e = 0.0;
+
+    if((s = huff_decode(br, dct)) < 0 || s > 11)
+        return -1;
+    if(s != 0) {
+        v = br_get(br, s);
+        c->pred += HUFF_EXTEND(v, s);
     }
 
-    while(!(Gpos >= len)) {
-        c = fgetc_();
-        while(c != '\xff') {
-            c = fgetc_();
-        }
-        c = fgetc_();
-        if(c == '\xd8' || c == '\xe0' || c == '\x00') {
-            continue;
-        } else if(c == '\xdb') { // read in quantization table
-            c = fgetc_(); cnt = (unsigned char)(c) * 256;
-            c = fgetc_(); cnt += (unsigned char)(c);
-            assert(cnt == 67);
-            uc = fgetc_(); if((uc >> 4) != 0) {
-                fprintf(stderr, "16bit quantization table not supported\n");
-                exit(-1);
-            }
-            int tab = uc & 0x0f;
-            QT[tab] = (float *)malloc(64 * sizeof(float));
-            unsigned char hc = 0; int j;
-            for(j = 0; j < 64; j++) {
-                uc = fgetc_(); QT[tab][j] = (float)uc;
-                hc ^= uc;
-            }
-        } else if(c == '\xc4') { // read in huffmann table
-            // 0 and 2 are DC tables (0-15), 1 and 3 are AC tables (0-255)
-            c = fgetc_(); cnt = (unsigned char)(c) * 256;
-            c = fgetc_(); cnt += (unsigned char)(c);
-            buffer = data + Gpos; Gpos += cnt - 2;
-
-            // parse huffman table...
-            int pos = 0; unsigned short int tab = 0;
-            do {
-                uc = buffer[pos]; pos++;
-                tab = (uc >> 4) + (uc & 0x0f) * 2;
-                tab = (uc & 0x0f) * 2 + (uc >> 4);
-                int pos2 = pos + 16;
-                unsigned char DhtCodesLen[16];
-                int i_len; int table_ind = 0;
-                int code_val = 0; int ind_code;
-                for(i_len = 1; i_len <= 16; i_len++) {
-                    DhtCodesLen[i_len-1] = (unsigned char)(buffer[pos+i_len-1]);
-                    for(ind_code = 0; ind_code < DhtCodesLen[i_len-1]; ind_code++) {
-                        dht_lookup_code[tab][table_ind] = buffer[pos2++];
-                        dht_lookup_bits[tab][table_ind] = (code_val << (32 - i_len));
-                        dht_lookup_mask[tab][table_ind] = ((1 << (i_len)) - 1) << (32 - i_len);
-                        dht_lookup_bitlen[tab][table_ind] = i_len;
-
-                        table_ind++; code_val++;
-                    }
-                    code_val <<= 1;
-                }
-                dht_lookup_size[tab] = table_ind;
-                pos = pos2;
-            } while(pos < cnt - 2);
-        } else if(c == '\xda') { // start frame, followed by entropy-coded data
-            c = fgetc_(); assert(c == '\x00');
-            c = fgetc_(); assert(c == '\x0c'); // length: 12
-            c = fgetc_(); assert(c == '\x03'); // three components
-            for(i = 0; i < 3; i++) {
-                int comp_id;
-                c = fgetc_(); comp_id = c;
-                c = fgetc_();
-                if(comp_id == 1) { // Y
-                    huffman_DCY = (unsigned)(c) >> 4;
-                    huffman_ACY = (unsigned)(c) & 0x0f;
-                }
-            }
-            // Y: 0/0, Cb & Cr: 1/1
-            c = fgetc_(); c = fgetc_(); c = fgetc_(); // skip three bytes
-
-            int data; uc = fgetc_(); int bitlen = 16; int bits_used = 0;
-            data = uc << 24; uc = fgetc_(); data |= uc << 16;
-
-            // read one XC coefficient from any table via huffmann code
-            int readXC(int tab) {
-                while(bitlen < 16) {
-                    uc = fgetc_();
-                    data = data | (uc << (24 - bitlen));
-                    bitlen += 8;
-                    if(((char)uc) == '\xff') {
-                        uc = fgetc_();
-                        if(((char)uc) == '\x00') {
-                            uc = fgetc_();
-                        }
-                        data = data | (uc << (24 - bitlen));
-                        bitlen += 8;
-                    }
-                }
-                int ind = 0; int done = 0; int res = -1;
-                while(done == 0) {
-                    if((data & dht_lookup_mask[tab][ind]) == dht_lookup_bits[tab][ind]) {
-                        res = dht_lookup_code[tab][ind];
-                        bits_used = dht_lookup_bitlen[tab][ind];
-                        done = 1;
-                    }
-                    ind++;
+    for(k = 1; k < 64; k++) {
+        if(br->nbits < 32)
+            br_fill(br);
 
-                    if(ind >= dht_lookup_size[tab]) {
-                        /*fprintf(stderr,"Code not found in huffmann table.\n");*/ return -1;
-                    }
-                }
-                data = data << bits_used; bitlen -= bits_used;
-                while(bitlen < 16) {
-                    uc = fgetc_();
-                    data = data | (uc << (24 - bitlen));
-                    bitlen += 8;
-                    if(((char)uc) == '\xff') {
-                        uc = fgetc_();
-                        if(((char)uc) == '\x00') {
-                            uc = fgetc_();
-                        }
-                        data = data | (uc << (24 - bitlen));
-                        bitlen += 8;
-                    }
-                }
-                return res;
-            }
+        idx = br_peek(br, SCAN_LOOKAHEAD);
+        if((f = act->fast[idx]) != 0) {
+            k += f >> 12;
+            br->nbits -= (f >> 8) & 0x0f;
+            v = act->fast_val[idx];
+        } else {
+            if((rs = huff_decode(br, act)) < 0)
+                return -1;
 
-            int readTable(int tabDC, int tabAC, int * lastDC, int * table) {
-                int j;
-                for(j = 0; j < 64; j++) {
-                    table[j] = 0;
-                }
-                int size_val = readXC(tabDC); if(size_val < 0) {
-                    return -1;
-                }
-                int DC = (data >> (32 - size_val)) & mask[size_val]; data <<= size_val; bitlen -= size_val; // true value is next size_val bits
-                DC = HUFF_EXTEND(DC, size_val); DC += *lastDC; *lastDC = DC;
-                table[0] = DC;
-                j = 0; int EOB = 0;
-                while(j < 63 && (EOB == 0)) {
-                    int comb = readXC(tabAC); if(comb < 0) {
-                        return -1;
-                    }
-                    int val = comb & 0x0f;
-                    int repeat = comb >> 4;
-                    if(val == 0) {
-                        if(repeat == 0x0f) {
-                            j += 16;
-                        } else {
-                            EOB = 1;
-                        }
-                    } else {
-                        j += repeat;
-                        DC = (data >> (32 - val)) & mask[val]; data <<= val; bitlen -= val;
-                        DC = HUFF_EXTEND(DC, val); table[j+1] = DC; j++;
-                    }
-                }
-                if(j <= 63) {
-                    return 0;
-                } else {
-                    /*fprintf(stderr,"ERROR: too many AC entries: %d\n",j);*/ return -1;
-                }
+            r = rs >> 4;
+            s = rs & 0x0f;
+            if(s == 0) {
+                if(r != 15)
+                    break;
+                k += 15;
+                continue;
             }
 
-            cnt = ((int)(width / 8 / scaleH_Y + 0.5)) * ((int)(height / 8 / scaleV_Y + 0.5));
+            k += r;
+            v = br_get(br, s);
+            v = HUFF_EXTEND(v, s);
+        }
 
-            int ctx = (int)(width / 8 + 0.5); int cty = (int)(height / 8 + 0.5);
-            ctx /= 2; cty /= 2; int rad = ctx / 2; if(cty < ctx) {
-                rad = cty / 2;
-            }
-            rad = rad * rad;
-            int xp = 0; int yp = 0;
+        if(energy != NULL && k <= SHARPNESS_COEFFS) {
+            x = (double)v * q[k];
+            e += diagonal[k] * x * x;
+        }
+    }
 
-            int lastDCY = 0; int lastDCCr = 0; int lastDCCb = 0;
-            int j; for(j = 0; j < 64; j++) {
-                sumAC[j] = 0.0;
-                sumSqrAC[j] = 0.0;
-            }
-            for(i = 0; i < cnt; i++) {
-                int table[128];
+    if(k > 64)
+        return -1;
 
-                if(readTable(huffman_DCY, huffman_ACY + 1, &lastDCY, table) < 0) {
-                    goto err;
-                }
+    if(energy != NULL)
+        *energy = e;
 
-                // weight by distance to center (gaussian?)
-                double xp_ = xp - ctx; double yp_ = yp - ctx;
-                double weight = exp(-(xp_ * xp_) / rad - (yp_ * yp_) / rad);
-                for(j = 0; j < 64; j++) {
-                    double x = (table[j] * QT[0][j]) * (table[j] * QT[0][j]) * weight;
-                    sumAC[j] += x;
-                    sumSqrAC[j] += x * x;
-                }
-                cnt2++;
-                xp++;
-                if(readTable(huffman_DCY, huffman_ACY + 1, &lastDCY, table) < 0) {
-                    goto err;
-                }
-                xp_ = xp - ctx; yp_ = yp - ctx;
-                weight = exp(-(xp_ * xp_) / rad - (yp_ * yp_) / rad);
-                for(j = 0; j < 64; j++) {
-                    double x = (table[j] * QT[0][j]) * (table[j] * QT[0][j]) * weight;
-                    sumAC[j] += x;
-                    sumSqrAC[j] += x * x;
-                }
-                cnt2++;
+    return 0;
+}
+
+/* gaussian weight of each luminance block, centered in the picture */
+static int update_weights(sharpness_ctx *ctx, int bw, int bh)
+{
+    int x, y;
+    double cx = bw / 2.0, cy = bh / 2.0, rad;
+
+    if(ctx->weight != NULL && ctx->weight_w == bw && ctx->weight_h == bh)
+        return 0;
+
+    free(ctx->weight);
+    if((ctx->weight = malloc(bw * bh * sizeof(float))) == NULL) {
+        ctx->weight_w = ctx->weight_h = 0;
+        return -1;
+    }
+
+    rad = ((cy < cx) ? cy : cx) / 2.0;
+    rad = (rad > 0.5) ? rad * rad : 0.25;
+
+    for(y = 0; y < bh; y++) {
+        for(x = 0; x < bw; x++) {
+            double dx = x - cx, dy = y - cy;
+            ctx->weight[y * bw + x] = exp(-(dx * dx) / rad - (dy * dy) / rad);
+        }
+    }
+
+    ctx->weight_w = bw;
+    ctx->weight_h = bh;
+    return 0;
+}
+
+/* results of scan() */
+typedef struct {
+    sharpness_ctx *ctx;
+    double sum;     /* sum of the weighted energies */
+    int blocks;     /* number of luminance blocks */
+} scan_result;
 
-                // ignore  C components
-                if(readTable(2, 3, &lastDCCr, table) < 0) {
-                    goto err;
+/******************************************************************************
+Description.: decode a scan and sum up the energy of the luminance blocks,
+              called by scan_parse
+Input Value.: * hdr....: parsed tables and frame header
+              * sc, ns.: components of this scan
+              * br.....: positioned at the entropy coded data
+              * arg....: the scan_result to fill
+Return Value: 0 if ok, -1 for corrupt data
+******************************************************************************/
+static int scan(scan_header *hdr, const int *sc, int ns, bitreader *br, void *arg)
+{
+    scan_result *res = arg;
+    sharpness_ctx *ctx = res->ctx;
+    scan_component *y = &hdr->comp[0];
+    int i, h, v, mx, my, mcu = 0, bw, bh;
+    double e;
+
+    bw = hdr->mcux * y->h;
+    bh = hdr->mcuy * y->v;
+
+    if(update_weights(ctx, bw, bh) < 0)
+        return -1;
+
+    res->sum = 0.0;
+    res->blocks = 0;
+
+    if(ns == 1) {
+        scan_component *c = &hdr->comp[sc[0]];
+        int bx = ((hdr->width * c->h + hdr->hmax - 1) / hdr->hmax + 7) / 8;
+        int by = ((hdr->height * c->v + hdr->vmax - 1) / hdr->vmax + 7) / 8;
+
+        for(my = 0; my < by; my++) {
+            for(mx = 0; mx < bx; mx++, mcu++) {
+                if(hdr->restart_interval && mcu && (mcu % hdr->restart_interval) == 0) {
+                    if(scan_restart(br) < 0)
+                        return -1;
+                    c->pred = 0;
                 }
-                if(readTable(2, 3, &lastDCCb, table) < 0) {
-                    goto err;
+                if(scan_block(br, &hdr->dc_tables[c->td], &hdr->ac_tables[c->ta], c,
+                              hdr->qt[c->tq], (sc[0] == 0) ? &e : NULL) < 0)
+                    return -1;
+                if(sc[0] == 0) {
+                    res->sum += e * ctx->weight[my * bw + mx];
+                    res->blocks++;
                 }
+            }
+        }
+        return 0;
+    }
 
-                xp++; if(xp == (int)(width / 8 + 0.5)) {
-                    xp = 0;
-                    yp++;
-                }
+    for(my = 0; my < hdr->mcuy; my++) {
+        for(mx = 0; mx < hdr->mcux; mx++, mcu++) {
+            if(hdr->restart_interval && mcu && (mcu % hdr->restart_interval) == 0) {
+                if(scan_restart(br) < 0)
+                    return -1;
+                for(i = 0; i < hdr->ncomp; i++)
+                    hdr->comp[i].pred = 0;
             }
-        } else if(c == '\xd9') { // end of file
-        } else if(c == '\xc0') { // start of frame
-            c = fgetc_(); cnt = (unsigned char)(c) * 256;
-            c = fgetc_(); cnt += (unsigned char)(c);
-
-            uc = fgetc_();
-            c = fgetc_(); cnt = (unsigned char)(c) * 256;
-            c = fgetc_(); cnt += (unsigned char)(c);
-            height = cnt;
-            c = fgetc_(); cnt = (unsigned char)(c) * 256;
-            c = fgetc_(); cnt += (unsigned char)(c);
-            width = cnt;
-            uc = fgetc_();
-            assert((int)uc == 3);
-
-            int j;
-            for(j = 0; j < uc; j++) {
-                c = fgetc_(); int id = (unsigned)c;
-                c = fgetc_();
-                if(c != '\x11') {
-                    if(id == 1) {
-                        scaleH_Y = ((unsigned)c) >> 4;
-                        scaleV_Y = ((unsigned)c) & 0x0f;
-                    } else {
-                        fprintf(stderr, "Sampling > 1 not supported for non-Y channels.\n");
-                        exit(-2);
+
+            for(i = 0; i < ns; i++) {
+                scan_component *c = &hdr->comp[sc[i]];
+                const scan_huff *dct = &hdr->dc_tables[c->td];
+                const scan_huff *act = &hdr->ac_tables[c->ta];
+
+                for(v = 0; v < c->v; v++) {
+                    for(h = 0; h < c->h; h++) {
+                        /* the chrominance blocks are decoded but ignored */
+                        if(scan_block(br, dct, act, c, hdr->qt[c->tq], (sc[i] == 0) ? &e : NULL) < 0)
+                            return -1;
+                        if(sc[i] == 0) {
+                            res->sum += e * ctx->weight[(my * y->v + v) * bw + mx * y->h + h];
+                            res->blocks++;
+                        }
                     }
                 }
-                c = fgetc_();
-                if(id == 1) {
-                    quant_Y = (unsigned)c;
-                }
             }
-        } else {
         }
     }
-    int j; int lenCurSeq = 2; int lenPrevTotal = 1; int valCurSeq = 1;
-    double sum = 0.0;
-    for(j = 0; j < 4; j++) {
-        free(QT[j]);
-    }
-    for(j = 1; j < 21; j++) {
-        if(j >= lenPrevTotal + lenCurSeq) {
-            lenCurSeq++;
-            lenPrevTotal = j;
-            valCurSeq++;
-        }
-        sumAC[j] /= (double)(cnt2);
-        sum += (double)valCurSeq * sumAC[j];
-    }
-    return sum;
 
-err:
-    return -1.0;
+    return 0;
+}
+
+/******************************************************************************
+Description.: prepare a context, it is required for getFrameSharpnessValue
+Input Value.: the context
+Return Value: -
+******************************************************************************/
+void sharpness_init(sharpness_ctx *ctx)
+{
+    memset(ctx, 0, sizeof(sharpness_ctx));
+}
+
+/******************************************************************************
+Description.: free the ressources of a context
+Input Value.: the context
+Return Value: -
+******************************************************************************/
+void sharpness_free(sharpness_ctx *ctx)
+{
+    free(ctx->weight);
+    ctx->weight = NULL;
+    ctx->weight_w = ctx->weight_h = 0;
+}
+
+/******************************************************************************
+Description.: estimate the sharpness of a picture from the low frequency AC
+              coefficients of the luminance. The blocks in the center of the
+              picture contribute most.
+Input Value.: * ctx....: the context, one per thread
+              * data...: the JPEG picture
+              * len....: size of the picture
+Return Value: the sharpness value (higher is sharper), -1.0 in case of error
+******************************************************************************/
+double getFrameSharpnessValue(sharpness_ctx *ctx, const unsigned char *data, int len)
+{
+    scan_result res;
+
+    res.ctx = ctx;
+    if(scan_parse(&ctx->hdr, data, len, scan, &res) < 0 || res.blocks == 0)
+        return -1.0;
+
+    return res.sum / res.blocks;
 }
@@ -1,4 +1,26 @@
-#define HUFF_EXTEND(x,s)  ((x) < (1<<((s)-1)) ? (x) + (((-1)<<(s)) + 1) : (x))
+#ifndef PROCESSJPEG_ONLYCENTER_H
+#define PROCESSJPEG_ONLYCENTER_H
 
-// haven't done restart markers, but these don't seem to appear
-double getFrameSharpnessValue(unsigned char *data, int len);
+#include "../output_motion/jpegscan.h"
+
+/*
+ * Keeps everything needed to scan the coefficients of a JPEG picture, one
+ * context is required per thread. It can be reused for every frame, the
+ * weights are only computed again if the resolution changes.
+ */
+typedef struct _sharpness_ctx sharpness_ctx;
+struct _sharpness_ctx {
+    scan_header hdr;
+
+    /* weight of each luminance block, decreasing with distance to center */
+    float *weight;
+    int weight_w, weight_h;
+};
+
+void sharpness_init(sharpness_ctx *ctx);
+void sharpness_free(sharpness_ctx *ctx);
+
+/* baseline JPEGs only, restart markers are supported */
+double getFrameSharpnessValue(sharpness_ctx *ctx, const unsigned char *data, int len);
+
+#endif
@@ -45,6 +45,7 @@
 #define OUTPUT_PLUGIN_NAME "FILE output plugin"
 
 static pthread_t worker;
+static int stop_fd = -1, stopping = 0;
 static globals *pglobal;
 static int fd, delay, ringbuffer_size = -1, ringbuffer_exceed = 0, max_frame_size;
 static char *folder = "/tmp";
@@ -80,20 +81,14 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
-
-    first_run = 0;
     OPRINT("cleaning up ressources allocated by worker thread\n");
 
     if(frame != NULL) {
         free(frame);
+        frame = NULL;
     }
-    close(fd);
+    close(stop_fd);
+    stop_fd = -1;
 }
 
 /******************************************************************************
@@ -202,13 +197,15 @@ void *worker_thread(void *arg)
     struct tm *now;
     unsigned char *tmp_framebuffer = NULL;
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
-
     while(ok >= 0 && !pglobal->stop) {
         DBG("waiting for fresh frame\n");
         pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(!stopping)
+            pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(stopping) {
+            pthread_mutex_unlock(&pglobal->in[input_number].db);
+            break;
+        }
 
         /* read buffer */
         frame_size = pglobal->in[input_number].size;
@@ -308,14 +305,11 @@ void *worker_thread(void *arg)
         }
 
         /* if specified, wait now */
-        if(delay > 0) {
-            usleep(1000 * delay);
+        if(delay > 0 && stop_event_wait(stop_fd, delay)) {
+            break;
         }
     }
 
-    /* cleanup now */
-    pthread_cleanup_pop(1);
-
     return NULL;
 }
 
@@ -448,12 +442,32 @@ int output_init(output_parameter *param)
 /******************************************************************************
 Description.: calling this function stops the worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the thread finished, -1 if it did not in time
 ******************************************************************************/
 int output_stop(int id)
 {
-    DBG("will cancel worker thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+
+    /* loaded but never run, there is no thread */
+    if(stop_fd < 0)
+        return 0;
+
+    DBG("will stop worker thread\n");
+    stop_deadline(&deadline);
+
+    /* wake up the thread, it waits either for a frame or for the delay */
+    pthread_mutex_lock(&pglobal->in[input_number].db);
+    stopping = 1;
+    pthread_cond_broadcast(&pglobal->in[input_number].db_update);
+    pthread_mutex_unlock(&pglobal->in[input_number].db);
+    stop_event_set(stop_fd);
+
+    if(join_thread(worker, &deadline) != 0) {
+        OPRINT("the worker thread did not finish in time\n");
+        return -1;
+    }
+
+    worker_cleanup(NULL);
     return 0;
 }
 
@@ -464,9 +478,14 @@ Return Value: always 0
 ******************************************************************************/
 int output_run(int id)
 {
+    stopping = 0;
+    if((stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        return 1;
+    }
+
     DBG("launching worker thread\n");
     pthread_create(&worker, 0, worker_thread, NULL);
-    pthread_detach(worker);
     return 0;
 }
 
@@ -36,6 +36,7 @@
 #include <netdb.h>
 #include <errno.h>
 #include <limits.h>
+#include <ctype.h>
 #include <linux/videodev2.h>
 #include <linux/version.h>
 #include "../../mjpg_streamer.h"
@@ -46,7 +47,7 @@
 #endif
 
 static globals *pglobal;
-extern context_http servers[MAX_OUTPUT_PLUGINS];
+extern context_http *servers;
 
 /******************************************************************************
 Description.: initializes the iobuffer structure properly
@@ -298,19 +299,31 @@ int unescape(char *string)
 
 /******************************************************************************
 Description.: Send a complete HTTP response and a single JPG-frame.
-Input Value.: fildescriptor fd to send the answer to
+Input Value.: the client to send the answer to and the input to take it from
 Return Value: -
 ******************************************************************************/
-void send_snapshot(int fd, int input_number)
+void send_snapshot(cfd *context_fd, int input_number)
 {
+    int fd = context_fd->fd;
     unsigned char *frame = NULL;
     int frame_size = 0;
     char buffer[BUFFER_SIZE] = {0};
     struct timeval timestamp;
 
+    /* a single H.264 access unit can not be decoded on its own */
+    if(pglobal->in[input_number].format == V4L2_PIX_FMT_H264) {
+        send_error(fd, 501, "this input delivers H.264, use action=stream");
+        return;
+    }
+
     /* wait for a fresh frame */
     pthread_mutex_lock(&pglobal->in[input_number].db);
-    pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+    if(!context_fd->pc->stopping)
+        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+    if(context_fd->pc->stopping) {
+        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        return;
+    }
 
     /* read buffer */
     frame_size = pglobal->in[input_number].size;
@@ -349,22 +362,33 @@ void send_snapshot(int fd, int input_number)
 
 /******************************************************************************
 Description.: Send a complete HTTP response and a stream of JPG-frames.
-Input Value.: fildescriptor fd to send the answer to
+              H.264 access units are sent back to back as an elementary
+              stream instead, without headers or boundaries between them.
+Input Value.: the client to send the answer to and the input to take it from
 Return Value: -
 ******************************************************************************/
-void send_stream(int fd, int input_number)
+void send_stream(cfd *context_fd, int input_number)
 {
+    int fd = context_fd->fd;
     unsigned char *frame = NULL, *tmp = NULL;
     int frame_size = 0, max_frame_size = 0;
     char buffer[BUFFER_SIZE] = {0};
     struct timeval timestamp;
+    int h264 = (pglobal->in[input_number].format == V4L2_PIX_FMT_H264);
 
     DBG("preparing header\n");
-    sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
-            STD_HEADER \
-            "Content-Type: multipart/x-mixed-replace;boundary=" BOUNDARY "\r\n" \
-            "\r\n" \
-            "--" BOUNDARY "\r\n");
+    if(h264) {
+        sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
+                STD_HEADER \
+                "Content-Type: video/h264\r\n" \
+                "\r\n");
+    } else {
+        sprintf(buffer, "HTTP/1.0 200 OK\r\n" \
+                STD_HEADER \
+                "Content-Type: multipart/x-mixed-replace;boundary=" BOUNDARY "\r\n" \
+                "\r\n" \
+                "--" BOUNDARY "\r\n");
+    }
 
     if(write(fd, buffer, strlen(buffer)) < 0) {
         free(frame);
@@ -377,7 +401,12 @@ void send_stream(int fd, int input_number)
 
         /* wait for fresh frames */
         pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(!context_fd->pc->stopping)
+            pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(context_fd->pc->stopping) {
+            pthread_mutex_unlock(&pglobal->in[input_number].db);
+            break;
+        }
 
         /* read buffer */
         frame_size = pglobal->in[input_number].size;
@@ -405,6 +434,12 @@ void send_stream(int fd, int input_number)
 
         pthread_mutex_unlock(&pglobal->in[input_number].db);
 
+        if(h264) {
+            DBG("sending access unit\n");
+            if(write(fd, frame, frame_size) < 0) break;
+            continue;
+        }
+
         /*
          * print the individual mimetype and the length
          * sending the content-length fixes random stream disruption observed
@@ -568,6 +603,35 @@ void send_file(int id, int fd, char *parameter)
     close(lfd);
 }
 
+/******************************************************************************
+Description.: check the parameters of a plugin to load for the option that
+              output_file and output_udp run as a program, getopt_long_only()
+              also accepts it with one dash and abbreviated, e.g. "-comm=x"
+Input Value.: details: the plugin and its parameters, separated by spaces
+Return Value: 1 if the option is given, 0 if not
+******************************************************************************/
+static int runs_program(const char *details)
+{
+    const char *p = details;
+    size_t len;
+
+    while((p = strchr(p, '-')) != NULL) {
+        /* only a dash at the start of a parameter begins an option */
+        if(p != details && p[-1] != ' ') {
+            p++;
+            continue;
+        }
+
+        while(*p == '-')
+            p++;
+        len = strcspn(p, "= ");
+        if(len > 0 && strncmp(p, "command", len) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
 /******************************************************************************
 Description.: Perform a command specified by parameter. Send response to fd.
 Input Value.: * fd.......: filedescriptor to send HTTP response to.
@@ -578,7 +642,7 @@ Return Value: -
 void command(int id, int fd, char *parameter)
 {
     char buffer[BUFFER_SIZE] = {0};
-    char *command = NULL, *svalue = NULL, *value, *command_id_string;
+    char *command = NULL, *svalue = NULL, *value, *command_id_string, *details = NULL;
     int res = 0, ivalue = 0, command_id = -1,  len = 0;
 
     DBG("parameter is: %s\n", parameter);
@@ -598,6 +662,8 @@ void command(int id, int fd, char *parameter)
         id: the control id
         group: the control's group eg. V4L2 control, jpg control, etc. This is optional
         value: value the control
+        details: only for the program itself, the plugin and its parameters to load,
+                 e.g. "dest=2&id=1&details=input_uvc.so%20-d%20/dev/video1"
     */
 
     /* search for required variable "command" */
@@ -701,20 +767,37 @@ void command(int id, int fd, char *parameter)
 
     switch(dest) {
     case Dest_Input:
-        if(plugin_no < pglobal->incnt) {
-            res = pglobal->in[plugin_no].cmd(plugin_no, command_id, group, ivalue);
-        } else {
-            DBG("Invalid plugin number: %d because only %d input plugins loaded", plugin_no,  pglobal->incnt-1);
-        }
-        break;
     case Dest_Output:
-        if(plugin_no < pglobal->outcnt) {
-            res = pglobal->out[plugin_no].cmd(plugin_no, command_id, group, ivalue);
-        } else {
-            DBG("Invalid plugin number: %d because only %d output plugins loaded", plugin_no,  pglobal->incnt-1);
+        /* the plugin can be unloaded by a command of another client, this call keeps it loaded */
+        if((res = pglobal->command(dest, plugin_no, command_id, group, ivalue)) < 0) {
+            DBG("Invalid plugin number: %d because only %d input and %d output plugins loaded", plugin_no, pglobal->incnt, pglobal->outcnt);
         }
         break;
     case Dest_Program:
+        if((value = strstr(parameter, "details=")) != NULL) {
+            value += strlen("details=");
+            details = strndup(value, strcspn(value, "&"));
+        }
+
+        if(pglobal->control == NULL || !servers[id].conf.loadplugins) {
+            DBG("the commands for plugins are not enabled\n");
+            res = -1;
+        } else if(details != NULL && runs_program(details)) {
+            DBG("a loaded plugin must not run programs: %s\n", details);
+            res = -1;
+        } else if((command_id == PRG_CMD_OUTPUT_STOP || command_id == PRG_CMD_OUTPUT_UNLOAD) && plugin_no == id) {
+            /* this thread runs the code of the plugin that would be unloaded */
+            DBG("the output plugin %d can not stop itself\n", id);
+            res = -1;
+        } else if(details != NULL && strcspn(details, "/") < strcspn(details, " ")) {
+            /* only load plugins from the search path of the dynamic linker */
+            DBG("the plugin must not be given with a path: %s\n", details);
+            res = -1;
+        } else {
+            res = pglobal->control(command_id, plugin_no, details);
+        }
+
+        if(details != NULL) free(details);
         break;
     default:
         fprintf(stderr, "Illegal command destination: %d\n", dest);
@@ -735,14 +818,109 @@ void command(int id, int fd, char *parameter)
     if(svalue != NULL) free(svalue);
 }
 
+/******************************************************************************
+Description.: find the input plugin a request addresses, either with a suffix
+              like "/?action=stream_12" or with a parameter like
+              "/?action=stream&input=12"
+Input Value.: first line of the HTTP request
+Return Value: number of the input plugin, 0 if the request does not name one
+              for compatibility reasons, -1 if the number is not valid
+******************************************************************************/
+static int request_input(const char *buffer)
+{
+    const char *p, *end;
+    long number;
+
+    /* only look at the URL */
+    if((end = strstr(buffer, " HTTP/")) == NULL)
+        end = buffer + strlen(buffer);
+
+    if((p = strstr(buffer, "input=")) != NULL && p < end) {
+        p += strlen("input=");
+    } else if((p = strchr(buffer, '_')) != NULL && p < end) {
+        p++;
+        if(!isdigit((unsigned char)*p))
+            return 0;
+    } else {
+        return 0;
+    }
+
+    if(!isdigit((unsigned char)*p))
+        return -1;
+
+    errno = 0;
+    number = strtol(p, NULL, 10);
+    if(errno != 0 || number > INT_MAX)
+        return -1;
+
+    return (int)number;
+}
+
+/******************************************************************************
+Description.: close the connection of a client thread that is about to leave,
+              the server joins the thread later and frees the cfd then
+Input Value.: the cfd of the client
+Return Value: always NULL
+******************************************************************************/
+static void *client_finished(cfd *pcfd)
+{
+    context_http *pcontext = pcfd->pc;
+
+    pthread_mutex_lock(&pcontext->clients_mutex);
+    close(pcfd->fd);
+    pcfd->fd = -1;
+    pcfd->done = 1;
+    pthread_mutex_unlock(&pcontext->clients_mutex);
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: join the threads of clients that left and free their cfd
+Input Value.: * pcontext: the server
+              * all.....: also wait for the clients that are still connected,
+                          their sockets must have been shut down
+              * deadline: from stop_deadline(), only used with all
+Return Value: 0 if ok, -1 if a thread did not finish in time
+******************************************************************************/
+int reap_clients(context_http *pcontext, int all, const struct timespec *deadline)
+{
+    cfd **p = &pcontext->clients, *pcfd;
+    int rc = 0;
+
+    pthread_mutex_lock(&pcontext->clients_mutex);
+    while((pcfd = *p) != NULL) {
+        if(!pcfd->done && !all) {
+            p = &pcfd->next;
+            continue;
+        }
+
+        /* the thread may wait for the mutex right before it finishes */
+        pthread_mutex_unlock(&pcontext->clients_mutex);
+        if(pcfd->done)
+            pthread_join(pcfd->thread, NULL);
+        else if(join_thread(pcfd->thread, deadline) != 0)
+            rc = -1;
+        pthread_mutex_lock(&pcontext->clients_mutex);
+
+        if(rc != 0)
+            break;
+
+        *p = pcfd->next;
+        free(pcfd);
+    }
+    pthread_mutex_unlock(&pcontext->clients_mutex);
+
+    return rc;
+}
+
 /******************************************************************************
 Description.: Serve a connected TCP-client. This thread function is called
               for each connect of a HTTP client like a webbrowser. It determines
               if it is a valid HTTP request and dispatches between the different
               response options.
 Input Value.: arg is the filedescriptor and server-context of the connected TCP
-              socket. It must have been allocated so it is freeable by this
-              thread function.
+              socket. It stays allocated until the server joined this thread.
 Return Value: always NULL
 ******************************************************************************/
 /* thread for clients that connected to this server */
@@ -756,10 +934,9 @@ void *client_thread(void *arg)
     request req;
     cfd lcfd; /* local-connected-file-descriptor */
 
-    /* we really need the fildescriptor and it must be freeable by us */
+    /* we really need the fildescriptor, the server frees it after the join */
     if(arg != NULL) {
         memcpy(&lcfd, arg, sizeof(cfd));
-        free(arg);
     } else
         return NULL;
 
@@ -770,8 +947,7 @@ void *client_thread(void *arg)
     /* What does the client want to receive? Read the request. */
     memset(buffer, 0, sizeof(buffer));
     if((cnt = _readline(lcfd.fd, &iobuf, buffer, sizeof(buffer) - 1, 5)) == -1) {
-        close(lcfd.fd);
-        return NULL;
+        return client_finished(arg);
     }
 
     /* determine what to deliver */
@@ -799,6 +975,9 @@ void *client_thread(void *arg)
     } else if(strstr(buffer, "GET /program.json") != NULL) {
         req.type = A_PROGRAM_JSON;
         input_suffixed = 255;
+    } else if((strstr(buffer, "GET /motion") != NULL) && (strstr(buffer, ".json") != NULL)) {
+        req.type = A_MOTION_JSON;
+        input_suffixed = 255;
     } else if(strstr(buffer, "GET /?action=command") != NULL) {
         int len;
         req.type = A_COMMAND;
@@ -807,8 +986,7 @@ void *client_thread(void *arg)
         if((pb = strstr(buffer, "GET /?action=command")) == NULL) {
             DBG("HTTP request seems to be malformed\n");
             send_error(lcfd.fd, 400, "Malformed HTTP request");
-            close(lcfd.fd);
-            return NULL;
+            return client_finished(arg);
         }
         pb += strlen("GET /?action=command"); // a pb points to thestring after the first & after command
 
@@ -826,8 +1004,7 @@ void *client_thread(void *arg)
             free(req.parameter);
             send_error(lcfd.fd, 500, "could not properly unescape command parameter string");
             LOG("could not properly unescape command parameter string\n");
-            close(lcfd.fd);
-            return NULL;
+            return client_finished(arg);
         }
 
         DBG("command parameter (len: %d): \"%s\"\n", len, req.parameter);
@@ -840,8 +1017,7 @@ void *client_thread(void *arg)
         if((pb = strstr(buffer, "GET /")) == NULL) {
             DBG("HTTP request seems to be malformed\n");
             send_error(lcfd.fd, 400, "Malformed HTTP request");
-            close(lcfd.fd);
-            return NULL;
+            return client_finished(arg);
         }
 
         pb += strlen("GET /");
@@ -863,14 +1039,7 @@ void *client_thread(void *arg)
      * generated from the 0. input plugin
      */
     if(input_suffixed) {
-        char *sch = strchr(buffer, '_');
-        if(sch != NULL) {  // there is an _ in the url so the input number should be present
-            DBG("sch %s\n", sch + 1); // FIXME if more than 10 input plugin is added
-            char numStr[3];
-            memset(numStr, 0, 3);
-            strncpy(numStr, sch + 1, 1);
-            input_number = atoi(numStr);
-        }
+        input_number = request_input(buffer);
         DBG("input plugin_no: %d\n", input_number);
     }
 
@@ -883,8 +1052,7 @@ void *client_thread(void *arg)
 
         if((cnt = _readline(lcfd.fd, &iobuf, buffer, sizeof(buffer) - 1, 5)) == -1) {
             free_request(&req);
-            close(lcfd.fd);
-            return NULL;
+            return client_finished(arg);
         }
 
         if(strstr(buffer, "User-Agent: ") != NULL) {
@@ -902,18 +1070,17 @@ void *client_thread(void *arg)
         if(req.credentials == NULL || strcmp(lcfd.pc->conf.credentials, req.credentials) != 0) {
             DBG("access denied\n");
             send_error(lcfd.fd, 401, "username and password do not match to configuration");
-            close(lcfd.fd);
             if(req.parameter != NULL) free(req.parameter);
             if(req.client != NULL) free(req.client);
             if(req.credentials != NULL) free(req.credentials);
-            return NULL;
+            return client_finished(arg);
         }
         DBG("access granted\n");
     }
 
     /* now it's time to answer */
 
-    if(!(input_number < pglobal->incnt)) {
+    if(input_number < 0 || input_number >= pglobal->incnt) {
         DBG("Input number: %d out of range (valid: 0..%d)\n", input_number, pglobal->incnt-1);
         send_error(lcfd.fd, 404, "Invalid input plugin number");
         req.type = A_UNKNOWN;
@@ -922,11 +1089,11 @@ void *client_thread(void *arg)
     switch(req.type) {
     case A_SNAPSHOT:
         DBG("Request for snapshot from input: %d\n", input_number);
-        send_snapshot(lcfd.fd, input_number);
+        send_snapshot(&lcfd, input_number);
         break;
     case A_STREAM:
         DBG("Request for stream from input: %d\n", input_number);
-        send_stream(lcfd.fd, input_number);
+        send_stream(&lcfd, input_number);
         break;
     case A_COMMAND:
         if(lcfd.pc->conf.nocommands) {
@@ -947,6 +1114,10 @@ void *client_thread(void *arg)
         DBG("Request for the program descriptor JSON file\n");
         send_Program_JSON(lcfd.fd);
         break;
+    case A_MOTION_JSON:
+        DBG("Request for the motion detection result of input: %d\n", input_number);
+        send_Motion_JSON(lcfd.fd, input_number);
+        break;
     case A_FILE:
         if(lcfd.pc->conf.www_folder == NULL)
             send_error(lcfd.fd, 501, "no www-folder configured");
@@ -957,16 +1128,16 @@ void *client_thread(void *arg)
         DBG("unknown request\n");
     }
 
-    close(lcfd.fd);
     free_request(&req);
 
     DBG("leaving HTTP client thread\n");
-    return NULL;
+    return client_finished(arg);
 }
 
 /******************************************************************************
-Description.: This function cleans up ressources allocated by the server_thread
-Input Value.: arg is not used
+Description.: This function cleans up ressources allocated by the server_thread,
+              it is called once the server and the clients finished
+Input Value.: the context of the server
 Return Value: -
 ******************************************************************************/
 void server_cleanup(void *arg)
@@ -976,8 +1147,11 @@ void server_cleanup(void *arg)
 
     OPRINT("cleaning up ressources allocated by server thread #%02d\n", pcontext->id);
 
-    for(i = 0; i < MAX_SD_LEN; i++)
-        close(pcontext->sd[i]);
+    for(i = 0; i < MAX_SD_LEN; i++) {
+        if(pcontext->sd[i] != -1)
+            close(pcontext->sd[i]);
+        pcontext->sd[i] = -1;
+    }
 }
 
 /******************************************************************************
@@ -989,7 +1163,6 @@ Return Value: always NULL, will only return on exit
 void *server_thread(void *arg)
 {
     int on;
-    pthread_t client;
     struct addrinfo *aip, *aip2;
     struct addrinfo hints;
     struct sockaddr_storage client_addr;
@@ -1003,9 +1176,6 @@ void *server_thread(void *arg)
     context_http *pcontext = arg;
     pglobal = pcontext->pglobal;
 
-    /* set cleanup handler to cleanup ressources */
-    pthread_cleanup_push(server_cleanup, pcontext);
-
     bzero(&hints, sizeof(hints));
     hints.ai_family = PF_UNSPEC;
     hints.ai_flags = AI_PASSIVE;
@@ -1074,14 +1244,6 @@ void *server_thread(void *arg)
 
     /* create a child for every client that connects */
     while(!pglobal->stop) {
-        //int *pfd = (int *)malloc(sizeof(int));
-        cfd *pcfd = malloc(sizeof(cfd));
-
-        if(pcfd == NULL) {
-            fprintf(stderr, "failed to allocate (a very small amount of) memory\n");
-            exit(EXIT_FAILURE);
-        }
-
         DBG("waiting for clients to connect\n");
 
         do {
@@ -1096,6 +1258,11 @@ void *server_thread(void *arg)
                 }
             }
 
+            /* output_stop() sets this event to end the server */
+            FD_SET(pcontext->stop_fd, &selectfds);
+            if(pcontext->stop_fd > max_fds)
+                max_fds = pcontext->stop_fd;
+
             err = select(max_fds + 1, &selectfds, NULL, NULL, NULL);
 
             if(err < 0 && errno != EINTR) {
@@ -1104,10 +1271,28 @@ void *server_thread(void *arg)
             }
         } while(err <= 0);
 
-        for(i = 0; i < max_fds + 1; i++) {
+        if(FD_ISSET(pcontext->stop_fd, &selectfds))
+            break;
+
+        /* the threads of clients that left meanwhile */
+        reap_clients(pcontext, 0, NULL);
+
+        for(i = 0; i < MAX_SD_LEN; i++) {
             if(pcontext->sd[i] != -1 && FD_ISSET(pcontext->sd[i], &selectfds)) {
+                /* one for each client, the thread keeps it until it is joined */
+                cfd *pcfd = calloc(1, sizeof(cfd));
+
+                if(pcfd == NULL) {
+                    fprintf(stderr, "failed to allocate (a very small amount of) memory\n");
+                    exit(EXIT_FAILURE);
+                }
+
                 pcfd->fd = accept(pcontext->sd[i], (struct sockaddr *)&client_addr, &addr_len);
                 pcfd->pc = pcontext;
+                if(pcfd->fd < 0) {
+                    free(pcfd);
+                    continue;
+                }
 
                 /* start new thread that will handle this TCP connected client */
                 DBG("create thread to handle client that just established a connection\n");
@@ -1119,19 +1304,22 @@ void *server_thread(void *arg)
                     syslog(LOG_INFO, "serving client: %s\n", name);
                 }
 #endif
-                if(pthread_create(&client, NULL, &client_thread, pcfd) != 0) {
+                pthread_mutex_lock(&pcontext->clients_mutex);
+                if(pthread_create(&pcfd->thread, NULL, &client_thread, pcfd) != 0) {
+                    pthread_mutex_unlock(&pcontext->clients_mutex);
                     DBG("could not launch another client thread\n");
                     close(pcfd->fd);
                     free(pcfd);
                     continue;
                 }
-                pthread_detach(client);
+                pcfd->next = pcontext->clients;
+                pcontext->clients = pcfd;
+                pthread_mutex_unlock(&pcontext->clients_mutex);
             }
         }
     }
 
-    DBG("leaving server thread, calling cleanup function now\n");
-    pthread_cleanup_pop(1);
+    DBG("leaving server thread\n");
 
     return NULL;
 }
@@ -1273,8 +1461,8 @@ void send_Program_JSON(int fd)
                 "\"args\": \"%s\"\n"
                 "}",
                 pglobal->in[k].param.id,
-                pglobal->in[k].plugin,
-                pglobal->in[k].param.parameters);
+                (pglobal->in[k].plugin != NULL) ? pglobal->in[k].plugin : "",
+                (pglobal->in[k].param.parameters != NULL) ? pglobal->in[k].param.parameters : "");
         if(k != (pglobal->incnt - 1))
             sprintf(buffer + strlen(buffer), ", \n");
         else
@@ -1295,8 +1483,8 @@ void send_Program_JSON(int fd)
                 "\"args\": \"%s\"\n"
                 "}",
                 pglobal->out[k].param.id,
-                pglobal->out[k].plugin,
-                pglobal->out[k].param.parameters);
+                (pglobal->out[k].plugin != NULL) ? pglobal->out[k].plugin : "",
+                (pglobal->out[k].param.parameters != NULL) ? pglobal->out[k].param.parameters : "");
         if(k != (pglobal->outcnt - 1))
             sprintf(buffer + strlen(buffer), ", \n");
         else
@@ -1425,3 +1613,75 @@ void send_Output_JSON(int fd, int plugin_number)
         DBG("unable to serve the control JSON file\n");
     }
 }
+
+/******************************************************************************
+Description.: Send the result of the motion detection of an input plugin as
+              JSON. The mask contains one string per row of 8x8 blocks, a '1'
+              marks a block that differs from the background.
+Input Value.: * fd...........: filedescriptor to send the answer to
+              * input_number.: the input plugin
+Return Value: -
+******************************************************************************/
+void send_Motion_JSON(int fd, int input_number)
+{
+    char *buffer, *p;
+    unsigned char *mask = NULL;
+    input_motion motion;
+    int x, y;
+
+    /* copy the result, the motion detector updates it for every frame */
+    pthread_mutex_lock(&pglobal->in[input_number].db);
+    motion = pglobal->in[input_number].motion;
+    if(motion.enabled && (mask = malloc(motion.width * motion.height)) != NULL)
+        memcpy(mask, motion.mask, motion.width * motion.height);
+    pthread_mutex_unlock(&pglobal->in[input_number].db);
+
+    if(!motion.enabled) {
+        send_error(fd, 404, "no motion detector attached to this input");
+        return;
+    }
+
+    if(mask == NULL || (buffer = malloc(BUFFER_SIZE + motion.height * (motion.width + 6))) == NULL) {
+        free(mask);
+        send_error(fd, 500, "not enough memory");
+        return;
+    }
+
+    p = buffer;
+    p += sprintf(p, "HTTP/1.0 200 OK\r\n" \
+                 "Content-type: %s\r\n" \
+                 STD_HEADER \
+                 "\r\n", "application/x-javascript");
+
+    p += sprintf(p,
+                 "{\n"
+                 "\"sequence\": \"%u\",\n"
+                 "\"timestamp\": \"%d.%06d\",\n"
+                 "\"score\": \"%d\",\n"
+                 "\"detected\": \"%d\",\n"
+                 "\"width\": \"%d\",\n"
+                 "\"height\": \"%d\",\n"
+                 "\"mask\": [\n",
+                 motion.sequence,
+                 (int)motion.timestamp.tv_sec, (int)motion.timestamp.tv_usec,
+                 motion.score,
+                 motion.detected,
+                 motion.width,
+                 motion.height);
+
+    for(y = 0; y < motion.height; y++) {
+        *p++ = '"';
+        for(x = 0; x < motion.width; x++)
+            *p++ = mask[y * motion.width + x] ? '1' : '0';
+        p += sprintf(p, (y != motion.height - 1) ? "\",\n" : "\"\n");
+    }
+
+    p += sprintf(p, "]\n}\n");
+
+    if(write(fd, buffer, p - buffer) < 0) {
+        DBG("unable to serve the motion JSON file\n");
+    }
+
+    free(buffer);
+    free(mask);
+}
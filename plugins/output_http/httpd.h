@@ -90,6 +90,7 @@ typedef enum {
     A_INPUT_JSON,
     A_OUTPUT_JSON,
     A_PROGRAM_JSON,
+    A_MOTION_JSON,
 } answer_t;
 
 /*
@@ -115,8 +116,11 @@ typedef struct {
     char *credentials;
     char *www_folder;
     char nocommands;
+    char loadplugins;
 } config;
 
+typedef struct _cfd cfd;
+
 /* context of each server thread */
 typedef struct {
     int sd[MAX_SD_LEN];
@@ -125,6 +129,14 @@ typedef struct {
     globals *pglobal;
     pthread_t threadID;
 
+    /* set by output_stop(), the clients waiting for a frame check it */
+    int stop_fd;
+    int stopping;
+
+    /* the connected clients, protected by the mutex */
+    pthread_mutex_t clients_mutex;
+    cfd *clients;
+
     config conf;
 } context_http;
 
@@ -132,17 +144,25 @@ typedef struct {
  * this struct is just defined to allow passing all necessary details to a worker thread
  * "cfd" is for connected/accepted filedescriptor
  */
-typedef struct {
+struct _cfd {
     context_http *pc;
     int fd;
-} cfd;
+
+    /* the client thread, it is joined once done is set */
+    pthread_t thread;
+    int done;
+    cfd *next;
+};
 
 /* prototypes */
 void *server_thread(void *arg);
+void server_cleanup(void *arg);
+int reap_clients(context_http *pcontext, int all, const struct timespec *deadline);
 void send_error(int fd, int which, char *message);
 void send_Output_JSON(int fd, int plugin_number);
 void send_Input_JSON(int fd, int plugin_number);
 void send_Program_JSON(int fd);
+void send_Motion_JSON(int fd, int input_number);
 
 
 
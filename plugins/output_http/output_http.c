@@ -41,9 +41,13 @@
 
 #define OUTPUT_PLUGIN_NAME "HTTP output plugin"
 /*
- * keep context for each server
+ * keep context for each server, allocated with global->outmax entries and
+ * freed with the last server
  */
-context_http servers[MAX_OUTPUT_PLUGINS];
+context_http *servers = NULL;
+
+/* several servers can be loaded */
+const int output_per_id = 1;
 
 /******************************************************************************
 Description.: print help for this plugin to stdout
@@ -60,7 +64,9 @@ void help(void)
             "                           flat hierarchy (no subfolders)\n" \
             " [-p | --port ]..........: TCP port for this HTTP server\n" \
             " [-c | --credentials ]...: ask for \"username:password\" on connect\n" \
-            " [-n | --nocommands ]....: disable execution of commands\n"
+            " [-n | --nocommands ]....: disable execution of commands\n" \
+            " [-l | --loadplugins ]...: allow the commands that load, start,\n" \
+            "                           stop and unload plugins, needs -c\n" \
             " ---------------------------------------------------------------\n");
 }
 
@@ -79,7 +85,7 @@ int output_init(output_parameter *param, int id)
     int i;
     int  port;
     char *credentials, *www_folder;
-    char nocommands;
+    char nocommands, loadplugins;
 
     DBG("output #%02d\n", param->id);
 
@@ -87,6 +93,7 @@ int output_init(output_parameter *param, int id)
     credentials = NULL;
     www_folder = NULL;
     nocommands = 0;
+    loadplugins = 0;
 
     param->argv[0] = OUTPUT_PLUGIN_NAME;
 
@@ -110,6 +117,8 @@ int output_init(output_parameter *param, int id)
             {"www", required_argument, 0, 0},
             {"n", no_argument, 0, 0},
             {"nocommands", no_argument, 0, 0},
+            {"l", no_argument, 0, 0},
+            {"loadplugins", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -163,36 +172,128 @@ int output_init(output_parameter *param, int id)
             DBG("case 8,9\n");
             nocommands = 1;
             break;
+
+            /* l, loadplugins */
+        case 10:
+        case 11:
+            DBG("case 10,11\n");
+            loadplugins = 1;
+            break;
         }
     }
 
+    /* a plugin can run programs, e.g. output_file -c, so only known users may load one */
+    if(loadplugins && credentials == NULL) {
+        OPRINT("ERROR: --loadplugins requires --credentials\n");
+        free(www_folder);
+        return 1;
+    }
+
+    if(servers == NULL && (servers = calloc(param->global->outmax, sizeof(context_http))) == NULL) {
+        OPRINT("not enough memory for the server contexts\n");
+        free(credentials);
+        free(www_folder);
+        return 1;
+    }
+
     servers[param->id].id = param->id;
     servers[param->id].pglobal = param->global;
+    servers[param->id].stop_fd = -1;
     servers[param->id].conf.port = port;
     servers[param->id].conf.credentials = credentials;
     servers[param->id].conf.www_folder = www_folder;
     servers[param->id].conf.nocommands = nocommands;
+    servers[param->id].conf.loadplugins = loadplugins;
 
     OPRINT("www-folder-path...: %s\n", (www_folder == NULL) ? "disabled" : www_folder);
     OPRINT("HTTP TCP port.....: %d\n", ntohs(port));
     OPRINT("username:password.: %s\n", (credentials == NULL) ? "disabled" : credentials);
     OPRINT("commands..........: %s\n", (nocommands) ? "disabled" : "enabled");
+    OPRINT("plugin commands...: %s\n", (loadplugins && !nocommands) ? "enabled" : "disabled");
     return 0;
 }
 
 /******************************************************************************
-Description.: this will stop the server thread, client threads
-              will not get cleaned properly, because they run detached and
-              no pointer is kept. This is not a huge issue, because this
-              funtion is intended to clean up the biggest mess on shutdown.
+Description.: forget a server, the table is freed with the last one because
+              the plugin may be unloaded then
+Input Value.: the server
+Return Value: -
+******************************************************************************/
+static void release_server(context_http *pcontext)
+{
+    globals *pglobal = pcontext->pglobal;
+    int i;
+
+    free(pcontext->conf.credentials);
+    pcontext->conf.credentials = NULL;
+    free(pcontext->conf.www_folder);
+    pcontext->conf.www_folder = NULL;
+
+    pcontext->pglobal = NULL;
+    for(i = 0; i < pglobal->outmax; i++) {
+        if(servers[i].pglobal != NULL)
+            return;
+    }
+
+    free(servers);
+    servers = NULL;
+}
+
+/******************************************************************************
+Description.: this will stop the server thread and the client threads, the
+              connections of the clients are shut down to wake them up
 Input Value.: id determines which server instance to send commands to
-Return Value: always 0
+Return Value: 0 if the threads finished, -1 if they did not in time
 ******************************************************************************/
 int output_stop(int id)
 {
+    context_http *pcontext = &servers[id];
+    globals *pglobal = pcontext->pglobal;
+    struct timespec deadline;
+    cfd *pcfd;
+    int i;
+
+    /* loaded but never run, there is no thread */
+    if(pcontext->stop_fd < 0) {
+        release_server(pcontext);
+        return 0;
+    }
+
+    DBG("will stop server thread #%02d\n", id);
+    stop_deadline(&deadline);
+
+    /* clients wait for frames of any input, wake up all of them */
+    pcontext->stopping = 1;
+    for(i = 0; i < pglobal->incnt; i++) {
+        pthread_mutex_lock(&pglobal->in[i].db);
+        pthread_cond_broadcast(&pglobal->in[i].db_update);
+        pthread_mutex_unlock(&pglobal->in[i].db);
+    }
+    stop_event_set(pcontext->stop_fd);
 
-    DBG("will cancel server thread #%02d\n", id);
-    pthread_cancel(servers[id].threadID);
+    if(join_thread(pcontext->threadID, &deadline) != 0) {
+        OPRINT("server thread #%02d did not finish in time\n", id);
+        return -1;
+    }
+
+    /* no new clients now, end the connections of the others */
+    pthread_mutex_lock(&pcontext->clients_mutex);
+    for(pcfd = pcontext->clients; pcfd != NULL; pcfd = pcfd->next) {
+        if(!pcfd->done)
+            shutdown(pcfd->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&pcontext->clients_mutex);
+
+    if(reap_clients(pcontext, 1, &deadline) != 0) {
+        OPRINT("the clients of server #%02d did not finish in time\n", id);
+        return -1;
+    }
+
+    server_cleanup(pcontext);
+    pthread_mutex_destroy(&pcontext->clients_mutex);
+    close(pcontext->stop_fd);
+    pcontext->stop_fd = -1;
+    release_server(pcontext);
 
     return 0;
 }
@@ -200,15 +301,23 @@ int output_stop(int id)
 /******************************************************************************
 Description.: This creates and starts the server thread
 Input Value.: id determines which server instance to send commands to
-Return Value: always 0
+Return Value: 0 if ok, 1 if the stop event could not be created
 ******************************************************************************/
 int output_run(int id)
 {
+    if((servers[id].stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        release_server(&servers[id]);
+        return 1;
+    }
+    servers[id].stopping = 0;
+    servers[id].clients = NULL;
+    pthread_mutex_init(&servers[id].clients_mutex, NULL);
+
     DBG("launching server thread #%02d\n", id);
 
     /* create thread and pass context to thread function */
     pthread_create(&(servers[id].threadID), NULL, server_thread, &(servers[id]));
-    pthread_detach(servers[id].threadID);
 
     return 0;
 }
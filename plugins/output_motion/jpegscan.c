@@ -0,0 +1,276 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jpegscan.h"
+
+/******************************************************************************
+Description.: builds the lookup tables for a Huffman table given by the DHT
+              segment, codes up to SCAN_LOOKAHEAD bits are resolved by a
+              single table access
+Input Value.: * h......: table to fill
+              * bits...: number of codes for each code length 1..16
+              * vals...: the symbols
+              * ac.....: 1 for an AC table, adds the fast tables
+Return Value: 0 if ok, -1 if the table is invalid
+******************************************************************************/
+static int huff_build(scan_huff *h, const unsigned char *bits, const unsigned char *vals, int ac)
+{
+    int i, j, l, code = 0, k = 0;
+
+    memset(h->look, 0, sizeof(h->look));
+    memset(h->fast, 0, sizeof(h->fast));
+
+    for(l = 1; l <= 16; l++) {
+        h->valoffset[l] = k - code;
+
+        for(i = 0; i < bits[l-1]; i++) {
+            if(k >= 256 || code >= (1 << l))
+                return -1;
+
+            if(l <= SCAN_LOOKAHEAD) {
+                int shift = SCAN_LOOKAHEAD - l;
+                for(j = 0; j < (1 << shift); j++)
+                    h->look[(code << shift) | j] = (l << 8) | vals[k];
+            }
+            h->huffval[k] = vals[k];
+            code++;
+            k++;
+        }
+
+        h->maxcode[l] = (bits[l-1] != 0) ? code - 1 : -1;
+        code <<= 1;
+    }
+    h->maxcode[17] = 0x7fffffff;
+
+    /* resolve the magnitude bits of short AC codes together with the code */
+    if(ac) {
+        for(i = 0; i < (1 << SCAN_LOOKAHEAD); i++) {
+            int e = h->look[i], len = e >> 8, r = (e & 0xff) >> 4, s = e & 0x0f, v;
+
+            if(e == 0 || s == 0 || len + s > SCAN_LOOKAHEAD)
+                continue;
+
+            v = (i >> (SCAN_LOOKAHEAD - len - s)) & ((1 << s) - 1);
+            h->fast[i] = (r << 12) | ((len + s) << 8) | 1;
+            h->fast_val[i] = HUFF_EXTEND(v, s);
+        }
+    }
+
+    h->defined = 1;
+    return 0;
+}
+
+/******************************************************************************
+Description.: positions the bitreader behind the next RSTn marker
+Input Value.: bitreader
+Return Value: 0 if ok, -1 if no marker was found
+******************************************************************************/
+int scan_restart(bitreader *br)
+{
+    const unsigned char *p = br->p;
+
+    while(p + 1 < br->end && !(p[0] == 0xff && p[1] >= 0xd0 && p[1] <= 0xd7))
+        p++;
+
+    if(p + 1 >= br->end)
+        return -1;
+
+    br->p = p + 2;
+    br->acc = 0;
+    br->nbits = 0;
+    br->marker = 0;
+    return 0;
+}
+
+/******************************************************************************
+Description.: parses the tables and the frame header of a baseline JPEG and
+              calls func for the first scan that contains the luminance
+Input Value.: * hdr....: receives the tables, may be reused for the next picture
+              * data...: the JPEG picture
+              * len....: size of the picture in bytes
+              * func...: decodes the scan
+              * arg....: passed to func
+Return Value: the return value of func, -1 for unsupported or corrupt pictures
+******************************************************************************/
+int scan_parse(scan_header *hdr, const unsigned char *data, int len, scan_func func, void *arg)
+{
+    const unsigned char *p = data, *end = data + len, *seg;
+    int i, j, k, marker, seglen;
+
+    if(len < 4 || p[0] != 0xff || p[1] != 0xd8)
+        return -1;
+    p += 2;
+
+    /* every frame of a M-JPEG stream brings its own tables */
+    for(i = 0; i < 4; i++) {
+        hdr->dc_tables[i].defined = 0;
+        hdr->ac_tables[i].defined = 0;
+    }
+    hdr->ncomp = 0;
+    hdr->restart_interval = 0;
+
+    while(p + 4 <= end) {
+        if(p[0] != 0xff) {
+            p++;
+            continue;
+        }
+
+        marker = p[1];
+        if(marker == 0xff) {
+            p++;
+            continue;
+        }
+        if(marker == 0xd8 || marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+            p += 2;
+            continue;
+        }
+        if(marker == 0xd9)
+            break;
+
+        seglen = (p[2] << 8) | p[3];
+        seg = p + 4;
+        p += 2 + seglen;
+        if(seglen < 2 || p > end)
+            return -1;
+        seglen -= 2;
+
+        switch(marker) {
+        case 0xdb: /* quantization tables */
+            for(i = 0; i < seglen;) {
+                int pq = seg[i] >> 4, tq = seg[i] & 0x0f;
+                i++;
+                if(tq > 3 || i + 64 * (pq + 1) > seglen)
+                    return -1;
+                for(j = 0; j < 64; j++, i += pq + 1)
+                    hdr->qt[tq][j] = pq ? ((seg[i] << 8) | seg[i+1]) : seg[i];
+            }
+            break;
+
+        case 0xc4: /* Huffman tables */
+            for(i = 0; i < seglen;) {
+                int tc = seg[i] >> 4, th = seg[i] & 0x0f, count = 0;
+                if(tc > 1 || th > 3 || i + 17 > seglen)
+                    return -1;
+                for(j = 0; j < 16; j++)
+                    count += seg[i + 1 + j];
+                if(i + 17 + count > seglen)
+                    return -1;
+                if(huff_build(tc ? &hdr->ac_tables[th] : &hdr->dc_tables[th], seg + i + 1, seg + i + 17, tc) < 0)
+                    return -1;
+                i += 17 + count;
+            }
+            break;
+
+        case 0xc0: /* baseline and extended sequential, Huffman coded */
+        case 0xc1:
+            if(seglen < 6 || seg[0] != 8)
+                return -1;
+            hdr->height = (seg[1] << 8) | seg[2];
+            hdr->width = (seg[3] << 8) | seg[4];
+            hdr->ncomp = seg[5];
+            if(hdr->ncomp < 1 || hdr->ncomp > 4 || seglen < 6 + 3 * hdr->ncomp ||
+               hdr->width == 0 || hdr->height == 0)
+                return -1;
+            hdr->hmax = hdr->vmax = 1;
+            for(i = 0; i < hdr->ncomp; i++) {
+                scan_component *c = &hdr->comp[i];
+                c->id = seg[6 + 3*i];
+                c->h = seg[7 + 3*i] >> 4;
+                c->v = seg[7 + 3*i] & 0x0f;
+                c->tq = seg[8 + 3*i] & 0x03;
+                if(c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4)
+                    return -1;
+                hdr->hmax = (c->h > hdr->hmax) ? c->h : hdr->hmax;
+                hdr->vmax = (c->v > hdr->vmax) ? c->v : hdr->vmax;
+            }
+            hdr->mcux = (hdr->width + 8 * hdr->hmax - 1) / (8 * hdr->hmax);
+            hdr->mcuy = (hdr->height + 8 * hdr->vmax - 1) / (8 * hdr->vmax);
+            break;
+
+        case 0xc2: case 0xc3: case 0xc5: case 0xc6: case 0xc7:
+        case 0xc9: case 0xca: case 0xcb: case 0xcd: case 0xce: case 0xcf:
+            /* progressive, lossless or arithmetic coding is not supported */
+            return -1;
+
+        case 0xdd: /* restart interval */
+            if(seglen < 2)
+                return -1;
+            hdr->restart_interval = (seg[0] << 8) | seg[1];
+            break;
+
+        case 0xda: { /* start of scan, followed by the entropy coded data */
+            int ns, sc[4], luma = 0;
+            bitreader br;
+
+            if(hdr->ncomp == 0 || seglen < 1)
+                return -1;
+            ns = seg[0];
+            if(ns < 1 || ns > 4 || seglen < 1 + 2 * ns + 3)
+                return -1;
+            for(i = 0; i < ns; i++) {
+                for(k = 0; k < hdr->ncomp; k++) {
+                    if(hdr->comp[k].id == seg[1 + 2*i])
+                        break;
+                }
+                if(k == hdr->ncomp)
+                    return -1;
+                sc[i] = k;
+                hdr->comp[k].td = (seg[2 + 2*i] >> 4) & 0x03;
+                hdr->comp[k].ta = seg[2 + 2*i] & 0x03;
+                luma |= (k == 0);
+            }
+
+            if(!luma) {
+                /* the luminance is coded in a later scan, skip this one */
+                while(p + 1 < end && !(p[0] == 0xff && p[1] != 0x00 && !(p[1] >= 0xd0 && p[1] <= 0xd7)))
+                    p++;
+                break;
+            }
+
+            for(i = 0; i < ns; i++) {
+                if(!hdr->dc_tables[hdr->comp[sc[i]].td].defined ||
+                   !hdr->ac_tables[hdr->comp[sc[i]].ta].defined)
+                    return -1;
+            }
+            for(i = 0; i < hdr->ncomp; i++)
+                hdr->comp[i].pred = 0;
+
+            br.p = p;
+            br.end = end;
+            br.acc = 0;
+            br.nbits = 0;
+            br.marker = 0;
+
+            return func(hdr, sc, ns, &br, arg);
+        }
+
+        default:
+            /* APPn, COM and others are not of interest */
+            break;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,163 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef JPEGSCAN_H
+#define JPEGSCAN_H
+
+/*
+ * Entropy decoding of baseline JPEGs, shared by the plugins that evaluate the
+ * coefficients of the frames without decompressing them (output_motion,
+ * output_autofocus and the still frame detection of input_uvc).
+ *
+ * scan_parse() reads the tables and the frame header and hands the first
+ * scan containing the luminance to a callback. The callback walks the MCUs
+ * and decodes the blocks with the inline functions below, so the per block
+ * work is compiled into the loop of each user.
+ */
+
+/* number of bits resolved with a single table lookup while decoding */
+#define SCAN_LOOKAHEAD 10
+
+#define HUFF_EXTEND(x, s) ((x) < (1 << ((s) - 1)) ? (x) - (1 << (s)) + 1 : (x))
+
+typedef struct _scan_huff scan_huff;
+struct _scan_huff {
+    int defined;
+    /* (code length << 8) | symbol, 0 if the code is longer than SCAN_LOOKAHEAD */
+    unsigned short look[1 << SCAN_LOOKAHEAD];
+    /*
+     * AC tables only: code and magnitude bits resolved at once,
+     * (run << 12) | (total length << 8) | 1, 0 if it does not fit
+     */
+    unsigned short fast[1 << SCAN_LOOKAHEAD];
+    short fast_val[1 << SCAN_LOOKAHEAD];
+    /* canonical decoding for the longer codes, see JPEG spec F.2.2.3 */
+    int maxcode[18];
+    int valoffset[17];
+    unsigned char huffval[256];
+};
+
+typedef struct _scan_component scan_component;
+struct _scan_component {
+    int id;
+    int h, v;       /* sampling factors */
+    int tq;         /* quantization table */
+    int td, ta;     /* Huffman tables used by the current scan */
+    int pred;       /* DC predictor */
+};
+
+/* tables and frame header of the picture, one is required per thread */
+typedef struct _scan_header scan_header;
+struct _scan_header {
+    unsigned short qt[4][64];   /* in zig-zag order */
+    scan_huff dc_tables[4];
+    scan_huff ac_tables[4];
+    scan_component comp[4];
+    int ncomp;
+    int width, height;
+    int restart_interval;
+
+    /* maximum sampling factors and the number of MCUs of an interleaved scan */
+    int hmax, vmax;
+    int mcux, mcuy;
+};
+
+/* reads the entropy coded segment, removes the stuffed zero bytes */
+typedef struct _bitreader bitreader;
+struct _bitreader {
+    const unsigned char *p, *end;
+    unsigned long long acc;
+    int nbits;
+    int marker;     /* a marker or the end of data was reached, feed zeros */
+};
+
+static inline void br_fill(bitreader *br)
+{
+    while(br->nbits <= 56) {
+        unsigned int c = 0;
+
+        if(!br->marker) {
+            if(br->p >= br->end) {
+                br->marker = 1;
+            } else if(*br->p != 0xff) {
+                c = *br->p++;
+            } else if(br->p + 1 < br->end && br->p[1] == 0x00) {
+                c = 0xff;
+                br->p += 2;
+            } else {
+                /* leave the pointer at the marker */
+                br->marker = 1;
+            }
+        }
+
+        br->acc = (br->acc << 8) | c;
+        br->nbits += 8;
+    }
+}
+
+static inline int br_peek(bitreader *br, int n)
+{
+    return (int)(br->acc >> (br->nbits - n)) & ((1 << n) - 1);
+}
+
+static inline int br_get(bitreader *br, int n)
+{
+    int v = br_peek(br, n);
+    br->nbits -= n;
+    return v;
+}
+
+static inline int huff_decode(bitreader *br, const scan_huff *h)
+{
+    int l, code, e;
+
+    if(br->nbits < 32)
+        br_fill(br);
+
+    e = h->look[br_peek(br, SCAN_LOOKAHEAD)];
+    if(e != 0) {
+        br->nbits -= e >> 8;
+        return e & 0xff;
+    }
+
+    /* slow path for the long and rare codes */
+    for(l = SCAN_LOOKAHEAD + 1; l <= 16; l++) {
+        code = br_peek(br, l);
+        if(code <= h->maxcode[l]) {
+            br->nbits -= l;
+            return h->huffval[code + h->valoffset[l]];
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * called for the scan with the luminance, the predictors are reset and the
+ * bitreader is positioned at the entropy coded data
+ */
+typedef int (*scan_func)(scan_header *hdr, const int *sc, int ns, bitreader *br, void *arg);
+
+int scan_restart(bitreader *br);
+int scan_parse(scan_header *hdr, const unsigned char *data, int len, scan_func func, void *arg);
+
+#endif
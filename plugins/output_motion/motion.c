@@ -0,0 +1,277 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "motion.h"
+
+/* background values are stored with this many fractional bits */
+#define MOTION_FP_SHIFT 4
+
+/******************************************************************************
+Description.: decodes one 8x8 block, returns the DC value and skips the
+              AC coefficients
+Input Value.: bitreader positioned at the start of the block and component
+Return Value: 0 if ok, -1 in case of corrupt data
+******************************************************************************/
+static inline int decode_block(bitreader *br, const scan_huff *dct, const scan_huff *act, scan_component *c)
+{
+    int s, r, rs, k, v;
+
+    if((s = huff_decode(br, dct)) < 0 || s > 11)
+        return -1;
+
+    if(s != 0) {
+        v = br_get(br, s);
+        c->pred += HUFF_EXTEND(v, s);
+    }
+
+    for(k = 1; k < 64; k++) {
+        if((rs = huff_decode(br, act)) < 0)
+            return -1;
+
+        r = rs >> 4;
+        s = rs & 0x0f;
+
+        if(s != 0) {
+            k += r;
+            br->nbits -= s;
+        } else if(r == 15) {
+            k += 15;
+        } else {
+            break;
+        }
+    }
+
+    return (k > 64) ? -1 : 0;
+}
+
+/******************************************************************************
+Description.: decodes the entropy coded data of one scan and stores the
+              luminance DC values, called by scan_parse
+Input Value.: * hdr....: parsed tables and frame header
+              * sc.....: indices of the components in this scan
+              * ns.....: number of components in this scan
+              * br.....: positioned at the entropy coded data
+              * arg....: the decoder
+Return Value: 0 if ok, -1 in case of corrupt data
+******************************************************************************/
+static int decode_scan(scan_header *hdr, const int *sc, int ns, bitreader *br, void *arg)
+{
+    dc_decoder *dec = arg;
+    scan_component *y = &hdr->comp[0];
+    int i, j, h, v, mx, my, mcu = 0;
+
+    dec->bw = hdr->mcux * y->h;
+    dec->bh = hdr->mcuy * y->v;
+    if(dec->bw * dec->bh > dec->dc_size) {
+        int *tmp = realloc(dec->dc, dec->bw * dec->bh * sizeof(int));
+        if(tmp == NULL)
+            return -1;
+        dec->dc = tmp;
+        dec->dc_size = dec->bw * dec->bh;
+    }
+
+    if(ns == 1) {
+        /* non-interleaved scan, each MCU is a single block */
+        scan_component *c = &hdr->comp[sc[0]];
+        int bx = ((hdr->width * c->h + hdr->hmax - 1) / hdr->hmax + 7) / 8;
+        int by = ((hdr->height * c->v + hdr->vmax - 1) / hdr->vmax + 7) / 8;
+
+        for(my = 0; my < by; my++) {
+            for(mx = 0; mx < bx; mx++, mcu++) {
+                if(hdr->restart_interval && mcu && (mcu % hdr->restart_interval) == 0) {
+                    if(scan_restart(br) < 0)
+                        return -1;
+                    c->pred = 0;
+                }
+                if(decode_block(br, &hdr->dc_tables[c->td], &hdr->ac_tables[c->ta], c) < 0)
+                    return -1;
+                if(sc[0] == 0)
+                    dec->dc[my * dec->bw + mx] = c->pred * hdr->qt[c->tq][0];
+            }
+        }
+        return 0;
+    }
+
+    for(my = 0; my < hdr->mcuy; my++) {
+        for(mx = 0; mx < hdr->mcux; mx++, mcu++) {
+            if(hdr->restart_interval && mcu && (mcu % hdr->restart_interval) == 0) {
+                if(scan_restart(br) < 0)
+                    return -1;
+                for(i = 0; i < hdr->ncomp; i++)
+                    hdr->comp[i].pred = 0;
+            }
+
+            for(i = 0; i < ns; i++) {
+                scan_component *c = &hdr->comp[sc[i]];
+                const scan_huff *dct = &hdr->dc_tables[c->td];
+                const scan_huff *act = &hdr->ac_tables[c->ta];
+
+                for(v = 0; v < c->v; v++) {
+                    for(h = 0; h < c->h; h++) {
+                        if(decode_block(br, dct, act, c) < 0)
+                            return -1;
+                        if(sc[i] == 0) {
+                            j = (my * y->v + v) * dec->bw + mx * y->h + h;
+                            dec->dc[j] = c->pred * hdr->qt[c->tq][0];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: parses a baseline JPEG and reconstructs the DC coefficients of
+              the first component (luminance), see dc_decoder for the results
+Input Value.: * dec....: decoder state, may be reused for the next picture
+              * data...: the JPEG picture
+              * len....: size of the picture in bytes
+Return Value: 0 if ok, -1 for unsupported or corrupt pictures
+******************************************************************************/
+int dc_decode(dc_decoder *dec, const unsigned char *data, int len)
+{
+    return scan_parse(&dec->hdr, data, len, decode_scan, dec);
+}
+
+/******************************************************************************
+Description.: free the buffers allocated by dc_decode
+Input Value.: decoder
+Return Value: -
+******************************************************************************/
+void dc_decoder_free(dc_decoder *dec)
+{
+    free(dec->dc);
+    dec->dc = NULL;
+    dec->dc_size = 0;
+}
+
+/******************************************************************************
+Description.: prepare a motion detector
+Input Value.: * md.......: the detector
+              * threshold: brightness difference in pixel levels (0..255) a
+                           block must differ from the background
+              * learn....: the background follows the picture with a rate
+                           of 1/2^learn per analysed frame
+              * limit....: permille of changed blocks to signal motion
+Return Value: -
+******************************************************************************/
+void motion_init(motion_detector *md, int threshold, int learn, int limit)
+{
+    memset(md, 0, sizeof(motion_detector));
+    md->threshold = threshold;
+    md->learn = learn;
+    md->limit = limit;
+}
+
+/******************************************************************************
+Description.: compare a picture against the background model and update it.
+              A change of the overall brightness (e.g. auto exposure) is
+              subtracted before the blocks are compared.
+Input Value.: * md.....: the detector
+              * data...: the JPEG picture
+              * len....: size of the picture in bytes
+Return Value: 0 if ok and md->mask, md->score and md->detected are updated,
+              -1 if the picture could not be parsed
+******************************************************************************/
+int motion_process(motion_detector *md, const unsigned char *data, int len)
+{
+    int i, n, d, thr, changed = 0;
+    long long sum = 0;
+    int *dc, *bg;
+
+    if(dc_decode(&md->dec, data, len) < 0)
+        return -1;
+
+    n = md->dec.bw * md->dec.bh;
+    dc = md->dec.dc;
+
+    /* (re)start the background model if the resolution changed */
+    if(md->bw != md->dec.bw || md->bh != md->dec.bh) {
+        free(md->background);
+        free(md->mask);
+        md->background = malloc(n * sizeof(int));
+        md->mask = calloc(n, 1);
+        if(md->background == NULL || md->mask == NULL) {
+            free(md->background);
+            free(md->mask);
+            md->background = NULL;
+            md->mask = NULL;
+            md->bw = md->bh = 0;
+            return -1;
+        }
+        for(i = 0; i < n; i++)
+            md->background[i] = dc[i] << MOTION_FP_SHIFT;
+        md->bw = md->dec.bw;
+        md->bh = md->dec.bh;
+        md->score = 0;
+        md->detected = 0;
+        return 0;
+    }
+
+    bg = md->background;
+    for(i = 0; i < n; i++)
+        sum += (dc[i] << MOTION_FP_SHIFT) - bg[i];
+    sum /= n;
+
+    /* the DC value is eight times the average of the block */
+    thr = (md->threshold * 8) << MOTION_FP_SHIFT;
+
+    for(i = 0; i < n; i++) {
+        d = (dc[i] << MOTION_FP_SHIFT) - bg[i];
+
+        if(d - sum > thr || d - sum < -thr) {
+            md->mask[i] = 1;
+            changed++;
+            /* adapt slower to foreground so moving objects stay visible */
+            bg[i] += d >> (md->learn + 2);
+        } else {
+            md->mask[i] = 0;
+            bg[i] += d >> md->learn;
+        }
+    }
+
+    md->score = changed * 1000 / n;
+    md->detected = (md->score >= md->limit);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: free the buffers of a motion detector
+Input Value.: the detector
+Return Value: -
+******************************************************************************/
+void motion_free(motion_detector *md)
+{
+    dc_decoder_free(&md->dec);
+    free(md->background);
+    free(md->mask);
+    md->background = NULL;
+    md->mask = NULL;
+    md->bw = md->bh = 0;
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "jpegscan.h"
+
+/*
+ * Motion detection in the compressed domain.
+ *
+ * Only the DC coefficients of the luminance blocks are reconstructed, this is
+ * the same as a 1/8 scaled decode of the Y plane. The AC coefficients still
+ * have to be Huffman decoded to find the start of the next block, but they
+ * are neither dequantized nor transformed, which makes this a lot cheaper
+ * than decompressing the picture.
+ */
+
+/* decoder state, one is required for each thread/picture source */
+typedef struct _dc_decoder dc_decoder;
+struct _dc_decoder {
+    scan_header hdr;
+
+    /* luminance DC values of the last picture, multiplied by the quantizer */
+    int *dc;
+    int dc_size;
+    int bw, bh;     /* dimensions of the DC plane in 8x8 blocks */
+};
+
+/* the background model and the result of the last analysed frame */
+typedef struct _motion_detector motion_detector;
+struct _motion_detector {
+    dc_decoder dec;
+
+    int threshold;  /* brightness difference in pixel levels to mark a block */
+    int learn;      /* background adapts with a rate of 1/2^learn per frame */
+    int limit;      /* permille of changed blocks to signal motion */
+
+    int *background;  /* fixed point, see MOTION_FP_SHIFT */
+    int bw, bh;
+
+    unsigned char *mask;
+    int score;
+    int detected;
+};
+
+int dc_decode(dc_decoder *dec, const unsigned char *data, int len);
+void dc_decoder_free(dc_decoder *dec);
+
+void motion_init(motion_detector *md, int threshold, int learn, int limit);
+int motion_process(motion_detector *md, const unsigned char *data, int len);
+void motion_free(motion_detector *md);
+
+#endif
@@ -0,0 +1,505 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+/*
+  This output plugin does not output pictures, it analyses the frames of an
+  input plugin and publishes a motion score and a mask of the changed blocks
+  in the "motion" member of the input. Other plugins can read it from there,
+  output_http serves it as /motion.json (or /motion_<input>.json).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <linux/videodev2.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "../../utils.h"
+#include "../../mjpg_streamer.h"
+
+#include "motion.h"
+
+#define OUTPUT_PLUGIN_NAME "MOTION output plugin"
+
+/* ids of the controls of this plugin */
+enum {
+    MOTION_CTRL_THRESHOLD = 1,
+    MOTION_CTRL_LIMIT = 2,
+    MOTION_CTRL_LEARN = 3,
+    MOTION_CTRL_COUNT = 3
+};
+
+/* context of each motion detector */
+typedef struct {
+    int id;
+    globals *pglobal;
+    pthread_t threadID;
+    int stopping;
+    int running;
+
+    int input_number;
+    int skip;
+    motion_detector md;
+    control controls[MOTION_CTRL_COUNT];
+
+    unsigned char *frame;
+    int max_frame_size;
+} context_motion;
+
+/* allocated with global->outmax entries, freed with the last detector */
+static context_motion *detectors = NULL;
+
+/* several detectors can be loaded */
+const int output_per_id = 1;
+
+/******************************************************************************
+Description.: print a help message
+Input Value.: -
+Return Value: -
+******************************************************************************/
+void help(void)
+{
+    fprintf(stderr, " ---------------------------------------------------------------\n" \
+            " Help for output plugin..: "OUTPUT_PLUGIN_NAME"\n" \
+            " ---------------------------------------------------------------\n" \
+            " The following parameters can be passed to this plugin:\n\n" \
+            " [-t | --threshold ].....: brightness difference of a 8x8 block\n" \
+            "                           to count as changed (1..255), default 12\n" \
+            " [-l | --limit ].........: permille of changed blocks to signal\n" \
+            "                           motion (0..1000), default 10\n" \
+            " [-a | --adapt ].........: background adapts by 1/2^N per frame\n" \
+            "                           (1..10), default 4\n" \
+            " [-s | --skip ]..........: analyse only every Nth frame\n" \
+            " [-i | --input ].........: read frames from the specified input plugin\n" \
+            " ---------------------------------------------------------------\n");
+}
+
+/******************************************************************************
+Description.: describe a control of this plugin for the JSON interface
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void init_control(control *c, int id, const char *name, int min, int max, int value)
+{
+    memset(c, 0, sizeof(control));
+    c->ctrl.id = id;
+    c->ctrl.type = V4L2_CTRL_TYPE_INTEGER;
+    snprintf((char *)c->ctrl.name, sizeof(c->ctrl.name), "%s", name);
+    c->ctrl.minimum = min;
+    c->ctrl.maximum = max;
+    c->ctrl.step = 1;
+    c->ctrl.default_value = value;
+    c->value = value;
+    c->group = IN_CMD_GENERIC;
+}
+
+/******************************************************************************
+Description.: removes the result of the detector from the input, so other
+              plugins do not take it for a live one after the detector stopped
+Input Value.: the detector
+Return Value: -
+******************************************************************************/
+static void withdraw(context_motion *pcontext)
+{
+    input *in = &pcontext->pglobal->in[pcontext->input_number];
+
+    pthread_mutex_lock(&in->db);
+    in->motion.enabled = 0;
+    in->motion.detected = 0;
+    in->motion.score = 0;
+    free(in->motion.mask);
+    in->motion.mask = NULL;
+    in->motion.width = in->motion.height = 0;
+    pthread_mutex_unlock(&in->db);
+}
+
+/******************************************************************************
+Description.: clean up allocated ressources
+Input Value.: context of the worker thread
+Return Value: -
+******************************************************************************/
+void worker_cleanup(void *arg)
+{
+    context_motion *pcontext = arg;
+
+    OPRINT("cleaning up ressources allocated by worker thread #%02d\n", pcontext->id);
+
+    withdraw(pcontext);
+
+    free(pcontext->frame);
+    pcontext->frame = NULL;
+    pcontext->max_frame_size = 0;
+    motion_free(&pcontext->md);
+}
+
+/******************************************************************************
+Description.: forget a detector, the table is freed with the last one because
+              the plugin may be unloaded then
+Input Value.: the detector
+Return Value: -
+******************************************************************************/
+static void release_detector(context_motion *pcontext)
+{
+    globals *pglobal = pcontext->pglobal;
+    int i;
+
+    pcontext->pglobal = NULL;
+    for(i = 0; i < pglobal->outmax; i++) {
+        if(detectors[i].pglobal != NULL)
+            return;
+    }
+
+    free(detectors);
+    detectors = NULL;
+}
+
+/******************************************************************************
+Description.: copies the result of the last analysed frame to the input, so
+              it is visible to other plugins
+Input Value.: * pcontext.: the detector
+              * timestamp: timestamp of the analysed frame
+Return Value: -
+******************************************************************************/
+static void publish(context_motion *pcontext, struct timeval *timestamp)
+{
+    input *in = &pcontext->pglobal->in[pcontext->input_number];
+    motion_detector *md = &pcontext->md;
+    int n = md->bw * md->bh;
+
+    pthread_mutex_lock(&in->db);
+
+    if(in->motion.width * in->motion.height != n) {
+        unsigned char *tmp = realloc(in->motion.mask, n);
+        if(tmp == NULL) {
+            pthread_mutex_unlock(&in->db);
+            return;
+        }
+        in->motion.mask = tmp;
+    }
+
+    memcpy(in->motion.mask, md->mask, n);
+    in->motion.width = md->bw;
+    in->motion.height = md->bh;
+    in->motion.score = md->score;
+    in->motion.detected = md->detected;
+    in->motion.timestamp = *timestamp;
+    in->motion.sequence++;
+    in->motion.enabled = 1;
+
+    pthread_mutex_unlock(&in->db);
+}
+
+/******************************************************************************
+Description.: this is the main worker thread
+              it loops forever, grabs a fresh frame and compares it against
+              the background
+Input Value.: context of the detector
+Return Value: always NULL
+******************************************************************************/
+void *worker_thread(void *arg)
+{
+    context_motion *pcontext = arg;
+    globals *pglobal = pcontext->pglobal;
+    input *in = &pglobal->in[pcontext->input_number];
+    int frame_size = 0, count = 0, detected = 0;
+    unsigned char *tmp = NULL;
+    struct timeval timestamp;
+
+    while(!pglobal->stop) {
+        DBG("waiting for fresh frame\n");
+        pthread_mutex_lock(&in->db);
+        if(!pcontext->stopping)
+            pthread_cond_wait(&in->db_update, &in->db);
+        if(pcontext->stopping) {
+            pthread_mutex_unlock(&in->db);
+            break;
+        }
+
+        if(++count < pcontext->skip) {
+            pthread_mutex_unlock(&in->db);
+            continue;
+        }
+        count = 0;
+
+        /* read buffer */
+        frame_size = in->size;
+
+        /* check if buffer for frame is large enough, increase it if necessary */
+        if(frame_size > pcontext->max_frame_size) {
+            DBG("increasing buffer size to %d\n", frame_size);
+
+            if((tmp = realloc(pcontext->frame, frame_size + (1 << 16))) == NULL) {
+                pthread_mutex_unlock(&in->db);
+                LOG("not enough memory\n");
+                break;
+            }
+            pcontext->frame = tmp;
+            pcontext->max_frame_size = frame_size + (1 << 16);
+        }
+
+        memcpy(pcontext->frame, in->buf, frame_size);
+        timestamp = in->timestamp;
+
+        pthread_mutex_unlock(&in->db);
+
+        /* process frame */
+        if(motion_process(&pcontext->md, pcontext->frame, frame_size) < 0) {
+            DBG("could not analyse frame of input %d\n", pcontext->input_number);
+            continue;
+        }
+
+        publish(pcontext, &timestamp);
+
+        if(pcontext->md.detected != detected) {
+            detected = pcontext->md.detected;
+            DBG("motion %s at input %d (score %d)\n", detected ? "started" : "stopped", pcontext->input_number, pcontext->md.score);
+        }
+    }
+
+    return NULL;
+}
+
+/*** plugin interface functions ***/
+/******************************************************************************
+Description.: this function is called first, in order to initialise
+              this plugin and pass a parameter string
+Input Value.: parameters
+Return Value: 0 if everything is ok, non-zero otherwise
+******************************************************************************/
+int output_init(output_parameter *param, int id)
+{
+    int i, threshold = 12, limit = 10, learn = 4, skip = 1, input_number = 0;
+    context_motion *pcontext;
+
+    param->argv[0] = OUTPUT_PLUGIN_NAME;
+
+    /* show all parameters for DBG purposes */
+    for(i = 0; i < param->argc; i++) {
+        DBG("argv[%d]=%s\n", i, param->argv[i]);
+    }
+
+    reset_getopt();
+    while(1) {
+        int option_index = 0, c = 0;
+        static struct option long_options[] = {
+            {"h", no_argument, 0, 0
+            },
+            {"help", no_argument, 0, 0},
+            {"t", required_argument, 0, 0},
+            {"threshold", required_argument, 0, 0},
+            {"l", required_argument, 0, 0},
+            {"limit", required_argument, 0, 0},
+            {"a", required_argument, 0, 0},
+            {"adapt", required_argument, 0, 0},
+            {"s", required_argument, 0, 0},
+            {"skip", required_argument, 0, 0},
+            {"i", required_argument, 0, 0},
+            {"input", required_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        c = getopt_long_only(param->argc, param->argv, "", long_options, &option_index);
+
+        /* no more options to parse */
+        if(c == -1) break;
+
+        /* unrecognized option */
+        if(c == '?') {
+            help();
+            return 1;
+        }
+
+        switch(option_index) {
+            /* h, help */
+        case 0:
+        case 1:
+            DBG("case 0,1\n");
+            help();
+            return 1;
+            break;
+
+            /* t, threshold */
+        case 2:
+        case 3:
+            DBG("case 2,3\n");
+            threshold = MIN(MAX(atoi(optarg), 1), 255);
+            break;
+
+            /* l, limit */
+        case 4:
+        case 5:
+            DBG("case 4,5\n");
+            limit = MIN(MAX(atoi(optarg), 0), 1000);
+            break;
+
+            /* a, adapt */
+        case 6:
+        case 7:
+            DBG("case 6,7\n");
+            learn = MIN(MAX(atoi(optarg), 1), 10);
+            break;
+
+            /* s, skip */
+        case 8:
+        case 9:
+            DBG("case 8,9\n");
+            skip = MAX(atoi(optarg), 1);
+            break;
+
+            /* i, input */
+        case 10:
+        case 11:
+            DBG("case 10,11\n");
+            input_number = atoi(optarg);
+            break;
+        }
+    }
+
+    if(!(input_number < param->global->incnt)) {
+        OPRINT("ERROR: the %d input_plugin number is too much only %d plugins loaded\n", input_number, param->global->incnt);
+        return 1;
+    }
+
+    if(param->global->in[input_number].format == V4L2_PIX_FMT_H264) {
+        OPRINT("ERROR: the %d input_plugin delivers H.264, motion detection needs JPG frames\n", input_number);
+        return 1;
+    }
+
+    if(detectors == NULL && (detectors = calloc(param->global->outmax, sizeof(context_motion))) == NULL) {
+        OPRINT("not enough memory for the detector contexts\n");
+        return 1;
+    }
+    pcontext = &detectors[param->id];
+
+    pcontext->id = param->id;
+    pcontext->pglobal = param->global;
+    pcontext->running = 0;
+    pcontext->input_number = input_number;
+    pcontext->skip = skip;
+    motion_init(&pcontext->md, threshold, learn, limit);
+
+    init_control(&pcontext->controls[0], MOTION_CTRL_THRESHOLD, "Motion threshold", 1, 255, threshold);
+    init_control(&pcontext->controls[1], MOTION_CTRL_LIMIT, "Motion limit", 0, 1000, limit);
+    init_control(&pcontext->controls[2], MOTION_CTRL_LEARN, "Background adaption", 1, 10, learn);
+    param->global->out[param->id].out_parameters = pcontext->controls;
+    param->global->out[param->id].parametercount = MOTION_CTRL_COUNT;
+
+    OPRINT("input plugin......: %d: %s\n", input_number, param->global->in[input_number].plugin);
+    OPRINT("threshold.........: %d\n", threshold);
+    OPRINT("limit.............: %d permille\n", limit);
+    OPRINT("adaption..........: 1/%d\n", 1 << learn);
+    OPRINT("analyse...........: every %d. frame\n", skip);
+    return 0;
+}
+
+/******************************************************************************
+Description.: calling this function stops the worker thread
+Input Value.: id of the instance
+Return Value: 0 if the thread finished, -1 if it did not in time
+******************************************************************************/
+int output_stop(int id)
+{
+    context_motion *pcontext = &detectors[id];
+    input *in = &pcontext->pglobal->in[pcontext->input_number];
+    struct timespec deadline;
+
+    /* loaded but never run, there is no thread */
+    if(!pcontext->running) {
+        release_detector(pcontext);
+        return 0;
+    }
+
+    DBG("will stop worker thread #%02d\n", id);
+    stop_deadline(&deadline);
+
+    /* the thread only ever waits for a frame */
+    pthread_mutex_lock(&in->db);
+    pcontext->stopping = 1;
+    pthread_cond_broadcast(&in->db_update);
+    pthread_mutex_unlock(&in->db);
+
+    if(join_thread(pcontext->threadID, &deadline) != 0) {
+        OPRINT("worker thread #%02d did not finish in time\n", id);
+        return -1;
+    }
+
+    worker_cleanup(pcontext);
+    release_detector(pcontext);
+    return 0;
+}
+
+/******************************************************************************
+Description.: calling this function creates and starts the worker thread
+Input Value.: id of the instance
+Return Value: always 0
+******************************************************************************/
+int output_run(int id)
+{
+    DBG("launching worker thread #%02d\n", id);
+    detectors[id].stopping = 0;
+    detectors[id].running = 1;
+    pthread_create(&detectors[id].threadID, 0, worker_thread, &detectors[id]);
+    return 0;
+}
+
+/******************************************************************************
+Description.: change the parameters of the detector at runtime
+Input Value.: * plugin.....: id of the instance
+              * control_id.: one of the MOTION_CTRL_* values
+              * value......: the new value
+Return Value: 0 if ok, -1 for unknown controls or values out of range
+******************************************************************************/
+int output_cmd(int plugin, unsigned int control_id, unsigned int group, int value)
+{
+    context_motion *pcontext = &detectors[plugin];
+    control *c;
+
+    DBG("command (%d, value: %d) for group %d triggered for plugin instance #%02d\n", control_id, value, group, plugin);
+
+    if(control_id < 1 || control_id > MOTION_CTRL_COUNT)
+        return -1;
+
+    c = &pcontext->controls[control_id - 1];
+    if(value < c->ctrl.minimum || value > c->ctrl.maximum)
+        return -1;
+
+    switch(control_id) {
+    case MOTION_CTRL_THRESHOLD:
+        pcontext->md.threshold = value;
+        break;
+    case MOTION_CTRL_LIMIT:
+        pcontext->md.limit = value;
+        break;
+    case MOTION_CTRL_LEARN:
+        pcontext->md.learn = value;
+        break;
+    }
+    c->value = value;
+
+    return 0;
+}
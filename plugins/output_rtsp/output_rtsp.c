@@ -21,17 +21,21 @@
 *******************************************************************************/
 
 /*
-  This output plugin is based on code from output_file.c
-  Writen by Dimitrios Zachariadis
-  Version 0.1, May 2010
+  This output plugin serves the frames of an input plugin as RTP/JPEG
+  stream (RFC 2435). Clients connect with RTSP and receive the packets
+  either by UDP or interleaved in the RTSP connection.
 
-  It provides a mechanism to take snapshots with a trigger from a UDP packet.
-  The UDP msg contains the path for the snapshot jpeg file
-  It echoes the message received back to the sender, after taking the snapshot
+  All sessions receive the same packets, a frame is packetized once and
+  sent to the UDP clients with a single sendmmsg call.
+
+  With a multicast group the packets are sent once to the group, no
+  matter how many clients joined it. The packets of a frame can be
+  spread over a part of the frame interval and protected by XOR FEC.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
 #include <linux/videodev2.h>
@@ -39,23 +43,39 @@
 #include <errno.h>
 #include <signal.h>
 #include <sys/socket.h>
-#include <resolv.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <getopt.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <time.h>
 #include <syslog.h>
 
-#include <dirent.h>
-
 #include "../../utils.h"
 #include "../../mjpg_streamer.h"
+#include "rtsp.h"
 
 #define OUTPUT_PLUGIN_NAME "RTSP output plugin"
 
+/* maximum number of clients receiving the stream at the same time */
+#define MAX_SESSIONS 16
+
+/* a TCP client that does not take a frame within this time is dropped */
+#define TCP_SEND_TIMEOUT 2000
+
+/* packets sent at once when pacing */
+#define PACE_BURST 8
+
+/* default port of the multicast group */
+#define MULTICAST_PORT 5004
+
 enum RTSP_State {
     RTSP_State_Setup,
     RTSP_State_Playing,
@@ -63,15 +83,85 @@ enum RTSP_State {
     RTSP_State_Teardown,
 };
 
-static pthread_t worker;
+typedef enum _rtp_transport rtp_transport;
+enum _rtp_transport {
+    RTP_UDP,
+    RTP_TCP,
+    RTP_MULTICAST   // the group receives the packets, not the session
+};
+
+/* a RTSP connection, sessions created by it end with the connection */
+typedef struct _rtsp_client rtsp_client;
+struct _rtsp_client {
+    int fd;
+    struct sockaddr_in peer;
+
+    /* replies and interleaved packets must not be mixed */
+    pthread_mutex_t write_lock;
+
+    /* the thread serving the connection, it is joined once done is set */
+    pthread_t thread;
+    int done;
+
+    /* the worker is sending to the socket, it stays open until released */
+    int refs;
+    rtsp_client *next;
+};
+
+typedef struct _rtsp_session rtsp_session;
+struct _rtsp_session {
+    int in_use;
+    enum RTSP_State state;
+    char id[17];
+    rtsp_client *client;
+    rtp_transport transport;
+    struct sockaddr_in rtp_addr;    // UDP: destination of the packets
+    int channel;                    // TCP: interleaved channel of RTP
+};
+
+/* a playing TCP session, copied so the frame is sent without the sessions mutex */
+typedef struct _tcp_dest tcp_dest;
+struct _tcp_dest {
+    int session;            // index in sessions
+    char id[17];
+    rtsp_client *client;    // referenced until release_tcp_dests()
+    int channel;
+};
+
+static pthread_t worker, server;
+static int stop_fd = -1, stopping = 0;
 static globals *pglobal;
-static int fd, max_frame_size;
+static int max_frame_size;
 static unsigned char *frame = NULL;
-static char *command = NULL;
 static int input_number = 0;
 
-// UDP port
-static int port = 554;
+static int port = 554, rtp_port = 0, mtu = RTP_DEFAULT_MTU;
+static int listen_sd = -1, rtp_sd = -1, rtcp_sd = -1;
+static int server_rtp_port, server_rtcp_port;
+
+/* multicast group, pacing and forward error correction */
+static int multicast = 0, ttl = 1, pace = -1, fec_group = 0;
+static struct sockaddr_in group_addr, fec_addr;
+static long long frame_interval = 0;
+
+/* the sessions and the stream are protected by this mutex */
+static pthread_mutex_t sessions_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rtsp_session sessions[MAX_SESSIONS];
+static rtp_stream stream;
+
+/* the connections, protected by this mutex */
+static pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rtsp_client *clients = NULL;
+
+/* the sessions the current frame goes to, used by the worker only */
+static tcp_dest tcp_dests[MAX_SESSIONS];
+static struct sockaddr_in udp_dests[MAX_SESSIONS + 1];
+
+/* buffers for sendmmsg, they only grow */
+static struct mmsghdr *msgs = NULL;
+static struct iovec *iovs = NULL;
+static unsigned char *prefixes = NULL;
+static int msgs_allocated = 0;
 
 /******************************************************************************
 Description.: print a help message
@@ -84,8 +174,22 @@ void help(void)
             " Help for output plugin..: "OUTPUT_PLUGIN_NAME"\n" \
             " ---------------------------------------------------------------\n" \
             " The following parameters can be passed to this plugin:\n\n" \
-            " [-p | --port ]..........: UDP port to listen for picture requests. UDP message is the filename to save\n\n" \
-            " [-i | --input ].......: read frames from the specified input plugin (first input plugin between the arguments is the 0th)\n\n" \
+            " [-p | --port ]..........: TCP port of the RTSP server\n" \
+            " [-r | --rtp_port ]......: UDP port to send RTP from, RTCP uses\n" \
+            "                           the next port, default is any port\n" \
+            " [-m | --mtu ]...........: maximum size of the RTP packets\n" \
+            " [-g | --group ].........: send to this multicast group instead of\n" \
+            "                           each client, address[:port]\n" \
+            " [-t | --ttl ]...........: time to live of the multicast packets\n" \
+            " [-P | --pace ]..........: spread the packets of a frame over this\n" \
+            "                           percentage of the frame interval, 0 sends\n" \
+            "                           them at once (default 50 with -g, else 0)\n" \
+            " [-f | --fec ]...........: send a XOR FEC packet (RFC 5109) for every\n" \
+            "                           group of this many packets to the multicast\n" \
+            "                           group, port + 2, payload type 127\n" \
+            " [-i | --input ].........: read frames from the specified input plugin (first input plugin between the arguments is the 0th)\n\n" \
+            " The frames must be baseline JPEGs with 4:2:2 or 4:2:0 sampling\n" \
+            " and the standard Huffman tables, like UVC cameras deliver them.\n" \
             " ---------------------------------------------------------------\n");
 }
 
@@ -96,69 +200,344 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
-
-    first_run = 0;
     OPRINT("cleaning up ressources allocated by worker thread\n");
 
     if(frame != NULL) {
         free(frame);
+        frame = NULL;
     }
-    close(fd);
+    max_frame_size = 0;
+
+    pthread_mutex_lock(&sessions_mutex);
+    rtp_stream_free(&stream);
+    free(msgs);
+    free(iovs);
+    free(prefixes);
+    msgs = NULL;
+    iovs = NULL;
+    prefixes = NULL;
+    msgs_allocated = 0;
+    pthread_mutex_unlock(&sessions_mutex);
 }
 
 /******************************************************************************
-Description.: this is the main worker thread
-              it loops forever, grabs a fresh frame and stores it to file
-Input Value.:
-Return Value:
+Description.: send a number of iovecs completely to a TCP connection. If the
+              socket does not take anything the frame is skipped, once the
+              first byte is sent the rest has to follow.
+Input Value.: * fd.....: the socket
+              * iov....: the data, it is modified
+              * count..: number of entries in iov
+Return Value: 1 if sent, 0 if skipped, -1 if the connection is broken
 ******************************************************************************/
-void *worker_thread(void *arg)
+static int send_iov(int fd, struct iovec *iov, int count)
 {
-    int ok = 1, frame_size = 0, rc = 0;
-    char buffer1[1024] = {0};
-    unsigned char *tmp_framebuffer = NULL;
+    struct msghdr msg;
+    struct pollfd pfd;
+    ssize_t n;
+    int sent = 0;
+
+    while(count > 0) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = MIN(count, IOV_MAX);
+
+        n = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                return -1;
+            if(!sent)
+                return 0;
+
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            if(poll(&pfd, 1, TCP_SEND_TIMEOUT) <= 0)
+                return -1;
+            continue;
+        }
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
+        sent = 1;
 
-    // set UDP server data structures ---------------------------
-    if(port <= 0) {
-        OPRINT("a valid UDP port must be provided\n");
-        return NULL;
+        /* skip what was sent */
+        while(count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if(count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
     }
-    struct sockaddr_in addr;
-    int sd;
-    int bytes;
-    unsigned int addr_len = sizeof(addr);
-    char udpbuffer[1024] = {0};
-    sd = socket(PF_INET, SOCK_DGRAM, 0);
-    bzero(&addr, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port);
-    if(bind(sd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
-        perror("bind");
-    // -----------------------------------------------------------
 
-    while(ok >= 0 && !pglobal->stop) {
-        DBG("waiting for a UDP message\n");
+    return 1;
+}
 
-        // UDP receive ---------------------------------------------
-        memset(udpbuffer, 0, sizeof(udpbuffer));
-        bytes = recvfrom(sd, udpbuffer, sizeof(udpbuffer), 0, (struct sockaddr*)&addr, &addr_len);
-        // ---------------------------------------------------------
+/* the slots are reused, the connection of a TCP session stays open */
+static void free_session(rtsp_session *s)
+{
+    DBG("session %s ends\n", s->id);
+    s->in_use = 0;
+    s->state = RTSP_State_Teardown;
+    s->client = NULL;
+}
 
+/******************************************************************************
+Description.: make sure the sendmmsg buffers can hold a number of messages
+Input Value.: number of messages
+Return Value: 0 if ok, -1 if there is not enough memory
+******************************************************************************/
+static int reserve_msgs(int count)
+{
+    struct mmsghdr *m;
+    struct iovec *v;
+    unsigned char *p;
+
+    if(count <= msgs_allocated)
+        return 0;
 
+    if((m = realloc(msgs, count * sizeof(struct mmsghdr))) == NULL)
+        return -1;
+    msgs = m;
+    if((v = realloc(iovs, 3 * count * sizeof(struct iovec))) == NULL)
+        return -1;
+    iovs = v;
+    if((p = realloc(prefixes, 4 * count)) == NULL)
+        return -1;
+    prefixes = p;
 
+    msgs_allocated = count;
+    return 0;
+}
+
+/******************************************************************************
+Description.: copy the playing TCP sessions, their connections stay open
+              until release_tcp_dests() is called
+Input Value.: -
+Return Value: number of entries in tcp_dests
+              the sessions mutex must be held
+******************************************************************************/
+static int collect_tcp_dests(void)
+{
+    int i, n = 0;
+    rtsp_session *s;
+
+    pthread_mutex_lock(&clients_mutex);
+    for(i = 0; i < MAX_SESSIONS; i++) {
+        s = &sessions[i];
+        if(!s->in_use || s->state != RTSP_State_Playing || s->transport != RTP_TCP)
+            continue;
+
+        tcp_dests[n].session = i;
+        memcpy(tcp_dests[n].id, s->id, sizeof(s->id));
+        tcp_dests[n].client = s->client;
+        tcp_dests[n].channel = s->channel;
+        s->client->refs++;
+        n++;
+    }
+    pthread_mutex_unlock(&clients_mutex);
+
+    return n;
+}
+
+/******************************************************************************
+Description.: copy the addresses of the playing UDP sessions and the
+              multicast group
+Input Value.: -
+Return Value: number of entries in udp_dests
+              the sessions mutex must be held
+******************************************************************************/
+static int collect_udp_dests(void)
+{
+    int i, n = 0;
+
+    for(i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i].in_use && sessions[i].state == RTSP_State_Playing && sessions[i].transport == RTP_UDP)
+            udp_dests[n++] = sessions[i].rtp_addr;
+    }
+    if(multicast)
+        udp_dests[n++] = group_addr;
+
+    return n;
+}
+
+/* drop the references of collect_tcp_dests, a closed connection is closed now */
+static void release_tcp_dests(int count)
+{
+    rtsp_client *client;
+    int i;
+
+    pthread_mutex_lock(&clients_mutex);
+    for(i = 0; i < count; i++) {
+        client = tcp_dests[i].client;
+        if(--client->refs == 0 && client->done && client->fd >= 0) {
+            close(client->fd);
+            client->fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&clients_mutex);
+}
+
+/******************************************************************************
+Description.: send the packets of the stream to the playing TCP sessions. A
+              slow client blocks the worker up to TCP_SEND_TIMEOUT, so this
+              is done without holding the sessions mutex.
+Input Value.: count: number of entries in tcp_dests
+Return Value: -
+******************************************************************************/
+static void send_interleaved(int count)
+{
+    int i, j, n, sent;
+    tcp_dest *d;
+    rtsp_session *s;
+    rtp_packet *pkt;
+
+    if(count == 0 || reserve_msgs(stream.count) < 0)
+        return;
+
+    /* TCP, the packets are framed with '$', channel and length */
+    for(i = 0; i < count; i++) {
+        d = &tcp_dests[i];
+
+        for(j = 0; j < stream.count; j++) {
+            pkt = &stream.packets[j];
+            n = pkt->header_len + pkt->payload_len;
+            prefixes[4*j] = '$';
+            prefixes[4*j+1] = d->channel;
+            prefixes[4*j+2] = n >> 8;
+            prefixes[4*j+3] = n & 0xff;
+
+            iovs[3*j].iov_base = &prefixes[4*j];
+            iovs[3*j].iov_len = 4;
+            iovs[3*j+1].iov_base = pkt->header;
+            iovs[3*j+1].iov_len = pkt->header_len;
+            iovs[3*j+2].iov_base = (void *)pkt->payload;
+            iovs[3*j+2].iov_len = pkt->payload_len;
+        }
+
+        pthread_mutex_lock(&d->client->write_lock);
+        sent = send_iov(d->client->fd, iovs, 3 * stream.count);
+        pthread_mutex_unlock(&d->client->write_lock);
+
+        if(sent == 0) {
+            DBG("session %s is congested, frame skipped\n", d->id);
+        } else if(sent < 0) {
+            OPRINT("session %s does not take data anymore\n", d->id);
+            /* the client thread notices the broken connection */
+            shutdown(d->client->fd, SHUT_RDWR);
+
+            /* unless the session ended or was replaced meanwhile */
+            pthread_mutex_lock(&sessions_mutex);
+            s = &sessions[d->session];
+            if(s->in_use && s->client == d->client && strcmp(s->id, d->id) == 0)
+                free_session(s);
+            pthread_mutex_unlock(&sessions_mutex);
+        }
+    }
+}
+
+/* fill a message of the sendmmsg buffers */
+static void set_msg(int n, struct sockaddr_in *addr, void *header, int header_len, const void *payload, int payload_len)
+{
+    iovs[2*n].iov_base = header;
+    iovs[2*n].iov_len = header_len;
+    iovs[2*n+1].iov_base = (void *)payload;
+    iovs[2*n+1].iov_len = payload_len;
+
+    memset(&msgs[n], 0, sizeof(struct mmsghdr));
+    msgs[n].msg_hdr.msg_name = addr;
+    msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    msgs[n].msg_hdr.msg_iov = &iovs[2*n];
+    msgs[n].msg_hdr.msg_iovlen = (payload_len > 0) ? 2 : 1;
+}
+
+/******************************************************************************
+Description.: send the packets of the stream to the UDP sessions and the
+              multicast group, paced if requested. The pacing sleeps for a
+              part of the frame interval, so this is done without holding
+              the sessions mutex.
+Input Value.: ndest: number of entries in udp_dests
+Return Value: -
+******************************************************************************/
+static void send_packets(int ndest)
+{
+    int i, j, n, f, first, last, sent;
+    long long gap = 0;
+    struct timespec next;
+    rtp_packet *pkt;
+
+    if(ndest == 0 || reserve_msgs(ndest * stream.count + stream.fec_count) < 0)
+        return;
+
+    n = (stream.count + PACE_BURST - 1) / PACE_BURST;
+    if(pace > 0 && frame_interval > 0 && n > 1)
+        gap = frame_interval * 1000 * pace / 100 / n;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    /* UDP, one message per packet and destination, FEC follows its group */
+    for(first = 0, f = 0; first < stream.count; first += PACE_BURST) {
+        last = MIN(first + PACE_BURST, stream.count);
+
+        for(j = first, n = 0; j < last; j++) {
+            pkt = &stream.packets[j];
+            for(i = 0; i < ndest; i++, n++)
+                set_msg(n, &udp_dests[i], pkt->header, pkt->header_len, pkt->payload, pkt->payload_len);
+
+            for(; f < stream.fec_count && stream.fec[f].last == j; f++, n++)
+                set_msg(n, &fec_addr, stream.fec[f].data, stream.fec[f].len, NULL, 0);
+        }
+
+        for(i = 0; i < n;) {
+            sent = sendmmsg(rtp_sd, &msgs[i], n - i, 0);
+            if(sent < 0) {
+                if(errno == EINTR)
+                    continue;
+                /* a single unreachable client must not stop the others */
+                DBG("sendmmsg failed: %s\n", strerror(errno));
+                i++;
+                continue;
+            }
+            i += sent;
+        }
+
+        if(gap > 0 && last < stream.count) {
+            next.tv_nsec += gap;
+            while(next.tv_nsec >= 1000000000L) {
+                next.tv_sec++;
+                next.tv_nsec -= 1000000000L;
+            }
+            if(stop_event_wait_until(stop_fd, &next))
+                return;
+        }
+    }
+}
+
+/******************************************************************************
+Description.: this is the main worker thread
+              it loops forever, grabs a fresh frame and sends it to the
+              playing sessions
+Input Value.:
+Return Value:
+******************************************************************************/
+void *worker_thread(void *arg)
+{
+    int i, frame_size = 0, playing, warned = 0, ntcp, nudp, ready;
+    unsigned char *tmp_framebuffer = NULL;
+    struct timeval timestamp;
+    unsigned int rtp_timestamp;
+    long long now, last = 0;
+    rtp_jpeg jpg;
+
+    while(!pglobal->stop) {
         DBG("waiting for fresh frame\n");
         pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(!stopping)
+            pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+        if(stopping) {
+            pthread_mutex_unlock(&pglobal->in[input_number].db);
+            break;
+        }
 
         /* read buffer */
         frame_size = pglobal->in[input_number].size;
@@ -179,64 +558,484 @@ void *worker_thread(void *arg)
 
         /* copy frame to our local buffer now */
         memcpy(frame, pglobal->in[input_number].buf, frame_size);
+        timestamp = pglobal->in[input_number].timestamp;
 
         /* allow others to access the global buffer again */
         pthread_mutex_unlock(&pglobal->in[input_number].db);
 
-        /* only save a file if a name came in with the UDP message */
-        if(strlen(udpbuffer) > 0) {
-            DBG("writing file: %s\n", udpbuffer);
+        if(timestamp.tv_sec == 0 && timestamp.tv_usec == 0)
+            gettimeofday(&timestamp, NULL);
+        rtp_timestamp = (unsigned int)(timestamp.tv_sec * (unsigned long long)RTP_CLOCK_RATE +
+                                       timestamp.tv_usec * (unsigned long long)RTP_CLOCK_RATE / 1000000);
 
-            /* open file for write. Path must pre-exist */
-            if((fd = open(udpbuffer, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
-                OPRINT("could not open the file %s\n", udpbuffer);
-                return NULL;
-            }
+        /* the pacing needs to know the frame interval */
+        now = timestamp.tv_sec * 1000000LL + timestamp.tv_usec;
+        if(last > 0 && now > last && now - last < 1000000)
+            frame_interval = (frame_interval > 0) ? (7 * frame_interval + now - last) / 8 : now - last;
+        last = now;
 
-            /* save picture to file */
-            if(write(fd, frame, frame_size) < 0) {
-                OPRINT("could not write to file %s\n", udpbuffer);
-                perror("write()");
-                close(fd);
-                return NULL;
+        pthread_mutex_lock(&sessions_mutex);
+
+        /* the multicast group is served even without RTSP clients */
+        for(i = 0, playing = multicast; i < MAX_SESSIONS; i++) {
+            if(sessions[i].in_use && sessions[i].state == RTSP_State_Playing)
+                playing++;
+        }
+
+        ready = 0;
+        if(playing > 0) {
+            if(rtp_jpeg_parse(frame, frame_size, &jpg) < 0) {
+                if(!warned)
+                    OPRINT("frame can not be sent as RTP/JPEG (see help), skipping such frames\n");
+                warned = 1;
+            } else if(rtp_jpeg_packetize(&stream, &jpg, rtp_timestamp) > 0) {
+                stream.fec_count = 0;
+                if(multicast && fec_group > 0)
+                    rtp_fec_protect(&stream, fec_group);
+                ready = 1;
             }
+        }
+
+        /* the packets of the stream are only changed by this thread */
+        ntcp = ready ? collect_tcp_dests() : 0;
+        nudp = ready ? collect_udp_dests() : 0;
+        pthread_mutex_unlock(&sessions_mutex);
+
+        /* TCP first, pacing the UDP packets would delay them */
+        send_interleaved(ntcp);
+        release_tcp_dests(ntcp);
+        send_packets(nudp);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: send a reply to a RTSP request
+Input Value.: * client.: the connection
+              * cseq...: sequence number of the request
+              * status.: status code and reason, for example "200 OK"
+              * headers: further header lines, may be NULL
+              * body...: content, may be NULL
+Return Value: -
+******************************************************************************/
+static void rtsp_reply(rtsp_client *client, int cseq, const char *status, const char *headers, const char *body)
+{
+    char buffer[RTSP_BUFFER_SIZE];
+    struct iovec iov[2];
+    int len;
+
+    len = snprintf(buffer, sizeof(buffer),
+                   "RTSP/1.0 %s\r\n" \
+                   "CSeq: %d\r\n" \
+                   "Server: MJPG-Streamer/0.2\r\n" \
+                   "%s" \
+                   "Content-Length: %d\r\n" \
+                   "\r\n",
+                   status, cseq, (headers != NULL) ? headers : "", (body != NULL) ? (int)strlen(body) : 0);
+    if(len >= (int)sizeof(buffer))
+        return;
+
+    iov[0].iov_base = buffer;
+    iov[0].iov_len = len;
+    iov[1].iov_base = (void *)((body != NULL) ? body : "");
+    iov[1].iov_len = (body != NULL) ? strlen(body) : 0;
+
+    /* replies are not skipped like frames, wait until the socket takes them */
+    pthread_mutex_lock(&client->write_lock);
+    if(send_iov(client->fd, iov, 2) == 0) {
+        struct pollfd pfd = { client->fd, POLLOUT, 0 };
+        if(poll(&pfd, 1, TCP_SEND_TIMEOUT) > 0)
+            send_iov(client->fd, iov, 2);
+    }
+    pthread_mutex_unlock(&client->write_lock);
+}
+
+/* the sessions mutex must be held */
+static rtsp_session *find_session(rtsp_client *client, const char *id)
+{
+    int i;
+
+    for(i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i].in_use && sessions[i].client == client && strcmp(sessions[i].id, id) == 0)
+            return &sessions[i];
+    }
+
+    return NULL;
+}
 
-            close(fd);
+/******************************************************************************
+Description.: handle a SETUP request, creates the session
+Input Value.: * client.: the connection
+              * req....: the request
+Return Value: -
+******************************************************************************/
+static void rtsp_setup(rtsp_client *client, rtsp_request *req)
+{
+    char value[64], headers[512];
+    int i, a = 0, b = 0;
+    rtsp_session *s = NULL;
+
+    pthread_mutex_lock(&sessions_mutex);
+
+    if(req->session[0] != '\0') {
+        if((s = find_session(client, req->session)) == NULL) {
+            pthread_mutex_unlock(&sessions_mutex);
+            rtsp_reply(client, req->cseq, "454 Session Not Found", NULL, NULL);
+            return;
         }
+    } else {
+        for(i = 0; i < MAX_SESSIONS && s == NULL; i++) {
+            if(!sessions[i].in_use)
+                s = &sessions[i];
+        }
+        if(s == NULL) {
+            pthread_mutex_unlock(&sessions_mutex);
+            rtsp_reply(client, req->cseq, "453 Not Enough Bandwidth", NULL, NULL);
+            return;
+        }
+    }
 
-        // send back client's message that came in udpbuffer
-        sendto(sd, udpbuffer, bytes, 0, (struct sockaddr*)&addr, sizeof(addr));
+    if(strcasestr(req->transport, "multicast") != NULL) {
+        if(!multicast) {
+            pthread_mutex_unlock(&sessions_mutex);
+            rtsp_reply(client, req->cseq, "461 Unsupported Transport", NULL, NULL);
+            return;
+        }
 
-        /* call the command if user specified one, pass current filename as argument */
-        if(command != NULL) {
-            memset(buffer1, 0, sizeof(buffer1));
+        s->transport = RTP_MULTICAST;
+        a = ntohs(group_addr.sin_port);
+        snprintf(headers, sizeof(headers), "Transport: RTP/AVP;multicast;destination=%s;port=%d-%d;ttl=%d;ssrc=%08X\r\n",
+                 inet_ntoa(group_addr.sin_addr), a, a + 1, ttl, stream.ssrc);
+    } else if(strncasecmp(req->transport, "RTP/AVP/TCP", 11) == 0) {
+        if(rtsp_transport_param(req->transport, "interleaved", value, sizeof(value)) == NULL ||
+           sscanf(value, "%d-%d", &a, &b) < 1)
+            a = 0;
+        if(a < 0 || a > 254)
+            a = 0;
 
-            /* udpbuffer still contains the filename, pass it to the command as parameter */
-            snprintf(buffer1, sizeof(buffer1), "%s \"%s\"", command, udpbuffer);
-            DBG("calling command %s", buffer1);
+        s->transport = RTP_TCP;
+        s->channel = a;
+        snprintf(headers, sizeof(headers), "Transport: RTP/AVP/TCP;unicast;interleaved=%d-%d;ssrc=%08X\r\n",
+                 a, a + 1, stream.ssrc);
+    } else if(strncasecmp(req->transport, "RTP/AVP", 7) == 0 &&
+              rtsp_transport_param(req->transport, "client_port", value, sizeof(value)) != NULL &&
+              sscanf(value, "%d-%d", &a, &b) >= 1 && a > 0 && a < 65536) {
+        if(b <= 0)
+            b = a + 1;
 
-            /* in addition provide the filename as environment variable */
-            if((rc = setenv("MJPG_FILE", udpbuffer, 1)) != 0) {
-                LOG("setenv failed (return value %d)\n", rc);
-            }
+        s->transport = RTP_UDP;
+        s->rtp_addr = client->peer;
+        s->rtp_addr.sin_port = htons(a);
+        snprintf(headers, sizeof(headers), "Transport: RTP/AVP;unicast;client_port=%d-%d;server_port=%d-%d;ssrc=%08X\r\n",
+                 a, b, server_rtp_port, server_rtcp_port, stream.ssrc);
+    } else {
+        pthread_mutex_unlock(&sessions_mutex);
+        rtsp_reply(client, req->cseq, "461 Unsupported Transport", NULL, NULL);
+        return;
+    }
+
+    if(!s->in_use) {
+        s->in_use = 1;
+        s->client = client;
+        snprintf(s->id, sizeof(s->id), "%08lX%08lX", random() & 0xffffffffL, random() & 0xffffffffL);
+    }
+    s->state = RTSP_State_Setup;
+
+    i = strlen(headers);
+    snprintf(headers + i, sizeof(headers) - i, "Session: %s;timeout=60\r\n", s->id);
+
+    pthread_mutex_unlock(&sessions_mutex);
+
+    DBG("session %s uses %s\n", s->id, (s->transport == RTP_TCP) ? "TCP" : "UDP");
+    rtsp_reply(client, req->cseq, "200 OK", headers, NULL);
+}
+
+/******************************************************************************
+Description.: handle a request
+Input Value.: * client.: the connection
+              * buffer.: the request, zero terminated
+Return Value: -
+******************************************************************************/
+static void rtsp_handle(rtsp_client *client, const char *buffer)
+{
+    rtsp_request req;
+    rtsp_session *s;
+    char headers[1024], body[1024], host[INET_ADDRSTRLEN] = "0.0.0.0", conn[64];
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    const char *url;
+    int n;
+
+    if(rtsp_parse_request(buffer, &req) < 0) {
+        rtsp_reply(client, 0, "400 Bad Request", NULL, NULL);
+        return;
+    }
+
+    DBG("%s %s (CSeq %d)\n", req.method, req.url, req.cseq);
+
+    if(strcmp(req.method, "OPTIONS") == 0) {
+        rtsp_reply(client, req.cseq, "200 OK",
+                   "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER, SET_PARAMETER\r\n", NULL);
+    } else if(strcmp(req.method, "DESCRIBE") == 0) {
+        if(getsockname(client->fd, (struct sockaddr *)&local, &len) == 0)
+            inet_ntop(AF_INET, &local.sin_addr, host, sizeof(host));
+
+        /* clients join the group if it is announced */
+        if(multicast)
+            snprintf(conn, sizeof(conn), "%s/%d", inet_ntoa(group_addr.sin_addr), ttl);
+        else
+            snprintf(conn, sizeof(conn), "0.0.0.0");
+
+        snprintf(body, sizeof(body),
+                 "v=0\r\n" \
+                 "o=- %u 1 IN IP4 %s\r\n" \
+                 "s=MJPG-Streamer\r\n" \
+                 "c=IN IP4 %s\r\n" \
+                 "t=0 0\r\n" \
+                 "a=control:*\r\n" \
+                 "m=video %d RTP/AVP %d\r\n" \
+                 "a=rtpmap:%d JPEG/%d\r\n" \
+                 "a=control:track0\r\n",
+                 stream.ssrc, host, conn, multicast ? ntohs(group_addr.sin_port) : 0,
+                 RTP_PT_JPEG, RTP_PT_JPEG, RTP_CLOCK_RATE);
+        url = req.url;
+        snprintf(headers, sizeof(headers), "Content-Base: %s%s\r\nContent-Type: application/sdp\r\n",
+                 url, (url[strlen(url)-1] == '/') ? "" : "/");
+        rtsp_reply(client, req.cseq, "200 OK", headers, body);
+    } else if(strcmp(req.method, "SETUP") == 0) {
+        rtsp_setup(client, &req);
+    } else if(strcmp(req.method, "PLAY") == 0 || strcmp(req.method, "PAUSE") == 0 ||
+              strcmp(req.method, "TEARDOWN") == 0) {
+        pthread_mutex_lock(&sessions_mutex);
+        if((s = find_session(client, req.session)) == NULL) {
+            pthread_mutex_unlock(&sessions_mutex);
+            rtsp_reply(client, req.cseq, "454 Session Not Found", NULL, NULL);
+            return;
+        }
+
+        snprintf(headers, sizeof(headers), "Session: %s\r\n", s->id);
+        if(strcmp(req.method, "PLAY") == 0) {
+            s->state = RTSP_State_Playing;
+            n = strlen(headers);
+            snprintf(headers + n, sizeof(headers) - n, "Range: npt=0.000-\r\nRTP-Info: url=%s;seq=%u\r\n",
+                     req.url, stream.seq);
+        } else if(strcmp(req.method, "PAUSE") == 0) {
+            s->state = RTSP_State_Paused;
+        } else {
+            free_session(s);
+        }
+        pthread_mutex_unlock(&sessions_mutex);
+
+        rtsp_reply(client, req.cseq, "200 OK", headers, NULL);
+    } else if(strcmp(req.method, "GET_PARAMETER") == 0 || strcmp(req.method, "SET_PARAMETER") == 0) {
+        /* used as keepalive */
+        rtsp_reply(client, req.cseq, "200 OK", NULL, NULL);
+    } else {
+        rtsp_reply(client, req.cseq, "501 Not Implemented", NULL, NULL);
+    }
+}
+
+/******************************************************************************
+Description.: serve a RTSP connection, the sessions it created end with it
+Input Value.: the client, it is freed after the thread was joined
+Return Value: NULL
+******************************************************************************/
+void *client_thread(void *arg)
+{
+    rtsp_client *client = arg;
+    char buffer[RTSP_BUFFER_SIZE + 1];
+    int i, n, len = 0, skip = 0, request;
 
-            /* execute the command now */
-            if((rc = system(buffer1)) != 0) {
-                LOG("command failed (return value %d)\n", rc);
+    while(!pglobal->stop) {
+        n = recv(client->fd, buffer + len, RTSP_BUFFER_SIZE - len, 0);
+        if(n <= 0)
+            break;
+
+        /* interleaved data from the client (RTCP) is not evaluated */
+        if(skip > 0) {
+            i = MIN(skip, n);
+            memmove(buffer + len, buffer + len + i, n - i);
+            skip -= i;
+            n -= i;
+        }
+        len += n;
+        buffer[len] = '\0';
+
+        while(len > 0) {
+            if(buffer[0] == '$') {
+                if(len < 4)
+                    break;
+                n = 4 + (((unsigned char)buffer[2] << 8) | (unsigned char)buffer[3]);
+                if(n > len) {
+                    skip = n - len;
+                    len = 0;
+                    break;
+                }
+            } else {
+                if((n = rtsp_request_length(buffer, len)) <= 0)
+                    break;
+
+                request = buffer[n];
+                buffer[n] = '\0';
+                rtsp_handle(client, buffer);
+                buffer[n] = request;
             }
+
+            memmove(buffer, buffer + n, len - n);
+            len -= n;
+            buffer[len] = '\0';
+        }
+
+        if(n < 0) {
+            DBG("invalid Content-Length\n");
+            break;
+        }
+
+        if(len == RTSP_BUFFER_SIZE) {
+            DBG("request too large\n");
+            break;
         }
     }
 
-    // close UDP port
-    if(port > 0)
-        close(sd);
+    DBG("RTSP connection closed\n");
+
+    pthread_mutex_lock(&sessions_mutex);
+    for(i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i].in_use && sessions[i].client == client)
+            free_session(&sessions[i]);
+    }
+    pthread_mutex_unlock(&sessions_mutex);
+
+    /* the worker may still send to the socket, the last reference closes it */
+    pthread_mutex_lock(&clients_mutex);
+    if(client->refs == 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+    client->done = 1;
+    pthread_mutex_unlock(&clients_mutex);
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: join the threads of closed connections and free them
+Input Value.: all: also wait for the connections that are still open, their
+                   sockets must have been shut down
+              deadline: from stop_deadline(), only used with all
+Return Value: 0 if ok, -1 if a thread did not finish in time
+******************************************************************************/
+static int reap_clients(int all, const struct timespec *deadline)
+{
+    rtsp_client **p = &clients, *client;
+    int rc = 0;
+
+    pthread_mutex_lock(&clients_mutex);
+    while((client = *p) != NULL) {
+        if((!client->done || client->refs > 0) && !all) {
+            p = &client->next;
+            continue;
+        }
+
+        /* the thread may wait for the mutex right before it finishes */
+        pthread_mutex_unlock(&clients_mutex);
+        if(client->done)
+            pthread_join(client->thread, NULL);
+        else if(join_thread(client->thread, deadline) != 0)
+            rc = -1;
+        pthread_mutex_lock(&clients_mutex);
+
+        if(rc != 0)
+            break;
+
+        *p = client->next;
+        pthread_mutex_destroy(&client->write_lock);
+        free(client);
+    }
+    pthread_mutex_unlock(&clients_mutex);
+
+    return rc;
+}
+
+/******************************************************************************
+Description.: accept RTSP connections, each one is served by its own thread
+Input Value.: -
+Return Value: NULL
+******************************************************************************/
+void *server_thread(void *arg)
+{
+    rtsp_client *client;
+    socklen_t len;
+    int on = 1;
+
+    while(!pglobal->stop) {
+        /* wait for a connection, or for the plugin to be stopped */
+        if(stop_event_poll(stop_fd, listen_sd, POLLIN) != 0)
+            break;
 
-    /* cleanup now */
-    pthread_cleanup_pop(1);
+        reap_clients(0, NULL);
+
+        if((client = calloc(1, sizeof(rtsp_client))) == NULL) {
+            LOG("not enough memory\n");
+            break;
+        }
+
+        len = sizeof(client->peer);
+        if((client->fd = accept(listen_sd, (struct sockaddr *)&client->peer, &len)) < 0) {
+            free(client);
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            break;
+        }
+
+        setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        pthread_mutex_init(&client->write_lock, NULL);
+
+        DBG("RTSP connection from %s\n", inet_ntoa(client->peer.sin_addr));
+
+        pthread_mutex_lock(&clients_mutex);
+        if(pthread_create(&client->thread, NULL, client_thread, client) != 0) {
+            pthread_mutex_unlock(&clients_mutex);
+            close(client->fd);
+            pthread_mutex_destroy(&client->write_lock);
+            free(client);
+            continue;
+        }
+        client->next = clients;
+        clients = client;
+        pthread_mutex_unlock(&clients_mutex);
+    }
 
     return NULL;
 }
 
+/* bind a UDP socket, port 0 picks any port */
+static int udp_socket(int udp_port, int *bound)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int sd;
+
+    if((sd = socket(PF_INET, SOCK_DGRAM, 0)) < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(udp_port);
+
+    if(bind(sd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+       getsockname(sd, (struct sockaddr *)&addr, &len) != 0) {
+        close(sd);
+        return -1;
+    }
+
+    *bound = ntohs(addr.sin_port);
+    return sd;
+}
+
 /*** plugin interface functions ***/
 /******************************************************************************
 Description.: this function is called first, in order to initialise
@@ -266,6 +1065,18 @@ int output_init(output_parameter *param)
             {"port", required_argument, 0, 0},
             {"i", required_argument, 0, 0},
             {"input", required_argument, 0, 0},
+            {"r", required_argument, 0, 0},
+            {"rtp_port", required_argument, 0, 0},
+            {"m", required_argument, 0, 0},
+            {"mtu", required_argument, 0, 0},
+            {"g", required_argument, 0, 0},
+            {"group", required_argument, 0, 0},
+            {"t", required_argument, 0, 0},
+            {"ttl", required_argument, 0, 0},
+            {"P", required_argument, 0, 0},
+            {"pace", required_argument, 0, 0},
+            {"f", required_argument, 0, 0},
+            {"fec", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -299,6 +1110,56 @@ int output_init(output_parameter *param)
             DBG("case 4,5\n");
             input_number = atoi(optarg);
             break;
+            /* r, rtp_port */
+        case 6:
+        case 7:
+            DBG("case 6,7\n");
+            rtp_port = atoi(optarg);
+            break;
+            /* m, mtu */
+        case 8:
+        case 9:
+            DBG("case 8,9\n");
+            mtu = atoi(optarg);
+            break;
+            /* g, group */
+        case 10:
+        case 11: {
+            char *colon;
+
+            DBG("case 10,11\n");
+            memset(&group_addr, 0, sizeof(group_addr));
+            group_addr.sin_family = AF_INET;
+            group_addr.sin_port = htons(MULTICAST_PORT);
+            if((colon = strchr(optarg, ':')) != NULL) {
+                *colon = '\0';
+                group_addr.sin_port = htons(atoi(colon + 1));
+            }
+            if(inet_aton(optarg, &group_addr.sin_addr) == 0 || !IN_MULTICAST(ntohl(group_addr.sin_addr.s_addr))) {
+                OPRINT("ERROR: %s is not a multicast address\n", optarg);
+                return 1;
+            }
+            multicast = 1;
+            break;
+        }
+            /* t, ttl */
+        case 12:
+        case 13:
+            DBG("case 12,13\n");
+            ttl = atoi(optarg);
+            break;
+            /* P, pace */
+        case 14:
+        case 15:
+            DBG("case 14,15\n");
+            pace = atoi(optarg);
+            break;
+            /* f, fec */
+        case 16:
+        case 17:
+            DBG("case 16,17\n");
+            fec_group = atoi(optarg);
+            break;
         }
     }
 
@@ -308,34 +1169,151 @@ int output_init(output_parameter *param)
         return 1;
     }
 
+    if(pglobal->in[input_number].format == V4L2_PIX_FMT_H264) {
+        OPRINT("ERROR: the %d input_plugin delivers H.264, RTP/JPEG needs JPG frames\n", input_number);
+        return 1;
+    }
+
+    if(mtu < RTP_HEADER_MAX + 64 || mtu > 65000) {
+        OPRINT("ERROR: the MTU must be between %d and 65000\n", RTP_HEADER_MAX + 64);
+        return 1;
+    }
+
+    if(fec_group < 0 || fec_group > RTP_FEC_MAX_GROUP) {
+        OPRINT("ERROR: a FEC packet can protect up to %d packets\n", RTP_FEC_MAX_GROUP);
+        return 1;
+    }
+
+    if(pace < 0)
+        pace = multicast ? 50 : 0;
+    pace = MIN(pace, 100);
+
+    if(multicast) {
+        fec_addr = group_addr;
+        fec_addr.sin_port = htons(ntohs(group_addr.sin_port) + 2);
+    }
+
+    srandom(time(NULL) ^ getpid());
+    memset(&stream, 0, sizeof(stream));
+    stream.ssrc = random();
+    stream.seq = random();
+    stream.mtu = mtu;
+
     OPRINT("input plugin.....: %d: %s\n", input_number, pglobal->in[input_number].plugin);
-    OPRINT("UDP port..........: %s\n", "disabled");
+    OPRINT("RTSP port........: %d\n", port);
+    OPRINT("RTP port.........: %s\n", (rtp_port > 0) ? "as specified" : "any");
+    OPRINT("MTU..............: %d\n", mtu);
+    if(multicast) {
+        OPRINT("multicast group..: %s:%d, TTL %d\n", inet_ntoa(group_addr.sin_addr), ntohs(group_addr.sin_port), ttl);
+        if(fec_group > 0) {
+            OPRINT("FEC..............: 1 packet per %d, port %d\n", fec_group, ntohs(fec_addr.sin_port));
+        }
+    }
+    OPRINT("pacing...........: %d%% of the frame interval\n", pace);
     return 0;
 }
 
 /******************************************************************************
-Description.: calling this function stops the worker thread
+Description.: calling this function stops the worker thread, the server and
+              the connections
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the threads finished, -1 if they did not in time
 ******************************************************************************/
 int output_stop(int id)
 {
-    DBG("will cancel worker thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+    rtsp_client *client;
+    int rc = 0;
+
+    /* loaded but never run, there is no thread */
+    if(stop_fd < 0)
+        return 0;
+
+    DBG("will stop worker thread\n");
+    stop_deadline(&deadline);
+
+    /* wake up the worker waiting for a frame and the server */
+    pthread_mutex_lock(&pglobal->in[input_number].db);
+    stopping = 1;
+    pthread_cond_broadcast(&pglobal->in[input_number].db_update);
+    pthread_mutex_unlock(&pglobal->in[input_number].db);
+    stop_event_set(stop_fd);
+
+    if(join_thread(worker, &deadline) != 0 || join_thread(server, &deadline) != 0)
+        rc = -1;
+
+    /* no new connections now, end the open ones */
+    pthread_mutex_lock(&clients_mutex);
+    for(client = clients; client != NULL; client = client->next) {
+        if(!client->done)
+            shutdown(client->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&clients_mutex);
+
+    if(rc != 0 || reap_clients(1, &deadline) != 0) {
+        OPRINT("the threads did not finish in time\n");
+        return -1;
+    }
+
+    worker_cleanup(NULL);
+    close(listen_sd);
+    close(rtp_sd);
+    close(rtcp_sd);
+    close(stop_fd);
+    listen_sd = rtp_sd = rtcp_sd = stop_fd = -1;
     return 0;
 }
 
 /******************************************************************************
-Description.: calling this function creates and starts the worker thread
+Description.: calling this function opens the sockets and starts the threads
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if ok, 1 if the sockets could not be opened
 ******************************************************************************/
 int output_run(int id)
 {
+    struct sockaddr_in addr;
+    int on = 1;
+
+    if((rtp_sd = udp_socket(rtp_port, &server_rtp_port)) < 0 ||
+       (rtcp_sd = udp_socket((rtp_port > 0) ? rtp_port + 1 : 0, &server_rtcp_port)) < 0) {
+        perror("could not open the RTP/RTCP ports");
+        return 1;
+    }
+
+    if((listen_sd = socket(PF_INET, SOCK_STREAM, 0)) < 0) {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if(bind(listen_sd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_sd, 10) != 0) {
+        perror("could not bind the RTSP port");
+        close(listen_sd);
+        return 1;
+    }
+
+    if(multicast) {
+        unsigned char mttl = ttl;
+        if(setsockopt(rtp_sd, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl)) != 0)
+            perror("could not set the multicast TTL");
+    }
+
+    OPRINT("RTP/RTCP ports...: %d-%d\n", server_rtp_port, server_rtcp_port);
+
+    stopping = 0;
+    if((stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        close(listen_sd);
+        return 1;
+    }
+
     DBG("launching worker thread\n");
     pthread_create(&worker, 0, worker_thread, NULL);
-    pthread_detach(worker);
+
+    pthread_create(&server, 0, server_thread, NULL);
     return 0;
 }
-
-
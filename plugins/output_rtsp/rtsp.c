@@ -1,6 +1,576 @@
-#include
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
 
-int main()
+/*
+  RTP payload format for JPEG (RFC 2435) and the bits of RTSP (RFC 2326)
+  needed to serve a single live stream.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "rtsp.h"
+
+/* the Huffman tables of JPEG spec K.3, receivers of RTP/JPEG assume them */
+static const unsigned char std_dc_luminance_bits[16] = {
+    0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+};
+static const unsigned char std_dc_chrominance_bits[16] = {
+    0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
+};
+static const unsigned char std_dc_values[12] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+static const unsigned char std_ac_luminance_bits[16] = {
+    0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d
+};
+static const unsigned char std_ac_luminance_values[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+static const unsigned char std_ac_chrominance_bits[16] = {
+    0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
+};
+static const unsigned char std_ac_chrominance_values[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+/******************************************************************************
+Description.: compare the tables of a DHT segment with the standard tables
+Input Value.: * seg....: content of the segment
+              * len....: length of the content
+Return Value: 0 if all tables are standard ones, -1 otherwise
+******************************************************************************/
+static int standard_huffman(const unsigned char *seg, int len)
+{
+    const unsigned char *bits, *vals;
+    int i = 0, count, j;
+
+    while(i + 17 <= len) {
+        switch(seg[i]) {
+        case 0x00:
+            bits = std_dc_luminance_bits;
+            vals = std_dc_values;
+            break;
+        case 0x01:
+            bits = std_dc_chrominance_bits;
+            vals = std_dc_values;
+            break;
+        case 0x10:
+            bits = std_ac_luminance_bits;
+            vals = std_ac_luminance_values;
+            break;
+        case 0x11:
+            bits = std_ac_chrominance_bits;
+            vals = std_ac_chrominance_values;
+            break;
+        default:
+            return -1;
+        }
+
+        for(j = 0, count = 0; j < 16; j++)
+            count += seg[i + 1 + j];
+
+        if(i + 17 + count > len || memcmp(seg + i + 1, bits, 16) != 0 ||
+           memcmp(seg + i + 17, vals, count) != 0)
+            return -1;
+
+        i += 17 + count;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: check if a JPEG can be sent as RTP/JPEG and find the parts
+              of it that are transmitted. The receiver rebuilds the headers
+              from the type, the size and the quantization tables, the
+              standard Huffman tables are implied. Frames with other
+              Huffman tables (for example optimized ones) are refused.
+Input Value.: * data...: the JPEG frame
+              * len....: size of the frame
+              * jpg....: receives the description
+Return Value: 0 if ok, -1 if the frame can not be represented
+******************************************************************************/
+int rtp_jpeg_parse(const unsigned char *data, int len, rtp_jpeg *jpg)
+{
+    const unsigned char *p = data, *end = data + len, *seg;
+    const unsigned char *tables[4] = {NULL, NULL, NULL, NULL};
+    int seglen, i, tq[3] = {0, 0, 0}, sof = 0;
+
+    if(len < 4 || p[0] != 0xff || p[1] != 0xd8)
+        return -1;
+    p += 2;
+
+    jpg->restart_interval = 0;
+
+    while(p + 2 <= end) {
+        if(p[0] != 0xff)
+            return -1;
+        if(p[1] == 0xff) {
+            p++;
+            continue;
+        }
+
+        /* the scan has not started yet, every marker has a length */
+        if(p + 4 > end)
+            return -1;
+        seglen = (p[2] << 8) | p[3];
+        seg = p + 4;
+        if(seglen < 2 || p + 2 + seglen > end)
+            return -1;
+
+        switch(p[1]) {
+        case 0xdb: /* quantization tables, only 8 bit precision */
+            for(i = 0; i + 65 <= seglen - 2; i += 65) {
+                if((seg[i] >> 4) != 0 || (seg[i] & 0x0f) > 3)
+                    return -1;
+                tables[seg[i] & 0x0f] = seg + i + 1;
+            }
+            break;
+
+        case 0xc0: /* baseline frame with Y, Cb and Cr */
+            if(seglen < 17 || seg[0] != 8 || seg[5] != 3)
+                return -1;
+            jpg->height = (seg[1] << 8) | seg[2];
+            jpg->width = (seg[3] << 8) | seg[4];
+            if(seg[7] == 0x21)
+                jpg->type = 0;
+            else if(seg[7] == 0x22)
+                jpg->type = 1;
+            else
+                return -1;
+            if(seg[10] != 0x11 || seg[13] != 0x11)
+                return -1;
+            for(i = 0; i < 3; i++)
+                tq[i] = seg[8 + 3 * i] & 0x03;
+            if(tq[1] != tq[2])
+                return -1;
+            sof = 1;
+            break;
+
+        case 0xc1: case 0xc2: case 0xc3: case 0xc5: case 0xc6: case 0xc7:
+        case 0xc9: case 0xca: case 0xcb: case 0xcd: case 0xce: case 0xcf:
+            return -1;
+
+        case 0xc4:
+            if(standard_huffman(seg, seglen - 2) < 0)
+                return -1;
+            break;
+
+        case 0xdd:
+            if(seglen < 4)
+                return -1;
+            jpg->restart_interval = (seg[0] << 8) | seg[1];
+            break;
+
+        case 0xda:
+            if(!sof || tables[tq[0]] == NULL || tables[tq[1]] == NULL)
+                return -1;
+
+            /* luminance uses the tables 0, chrominance the tables 1 */
+            if(seglen < 12 || seg[0] != 3 || seg[2] != 0x00 || seg[4] != 0x11 || seg[6] != 0x11)
+                return -1;
+
+            /* the payload format has room for 2040x2040 pixels */
+            if(jpg->width == 0 || jpg->height == 0 || jpg->width > 2040 || jpg->height > 2040)
+                return -1;
+
+            memcpy(jpg->qtables, tables[tq[0]], 64);
+            memcpy(jpg->qtables + 64, tables[tq[1]], 64);
+            if(jpg->restart_interval)
+                jpg->type += 64;
+
+            jpg->scan = p + 2 + seglen;
+            jpg->scan_len = end - jpg->scan;
+
+            /* the receiver appends the EOI marker again */
+            for(i = jpg->scan_len - 2; i >= 0; i--) {
+                if(jpg->scan[i] == 0xff && jpg->scan[i+1] == 0xd9) {
+                    jpg->scan_len = i;
+                    break;
+                }
+            }
+            return 0;
+
+        default:
+            break;
+        }
+
+        p += 2 + seglen;
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+Description.: split a frame into RTP packets, the headers are prepared in the
+              packet array of the stream and the payload points into the frame
+Input Value.: * st.....: the stream, its sequence number is advanced
+              * jpg....: the parsed frame
+              * timestamp: RTP timestamp of the frame (90 kHz)
+Return Value: number of packets, -1 if there is not enough memory
+******************************************************************************/
+int rtp_jpeg_packetize(rtp_stream *st, const rtp_jpeg *jpg, unsigned int timestamp)
+{
+    int offset = 0, n, chunk;
+    rtp_packet *pkt, *tmp;
+    unsigned char *h;
+
+    st->count = 0;
+
+    while(offset < jpg->scan_len) {
+        if(st->count == st->allocated) {
+            n = (st->allocated > 0) ? st->allocated * 2 : 64;
+            if((tmp = realloc(st->packets, n * sizeof(rtp_packet))) == NULL)
+                return -1;
+            st->packets = tmp;
+            st->allocated = n;
+        }
+
+        pkt = &st->packets[st->count++];
+        h = pkt->header;
+
+        /* RTP header, RFC 3550 section 5.1 */
+        h[0] = 0x80;
+        h[1] = RTP_PT_JPEG;
+        h[2] = st->seq >> 8;
+        h[3] = st->seq & 0xff;
+        h[4] = timestamp >> 24;
+        h[5] = timestamp >> 16;
+        h[6] = timestamp >> 8;
+        h[7] = timestamp;
+        h[8] = st->ssrc >> 24;
+        h[9] = st->ssrc >> 16;
+        h[10] = st->ssrc >> 8;
+        h[11] = st->ssrc;
+        st->seq++;
+
+        /* main JPEG header, RFC 2435 section 3.1, Q = 255 means in-band tables */
+        h[12] = 0;
+        h[13] = offset >> 16;
+        h[14] = offset >> 8;
+        h[15] = offset;
+        h[16] = jpg->type;
+        h[17] = 255;
+        h[18] = (jpg->width + 7) / 8;
+        h[19] = (jpg->height + 7) / 8;
+        pkt->header_len = 20;
+
+        /* restart marker header, the frame is not split at restart intervals */
+        if(jpg->type & 64) {
+            h[20] = jpg->restart_interval >> 8;
+            h[21] = jpg->restart_interval & 0xff;
+            h[22] = 0xff;
+            h[23] = 0xff;
+            pkt->header_len = 24;
+        }
+
+        /* quantization table header only in the first packet */
+        if(offset == 0) {
+            h += pkt->header_len;
+            h[0] = 0;
+            h[1] = 0;
+            h[2] = 0;
+            h[3] = 128;
+            memcpy(h + 4, jpg->qtables, 128);
+            pkt->header_len += 4 + 128;
+        }
+
+        chunk = st->mtu - pkt->header_len;
+        if(chunk > jpg->scan_len - offset)
+            chunk = jpg->scan_len - offset;
+
+        pkt->payload = jpg->scan + offset;
+        pkt->payload_len = chunk;
+        offset += chunk;
+    }
+
+    /* the marker bit flags the last packet of the frame */
+    if(st->count > 0)
+        st->packets[st->count - 1].header[1] |= 0x80;
+
+    return st->count;
+}
+
+/******************************************************************************
+Description.: build XOR parity packets (RFC 5109, level 0 only) for the
+              packets of the current frame. Each one protects a group of
+              consecutive packets, a receiver can restore one lost packet
+              per group.
+Input Value.: * st.....: the stream with the packetized frame
+              * group..: number of packets protected by one FEC packet
+Return Value: number of FEC packets, -1 if there is not enough memory
+******************************************************************************/
+int rtp_fec_protect(rtp_stream *st, int group)
 {
+    int first, last, i, j, len, max_len, n;
+    unsigned int ts, mask;
+    unsigned char *f, *x, b0, b1;
+    unsigned short len_recovery;
+    rtp_fec_packet *tmp;
+    rtp_packet *pkt;
+
+    st->fec_count = 0;
+
+    for(first = 0; first < st->count; first += group) {
+        last = first + group - 1;
+        if(last >= st->count)
+            last = st->count - 1;
+
+        if(st->fec_count == st->fec_allocated) {
+            n = (st->fec_allocated > 0) ? st->fec_allocated * 2 : 16;
+            if((tmp = realloc(st->fec, n * sizeof(rtp_fec_packet))) == NULL)
+                return -1;
+            for(i = st->fec_allocated; i < n; i++) {
+                if((tmp[i].data = malloc(st->mtu + RTP_FEC_OVERHEAD)) == NULL) {
+                    st->fec = tmp;
+                    st->fec_allocated = i;
+                    return -1;
+                }
+            }
+            st->fec = tmp;
+            st->fec_allocated = n;
+        }
+
+        f = st->fec[st->fec_count].data;
+        x = f + RTP_FEC_OVERHEAD;
+        b0 = b1 = 0;
+        ts = 0;
+        len_recovery = 0;
+        max_len = 0;
+        mask = 0;
+
+        /* XOR everything that follows the fixed RTP headers */
+        for(i = first; i <= last; i++) {
+            pkt = &st->packets[i];
+            len = pkt->header_len - 12 + pkt->payload_len;
+
+            for(j = max_len; j < len; j++)
+                x[j] = 0;
+            if(len > max_len)
+                max_len = len;
+
+            for(j = 12; j < pkt->header_len; j++)
+                x[j - 12] ^= pkt->header[j];
+            for(j = 0; j < pkt->payload_len; j++)
+                x[pkt->header_len - 12 + j] ^= pkt->payload[j];
+
+            b0 ^= pkt->header[0];
+            b1 ^= pkt->header[1];
+            ts ^= ((unsigned int)pkt->header[4] << 24) | (pkt->header[5] << 16) | (pkt->header[6] << 8) | pkt->header[7];
+            len_recovery ^= len;
+            mask |= 0x8000 >> (i - first);
+        }
+
+        /* RTP header, the packets of a frame share the timestamp */
+        f[0] = 0x80;
+        f[1] = RTP_PT_FEC;
+        f[2] = st->fec_seq >> 8;
+        f[3] = st->fec_seq & 0xff;
+        memcpy(f + 4, st->packets[first].header + 4, 8);
+        st->fec_seq++;
+
+        /* FEC header, E and L are 0 */
+        f[12] = b0 & 0x3f;
+        f[13] = b1;
+        f[14] = st->packets[first].header[2];
+        f[15] = st->packets[first].header[3];
+        f[16] = ts >> 24;
+        f[17] = ts >> 16;
+        f[18] = ts >> 8;
+        f[19] = ts;
+        f[20] = len_recovery >> 8;
+        f[21] = len_recovery & 0xff;
+
+        /* level 0 header */
+        f[22] = max_len >> 8;
+        f[23] = max_len & 0xff;
+        f[24] = mask >> 8;
+        f[25] = mask & 0xff;
+
+        st->fec[st->fec_count].len = RTP_FEC_OVERHEAD + max_len;
+        st->fec[st->fec_count].last = last;
+        st->fec_count++;
+    }
+
+    return st->fec_count;
+}
+
+void rtp_stream_free(rtp_stream *st)
+{
+    int i;
+
+    free(st->packets);
+    st->packets = NULL;
+    st->count = st->allocated = 0;
+
+    for(i = 0; i < st->fec_allocated; i++)
+        free(st->fec[i].data);
+    free(st->fec);
+    st->fec = NULL;
+    st->fec_count = st->fec_allocated = 0;
+}
+
+/******************************************************************************
+Description.: check if a complete request is in the buffer
+Input Value.: * buffer.: received data, zero terminated
+              * len....: number of bytes in the buffer
+Return Value: length of the request including its body, 0 if incomplete,
+              -1 if the body can not fit into the buffer or its length is
+              invalid
+******************************************************************************/
+int rtsp_request_length(const char *buffer, int len)
+{
+    const char *end = strstr(buffer, "\r\n\r\n"), *cl;
+    char *digits;
+    long body = 0;
+    int header;
+
+    if(end == NULL)
+        return 0;
+
+    header = end + 4 - buffer;
+
+    cl = strcasestr(buffer, "\nContent-Length:");
+    if(cl != NULL && cl < end) {
+        errno = 0;
+        body = strtol(cl + 16, &digits, 10);
+        if(errno != 0 || digits == cl + 16 || body < 0)
+            return -1;
+    }
+
+    /* checked before the sum, a huge length must not wrap it */
+    if(body > RTSP_BUFFER_SIZE - header)
+        return -1;
+
+    if(header + body > len)
+        return 0;
+
+    return header + body;
+}
+
+/* copy the value of a header line, the name includes the colon */
+static void header_value(const char *buffer, const char *name, char *value, int size)
+{
+    const char *p = buffer, *e;
+    int n = strlen(name);
+
+    value[0] = '\0';
+
+    while((p = strchr(p, '\n')) != NULL) {
+        p++;
+        if(strncasecmp(p, name, n) != 0)
+            continue;
+
+        p += n;
+        while(*p == ' ' || *p == '\t')
+            p++;
+        for(e = p; *e != '\0' && *e != '\r' && *e != '\n'; e++);
+
+        n = e - p;
+        if(n >= size)
+            n = size - 1;
+        memcpy(value, p, n);
+        value[n] = '\0';
+        return;
+    }
+}
+
+/******************************************************************************
+Description.: parse the request line and the headers this server needs
+Input Value.: * buffer.: the request, zero terminated
+              * req....: receives the parsed values
+Return Value: 0 if ok, -1 if the request line is malformed
+******************************************************************************/
+int rtsp_parse_request(const char *buffer, rtsp_request *req)
+{
+    char value[64];
+
+    memset(req, 0, sizeof(rtsp_request));
+
+    if(sscanf(buffer, "%31s %511s RTSP/", req->method, req->url) != 2)
+        return -1;
+
+    header_value(buffer, "CSeq:", value, sizeof(value));
+    req->cseq = atoi(value);
+    header_value(buffer, "Session:", req->session, sizeof(req->session));
+    header_value(buffer, "Transport:", req->transport, sizeof(req->transport));
+
+    /* the session header may carry a timeout */
+    req->session[strcspn(req->session, ";")] = '\0';
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: find a parameter of the first transport specification
+Input Value.: * transport: value of the Transport header
+              * name...: name of the parameter, for example "client_port"
+              * value..: receives the value, empty for flags without value
+              * size...: size of value
+Return Value: value if the parameter exists, NULL otherwise
+******************************************************************************/
+char *rtsp_transport_param(const char *transport, const char *name, char *value, int size)
+{
+    const char *p = transport, *e;
+    int n = strlen(name), len;
+
+    while(*p != '\0' && *p != ',') {
+        for(e = p; *e != '\0' && *e != ';' && *e != ','; e++);
+
+        if(strncasecmp(p, name, n) == 0 && (p[n] == '=' || p + n == e)) {
+            len = (p[n] == '=') ? e - p - n - 1 : 0;
+            if(len >= size)
+                len = size - 1;
+            memcpy(value, p + n + 1, len);
+            value[len] = '\0';
+            return value;
+        }
+
+        p = (*e == ';') ? e + 1 : e;
+    }
 
+    return NULL;
 }
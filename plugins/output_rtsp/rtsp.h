@@ -0,0 +1,113 @@
+/*******************************************************************************
+#                                                                              #
+#      MJPG-streamer allows to stream JPG frames from an input-plugin          #
+#      to several output plugins                                               #
+#                                                                              #
+#      Copyright (C) 2007 Tom Stöveken                                         #
+#                                                                              #
+# This program is free software; you can redistribute it and/or modify         #
+# it under the terms of the GNU General Public License as published by         #
+# the Free Software Foundation; version 2 of the License.                      #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU General Public License for more details.                                 #
+#                                                                              #
+# You should have received a copy of the GNU General Public License            #
+# along with this program; if not, write to the Free Software                  #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA    #
+#                                                                              #
+*******************************************************************************/
+
+#ifndef RTSP_H
+#define RTSP_H
+
+#include <sys/uio.h>
+
+/* static payload type of JPEG, see RFC 3551 */
+#define RTP_PT_JPEG 26
+#define RTP_CLOCK_RATE 90000
+
+/* dynamic payload type of the XOR FEC packets (RFC 5109) */
+#define RTP_PT_FEC 127
+/* RTP header, FEC header and FEC level 0 header with a 16 bit mask */
+#define RTP_FEC_OVERHEAD (12 + 10 + 4)
+/* the 16 bit mask limits the number of packets protected together */
+#define RTP_FEC_MAX_GROUP 16
+
+/* RTP header, JPEG header, restart marker header and quantization tables */
+#define RTP_HEADER_MAX (12 + 8 + 4 + 4 + 128)
+
+/* default size of RTP packets, leaves room for IP and UDP headers */
+#define RTP_DEFAULT_MTU 1400
+
+#define RTSP_BUFFER_SIZE 4096
+
+/* the payload header of RFC 2435 can only describe such frames */
+typedef struct _rtp_jpeg rtp_jpeg;
+struct _rtp_jpeg {
+    int type;                       // 0 for 4:2:2, 1 for 4:2:0, +64 with restart markers
+    int width, height;
+    int restart_interval;
+    unsigned char qtables[128];     // luminance and chrominance table, zig-zag order
+    const unsigned char *scan;      // entropy coded data without the EOI marker
+    int scan_len;
+};
+
+/* one packet refers to its header and to a part of the frame */
+typedef struct _rtp_packet rtp_packet;
+struct _rtp_packet {
+    unsigned char header[RTP_HEADER_MAX];
+    int header_len;
+    const unsigned char *payload;
+    int payload_len;
+};
+
+/* a parity packet that allows to recover one lost packet of its group */
+typedef struct _rtp_fec_packet rtp_fec_packet;
+struct _rtp_fec_packet {
+    unsigned char *data;    // mtu + RTP_FEC_OVERHEAD bytes
+    int len;
+    int last;               // index of the last media packet it protects
+};
+
+/* all sessions receive the same packets, so the stream state is shared */
+typedef struct _rtp_stream rtp_stream;
+struct _rtp_stream {
+    unsigned int ssrc;
+    unsigned short seq;
+    int mtu;
+
+    /* packets of the current frame, the array only grows */
+    rtp_packet *packets;
+    int count;
+    int allocated;
+
+    /* FEC packets of the current frame, they have their own sequence */
+    rtp_fec_packet *fec;
+    int fec_count;
+    int fec_allocated;
+    unsigned short fec_seq;
+};
+
+/* the parts of a RTSP request this server deals with */
+typedef struct _rtsp_request rtsp_request;
+struct _rtsp_request {
+    char method[32];
+    char url[512];
+    int cseq;
+    char session[64];
+    char transport[256];
+};
+
+int rtp_jpeg_parse(const unsigned char *data, int len, rtp_jpeg *jpg);
+int rtp_jpeg_packetize(rtp_stream *st, const rtp_jpeg *jpg, unsigned int timestamp);
+int rtp_fec_protect(rtp_stream *st, int group);
+void rtp_stream_free(rtp_stream *st);
+
+int rtsp_parse_request(const char *buffer, rtsp_request *req);
+int rtsp_request_length(const char *buffer, int len);
+char *rtsp_transport_param(const char *transport, const char *name, char *value, int size);
+
+#endif
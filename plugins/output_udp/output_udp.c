@@ -26,8 +26,33 @@
   Version 0.1, May 2010
 
   It provides a mechanism to take snapshots with a trigger from a UDP packet.
-  The UDP msg contains the path for the snapshot jpeg file
-  It echoes the message received back to the sender, after taking the snapshot
+  The UDP msg contains the path for the snapshot jpeg file, relative to the
+  output folder. It echoes the message received back to the sender, after
+  taking the snapshot.
+
+  In stream mode the plugin pushes every frame to the subscribed receivers
+  as soon as it arrives. A receiver sends "SUBSCRIBE" to the UDP port and
+  gets "SUBSCRIBE <token>" back, a random token of 16 hex digits. Frames are
+  only sent after the receiver returned "SUBSCRIBE <token>", so a forged
+  sender address does not get a stream. The receiver has to repeat
+  "SUBSCRIBE <token>" within the keepalive time, otherwise it is dropped.
+  "UNSUBSCRIBE <token>" ends the subscription at once. Messages with the
+  token are echoed back to the receiver.
+
+  A frame is split into fragments that fit into the MTU, every datagram
+  starts with this header, all fields in network byte order:
+
+    offset  size
+       0     2   magic "MJ"
+       2     1   version (1)
+       3     1   flags (0)
+       4     4   frame sequence number
+       8     2   fragment index
+      10     2   fragment count
+      12     4   frame size in bytes
+      16     8   timestamp of the frame in microseconds since the epoch
+
+  Fragment i carries the bytes starting at i * (MTU - 24) of the frame.
 */
 
 #include <stdio.h>
@@ -43,6 +68,7 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <getopt.h>
 #include <pthread.h>
 #include <fcntl.h>
@@ -56,14 +82,24 @@
 
 #define OUTPUT_PLUGIN_NAME "UDP output plugin"
 
-enum RTSP_State {
-    RTSP_State_Setup,
-    RTSP_State_Playing,
-    RTSP_State_Paused,
-    RTSP_State_Teardown,
+#define UDP_MAGIC 0x4d4a
+#define UDP_VERSION 1
+#define UDP_HEADER_SIZE 24
+#define UDP_DEFAULT_MTU 1400
+#define MAX_PEERS 16
+
+/* a receiver of the stream */
+typedef struct _udp_peer udp_peer;
+struct _udp_peer {
+    int in_use;
+    int confirmed;          // the receiver returned the token
+    char token[17];
+    struct sockaddr_in addr;
+    struct timespec last_seen;
 };
 
-static pthread_t worker;
+static pthread_t worker, subscriber;
+static int stop_fd = -1, stopping = 0;
 static globals *pglobal;
 static int fd, delay, max_frame_size;
 static char *folder = "/tmp";
@@ -73,6 +109,19 @@ static int input_number = 0;
 
 // UDP port
 static int port = 0;
+static int sd = -1;
+
+/* stream mode */
+static int stream = 0, mtu = UDP_DEFAULT_MTU, keepalive = 5;
+static udp_peer peers[MAX_PEERS];
+static pthread_mutex_t peers_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* headers and buffers for sendmmsg, they only grow */
+static unsigned char *headers = NULL;
+static int headers_allocated = 0;
+static struct mmsghdr *msgs = NULL;
+static struct iovec *iovs = NULL;
+static int msgs_allocated = 0;
 
 /******************************************************************************
 Description.: print a help message
@@ -85,11 +134,17 @@ void help(void)
             " Help for output plugin..: "OUTPUT_PLUGIN_NAME"\n" \
             " ---------------------------------------------------------------\n" \
             " The following parameters can be passed to this plugin:\n\n" \
-            " [-f | --folder ]........: folder to save pictures\n" \
+            " [-f | --folder ]........: folder to save pictures, the requested names are relative to it\n" \
             " [-d | --delay ].........: delay after saving pictures in ms\n" \
             " [-c | --command ].......: execute command after saveing picture\n" \
             " [-p | --port ]..........: UDP port to listen for picture requests. UDP message is the filename to save\n\n" \
             " [-i | --input ].......: read frames from the specified input plugin (first input plugin between the arguments is the 0th)\n\n" \
+            " [-s | --stream ]........: push every frame to the receivers that subscribed\n" \
+            "                           with \"SUBSCRIBE\" to the UDP port and returned\n" \
+            "                           the token of the answer, instead of saving snapshots\n" \
+            " [-m | --mtu ]...........: maximum size of the datagrams in stream mode\n" \
+            " [-k | --keepalive ].....: seconds a receiver stays subscribed without\n" \
+            "                           repeating \"SUBSCRIBE <token>\"\n" \
             " ---------------------------------------------------------------\n");
 }
 
@@ -100,109 +155,158 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
-
-    first_run = 0;
     OPRINT("cleaning up ressources allocated by worker thread\n");
 
     if(frame != NULL) {
         free(frame);
+        frame = NULL;
     }
-    close(fd);
+    free(headers);
+    headers = NULL;
+    free(msgs);
+    msgs = NULL;
+    free(iovs);
+    iovs = NULL;
+    max_frame_size = headers_allocated = msgs_allocated = 0;
+    close(sd);
+    sd = -1;
+    close(stop_fd);
+    stop_fd = -1;
 }
 
 /******************************************************************************
-Description.: this is the main worker thread
-              it loops forever, grabs a fresh frame and stores it to file
-Input Value.:
-Return Value:
+Description.: build the path of a snapshot inside the output folder
+Input Value.: name as received, buffer for the path and its size
+Return Value: 0 if ok, -1 if the name is empty or leaves the folder
 ******************************************************************************/
-void *worker_thread(void *arg)
+static int snapshot_path(const char *udpbuffer, char *path, int size)
 {
-    int ok = 1, frame_size = 0, rc = 0;
-    char buffer1[1024] = {0};
+    char name[1024], *p;
+    int len;
+
+    snprintf(name, sizeof(name), "%s", udpbuffer);
+    len = strlen(name);
+
+    /* tools like netcat append a newline */
+    while(len > 0 && (name[len-1] == '\n' || name[len-1] == '\r'))
+        name[--len] = '\0';
+
+    if(len == 0 || name[0] == '/')
+        return -1;
+
+    /* no ".." component anywhere in the name */
+    for(p = name; (p = strstr(p, "..")) != NULL; p += 2) {
+        if((p == name || p[-1] == '/') && (p[2] == '\0' || p[2] == '/'))
+            return -1;
+    }
+
+    if(snprintf(path, size, "%s/%s", folder, name) >= size)
+        return -1;
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: wait for a fresh frame and copy it to the local buffer
+Input Value.: pointer to store the timestamp of the frame at, may be NULL
+Return Value: size of the frame, -1 if there is not enough memory or the
+              plugin is stopped
+******************************************************************************/
+static int grab_frame(struct timeval *timestamp)
+{
+    int frame_size;
     unsigned char *tmp_framebuffer = NULL;
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
+    DBG("waiting for fresh frame\n");
+    pthread_mutex_lock(&pglobal->in[input_number].db);
+    if(!stopping)
+        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
+    if(stopping) {
+        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        return -1;
+    }
+
+    /* read buffer */
+    frame_size = pglobal->in[input_number].size;
 
-    // set UDP server data structures ---------------------------
-    if(port <= 0) {
-        OPRINT("a valid UDP port must be provided\n");
-        return NULL;
+    /* check if buffer for frame is large enough, increase it if necessary */
+    if(frame_size > max_frame_size) {
+        DBG("increasing buffer size to %d\n", frame_size);
+
+        max_frame_size = frame_size + (1 << 16);
+        if((tmp_framebuffer = realloc(frame, max_frame_size)) == NULL) {
+            pthread_mutex_unlock(&pglobal->in[input_number].db);
+            LOG("not enough memory\n");
+            return -1;
+        }
+
+        frame = tmp_framebuffer;
     }
+
+    /* copy frame to our local buffer now */
+    memcpy(frame, pglobal->in[input_number].buf, frame_size);
+    if(timestamp != NULL)
+        *timestamp = pglobal->in[input_number].timestamp;
+
+    /* allow others to access the global buffer again */
+    pthread_mutex_unlock(&pglobal->in[input_number].db);
+
+    return frame_size;
+}
+
+/******************************************************************************
+Description.: take snapshots on request, the legacy mode of this plugin
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void snapshot_loop(void)
+{
+    int ok = 1, frame_size = 0, rc = 0;
+    char buffer1[1024] = {0};
+    char path[1024];
     struct sockaddr_in addr;
-    int sd;
     int bytes;
-    unsigned int addr_len = sizeof(addr);
+    socklen_t addr_len;
     char udpbuffer[1024] = {0};
-    sd = socket(PF_INET, SOCK_DGRAM, 0);
-    bzero(&addr, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port);
-    if(bind(sd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
-        perror("bind");
-    // -----------------------------------------------------------
 
     while(ok >= 0 && !pglobal->stop) {
         DBG("waiting for a UDP message\n");
 
         // UDP receive ---------------------------------------------
         memset(udpbuffer, 0, sizeof(udpbuffer));
-        bytes = recvfrom(sd, udpbuffer, sizeof(udpbuffer), 0, (struct sockaddr*)&addr, &addr_len);
+        addr_len = sizeof(addr);
+        if(stop_event_poll(stop_fd, sd, POLLIN) != 0)
+            return;
+        bytes = recvfrom(sd, udpbuffer, sizeof(udpbuffer) - 1, 0, (struct sockaddr*)&addr, &addr_len);
+        if(bytes < 0)
+            continue;
         // ---------------------------------------------------------
 
-
-
-        DBG("waiting for fresh frame\n");
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[input_number].db_update, &pglobal->in[input_number].db);
-
-        /* read buffer */
-        frame_size = pglobal->in[input_number].size;
-
-        /* check if buffer for frame is large enough, increase it if necessary */
-        if(frame_size > max_frame_size) {
-            DBG("increasing buffer size to %d\n", frame_size);
-
-            max_frame_size = frame_size + (1 << 16);
-            if((tmp_framebuffer = realloc(frame, max_frame_size)) == NULL) {
-                pthread_mutex_unlock(&pglobal->in[input_number].db);
-                LOG("not enough memory\n");
-                return NULL;
-            }
-
-            frame = tmp_framebuffer;
-        }
-
-        /* copy frame to our local buffer now */
-        memcpy(frame, pglobal->in[input_number].buf, frame_size);
-
-        /* allow others to access the global buffer again */
-        pthread_mutex_unlock(&pglobal->in[input_number].db);
+        if((frame_size = grab_frame(NULL)) < 0)
+            return;
 
         /* only save a file if a name came in with the UDP message */
+        path[0] = '\0';
         if(strlen(udpbuffer) > 0) {
-            DBG("writing file: %s\n", udpbuffer);
+            if(snapshot_path(udpbuffer, path, sizeof(path)) < 0) {
+                OPRINT("refusing to write the file \"%s\", it must be a name inside %s\n", udpbuffer, folder);
+                continue;
+            }
+
+            DBG("writing file: %s\n", path);
 
             /* open file for write. Path must pre-exist */
-            if((fd = open(udpbuffer, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
-                OPRINT("could not open the file %s\n", udpbuffer);
-                return NULL;
+            if((fd = open(path, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+                OPRINT("could not open the file %s\n", path);
+                continue;
             }
 
             /* save picture to file */
             if(write(fd, frame, frame_size) < 0) {
-                OPRINT("could not write to file %s\n", udpbuffer);
+                OPRINT("could not write to file %s\n", path);
                 perror("write()");
                 close(fd);
-                return NULL;
+                continue;
             }
 
             close(fd);
@@ -215,12 +319,12 @@ void *worker_thread(void *arg)
         if(command != NULL) {
             memset(buffer1, 0, sizeof(buffer1));
 
-            /* udpbuffer still contains the filename, pass it to the command as parameter */
-            snprintf(buffer1, sizeof(buffer1), "%s \"%s\"", command, udpbuffer);
+            /* pass the filename to the command as parameter */
+            snprintf(buffer1, sizeof(buffer1), "%s \"%s\"", command, path);
             DBG("calling command %s", buffer1);
 
             /* in addition provide the filename as environment variable */
-            if((rc = setenv("MJPG_FILE", udpbuffer, 1)) != 0) {
+            if((rc = setenv("MJPG_FILE", path, 1)) != 0) {
                 LOG("setenv failed (return value %d)\n", rc);
             }
 
@@ -231,17 +335,306 @@ void *worker_thread(void *arg)
         }
 
         /* if specified, wait now */
-        if(delay > 0) {
-            usleep(1000 * delay);
+        if(delay > 0 && stop_event_wait(stop_fd, delay)) {
+            return;
         }
     }
+}
 
-    // close UDP port
-    if(port > 0)
-        close(sd);
+/******************************************************************************
+Description.: make sure the sendmmsg buffers can hold a number of fragments
+              to a number of peers
+Input Value.: number of fragments and of peers
+Return Value: 0 if ok, -1 if there is not enough memory
+******************************************************************************/
+static int reserve_msgs(int fragments, int npeers)
+{
+    unsigned char *h;
+    struct mmsghdr *m;
+    struct iovec *v;
+    int count = fragments * npeers;
+
+    if(fragments > headers_allocated) {
+        if((h = realloc(headers, fragments * UDP_HEADER_SIZE)) == NULL)
+            return -1;
+        headers = h;
+        if((v = realloc(iovs, 2 * fragments * sizeof(struct iovec))) == NULL)
+            return -1;
+        iovs = v;
+        headers_allocated = fragments;
+    }
+
+    if(count > msgs_allocated) {
+        if((m = realloc(msgs, count * sizeof(struct mmsghdr))) == NULL)
+            return -1;
+        msgs = m;
+        msgs_allocated = count;
+    }
+
+    return 0;
+}
+
+static void put16(unsigned char *p, unsigned int v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put32(unsigned char *p, unsigned int v)
+{
+    put16(p, v >> 16);
+    put16(p + 2, v);
+}
+
+/******************************************************************************
+Description.: copy the addresses of the subscribed peers and drop the ones
+              that did not renew or confirm their subscription in time
+Input Value.: array to store the addresses at, MAX_PEERS entries
+Return Value: number of peers
+******************************************************************************/
+static int active_peers(struct sockaddr_in *dest)
+{
+    int i, n = 0;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&peers_mutex);
+    for(i = 0; i < MAX_PEERS; i++) {
+        if(!peers[i].in_use)
+            continue;
+
+        if(now.tv_sec - peers[i].last_seen.tv_sec > keepalive) {
+            if(peers[i].confirmed)
+                OPRINT("receiver %s:%d did not renew its subscription\n",
+                       inet_ntoa(peers[i].addr.sin_addr), ntohs(peers[i].addr.sin_port));
+            peers[i].in_use = 0;
+            continue;
+        }
+
+        if(peers[i].confirmed)
+            dest[n++] = peers[i].addr;
+    }
+    pthread_mutex_unlock(&peers_mutex);
+
+    return n;
+}
+
+/******************************************************************************
+Description.: push every frame to the subscribed peers
+Input Value.: -
+Return Value: -
+******************************************************************************/
+static void stream_loop(void)
+{
+    struct sockaddr_in dest[MAX_PEERS];
+    struct timeval timestamp;
+    unsigned long long usec;
+    unsigned int seq = 0;
+    int i, j, n, sent, frame_size, fragments, npeers, payload = mtu - UDP_HEADER_SIZE;
+    unsigned char *h;
+
+    while(!pglobal->stop) {
+        if((frame_size = grab_frame(&timestamp)) < 0)
+            return;
+
+        seq++;
+
+        if((npeers = active_peers(dest)) == 0)
+            continue;
+
+        fragments = (frame_size + payload - 1) / payload;
+        if(fragments == 0 || fragments > 0xffff) {
+            DBG("frame of %d bytes can not be sent\n", frame_size);
+            continue;
+        }
+
+        if(reserve_msgs(fragments, npeers) < 0) {
+            LOG("not enough memory\n");
+            return;
+        }
+
+        if(timestamp.tv_sec == 0 && timestamp.tv_usec == 0)
+            gettimeofday(&timestamp, NULL);
+        usec = (unsigned long long)timestamp.tv_sec * 1000000 + timestamp.tv_usec;
+
+        /* the headers and vectors of a fragment are shared by all peers */
+        for(i = 0; i < fragments; i++) {
+            h = headers + i * UDP_HEADER_SIZE;
+            put16(h, UDP_MAGIC);
+            h[2] = UDP_VERSION;
+            h[3] = 0;
+            put32(h + 4, seq);
+            put16(h + 8, i);
+            put16(h + 10, fragments);
+            put32(h + 12, frame_size);
+            put32(h + 16, usec >> 32);
+            put32(h + 20, usec);
+
+            iovs[2*i].iov_base = h;
+            iovs[2*i].iov_len = UDP_HEADER_SIZE;
+            iovs[2*i+1].iov_base = frame + i * payload;
+            iovs[2*i+1].iov_len = MIN(payload, frame_size - i * payload);
+        }
+
+        /* fragment by fragment, so no peer waits for the whole frame of another */
+        for(i = 0, n = 0; i < fragments; i++) {
+            for(j = 0; j < npeers; j++, n++) {
+                memset(&msgs[n], 0, sizeof(struct mmsghdr));
+                msgs[n].msg_hdr.msg_name = &dest[j];
+                msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+                msgs[n].msg_hdr.msg_iov = &iovs[2*i];
+                msgs[n].msg_hdr.msg_iovlen = 2;
+            }
+        }
+
+        for(i = 0; i < n;) {
+            sent = sendmmsg(sd, &msgs[i], n - i, 0);
+            if(sent < 0) {
+                if(errno == EINTR)
+                    continue;
+                /* a single unreachable receiver must not stop the others */
+                DBG("sendmmsg failed: %s\n", strerror(errno));
+                i++;
+                continue;
+            }
+            i += sent;
+        }
+    }
+}
 
-    /* cleanup now */
-    pthread_cleanup_pop(1);
+/******************************************************************************
+Description.: this is the main worker thread
+              it loops forever, grabs a fresh frame and stores it to file
+              or sends it to the subscribed peers
+Input Value.:
+Return Value:
+******************************************************************************/
+void *worker_thread(void *arg)
+{
+    if(stream)
+        stream_loop();
+    else
+        snapshot_loop();
+
+    return NULL;
+}
+
+/******************************************************************************
+Description.: create the token a receiver has to return to get the stream
+Input Value.: buffer for 16 hex digits and the terminating zero
+Return Value: 0 if ok, -1 if there is no random number
+******************************************************************************/
+static int new_token(char *token)
+{
+    unsigned char bytes[8];
+    int fd, i, n;
+
+    if((fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    n = read(fd, bytes, sizeof(bytes));
+    close(fd);
+    if(n != sizeof(bytes))
+        return -1;
+
+    for(i = 0; i < 8; i++)
+        sprintf(token + 2 * i, "%02x", bytes[i]);
+
+    return 0;
+}
+
+/******************************************************************************
+Description.: receives the subscriptions and keepalives of the stream mode.
+              A new receiver only gets a token, the stream starts when it sends
+              the token back, which it can only if the address is its own.
+Input Value.:
+Return Value:
+******************************************************************************/
+void *subscriber_thread(void *arg)
+{
+    char buffer[64], *token;
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+    int i, bytes, found, oldest, subscribe;
+    udp_peer *p;
+
+    while(!pglobal->stop) {
+        addr_len = sizeof(addr);
+        if(stop_event_poll(stop_fd, sd, POLLIN) != 0)
+            break;
+        if((bytes = recvfrom(sd, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *)&addr, &addr_len)) < 0)
+            continue;
+        buffer[bytes] = '\0';
+
+        if(strncmp(buffer, "SUBSCRIBE", 9) == 0) {
+            subscribe = 1;
+            token = buffer + 9;
+        } else if(strncmp(buffer, "UNSUBSCRIBE", 11) == 0) {
+            subscribe = 0;
+            token = buffer + 11;
+        } else {
+            DBG("ignoring message from %s:%d\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+            continue;
+        }
+        if(*token == ' ')
+            token++;
+        token[strcspn(token, "\r\n")] = '\0';
+        bytes = strlen(buffer);
+
+        pthread_mutex_lock(&peers_mutex);
+        for(i = 0, found = -1, oldest = -1; i < MAX_PEERS; i++) {
+            p = &peers[i];
+            if(p->in_use && p->addr.sin_addr.s_addr == addr.sin_addr.s_addr && p->addr.sin_port == addr.sin_port) {
+                found = i;
+                break;
+            }
+            if(!p->in_use && found < 0)
+                found = -2 - i;
+            /* unconfirmed receivers make room for new ones, so forged requests can not fill the table */
+            if(p->in_use && !p->confirmed && (oldest < 0 || p->last_seen.tv_sec < peers[oldest].last_seen.tv_sec))
+                oldest = i;
+        }
+        if(found == -1 && oldest >= 0)
+            found = -2 - oldest;
+
+        if(subscribe && *token == '\0') {
+            /* a new receiver gets a token, a known one the token it has */
+            if(found == -1) {
+                pthread_mutex_unlock(&peers_mutex);
+                OPRINT("too many receivers, refusing %s:%d\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+                continue;
+            }
+            if(found < -1) {
+                p = &peers[-2 - found];
+                if(new_token(p->token) < 0) {
+                    pthread_mutex_unlock(&peers_mutex);
+                    perror("could not create a token");
+                    continue;
+                }
+                p->in_use = 1;
+                p->confirmed = 0;
+                p->addr = addr;
+                clock_gettime(CLOCK_MONOTONIC, &p->last_seen);
+            }
+            bytes = snprintf(buffer, sizeof(buffer), "SUBSCRIBE %s", p->token);
+        } else if(found < 0 || strcmp(token, peers[found].token) != 0) {
+            pthread_mutex_unlock(&peers_mutex);
+            DBG("wrong token from %s:%d\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+            continue;
+        } else if(subscribe) {
+            p = &peers[found];
+            if(!p->confirmed)
+                OPRINT("receiver %s:%d subscribed\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+            p->confirmed = 1;
+            clock_gettime(CLOCK_MONOTONIC, &p->last_seen);
+        } else {
+            peers[found].in_use = 0;
+            OPRINT("receiver %s:%d unsubscribed\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+        }
+        pthread_mutex_unlock(&peers_mutex);
+
+        sendto(sd, buffer, bytes, 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
 
     return NULL;
 }
@@ -283,6 +676,12 @@ int output_init(output_parameter *param)
             {"port", required_argument, 0, 0},
             {"i", required_argument, 0, 0},
             {"input", required_argument, 0, 0},
+            {"s", no_argument, 0, 0},
+            {"stream", no_argument, 0, 0},
+            {"m", required_argument, 0, 0},
+            {"mtu", required_argument, 0, 0},
+            {"k", required_argument, 0, 0},
+            {"keepalive", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -341,6 +740,24 @@ int output_init(output_parameter *param)
             DBG("case 10,11\n");
             input_number = atoi(optarg);
             break;
+            /* s, stream */
+        case 12:
+        case 13:
+            DBG("case 12,13\n");
+            stream = 1;
+            break;
+            /* m, mtu */
+        case 14:
+        case 15:
+            DBG("case 14,15\n");
+            mtu = atoi(optarg);
+            break;
+            /* k, keepalive */
+        case 16:
+        case 17:
+            DBG("case 16,17\n");
+            keepalive = atoi(optarg);
+            break;
         }
     }
 
@@ -349,10 +766,24 @@ int output_init(output_parameter *param)
         OPRINT("ERROR: the %d input_plugin number is too much only %d plugins loaded\n", input_number, pglobal->incnt);
         return 1;
     }
+    if(mtu < UDP_HEADER_SIZE + 64 || mtu > 65000) {
+        OPRINT("ERROR: the MTU must be between %d and 65000\n", UDP_HEADER_SIZE + 64);
+        return 1;
+    }
+    if(keepalive < 1) {
+        OPRINT("ERROR: the keepalive time must be at least one second\n");
+        return 1;
+    }
     OPRINT("input plugin.....: %d: %s\n", input_number, pglobal->in[input_number].plugin);
-    OPRINT("output folder.....: %s\n", folder);
-    OPRINT("delay after save..: %d\n", delay);
-    OPRINT("command...........: %s\n", (command == NULL) ? "disabled" : command);
+    if(stream) {
+        OPRINT("mode..............: stream to subscribed receivers\n");
+        OPRINT("MTU...............: %d\n", mtu);
+        OPRINT("keepalive.........: %d s\n", keepalive);
+    } else {
+        OPRINT("output folder.....: %s\n", folder);
+        OPRINT("delay after save..: %d\n", delay);
+        OPRINT("command...........: %s\n", (command == NULL) ? "disabled" : command);
+    }
     if(port > 0) {
         OPRINT("UDP port..........: %d\n", port);
     } else {
@@ -364,26 +795,84 @@ int output_init(output_parameter *param)
 /******************************************************************************
 Description.: calling this function stops the worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the threads finished, -1 if they did not in time
 ******************************************************************************/
 int output_stop(int id)
 {
-    DBG("will cancel worker thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+    int rc = 0;
+
+    /* loaded but never run, there is no thread */
+    if(stop_fd < 0)
+        return 0;
+
+    DBG("will stop worker thread\n");
+    stop_deadline(&deadline);
+
+    /* wake up the threads, they wait for a frame, a message or the delay */
+    pthread_mutex_lock(&pglobal->in[input_number].db);
+    stopping = 1;
+    pthread_cond_broadcast(&pglobal->in[input_number].db_update);
+    pthread_mutex_unlock(&pglobal->in[input_number].db);
+    stop_event_set(stop_fd);
+
+    if(join_thread(worker, &deadline) != 0)
+        rc = -1;
+    if(stream && join_thread(subscriber, &deadline) != 0)
+        rc = -1;
+
+    if(rc != 0) {
+        OPRINT("the threads did not finish in time\n");
+        return -1;
+    }
+
+    worker_cleanup(NULL);
     return 0;
 }
 
 /******************************************************************************
-Description.: calling this function creates and starts the worker thread
+Description.: calling this function opens the UDP port and starts the threads
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if ok, 1 if the port could not be opened
 ******************************************************************************/
 int output_run(int id)
 {
+    struct sockaddr_in addr;
+
+    // set UDP server data structures ---------------------------
+    if(port <= 0) {
+        OPRINT("a valid UDP port must be provided\n");
+        return 1;
+    }
+
+    if((sd = socket(PF_INET, SOCK_DGRAM, 0)) < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if(bind(sd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        close(sd);
+        return 1;
+    }
+    // -----------------------------------------------------------
+
+    stopping = 0;
+    if((stop_fd = stop_event_open()) < 0) {
+        perror("could not create the stop event");
+        close(sd);
+        return 1;
+    }
+
     DBG("launching worker thread\n");
     pthread_create(&worker, 0, worker_thread, NULL);
-    pthread_detach(worker);
+
+    if(stream) {
+        pthread_create(&subscriber, 0, subscriber_thread, NULL);
+    }
     return 0;
 }
-
-
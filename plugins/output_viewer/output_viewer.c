@@ -37,8 +37,10 @@
 #define OUTPUT_PLUGIN_NAME "VIEWER output plugin"
 
 static pthread_t worker;
+static int stopping = 0, running = 0;
 static globals *pglobal;
 static unsigned char *frame = NULL;
+static int max_frame_size;
 static int plugin_number;
 
 
@@ -62,17 +64,11 @@ Return Value: -
 ******************************************************************************/
 void worker_cleanup(void *arg)
 {
-    static unsigned char first_run = 1;
-
-    if(!first_run) {
-        DBG("already cleaned up ressources\n");
-        return;
-    }
-
-    first_run = 0;
     OPRINT("cleaning up ressources allocated by worker thread\n");
 
     free(frame);
+    frame = NULL;
+    max_frame_size = 0;
     SDL_Quit();
 }
 
@@ -255,6 +251,7 @@ Return Value:
 void *worker_thread(void *arg)
 {
     int frame_size = 0, firstrun = 1;
+    unsigned char *tmp = NULL;
 
     SDL_Surface *screen = NULL, *image = NULL;
     decompressed_image rgbimage;
@@ -266,25 +263,35 @@ void *worker_thread(void *arg)
     /* initialze the SDL video subsystem */
     if(SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
-        exit(EXIT_FAILURE);
-    }
-
-    /* just allocate a large buffer for the JPEGs */
-    if((frame = malloc(4096 * 1024)) == NULL) {
-        OPRINT("not enough memory for worker thread\n");
-        exit(EXIT_FAILURE);
+        return NULL;
     }
 
-    /* set cleanup handler to cleanup allocated ressources */
-    pthread_cleanup_push(worker_cleanup, NULL);
-
     while(!pglobal->stop) {
         DBG("waiting for fresh frame\n");
-        pthread_mutex_lock(&pglobal->in[input_number].db);
-        pthread_cond_wait(&pglobal->in[plugin_number].db_update, &pglobal->in[plugin_number].db);
+        pthread_mutex_lock(&pglobal->in[plugin_number].db);
+        if(!stopping)
+            pthread_cond_wait(&pglobal->in[plugin_number].db_update, &pglobal->in[plugin_number].db);
+        if(stopping) {
+            pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+            break;
+        }
 
         /* read buffer */
         frame_size = pglobal->in[plugin_number].size;
+
+        /* check if buffer for frame is large enough, increase it if necessary */
+        if(frame_size > max_frame_size) {
+            DBG("increasing buffer size to %d\n", frame_size);
+
+            if((tmp = realloc(frame, frame_size + (1 << 16))) == NULL) {
+                pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+                LOG("not enough memory\n");
+                break;
+            }
+            frame = tmp;
+            max_frame_size = frame_size + (1 << 16);
+        }
+
         memcpy(frame, pglobal->in[plugin_number].buf, frame_size);
 
         pthread_mutex_unlock(&pglobal->in[plugin_number].db);
@@ -327,10 +334,11 @@ void *worker_thread(void *arg)
         SDL_Flip(screen);
     }
 
-    pthread_cleanup_pop(1);
-
-    /* get rid of the image */
-    SDL_FreeSurface(image);
+    /* get rid of the image, before the first frame it is not a surface yet */
+    if(firstrun)
+        free(rgbimage.buffer);
+    else
+        SDL_FreeSurface(image);
 
     return NULL;
 }
@@ -399,12 +407,32 @@ int output_init(output_parameter *param)
 /******************************************************************************
 Description.: calling this function stops the worker thread
 Input Value.: -
-Return Value: always 0
+Return Value: 0 if the thread finished, -1 if it did not in time
 ******************************************************************************/
 int output_stop(int id)
 {
-    DBG("will cancel worker thread\n");
-    pthread_cancel(worker);
+    struct timespec deadline;
+
+    /* loaded but never run, there is no thread */
+    if(!running)
+        return 0;
+
+    DBG("will stop worker thread\n");
+    stop_deadline(&deadline);
+
+    /* the thread only ever waits for a frame */
+    pthread_mutex_lock(&pglobal->in[plugin_number].db);
+    stopping = 1;
+    pthread_cond_broadcast(&pglobal->in[plugin_number].db_update);
+    pthread_mutex_unlock(&pglobal->in[plugin_number].db);
+
+    if(join_thread(worker, &deadline) != 0) {
+        OPRINT("worker thread did not finish in time\n");
+        return -1;
+    }
+
+    running = 0;
+    worker_cleanup(NULL);
     return 0;
 }
 
@@ -416,8 +444,9 @@ Return Value: always 0
 int output_run(int id)
 {
     DBG("launching worker thread\n");
+    stopping = 0;
+    running = 1;
     pthread_create(&worker, 0, worker_thread, NULL);
-    pthread_detach(worker);
     return 0;
 }
 
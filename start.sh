@@ -68,6 +68,9 @@ export LD_LIBRARY_PATH="$(pwd)"
 ## If you want to track down errors, use this simple testpicture plugin as input source.
 ## to use the testpicture input plugin instead of a webcam or folder:
 #./mjpg_streamer -i "input_testpicture.so -r 320x240 -d 500" -o "output_http.so -w www"
+## as load generator: a 4K test pattern at 60 fps, frames of 500 to 1500 KiB
+## carrying their sequence number and timestamp
+#./mjpg_streamer -i "input_testpicture.so -r 3840x2160 -f 60 -s 500:1500 -o" -o "output_http.so -w www"
 
 ## The input_file.so plugin watches a folder for new files, it does not matter where
 ## the JPEG files orginate from. For instance it is possible to grab the desktop and 
@@ -80,6 +83,10 @@ export LD_LIBRARY_PATH="$(pwd)"
 ## To upload files to a FTP server (edit the script first)
 # ./mjpg_streamer -i input_testpicture.so -o "output_file.so --command plugins/output_file/examples/ftp_upload.sh"
 
+## To detect motion of the first camera, the result can be fetched as JSON from
+## http://127.0.0.1:8080/motion_0.json
+# ./mjpg_streamer -i input_uvc.so -o "output_http.so -w www" -o "output_motion.so -i 0 -t 12 -l 10"
+
 ## To create a control only interface useful for controlling the pan/tilt throug
 ## a webpage while another program streams video/audio, like skype.
 #./mjpg_streamer -i "./input_control.so" -o "./output_http.so -w ./www"
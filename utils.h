@@ -20,6 +20,18 @@
 #                                                                              #
 *******************************************************************************/
 
+#ifndef UTILS_H
+#define UTILS_H
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
 #define ABS(a) (((a) < 0) ? -(a) : (a))
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
@@ -48,4 +60,148 @@ static inline void reset_getopt(void)
 #endif
 }
 
+/* the time the threads of a plugin get to finish after it was asked to stop */
+#define STOP_TIMEOUT_MS 500
+
+/******************************************************************************
+Description.: create the event that wakes up the threads of a plugin when it
+              is asked to stop, the threads wait for it with poll() or select()
+              together with the file descriptors they wait for anyway
+Input Value.: -
+Return Value: file descriptor of the event or -1
+******************************************************************************/
+static inline int stop_event_open(void)
+{
+    return eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+/******************************************************************************
+Description.: set the event, it stays set until it is closed
+Input Value.: file descriptor of the event
+Return Value: -
+******************************************************************************/
+static inline void stop_event_set(int fd)
+{
+    uint64_t one = 1;
+
+    if(write(fd, &one, sizeof(one)) != sizeof(one))
+        perror("could not set the stop event");
+}
+
+/******************************************************************************
+Description.: reset the event, only for events that are set more than once
+Input Value.: file descriptor of the event
+Return Value: -
+******************************************************************************/
+static inline void stop_event_clear(int fd)
+{
+    uint64_t count;
+
+    if(read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        perror("could not reset the event");
+}
+
+/******************************************************************************
+Description.: sleep until the timeout or until the event is set
+Input Value.: fd: the event
+              timeout_ms: time to sleep, 0 only checks the event, -1 sleeps
+                          until the event is set
+Return Value: 1 if the event is set, 0 after the timeout
+******************************************************************************/
+static inline int stop_event_wait(int fd, int timeout_ms)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int rc;
+
+    do {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while(rc < 0 && errno == EINTR);
+
+    return rc > 0;
+}
+
+/******************************************************************************
+Description.: like stop_event_wait() but sleep until a point in time
+Input Value.: fd: the event
+              until: CLOCK_MONOTONIC time to wake up at
+Return Value: 1 if the event is set, 0 after the timeout
+******************************************************************************/
+static inline int stop_event_wait_until(int fd, const struct timespec *until)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    struct timespec now, left;
+    int rc;
+
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = until->tv_sec - now.tv_sec;
+        left.tv_nsec = until->tv_nsec - now.tv_nsec;
+        if(left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000L;
+        }
+        if(left.tv_sec < 0)
+            left.tv_sec = left.tv_nsec = 0;
+        rc = ppoll(&pfd, 1, &left, NULL);
+    } while(rc < 0 && errno == EINTR);
+
+    return rc > 0;
+}
+
+/******************************************************************************
+Description.: wait until a file descriptor is ready or the event is set, the
+              threads call this before a read(), accept() or ioctl() that
+              would block
+Input Value.: stop_fd: the event
+              fd: file descriptor to wait for
+              events: POLLIN or POLLOUT
+Return Value: 1 if the event is set, 0 if fd is ready, -1 on errors
+******************************************************************************/
+static inline int stop_event_poll(int stop_fd, int fd, short events)
+{
+    struct pollfd pfd[2] = {
+        { .fd = stop_fd, .events = POLLIN },
+        { .fd = fd, .events = events }
+    };
+    int rc;
+
+    do {
+        rc = poll(pfd, 2, -1);
+    } while(rc < 0 && errno == EINTR);
+
+    if(rc < 0)
+        return -1;
+
+    return (pfd[0].revents & POLLIN) ? 1 : 0;
+}
+
+/******************************************************************************
+Description.: the point in time until a stopped plugin waits for its threads
+Input Value.: deadline to fill in
+Return Value: -
+******************************************************************************/
+static inline void stop_deadline(struct timespec *deadline)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += STOP_TIMEOUT_MS / 1000;
+    deadline->tv_nsec += (STOP_TIMEOUT_MS % 1000) * 1000000L;
+    if(deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/******************************************************************************
+Description.: wait for a thread to finish, but not beyond the deadline
+Input Value.: thread: the thread to join
+              deadline: from stop_deadline()
+Return Value: 0 if the thread finished, else it is still running
+******************************************************************************/
+static inline int join_thread(pthread_t thread, const struct timespec *deadline)
+{
+    return pthread_timedjoin_np(thread, NULL, deadline);
+}
+
 void daemon_mode(void);
+
+#endif